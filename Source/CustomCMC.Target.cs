@@ -10,6 +10,7 @@ public class CustomCMCTarget : TargetRules
 		Type = TargetType.Game;
 		DefaultBuildSettings = BuildSettingsVersion.V5;
 		IncludeOrderVersion = EngineIncludeOrderVersion.Unreal5_6;
+		bWithPushModel = true;
 		ExtraModuleNames.Add("CustomCMC");
 	}
 }
@@ -18,11 +18,19 @@ public class CustomCMC : ModuleRules
 			"StateTreeModule",
 			"GameplayStateTreeModule",
 			"UMG",
-			"MotionWarping"
+			"MotionWarping",
+			"NetCore",
+			"ReplicationGraph"
 		});
 
 		PrivateDependencyModuleNames.AddRange(new string[] { });
 
+		// CustomCMC.Net.Stress drives Play In Editor sessions
+		if (Target.bBuildEditor)
+		{
+			PrivateDependencyModuleNames.Add("UnrealEd");
+		}
+
 		PublicIncludePaths.AddRange(new string[] {
 			"CustomCMC",
 			"CustomCMC/Variant_Platforming",
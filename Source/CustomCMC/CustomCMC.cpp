@@ -2,6 +2,19 @@
 
 #include "CustomCMC.h"
 #include "Modules/ModuleManager.h"
+#include "Engine/World.h"
+
+UE_TRACE_CHANNEL_DEFINE(CustomCMCChannel);
+
+bool CustomCMC::ShouldRunCosmetics(const UObject* WorldContextObject)
+{
+#if UE_SERVER
+	return false;
+#else
+	const UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World && World->GetNetMode() != NM_DedicatedServer;
+#endif
+}
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, CustomCMC, "CustomCMC" );
  
\ No newline at end of file
@@ -3,3 +3,25 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+DECLARE_STATS_GROUP(TEXT("CustomCMC"), STATGROUP_CustomCMC, STATCAT_Advanced);
+
+// Insights channel for movement scopes in builds without stats, enable with -trace=cpu,CustomCMC
+UE_TRACE_CHANNEL_EXTERN(CustomCMCChannel, CUSTOMCMC_API);
+
+// One profiler scope per call. With stats, the cycle stat for `stat CustomCMC`, which already shows in Insights on the
+// cpu channel. Without stats, where the cycle stat compiles out, a named scope on the CustomCMC channel
+#if STATS
+#define CUSTOMCMC_SCOPE(Stat) SCOPE_CYCLE_COUNTER(Stat)
+#else
+#define CUSTOMCMC_SCOPE(Stat) TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(Stat, CustomCMCChannel)
+#endif
+
+namespace CustomCMC
+{
+	// False in the CustomCMCServer target and on dedicated servers run from a game or editor build.
+	// Widgets, cameras, debug output and montages only other players see are skipped then
+	CUSTOMCMC_API bool ShouldRunCosmetics(const UObject* WorldContextObject);
+}
@@ -2,7 +2,12 @@
 
 #include "CustomCMCCharacter.h"
 
+#include "CustomCMC.h"
 #include "CustomCharacterMovementComponent.h"
+#include "CustomCMCReplicationGraph.h"
+#include "MovementModeCounters.h"
+#include "Engine/ActorChannel.h"
+#include "Engine/NetDriver.h"
 #include "Engine/LocalPlayer.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
@@ -12,9 +17,12 @@
 #include "EnhancedInputComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "InputActionValue.h"
+#include "Net/DataBunch.h"
 
 DEFINE_LOG_CATEGORY(LogTemplateCharacter);
 
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Ignore Params Rebuilds"), STAT_IgnoreParamsRebuilds, STATGROUP_CustomCMC);
+
 void ACustomCMCCharacter::Jump()
 {
 	Super::Jump();
@@ -190,15 +198,113 @@ void ACustomCMCCharacter::DoJumpEnd()
 }
 
 
-FCollisionQueryParams ACustomCMCCharacter::GetIgnoreCharacterParams() const
+void ACustomCMCCharacter::PostInitializeComponents()
 {
-	FCollisionQueryParams Params;
+	Super::PostInitializeComponents();
+
+	RefreshIgnoreCharacterParams();
+
+	// Nobody looks through a server's camera, stop the boom's per-tick collision probe
+	if (!CustomCMC::ShouldRunCosmetics(this))
+	{
+		CameraBoom->SetComponentTickEnabled(false);
+	}
+}
+
+void ACustomCMCCharacter::RefreshIgnoreCharacterParams(const AActor* ExcludedChild)
+{
+	INC_DWORD_STAT(STAT_IgnoreParamsRebuilds);
+
+	IgnoreCharacterParams = FCollisionQueryParams(SCENE_QUERY_STAT(CustomCharacterMovement), false, this);
 
 	TArray<AActor*> CharacterChildren;
 	GetAllChildActors(CharacterChildren);
-	Params.AddIgnoredActors(CharacterChildren);
-	Params.AddIgnoredActor(this);
+	CharacterChildren.Remove(const_cast<AActor*>(ExcludedChild));
+	IgnoreCharacterParams.AddIgnoredActors(CharacterChildren);
+
+	// A child going away has to drop out of the ignore list
+	for (AActor* Child : CharacterChildren)
+	{
+		Child->OnDestroyed.AddUniqueDynamic(this, &ACustomCMCCharacter::OnChildActorDestroyed);
+	}
+}
+
+void ACustomCMCCharacter::UpdateNetUpdateRate(bool bMovementModeChanged)
+{
+	const UCustomCharacterMovementComponent* Movement = CustomCharacterMovementComponent;
+	if (!Movement) return;
+
+	// The ledge grab transition is a root motion source run in MOVE_Flying
+	const bool bTransition = Movement->MovementMode == MOVE_Flying && Movement->HasRootMotionSources();
+	const bool bStill = Movement->Velocity.SizeSquared() < FMath::Square(IdleNetSpeed);
+
+	float Frequency = MovingNetUpdateFrequency;
+	float Priority = MovingNetPriority;
+	if (bTransition || Movement->IsFalling())
+	{
+		Frequency = FastNetUpdateFrequency;
+		Priority = FastNetPriority;
+	}
+	else if (bStill && (Movement->IsMovingOnGround() || Movement->IsHanging()))
+	{
+		Frequency = IdleNetUpdateFrequency;
+		Priority = IdleNetPriority;
+	}
+
+	// The next update was scheduled at the old rate, a slower tier can wait for it but a faster one cannot
+	const bool bFrequencyRose = Frequency > GetNetUpdateFrequency();
+	if (Frequency != GetNetUpdateFrequency())
+	{
+		SetNetUpdateFrequency(Frequency);
+
+		// The replication graph keeps its own update period per actor
+		if (UCustomCMCReplicationGraph* Graph = GetNetDriver() ? Cast<UCustomCMCReplicationGraph>(GetNetDriver()->GetReplicationDriver()) : nullptr)
+		{
+			Graph->SetActorNetUpdateFrequency(this, Frequency);
+		}
+	}
+	NetPriority = Priority;
+
+	// Proxies see the new mode, or a character starting to move, now rather than at the old rate
+	if (bMovementModeChanged || bFrequencyRose)
+	{
+		ForceNetUpdate();
+	}
+}
+
+void ACustomCMCCharacter::PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker)
+{
+	Super::PreReplication(ChangedPropertyTracker);
+
+#if !UE_BUILD_SHIPPING
+	if (CustomCharacterMovementComponent)
+	{
+		++CustomCharacterMovementComponent->GetModeCounters().Get(FMovementModeCounters::GetMode(*CustomCharacterMovementComponent)).NetUpdates;
+	}
+#endif
+}
+
+bool ACustomCMCCharacter::ReplicateSubobjects(UActorChannel* Channel, FOutBunch* Bunch, FReplicationFlags* RepFlags)
+{
+	const bool bWroteSomething = Super::ReplicateSubobjects(Channel, Bunch, RepFlags);
 
-	return Params;
+#if !UE_BUILD_SHIPPING
+	// The bunch is this character's update for one connection, its own properties followed by its components'.
+	// Actors on the registered subobject list path or Iris never come through here
+	if (CustomCharacterMovementComponent && Bunch)
+	{
+		CustomCharacterMovementComponent->GetModeCounters().Get(FMovementModeCounters::GetMode(*CustomCharacterMovementComponent)).NetBits += Bunch->GetNumBits();
+	}
+#endif
+	return bWroteSomething;
+}
+
+void ACustomCMCCharacter::OnChildActorDestroyed(AActor* DestroyedActor)
+{
+	// The destroyed child is still listed by its component while OnDestroyed runs
+	if (!IsActorBeingDestroyed())
+	{
+		RefreshIgnoreCharacterParams(DestroyedActor);
+	}
 }
 
@@ -78,6 +78,9 @@ protected:
 	/** Initialize input action bindings */
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
+	/** Builds the ignore params once the child actor components have spawned their actors */
+	virtual void PostInitializeComponents() override;
+
 protected:
 
 	/** Called for movement input */
@@ -115,8 +118,51 @@ public:
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFollowCamera() const { return FollowCamera; }
 
-	FCollisionQueryParams GetIgnoreCharacterParams() const;
+	/** Query params that ignore this character and its child actors, shared by all movement traces */
+	FORCEINLINE const FCollisionQueryParams& GetIgnoreCharacterParams() const { return IgnoreCharacterParams; }
+
+	/** Rebuilds the ignore params, call after child actors are attached or detached at runtime */
+	void RefreshIgnoreCharacterParams(const AActor* ExcludedChild = nullptr);
 
 	FORCEINLINE UCustomCharacterMovementComponent* GetCustomMovementComponent() const {return CustomCharacterMovementComponent;}
+
+	/** Server only, picks NetUpdateFrequency and NetPriority from the movement mode and speed. A mode change or a faster tier also forces a net update */
+	void UpdateNetUpdateRate(bool bMovementModeChanged);
+
+	virtual void PreReplication(IRepChangedPropertyTracker& ChangedPropertyTracker) override;
+
+	/** Counts the bits written for this character and its components to each connection, see FMovementModeCounters::FTotals::NetBits */
+	virtual bool ReplicateSubobjects(class UActorChannel* Channel, class FOutBunch* Bunch, FReplicationFlags* RepFlags) override;
+
+protected:
+
+	/** Net update rate and priority during the ledge grab transition and while falling */
+	UPROPERTY(EditDefaultsOnly, Category="Replication")
+	float FastNetUpdateFrequency = 60.f;
+	UPROPERTY(EditDefaultsOnly, Category="Replication")
+	float FastNetPriority = 3.f;
+
+	/** Net update rate and priority while walking or hanging and moving */
+	UPROPERTY(EditDefaultsOnly, Category="Replication")
+	float MovingNetUpdateFrequency = 30.f;
+	UPROPERTY(EditDefaultsOnly, Category="Replication")
+	float MovingNetPriority = 2.f;
+
+	/** Net update rate and priority while standing or hanging still */
+	UPROPERTY(EditDefaultsOnly, Category="Replication")
+	float IdleNetUpdateFrequency = 5.f;
+	UPROPERTY(EditDefaultsOnly, Category="Replication")
+	float IdleNetPriority = 1.f;
+
+	/** Below this speed the character counts as still */
+	UPROPERTY(EditDefaultsOnly, Category="Replication")
+	float IdleNetSpeed = 10.f;
+
+private:
+
+	UFUNCTION()
+	void OnChildActorDestroyed(AActor* DestroyedActor);
+
+	FCollisionQueryParams IgnoreCharacterParams;
 };
 
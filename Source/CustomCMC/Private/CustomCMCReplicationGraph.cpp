@@ -0,0 +1,233 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CustomCMCReplicationGraph.h"
+
+#include "CombatCheckpointVolume.h"
+#include "CombatDamageableBox.h"
+#include "CombatEnemy.h"
+#include "CustomCMCCharacter.h"
+#include "SideScrollingPickup.h"
+#include "Engine/NetConnection.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/Info.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/ScopeExit.h"
+#include "UObject/UObjectIterator.h"
+
+void UCustomCMCReplicationGraph::ResetGameWorldState()
+{
+	Super::ResetGameWorldState();
+
+	PendingOwnerOnlyActors.Reset();
+	OwnerOnlyActorNodes.Reset();
+	for (const FCustomCMCConnectionNode& ConnectionNode : ConnectionNodes)
+	{
+		ConnectionNode.Node->NotifyResetAllNetworkActors();
+	}
+}
+
+void UCustomCMCReplicationGraph::InitGlobalActorClassSettings()
+{
+	Super::InitGlobalActorClassSettings();
+
+	ClassRepPolicies.Set(AReplicationGraphDebugActor::StaticClass(), ECustomCMCClassRepPolicy::NotRouted);
+	ClassRepPolicies.Set(APlayerController::StaticClass(), ECustomCMCClassRepPolicy::NotRouted);
+	// Game modes never replicate, the game state and player states are what clients see of them
+	ClassRepPolicies.Set(AInfo::StaticClass(), ECustomCMCClassRepPolicy::RelevantAllConnections);
+	ClassRepPolicies.Set(ACharacter::StaticClass(), ECustomCMCClassRepPolicy::Spatialize_Dynamic);
+	ClassRepPolicies.Set(ACustomCMCCharacter::StaticClass(), ECustomCMCClassRepPolicy::Spatialize_Dynamic);
+	ClassRepPolicies.Set(ACombatEnemy::StaticClass(), ECustomCMCClassRepPolicy::Spatialize_Dynamic);
+	// Simulates physics, so it can be knocked into another cell
+	ClassRepPolicies.Set(ACombatDamageableBox::StaticClass(), ECustomCMCClassRepPolicy::Spatialize_Dynamic);
+	ClassRepPolicies.Set(ASideScrollingPickup::StaticClass(), ECustomCMCClassRepPolicy::Spatialize_Dormancy);
+	ClassRepPolicies.Set(ACombatCheckpointVolume::StaticClass(), ECustomCMCClassRepPolicy::Spatialize_Dormancy);
+
+	// Cull distance and update rate of every replicated class come from its CDO, as without the graph
+	for (TObjectIterator<UClass> It; It; ++It)
+	{
+		UClass* Class = *It;
+		const AActor* ActorCDO = Cast<AActor>(Class->GetDefaultObject(false));
+		if (!ActorCDO || !ActorCDO->GetIsReplicated()) continue;
+
+		// Blueprint skeleton and reinstancing classes are never spawned
+		if (Class->GetName().StartsWith(TEXT("SKEL_")) || Class->GetName().StartsWith(TEXT("REINST_"))) continue;
+
+		FClassReplicationInfo ClassInfo;
+		ClassInfo.SetCullDistanceSquared(ActorCDO->GetNetCullDistanceSquared());
+		ClassInfo.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(ActorCDO->GetNetUpdateFrequency());
+		GlobalActorReplicationInfoMap.SetClassInfo(Class, ClassInfo);
+	}
+}
+
+void UCustomCMCReplicationGraph::InitGlobalGraphNodes()
+{
+	GridNode = CreateNewNode<UReplicationGraphNode_GridSpatialization2D>();
+	GridNode->CellSize = GridCellSize;
+	GridNode->SpatialBias = GridSpatialBias;
+	AddGlobalGraphNode(GridNode);
+
+	AlwaysRelevantNode = CreateNewNode<UReplicationGraphNode_ActorList>();
+	AddGlobalGraphNode(AlwaysRelevantNode);
+}
+
+void UCustomCMCReplicationGraph::InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection)
+{
+	Super::InitConnectionGraphNodes(RepGraphConnection);
+
+	// Adds the connection's own controller, pawn and view target by itself
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* Node = CreateNewNode<UReplicationGraphNode_AlwaysRelevant_ForConnection>();
+	AddConnectionGraphNode(Node, RepGraphConnection);
+	ConnectionNodes.Add({ RepGraphConnection->NetConnection, Node });
+}
+
+void UCustomCMCReplicationGraph::RemoveClientConnection(UNetConnection* NetConnection)
+{
+	// The connection's node goes with it, its owner-only actors wait for a new owner
+	if (const UReplicationGraphNode_AlwaysRelevant_ForConnection* Node = GetConnectionNode(NetConnection))
+	{
+		for (auto It = OwnerOnlyActorNodes.CreateIterator(); It; ++It)
+		{
+			if (It->Value != Node) continue;
+
+			if (IsValid(It->Key))
+			{
+				PendingOwnerOnlyActors.Add(It->Key);
+			}
+			It.RemoveCurrent();
+		}
+	}
+	ConnectionNodes.RemoveAllSwap([NetConnection](const FCustomCMCConnectionNode& ConnectionNode) { return ConnectionNode.NetConnection == NetConnection; });
+
+	Super::RemoveClientConnection(NetConnection);
+}
+
+ECustomCMCClassRepPolicy UCustomCMCReplicationGraph::GetPolicy(const AActor* Actor) const
+{
+	// Instance flags win over the class
+	if (Actor->bAlwaysRelevant) return ECustomCMCClassRepPolicy::RelevantAllConnections;
+	if (Actor->bOnlyRelevantToOwner) return ECustomCMCClassRepPolicy::OwnerOnly;
+
+	const ECustomCMCClassRepPolicy* Policy = ClassRepPolicies.Get(Actor->GetClass());
+	return Policy ? *Policy : ECustomCMCClassRepPolicy::Spatialize_Dynamic;
+}
+
+UReplicationGraphNode_AlwaysRelevant_ForConnection* UCustomCMCReplicationGraph::GetConnectionNode(const UNetConnection* NetConnection) const
+{
+	const FCustomCMCConnectionNode* ConnectionNode = ConnectionNodes.FindByPredicate(
+		[NetConnection](const FCustomCMCConnectionNode& Candidate) { return Candidate.NetConnection == NetConnection; });
+	return ConnectionNode ? ConnectionNode->Node.Get() : nullptr;
+}
+
+bool UCustomCMCReplicationGraph::RouteOwnerOnlyActor(AActor* Actor)
+{
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* Node = GetConnectionNode(Actor->GetNetConnection());
+	if (!Node) return false;
+
+	Node->NotifyAddNetworkActor(FNewReplicatedActorInfo(Actor));
+	OwnerOnlyActorNodes.Add(Actor, Node);
+	return true;
+}
+
+void UCustomCMCReplicationGraph::RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo)
+{
+	switch (GetPolicy(ActorInfo.Actor))
+	{
+	case ECustomCMCClassRepPolicy::NotRouted:
+		break;
+	case ECustomCMCClassRepPolicy::RelevantAllConnections:
+		AlwaysRelevantNode->NotifyAddNetworkActor(ActorInfo);
+		break;
+	case ECustomCMCClassRepPolicy::Spatialize_Static:
+		GridNode->AddActor_Static(ActorInfo, GlobalInfo);
+		break;
+	case ECustomCMCClassRepPolicy::Spatialize_Dynamic:
+		GridNode->AddActor_Dynamic(ActorInfo, GlobalInfo);
+		break;
+	case ECustomCMCClassRepPolicy::Spatialize_Dormancy:
+		GridNode->AddActor_Dormancy(ActorInfo, GlobalInfo);
+		break;
+	case ECustomCMCClassRepPolicy::OwnerOnly:
+		if (!RouteOwnerOnlyActor(ActorInfo.Actor))
+		{
+			PendingOwnerOnlyActors.Add(ActorInfo.Actor);
+		}
+		break;
+	}
+}
+
+void UCustomCMCReplicationGraph::RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo)
+{
+	switch (GetPolicy(ActorInfo.Actor))
+	{
+	case ECustomCMCClassRepPolicy::NotRouted:
+		break;
+	case ECustomCMCClassRepPolicy::RelevantAllConnections:
+		AlwaysRelevantNode->NotifyRemoveNetworkActor(ActorInfo);
+		break;
+	case ECustomCMCClassRepPolicy::Spatialize_Static:
+		GridNode->RemoveActor_Static(ActorInfo);
+		break;
+	case ECustomCMCClassRepPolicy::Spatialize_Dynamic:
+		GridNode->RemoveActor_Dynamic(ActorInfo);
+		break;
+	case ECustomCMCClassRepPolicy::Spatialize_Dormancy:
+		GridNode->RemoveActor_Dormancy(ActorInfo);
+		break;
+	case ECustomCMCClassRepPolicy::OwnerOnly:
+	{
+		PendingOwnerOnlyActors.RemoveSingleSwap(ActorInfo.Actor);
+		TObjectPtr<UReplicationGraphNode_AlwaysRelevant_ForConnection> Node;
+		if (OwnerOnlyActorNodes.RemoveAndCopyValue(ActorInfo.Actor, Node))
+		{
+			Node->NotifyRemoveNetworkActor(ActorInfo);
+		}
+		break;
+	}
+	}
+}
+
+void UCustomCMCReplicationGraph::SetActorNetUpdateFrequency(const AActor* Actor, float NetUpdateFrequency)
+{
+	if (FGlobalActorReplicationInfo* GlobalInfo = GlobalActorReplicationInfoMap.Find(Actor))
+	{
+		GlobalInfo->Settings.ReplicationPeriodFrame = GetReplicationPeriodFrameForFrequency(NetUpdateFrequency);
+	}
+}
+
+int32 UCustomCMCReplicationGraph::ServerReplicateActors(float DeltaSeconds)
+{
+#if !UE_BUILD_SHIPPING
+	const double StartTime = FPlatformTime::Seconds();
+	ON_SCOPE_EXIT { ReplicateActorsSeconds += FPlatformTime::Seconds() - StartTime; };
+#endif
+
+	// An actor handed to another owner moves to that connection's node, or waits if the new owner has none
+	for (auto It = OwnerOnlyActorNodes.CreateIterator(); It; ++It)
+	{
+		AActor* Actor = It->Key;
+		if (!IsValid(Actor) || GetConnectionNode(Actor->GetNetConnection()) == It->Value) continue;
+
+		It->Value->NotifyRemoveNetworkActor(FNewReplicatedActorInfo(Actor));
+		It.RemoveCurrent();
+		PendingOwnerOnlyActors.Add(Actor);
+	}
+
+	// Owners are often set after spawning, route those actors as soon as they have a connection
+	for (int32 i = PendingOwnerOnlyActors.Num() - 1; i >= 0; --i)
+	{
+		AActor* Actor = PendingOwnerOnlyActors[i];
+		if (!IsValid(Actor))
+		{
+			PendingOwnerOnlyActors.RemoveAtSwap(i);
+			continue;
+		}
+
+		if (RouteOwnerOnlyActor(Actor))
+		{
+			PendingOwnerOnlyActors.RemoveAtSwap(i);
+		}
+	}
+
+	return Super::ServerReplicateActors(DeltaSeconds);
+}
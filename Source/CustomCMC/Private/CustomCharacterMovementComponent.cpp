@@ -3,42 +3,142 @@
 
 #include "CustomCharacterMovementComponent.h"
 
+#include "CustomCMC.h"
 #include "CustomCMCCharacter.h"
+#include "LedgeIndexSubsystem.h"
+#include "LedgeMath.h"
+#include "LedgeProbeSubsystem.h"
+#include "MovementCorrectionTelemetry.h"
+#include "MovementModeCounters.h"
+#include "MovementMoveRecording.h"
+#include "ServerMoveScheduler.h"
+#include "Animation/AnimInstance.h"
 #include "Components/CapsuleComponent.h"
+#include "Components/SkeletalMeshComponent.h"
 #include "GameFramework/Character.h"
+#include "GameFramework/GameNetworkManager.h"
+#include "GameFramework/GameStateBase.h"
 #include "Net/UnrealNetwork.h"
-#include "DrawDebugHelpers.h"
+#include "Net/Core/PushModel/PushModel.h"
 #include "Kismet/KismetMathLibrary.h"
-#include "Kismet/KismetSystemLibrary.h"
-
-#if 0
-float MacroDuration = 2.f;
-#define SLOG(x) GEngine->AddOnScreenDebugMessage(-1, MacroDuration ? MacroDuration : -1.f, FColor::Yellow, x);
-#define POINT(x, c) DrawDebugPoint(GetWorld(), x, 10, c, !MacroDuration, MacroDuration);
-#define LINE(x1, x2, c) DrawDebugLine(GetWorld(), x1, x2, c, !MacroDuration, MacroDuration);
-#define CAPSULE(x, c) DrawDebugCapsule(GetWorld(), x, CapHH(), CapR(), FQuat::Identity, c, !MacroDuration, MacroDuration);
+#include "EngineUtils.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "UObject/CoreNet.h"
+#include "Misc/ScopeExit.h"
+
+// Debug output goes through the character's FMovementDebugRecorder, arguments are only evaluated while CustomCMC.Debug.Movement is on.
+// The server target compiles it out
+#if !UE_BUILD_SHIPPING && !UE_SERVER
+static constexpr float MacroDuration = 2.f;
+#define MOVEMENT_DEBUG(x) { if (FMovementDebugRecorder::IsEnabled()) { DebugRecorder.x; } }
 #else
-#define SLOG(x)
-#define POINT(x, c)
-#define LINE(x1, x2, c)
-#define CAPSULE(x, c)
+#define MOVEMENT_DEBUG(x)
 #endif
+#define SLOG(x) MOVEMENT_DEBUG(Message(x, FColor::Yellow, MacroDuration))
+#define POINT(x, c) MOVEMENT_DEBUG(Point(x, c, MacroDuration))
+#define LINE(x1, x2, c) MOVEMENT_DEBUG(Line(x1, x2, c, MacroDuration))
+#define CAPSULE(x, c) MOVEMENT_DEBUG(Capsule(x, CapHH(), CapR(), c, MacroDuration))
+
+DECLARE_CYCLE_STAT(TEXT("TryLedgeGrab"), STAT_TryLedgeGrab, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("LedgeGrab Front"), STAT_LedgeGrabFront, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("LedgeGrab Height"), STAT_LedgeGrabHeight, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("LedgeGrab Clearance"), STAT_LedgeGrabClearance, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("PhysHang"), STAT_PhysHang, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("Hang Probe"), STAT_HangProbe, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("Hang Wall/Top Traces"), STAT_HangWallTopTraces, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("Climbable Surface Sweep"), STAT_ClimbableSurfaceSweep, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("ProcessClimbableSurfaceInfo"), STAT_ProcessClimbableSurfaceInfo, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("SnapMovementToClimableSurfaces"), STAT_SnapToClimbableSurfaces, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("CheckHasReachedFloor"), STAT_CheckHasReachedFloor, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("SavedMove Pack"), STAT_SavedMovePack, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("SavedMove Unpack"), STAT_SavedMoveUnpack, STATGROUP_CustomCMC);
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("ServerMoves Sent"), STAT_ServerMovesSent, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Server Corrections Sent"), STAT_ServerCorrectionsSent, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("ServerMoves Folded"), STAT_ServerMovesFolded, STATGROUP_CustomCMC);
+
+// Saved move slab use, both running totals over every client prediction data
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("SavedMove Pool High Water"), STAT_SavedMovePoolHighWater, STATGROUP_CustomCMC);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("SavedMove Heap Allocations"), STAT_SavedMoveHeapAllocations, STATGROUP_CustomCMC);
+
+// Scene queries issued by this component each frame, by phase and by the movement mode they were issued in
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries LedgeGrab"), STAT_QueriesLedgeGrab, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries Hang Probe"), STAT_QueriesHangProbe, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries Hang Snap"), STAT_QueriesHangSnap, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries In Walking"), STAT_QueriesWalking, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries In Falling"), STAT_QueriesFalling, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries In Transition"), STAT_QueriesTransition, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries In Hang"), STAT_QueriesHang, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries In Other Modes"), STAT_QueriesOther, STATGROUP_CustomCMC);
+
+#if !UE_BUILD_SHIPPING
+static void CountSceneQuery(const UCustomCharacterMovementComponent& Movement)
+{
+	const FMovementModeCounters::EMode Mode = FMovementModeCounters::GetMode(Movement);
+	++Movement.GetModeCounters().Get(Mode).SceneQueries;
+
+	switch (Mode)
+	{
+	case FMovementModeCounters::EMode::Walking:		INC_DWORD_STAT(STAT_QueriesWalking); break;
+	case FMovementModeCounters::EMode::Falling:		INC_DWORD_STAT(STAT_QueriesFalling); break;
+	case FMovementModeCounters::EMode::Transition:	INC_DWORD_STAT(STAT_QueriesTransition); break;
+	case FMovementModeCounters::EMode::Hang:		INC_DWORD_STAT(STAT_QueriesHang); break;
+	default:										INC_DWORD_STAT(STAT_QueriesOther); break;
+	}
+}
+#define COUNT_SCENE_QUERY(PhaseStat) { INC_DWORD_STAT(PhaseStat); CountSceneQuery(*this); }
+
+// Scene queries the component's world has issued in every mode
+static uint64 CountWorldSceneQueries(const UCustomCharacterMovementComponent& Movement)
+{
+	uint64 SceneQueries = 0;
+	for (int32 Mode = 0; Mode < static_cast<int32>(FMovementModeCounters::EMode::Num); ++Mode)
+	{
+		SceneQueries += Movement.GetModeCounters().Get(static_cast<FMovementModeCounters::EMode>(Mode)).SceneQueries;
+	}
+	return SceneQueries;
+}
+// Charges the scene queries a jump press spent resolving its ledge to the path that resolved it
+#define COUNT_LEDGE_RESOLVE(Total) LedgeResolveQueries = &Total;
+#else
+#define COUNT_SCENE_QUERY(PhaseStat)
+#define COUNT_LEDGE_RESOLVE(Total)
+#endif
+
+static TAutoConsoleVariable<bool> CVarUseLedgeIndex(
+	TEXT("CustomCMC.UseLedgeIndex"),
+	true,
+	TEXT("Resolve ledge grabs and hang normals from the offline ledge index before tracing collision"));
+
+static TAutoConsoleVariable<bool> CVarHangMoveCoalescing(
+	TEXT("CustomCMC.Net.HangMoveCoalescing"),
+	true,
+	TEXT("Combine hang moves on the same ledge and send them at HangMinNetSendInterval. Off leaves hang moves to the generic rules"));
+
+// Server world time in whole ms as FLedgeGrabEvent carries it, wrapping rather than losing precision
+static uint32 GetLedgeGrabTimeMs(double ServerWorldTimeSeconds)
+{
+	return static_cast<uint32>(static_cast<uint64>(FMath::Max(0.0, ServerWorldTimeSeconds) * 1000.0));
+}
 
 UCustomCharacterMovementComponent::UCustomCharacterMovementComponent(): Safe_bWantsToSprint(false),
                                                                         Safe_bHadAnimRootMotion(false),
                                                                         Safe_bTransitionFinished(false),
                                                                         TransitionQueuedMontage(nullptr),
                                                                         TransitionQueuedMontageSpeed(0),
-                                                                        TransitionRMS_ID(0), Proxy_bLedgeGrabbed(false),
+                                                                        TransitionRMS_ID(0),
                                                                         TallLedgeGrabMontage(nullptr),
                                                                         TransitionTallLedgeGrabMontage(nullptr),
                                                                         ProxyShortLedgeGrabMontage(nullptr),
-                                                                        ProxyTallLedgeGrabMontage(nullptr),
                                                                         CustomCharacterOwner(nullptr),
+                                                                        LedgeIndexSubsystem(nullptr),
                                                                         CurrentClimbableSurfaceNormal(),
                                                                         CurrentClimbableSurfaceLocation()
 {
 	NavAgentProps.bCanCrouch = true;
+	SetNetworkMoveDataContainer(CustomNetworkMoveDataContainer);
+	SetMoveResponseDataContainer(CustomMoveResponseDataContainer);
 }
 
 bool UCustomCharacterMovementComponent::IsCustomMovementMode(ECustomMovementMode InCustomMovementMode) const
@@ -124,10 +224,44 @@ void UCustomCharacterMovementComponent::PhysCustom(float deltaTime, int32 Iterat
 	
 }
 
+void UCustomCharacterMovementComponent::PhysFlying(float deltaTime, int32 Iterations)
+{
+	// Only the ledge grab transition, its root motion velocity holds for the tick and the substeps just sweep it in shorter pieces
+	if (!GetRootMotionSourceByID(TransitionRMS_ID))
+	{
+		Super::PhysFlying(deltaTime, Iterations);
+		return;
+	}
+
+	const int32 NumSubsteps = GetNumHangSubsteps(deltaTime);
+	const float Substep = deltaTime / NumSubsteps;
+	for (int32 SubstepIndex = 0; SubstepIndex < NumSubsteps; ++SubstepIndex)
+	{
+		Super::PhysFlying(Substep, Iterations);
+
+		// The transition ended mid tick, the mode it ended in takes the substeps left
+		if (MovementMode != MOVE_Flying)
+		{
+			StartNewPhysics((NumSubsteps - SubstepIndex - 1) * Substep, Iterations);
+			return;
+		}
+	}
+}
+
 void UCustomCharacterMovementComponent::OnMovementModeChanged(EMovementMode PreviousMovementMode,
 	uint8 PreviousCustomMode)
 {
 	Super::OnMovementModeChanged(PreviousMovementMode, PreviousCustomMode);
+
+	// Probes from a previous hang are never reused
+	HangProbe.bValid = false;
+	bHangSnapBlocked = false;
+	bMovementModeChangedInMove = true;
+
+	if (CustomCharacterOwner && CustomCharacterOwner->HasAuthority())
+	{
+		CustomCharacterOwner->UpdateNetUpdateRate(true);
+	}
 	
 	if (IsFalling())
 	{
@@ -161,6 +295,8 @@ FString UCustomCharacterMovementComponent::GetMovementModeAsString(EMovementMode
 
 bool UCustomCharacterMovementComponent::TryLedgeGrab()
 {
+	CUSTOMCMC_SCOPE(STAT_TryLedgeGrab);
+
 	// could just set to climb here
 	//probably need make rotation 54:33
 		// Temp Enable Crouching
@@ -172,7 +308,7 @@ bool UCustomCharacterMovementComponent::TryLedgeGrab()
 	// Helper Variables
 	FVector BaseLoc = UpdatedComponent->GetComponentLocation() + FVector::DownVector * CapHH();
 	FVector Fwd = UpdatedComponent->GetForwardVector().GetSafeNormal2D();
-	auto Params = CustomCharacterOwner->GetIgnoreCharacterParams();
+	const FCollisionQueryParams& Params = CustomCharacterOwner->GetIgnoreCharacterParams();
 	float MaxHeight = CapHH() * 2+ LedgeGrabReachHeight;
 	float CosMMWSA = FMath::Cos(FMath::DegreesToRadians(LedgeGrabMinWallSteepnessAngle));
 	float CosMMSA = FMath::Cos(FMath::DegreesToRadians(LedgeGrabMaxSurfaceAngle));
@@ -180,69 +316,84 @@ bool UCustomCharacterMovementComponent::TryLedgeGrab()
 
 	SLOG("Starting LedgeGrab Attempt")
 
-	// Check Front Face
 	FHitResult FrontHit;
-
+	FHitResult SurfaceHit;
+	FCollisionShape CapShape = FCollisionShape::MakeCapsule(CapR(), CapHH());
 	float CheckDistance = FMath::Clamp(Velocity | Fwd, CapR() + 30, MaxLedgeGrabDistance);
-	FVector FrontStart = BaseLoc + FVector::UpVector * (MaxStepHeight - 1);
-	for (int i = 0; i < 6; i++)
-	{
-		LINE(FrontStart, FrontStart + Fwd * CheckDistance, FColor::Red)
-		if (GetWorld()->LineTraceSingleByProfile(FrontHit, FrontStart, FrontStart + Fwd * CheckDistance, "BlockAll", Params)) break;
-		FrontStart += FVector::UpVector * (2.f * CapHH() - (MaxStepHeight - 1)) / 5;
-	}
-	if (!FrontHit.IsValidBlockingHit()) return false;
-	float CosWallSteepnessAngle = FrontHit.Normal | FVector::UpVector;
-	// Pipe Symbol is used for the dot product in this context
-	if (FMath::Abs(CosWallSteepnessAngle) > CosMMWSA || (Fwd | -FrontHit.Normal) < CosMMAA) return false;
-
-	POINT(FrontHit.Location, FColor::Red);
+	float Height;
+	float IndexedClearance;
 
-	// Check Height
-	TArray<FHitResult> HeightHits;
-	FHitResult SurfaceHit;
-	// Vector  traveling in the direction up the surface the wall to the edge 
-	FVector WallUp = FVector::VectorPlaneProject(FVector::UpVector, FrontHit.Normal).GetSafeNormal();
-	//Angle between world up and WallUP
-	float WallCos = FVector::UpVector | FrontHit.Normal;
-
-	//enbales us to make a downward cast down towards the wall
-	float WallSin = FMath::Sqrt(1 - WallCos * WallCos);
-	// 
-	FVector TraceStart = FrontHit.Location + Fwd + WallUp * (MaxHeight - (MaxStepHeight - 1)) / WallSin;
-	LINE(TraceStart, FrontHit.Location + Fwd, FColor::Orange)
-		if (!GetWorld()->LineTraceMultiByProfile(HeightHits, TraceStart, FrontHit.Location + Fwd, "BlockAll", Params)) return false;
-	for (const FHitResult& Hit : HeightHits)
-	{
-		if (Hit.IsValidBlockingHit())
+#if !UE_BUILD_SHIPPING
+	uint64* LedgeResolveQueries = nullptr;
+	const uint64 SceneQueriesBefore = CountWorldSceneQueries(*this);
+	ON_SCOPE_EXIT
+	{
+		if (LedgeResolveQueries)
 		{
-			SurfaceHit = Hit;
-			break;
+			*LedgeResolveQueries += CountWorldSceneQueries(*this) - SceneQueriesBefore;
 		}
-	}
-	// if no blocking hit or surface is too steep
-	if (!SurfaceHit.IsValidBlockingHit() || (SurfaceHit.Normal | FVector::UpVector) < CosMMSA) return false;
-	float Height = (SurfaceHit.Location - BaseLoc) | FVector::UpVector;
+	};
+#endif
 
-	SLOG(FString::Printf(TEXT("Height: %f"), Height))
-	POINT(SurfaceHit.Location, FColor::Blue);
+	// Resolve from the offline ledge index first, one short trace confirms it against the scene as it is now.
+	// When the scene no longer matches the index, fall back to the cache and the probe
+	if (FindIndexedLedge(BaseLoc, Fwd, CheckDistance, FrontHit, SurfaceHit, IndexedClearance) && ConfirmIndexedLedge(FrontHit, SurfaceHit, Params))
+	{
+		++LedgeIndexHits;
+		COUNT_LEDGE_RESOLVE(LedgeIndexQueries)
+		if (FMath::Abs(FrontHit.Normal | FVector::UpVector) > CosMMWSA || (SurfaceHit.Normal | FVector::UpVector) < CosMMSA) return false;
 
-	if (Height > MaxHeight) return false;
+		Height = (SurfaceHit.Location - BaseLoc) | FVector::UpVector;
+		if (Height > MaxHeight) return false;
 
-	// Check Clearance
-	float SurfaceCos = FVector::UpVector | SurfaceHit.Normal;
-	float SurfaceSin = FMath::Sqrt(1 - SurfaceCos * SurfaceCos);
-	FVector ClearCapLoc = SurfaceHit.Location + Fwd * CapR() + FVector::UpVector * (CapHH() + 1 + CapR() * 2 * SurfaceSin);
-	FCollisionShape CapShape = FCollisionShape::MakeCapsule(CapR(), CapHH());
-	if (GetWorld()->OverlapAnyTestByProfile(ClearCapLoc, FQuat::Identity, "BlockAll", CapShape, Params))
+		// Same capsule span as the clearance overlap, static geometry alone already blocks it
+		float SurfaceCos = FVector::UpVector | SurfaceHit.Normal;
+		float SurfaceSin = FMath::Sqrt(1 - SurfaceCos * SurfaceCos);
+		if (IndexedClearance < 2.f * CapHH() + 1 + CapR() * 2 * SurfaceSin) return false;
+
+		// Pawns and dynamic actors on the ledge are not in the index
+		if (!HasLedgeClearance(SurfaceHit, Fwd, Params)) return false;
+	}
+	// Resolve from a recently validated ledge when we are still inside its validity volume
+	else if (const FLedgeCacheEntry* CachedLedge = FindCachedLedge(BaseLoc, Fwd))
 	{
-		CAPSULE(ClearCapLoc, FColor::Red)
-				return false;
+		++LedgeCacheHits;
+		COUNT_LEDGE_RESOLVE(LedgeCacheQueries)
+		if ((Fwd | -CachedLedge->FrontHit.Normal) < CosMMAA) return false;
+
+		FrontHit = CachedLedge->FrontHit;
+		SurfaceHit = CachedLedge->SurfaceHit;
+		Height = (SurfaceHit.Location - BaseLoc) | FVector::UpVector;
+		if (Height > MaxHeight) return false;
+
+		// Pawns and dynamic actors come and go on a ledge, only its geometry is cached
+		if (!HasLedgeClearance(SurfaceHit, Fwd, Params)) return false;
 	}
 	else
 	{
-		CAPSULE(ClearCapLoc, FColor::Green)
+		++LedgeCacheMisses;
+		COUNT_LEDGE_RESOLVE(LedgeProbeQueries)
+
+		// Use this frame's batched probe when it was run for exactly this query
+		FLedgeProbe Probe;
+		if (!ConsumeBatchedLedgeProbe(BaseLoc, Fwd, CheckDistance, Probe))
+		{
+			ProbeLedge(BaseLoc, Fwd, CheckDistance, Params, Probe);
+		}
+		if (!Probe.bValidLedge) return false;
+
+		FrontHit = Probe.FrontHit;
+		SurfaceHit = Probe.SurfaceHit;
+		Height = (SurfaceHit.Location - BaseLoc) | FVector::UpVector;
+
+		CacheLedge(FrontHit, SurfaceHit, BaseLoc, Fwd);
+		if (!Probe.bHasClearance) return false;
 	}
+#if !UE_BUILD_SHIPPING
+	// The tall ledge overlap below runs whichever path resolved the ledge
+	*LedgeResolveQueries += CountWorldSceneQueries(*this) - SceneQueriesBefore;
+	LedgeResolveQueries = nullptr;
+#endif
 	SLOG("Can LedgeGrab")
 	
 	// LedgeGrab Selection
@@ -254,6 +405,7 @@ bool UCustomCharacterMovementComponent::TryLedgeGrab()
 		bTallLedgeGrab = true;
 	else if (IsMovementMode(MOVE_Falling) && (Velocity | FVector::UpVector) < 0)
 	{
+		COUNT_SCENE_QUERY(STAT_QueriesLedgeGrab)
 		if (!GetWorld()->OverlapAnyTestByProfile(TallLedgeGrabTarget, FQuat::Identity, "BlockAll", CapShape, Params))
 			bTallLedgeGrab = true;
 	}
@@ -291,7 +443,9 @@ bool UCustomCharacterMovementComponent::TryLedgeGrab()
 	TransitionRMS_ID = ApplyRootMotionSource(TransitionRMS);
 	
 	// cache the exact ledge direction for PhysHang:
-	CurrentLedgeTangent = FVector::CrossProduct(SurfaceHit.Normal, FrontHit.Normal).GetSafeNormal();
+	CurrentLedgeTangent = FLedgeMath::GetEdgeTangent(SurfaceHit.Normal, FrontHit.Normal);
+	CurrentLedgeAnchor = SurfaceHit.Location;
+	++LedgeGrabID;
 
 	
 	// Animations
@@ -300,32 +454,24 @@ bool UCustomCharacterMovementComponent::TryLedgeGrab()
 		TransitionQueuedMontage = TallLedgeGrabMontage;
 		// Transition is not a root motion montage but maybe I can see how this would work with motion warping
 		CharacterOwner->PlayAnimMontage(TransitionTallLedgeGrabMontage, 1 / TransitionRMS->Duration);
-		if (IsServer()) Proxy_bLedgeGrabbed = !Proxy_bLedgeGrabbed;
 
-		
-		if (GEngine)
-		{
-			
-			GEngine->AddOnScreenDebugMessage(
-				4,
-				10.5f,
-				FColor::Red,
-				FString::Printf(TEXT("TallGrabAttmepted"))
-			);
-		}
+		MOVEMENT_DEBUG(Message(TEXT("TallGrabAttmepted"), FColor::Red, 10.5f, 4))
 	}
 	else
 	{
-		if (GEngine)
-		{
-			
-			GEngine->AddOnScreenDebugMessage(
-				5,
-				10.5f,
-				FColor::Red,
-				FString::Printf(TEXT("TallGrabFailed"))
-			);
-		}
+		MOVEMENT_DEBUG(Message(TEXT("TallGrabFailed"), FColor::Red, 10.5f, 5))
+	}
+
+	if (IsServer())
+	{
+		const AGameStateBase* GameState = GetWorld()->GetGameState();
+		++LedgeGrabEvent.Sequence;
+		LedgeGrabEvent.TargetLocation = TransitionTarget;
+		LedgeGrabEvent.PackedTangent = FLedgeMath::PackDirection(CurrentLedgeTangent);
+		LedgeGrabEvent.Montage = bTallLedgeGrab ? ELedgeGrabMontage::Tall : ELedgeGrabMontage::Short;
+		LedgeGrabEvent.DurationMs = static_cast<uint8>(FMath::Clamp(FMath::RoundToInt32(TransitionRMS->Duration * 1000.f), 1, MAX_uint8));
+		LedgeGrabEvent.ServerStartTimeMs = GetLedgeGrabTimeMs(GameState ? GameState->GetServerWorldTimeSeconds() : GetWorld()->GetTimeSeconds());
+		MARK_PROPERTY_DIRTY_FROM_NAME(UCustomCharacterMovementComponent, LedgeGrabEvent, this);
 	}
 	FQuat NewRotation = FRotationMatrix::MakeFromXZ(-FrontHit.Normal, FVector::UpVector).ToQuat();
 	SafeMoveUpdatedComponent(FVector::ZeroVector, NewRotation, false, FrontHit);
@@ -334,16 +480,7 @@ bool UCustomCharacterMovementComponent::TryLedgeGrab()
 	
 
 	// after calculate CurrentLedgeTangent…
-	if (GEngine)
-	{
-		// -1 = auto key, 1.5f = stays on screen for 1.5 seconds
-		GEngine->AddOnScreenDebugMessage(
-			-11,
-			10.5f,
-			FColor::Red,
-			FString::Printf(TEXT("Tangent = %s"), *CurrentLedgeTangent.ToString())
-		);
-	}
+	MOVEMENT_DEBUG(Message(FString::Printf(TEXT("Tangent = %s"), *CurrentLedgeTangent.ToString()), FColor::Red, 10.5f, -11))
 
 	// Cache front and surface hits
 	CurrentLedgeWallNormal = FrontHit.Normal;
@@ -356,354 +493,767 @@ bool UCustomCharacterMovementComponent::TryLedgeGrab()
 	return true;
 }
 
-void UCustomCharacterMovementComponent::PhysHang(float deltaTime, int32 Iterations)
+void UCustomCharacterMovementComponent::ProbeLedge(const FVector& BaseLoc, const FVector& Fwd, float CheckDistance,
+	const FCollisionQueryParams& Params, FLedgeProbe& Out) const
 {
-	if (deltaTime < MIN_TICK_TIME)
-	{
-		return;
-	}
-	if (!CharacterOwner || (!CharacterOwner->Controller && !bRunPhysicsWithNoController && !HasAnimRootMotion() && !CurrentRootMotion.HasOverrideVelocity() && (CharacterOwner->GetLocalRole() != ROLE_SimulatedProxy)))
+	float MaxHeight = CapHH() * 2+ LedgeGrabReachHeight;
+	float CosMMWSA = FMath::Cos(FMath::DegreesToRadians(LedgeGrabMinWallSteepnessAngle));
+	float CosMMSA = FMath::Cos(FMath::DegreesToRadians(LedgeGrabMaxSurfaceAngle));
+	float CosMMAA = FMath::Cos(FMath::DegreesToRadians(LedgeGrabMaxAlignmentAngle));
+	FHitResult& FrontHit = Out.FrontHit;
+	FHitResult& SurfaceHit = Out.SurfaceHit;
+
+	// Check Front Face
 	{
-		Acceleration = FVector::ZeroVector;
-		Velocity = FVector::ZeroVector;
-		return;
+		CUSTOMCMC_SCOPE(STAT_LedgeGrabFront);
+		FVector FrontStart = BaseLoc + FVector::UpVector * (MaxStepHeight - 1);
+		for (int i = 0; i < 6; i++)
+		{
+			LINE(FrontStart, FrontStart + Fwd * CheckDistance, FColor::Red)
+			COUNT_SCENE_QUERY(STAT_QueriesLedgeGrab)
+			if (GetWorld()->LineTraceSingleByProfile(FrontHit, FrontStart, FrontStart + Fwd * CheckDistance, "BlockAll", Params)) break;
+			FrontStart += FVector::UpVector * (2.f * CapHH() - (MaxStepHeight - 1)) / 5;
+		}
 	}
+	if (!FrontHit.IsValidBlockingHit()) return;
+	float CosWallSteepnessAngle = FrontHit.Normal | FVector::UpVector;
+	// Pipe Symbol is used for the dot product in this context
+	if (FMath::Abs(CosWallSteepnessAngle) > CosMMWSA || (Fwd | -FrontHit.Normal) < CosMMAA) return;
 
-	// --- 1) Trace the wall face (forward) ---
-	FHitResult WallHit;
-	{
-		// 1. Grab your capsule’s world location
-		const FVector ComponentLoc = UpdatedComponent->GetComponentLocation();
+	POINT(FrontHit.Location, FColor::Red);
 
-		// 2. Move up by BaseEyeHeight, then forward by 30cm
-		const FVector WallStartEye = ComponentLoc
-			+ UpdatedComponent->GetUpVector() * CharacterOwner->BaseEyeHeight
-			+ UpdatedComponent->GetForwardVector() * 30.f;
+	// Check Height
+	{
+		CUSTOMCMC_SCOPE(STAT_LedgeGrabHeight);
+		TArray<FHitResult> HeightHits;
+		// Vector  traveling in the direction up the surface the wall to the edge 
+		FVector WallUp = FVector::VectorPlaneProject(FVector::UpVector, FrontHit.Normal).GetSafeNormal();
+		//Angle between world up and WallUP
+		float WallCos = FVector::UpVector | FrontHit.Normal;
+
+		//enbales us to make a downward cast down towards the wall
+		float WallSin = FMath::Sqrt(1 - WallCos * WallCos);
+		// 
+		FVector TraceStart = FrontHit.Location + Fwd + WallUp * (MaxHeight - (MaxStepHeight - 1)) / WallSin;
+		LINE(TraceStart, FrontHit.Location + Fwd, FColor::Orange)
+		COUNT_SCENE_QUERY(STAT_QueriesLedgeGrab)
+		if (!GetWorld()->LineTraceMultiByProfile(HeightHits, TraceStart, FrontHit.Location + Fwd, "BlockAll", Params)) return;
+		for (const FHitResult& Hit : HeightHits)
+		{
+			if (Hit.IsValidBlockingHit())
+			{
+				SurfaceHit = Hit;
+				break;
+			}
+		}
+		// if no blocking hit or surface is too steep
+		if (!SurfaceHit.IsValidBlockingHit() || (SurfaceHit.Normal | FVector::UpVector) < CosMMSA) return;
+		float Height = (SurfaceHit.Location - BaseLoc) | FVector::UpVector;
 
-		// 3. End point at max distance
-		const FVector WallEnd = WallStartEye + UpdatedComponent->GetForwardVector() * MaxLedgeGrabDistance;
+		SLOG(FString::Printf(TEXT("Height: %f"), Height))
+		POINT(SurfaceHit.Location, FColor::Blue);
 
+		if (Height > MaxHeight) return;
+	}
+	Out.bValidLedge = true;
 
-		GetWorld()->LineTraceSingleByProfile(
-			WallHit, WallStartEye, WallEnd, TEXT("BlockAll"), CustomCharacterOwner->GetIgnoreCharacterParams()
-		);
+	Out.bHasClearance = HasLedgeClearance(SurfaceHit, Fwd, Params);
+}
 
-		// draw the wall trace in magenta
-		DrawDebugLine(
-			GetWorld(),
-			WallStartEye,
-			WallEnd,
-			FColor::Magenta,   // color
-			false,             // persistent lines?
-			0.1f,              // life time
-			0,                 // depth priority
-			5.0f               // thickness
-		);
+bool UCustomCharacterMovementComponent::HasLedgeClearance(const FHitResult& SurfaceHit, const FVector& Fwd, const FCollisionQueryParams& Params) const
+{
+	// Check Clearance
+	CUSTOMCMC_SCOPE(STAT_LedgeGrabClearance);
+	COUNT_SCENE_QUERY(STAT_QueriesLedgeGrab)
+	float SurfaceCos = FVector::UpVector | SurfaceHit.Normal;
+	float SurfaceSin = FMath::Sqrt(1 - SurfaceCos * SurfaceCos);
+	FVector ClearCapLoc = SurfaceHit.Location + Fwd * CapR() + FVector::UpVector * (CapHH() + 1 + CapR() * 2 * SurfaceSin);
+	FCollisionShape CapShape = FCollisionShape::MakeCapsule(CapR(), CapHH());
+	const bool bHasClearance = !GetWorld()->OverlapAnyTestByProfile(ClearCapLoc, FQuat::Identity, "BlockAll", CapShape, Params);
+	if (!bHasClearance)
+	{
+		CAPSULE(ClearCapLoc, FColor::Red)
 	}
-
-	// --- 2) Trace the top face (down from just above the wall hit) ---
-	FHitResult TopHit;
-	if (WallHit.IsValidBlockingHit())
+	else
 	{
-		FVector WallUp = FVector::VectorPlaneProject(FVector::UpVector, WallHit.Normal).GetSafeNormal();
-		const float ProbeHeight = CapHH() * 2.f + 10.f;
+		CAPSULE(ClearCapLoc, FColor::Green)
+	}
+	return bHasClearance;
+}
 
-		// how far forward off the wall you want to push your trace (in cm)
-		const float ForwardOffset = 20.f;
+void UCustomCharacterMovementComponent::ProbeHang(const FVector& Location, const FQuat& Rotation,
+	const FCollisionQueryParams& Params, const FCollisionQueryParams& ClimbParams, FHangProbe& Out) const
+{
+	CUSTOMCMC_SCOPE(STAT_HangProbe);
+	const FVector Forward = Rotation.GetForwardVector();
+	const FVector Up = Rotation.GetUpVector();
+
+	// Copied before the reset, the faces are kept below once the climbable sweep confirms the wall
+	FHitResult CarriedWallHit;
+	FHitResult CarriedTopHit;
+	FVector CarriedTraceLocation = FVector::ZeroVector;
+	const bool bCanCarryLedge = CanCarryHangLedge(Location, Rotation, Out);
+	if (bCanCarryLedge)
+	{
+		CarriedWallHit = Out.WallHit;
+		CarriedTopHit = Out.TopHit;
+		CarriedTraceLocation = Out.LedgeTraceLocation;
+	}
 
-		// move your start/end off the wall surface a bit
-		FVector WallForward = -WallHit.Normal * ForwardOffset;
+	Out.Reset();
+	Out.Location = Location;
+	Out.Rotation = Rotation;
 
-		// now build start/end
-		const FVector TopStart = WallHit.Location + WallUp * ProbeHeight + WallForward;
-		const FVector TopEnd   = WallHit.Location - WallUp * ProbeHeight + WallForward;
+	// Climbable surfaces just in front of the capsule
+	const FVector ClimbStart = Location + Forward * 30.f;
+	COUNT_SCENE_QUERY(STAT_QueriesHangProbe)
+	DoCapsuleTraceMultiByObject(ClimbStart, ClimbStart + Forward, ClimbParams, Out.ClimbableHits);
+	for (const FHitResult& Hit : Out.ClimbableHits)
+	{
+		Out.TrackComponent(Hit);
+	}
 
-		GetWorld()->LineTraceSingleByProfile(
-			TopHit, TopStart, TopEnd, TEXT("BlockAll"), CustomCharacterOwner->GetIgnoreCharacterParams()
-		);
+	// Look the ledge up in the offline index, the wall and top traces are the fallback
+	Out.bIndexedLedge = FindIndexedHangLedge(Location, Rotation, Out.IndexHit);
+	if (!Out.bIndexedLedge)
+	{
+		// Shimmying along one flat wall finds the same faces, only their hit locations slide along them and PhysHang
+		// reads the normals alone. Kept while the climbable sweep still touches that wall face on
+		const float MinNormalDot = FMath::Cos(FMath::DegreesToRadians(HangProbeReuseAngle));
+		Out.bLedgeCarried = bCanCarryLedge && Out.ClimbableHits.ContainsByPredicate([&CarriedWallHit, MinNormalDot](const FHitResult& Hit)
+		{
+			return Hit.GetComponent() == CarriedWallHit.GetComponent() && (Hit.ImpactNormal | CarriedWallHit.ImpactNormal) >= MinNormalDot;
+		});
 
-		// draw the top trace in cyan
-		DrawDebugLine(
-			GetWorld(),
-			TopStart,
-			TopEnd,
-			FColor::Cyan,
-			false,
-			0.1f,
-			0,
-			5.0f
-		);
+		if (Out.bLedgeCarried)
+		{
+			Out.WallHit = CarriedWallHit;
+			Out.TopHit = CarriedTopHit;
+			Out.LedgeTraceLocation = CarriedTraceLocation;
+		}
+		else
+		{
+			CUSTOMCMC_SCOPE(STAT_HangWallTopTraces);
+			Out.LedgeTraceLocation = Location;
+
+			// Wall face: up by BaseEyeHeight, forward by 30cm, then out to max distance
+			Out.WallStart = Location + Up * CharacterOwner->BaseEyeHeight + Forward * 30.f;
+			Out.WallEnd = Out.WallStart + Forward * MaxLedgeGrabDistance;
+			COUNT_SCENE_QUERY(STAT_QueriesHangProbe)
+			GetWorld()->LineTraceSingleByProfile(Out.WallHit, Out.WallStart, Out.WallEnd, TEXT("BlockAll"), Params);
+
+			// Top face: down from just above the wall hit
+			if (Out.WallHit.IsValidBlockingHit())
+			{
+				FVector WallUp = FVector::VectorPlaneProject(FVector::UpVector, Out.WallHit.Normal).GetSafeNormal();
+				const float ProbeHeight = CapHH() * 2.f + 10.f;
+
+				// how far forward off the wall you want to push your trace (in cm)
+				const float ForwardOffset = 20.f;
+
+				// move your start/end off the wall surface a bit
+				FVector WallForward = -Out.WallHit.Normal * ForwardOffset;
+
+				Out.TopStart = Out.WallHit.Location + WallUp * ProbeHeight + WallForward;
+				Out.TopEnd   = Out.WallHit.Location - WallUp * ProbeHeight + WallForward;
+				COUNT_SCENE_QUERY(STAT_QueriesHangProbe)
+				GetWorld()->LineTraceSingleByProfile(Out.TopHit, Out.TopStart, Out.TopEnd, TEXT("BlockAll"), Params);
+			}
+		}
 	}
 
-	// only proceed if we have both normals
-	if (WallHit.IsValidBlockingHit() && TopHit.IsValidBlockingHit())
-	{
-		CurrentLedgeWallNormal = WallHit.Normal.GetSafeNormal();
-		CurrentLedgeTopNormal  = TopHit.Normal.GetSafeNormal();
+	Out.TrackComponent(Out.WallHit);
+	Out.TrackComponent(Out.TopHit);
+	Out.bValid = true;
+}
 
-		// --- 3) Cross them to get the edge tangent ---
-		FVector FreshTangent = FVector::CrossProduct(CurrentLedgeWallNormal, CurrentLedgeTopNormal).GetSafeNormal();
-		CurrentLedgeTangent  = FMath::VInterpTo(CurrentLedgeTangent, FreshTangent, deltaTime, CornerInterpSpeed);
+void UCustomCharacterMovementComponent::ProbeHangFloor(const FCollisionQueryParams& ClimbParams, FHangProbe& Probe) const
+{
+	CUSTOMCMC_SCOPE(STAT_HangProbe);
 
-		// debug
-		DrawDebugLine(
-			GetWorld(),
-			UpdatedComponent->GetComponentLocation(),
-			UpdatedComponent->GetComponentLocation() + CurrentLedgeTangent * 200.f,
-			FColor::Magenta, false, 0.1f, 0, 5.f
-		);
-	}
-	
-	/*Process all the climbable surfaces info*/
-	TraceClimbableSurfaces();
-	ProcessClimbableSurfaceInfo();
-	
-	
-	// after you calculate CurrentLedgeTangent…
-	if (GEngine)
+	// Floor just below the capsule, a separate sweep so a wall and floor on the same mesh both report a hit
+	const FVector FloorStart = Probe.Location - Probe.Rotation.GetUpVector() * 50.f;
+	COUNT_SCENE_QUERY(STAT_QueriesHangProbe)
+	DoCapsuleTraceMultiByObject(FloorStart, FloorStart - Probe.Rotation.GetUpVector(), ClimbParams, Probe.FloorHits);
+	for (const FHitResult& Hit : Probe.FloorHits)
 	{
-		// -1 = auto key, 1.5f = stays on screen for 1.5 seconds
-		GEngine->AddOnScreenDebugMessage(
-			2,
-			.5f,
-			FColor::Green,
-			FString::Printf(TEXT("Tangent = %s"), *CurrentLedgeTangent.ToString())
-		);
+		Probe.TrackComponent(Hit);
 	}
-	/*Check if we should stop climbing*/
-	if(CheckShouldStopHanging() || CheckHasReachedFloor())
+	Probe.bFloorProbed = true;
+}
+
+bool UCustomCharacterMovementComponent::CanCarryHangLedge(const FVector& Location, const FQuat& Rotation, const FHangProbe& Previous) const
+{
+	if (!Previous.bValid || Previous.bIndexedLedge) return false;
+	if (!Previous.WallHit.IsValidBlockingHit() || !Previous.TopHit.IsValidBlockingHit()) return false;
+	// Same rule as CanReuseHangProbe, the server only carries faces over once it trusts the client's hang state
+	const bool bRemoteClientMove = CharacterOwner->GetLocalRole() == ROLE_Authority && !CharacterOwner->IsLocallyControlled();
+	if (bRemoteClientMove && !bClientHangStateValidated) return false;
+	// Bounded so a top face that changes further along the same wall is traced again
+	if (FVector::DistSquared(Location, Previous.LedgeTraceLocation) > FMath::Square(HangLedgeCarryDistance)) return false;
+	if (Rotation.AngularDistance(Previous.Rotation) > FMath::DegreesToRadians(HangProbeReuseAngle)) return false;
+
+	for (const FHitResult* Hit : { &Previous.WallHit, &Previous.TopHit })
 	{
-		StopHanging();
+		const UPrimitiveComponent* Component = Hit->GetComponent();
+		const TPair<TWeakObjectPtr<const UPrimitiveComponent>, FTransform>* Tracked = Previous.Components.FindByPredicate(
+			[Component](const TPair<TWeakObjectPtr<const UPrimitiveComponent>, FTransform>& Entry) { return Entry.Key.Get() == Component; });
+		if (!Component || !Tracked || !Component->GetComponentTransform().Equals(Tracked->Value)) return false;
 	}
+	return true;
+}
 
-	RestorePreAdditiveRootMotionVelocity();
+void FHangProbe::TrackComponent(const FHitResult& Hit)
+{
+	const UPrimitiveComponent* Component = Hit.GetComponent();
+	if (!Component || Components.ContainsByPredicate([Component](const TPair<TWeakObjectPtr<const UPrimitiveComponent>, FTransform>& Tracked)
+	{
+		return Tracked.Key.Get() == Component;
+	})) return;
 
-	if( !HasAnimRootMotion() && !CurrentRootMotion.HasOverrideVelocity() )
-	{	//Define the max climb speed and acceleration
-		CalcVelocity(deltaTime, 0.f, true, LedgeBrakingDeceleration);
-	}
+	Components.Emplace(Component, Component->GetComponentTransform());
+}
 
-	ApplyRootMotionToVelocity(deltaTime);
+bool UCustomCharacterMovementComponent::CanReuseHangProbe(const FVector& Location, const FQuat& Rotation) const
+{
+	if (!HangProbe.bValid) return false;
+	// A longer reuse distance than the client's would let the server hang on past the end of a ledge the client already left
+	const bool bRemoteClientMove = CharacterOwner->GetLocalRole() == ROLE_Authority && !CharacterOwner->IsLocallyControlled();
+	if (bRemoteClientMove && !bClientHangStateValidated) return false;
+	if (FVector::DistSquared(Location, HangProbe.Location) > FMath::Square(HangProbeReuseDistance)) return false;
+	if (Rotation.AngularDistance(HangProbe.Rotation) > FMath::DegreesToRadians(HangProbeReuseAngle)) return false;
+
+	for (const TPair<TWeakObjectPtr<const UPrimitiveComponent>, FTransform>& Tracked : HangProbe.Components)
+	{
+		const UPrimitiveComponent* Component = Tracked.Key.Get();
+		if (!Component || !Component->GetComponentTransform().Equals(Tracked.Value)) return false;
+	}
+	return true;
+}
 
-	FVector OldLocation = UpdatedComponent->GetComponentLocation();
-	const FVector Adjusted = Velocity * deltaTime;
-	FHitResult Hit(1.f);
+bool UCustomCharacterMovementComponent::GatherBatchedProbes()
+{
+	BatchedProbes.bHang = false;
+	BatchedProbes.bLedge = false;
+	if (!UpdatedComponent || !CharacterOwner || !CustomCharacterOwner) return false;
 
-	//Handle climb rotation
-	SafeMoveUpdatedComponent(Adjusted, GetClimbRotation(deltaTime), true, Hit);
+	// Remote clients' moves are applied from ServerMove before the world ticks, only characters moved by their own tick can use the batch
+	const bool bMovedByTick = CharacterOwner->IsLocallyControlled() || (CharacterOwner->HasAuthority() && CharacterOwner->GetRemoteRole() != ROLE_AutonomousProxy);
+	if (!bMovedByTick) return false;
 
-	if (Hit.Time < 1.f)
+	const FVector Location = UpdatedComponent->GetComponentLocation();
+	if (IsHanging())
 	{
-		//adjust and try again
-		HandleImpact(Hit, deltaTime, Adjusted);
-		SlideAlongSurface(Adjusted, (1.f-Hit.Time), Hit.Normal, Hit, true);
-	}
+		// PhysHang will reuse its last probe
+		if (CanReuseHangProbe(Location, UpdatedComponent->GetComponentQuat())) return false;
 
-	if(!HasAnimRootMotion() && !CurrentRootMotion.HasOverrideVelocity() )
+		BatchedProbes.bHang = true;
+		BatchedProbes.HangLocation = Location;
+		BatchedProbes.HangRotation = UpdatedComponent->GetComponentQuat();
+		BatchedProbes.HangBounds = GetHangProbeBounds(Location, BatchedProbes.HangRotation);
+	}
+	else if (CustomCharacterOwner->bPressedCustomJump && IsMovementMode(MOVE_Falling))
 	{
-		Velocity = (UpdatedComponent->GetComponentLocation() - OldLocation) / deltaTime;
+		// Same inputs TryLedgeGrab will build
+		const FVector BaseLoc = Location + FVector::DownVector * CapHH();
+		const FVector Fwd = UpdatedComponent->GetForwardVector().GetSafeNormal2D();
+		const float CheckDistance = FMath::Clamp(Velocity | Fwd, CapR() + 30, MaxLedgeGrabDistance);
+
+		// Ledges resolved by the index or the cache need no probe
+		FHitResult IndexedFrontHit, IndexedSurfaceHit;
+		float IndexedClearance;
+		if (!FindIndexedLedge(BaseLoc, Fwd, CheckDistance, IndexedFrontHit, IndexedSurfaceHit, IndexedClearance) && !FindCachedLedge(BaseLoc, Fwd))
+		{
+			BatchedProbes.bLedge = true;
+			BatchedProbes.LedgeBaseLoc = BaseLoc;
+			BatchedProbes.LedgeFwd = Fwd;
+			BatchedProbes.LedgeCheckDistance = CheckDistance;
+			BatchedProbes.LedgeBounds = GetLedgeProbeBounds(BaseLoc, Fwd, CheckDistance);
+		}
 	}
 
-	/*Snap movement to climbable surfaces*/
-	SnapMovementToClimableSurfaces(deltaTime);
-	
-	/*if(CheckHasReachedLedge())
-	{	
-		PlayClimbMontage(ClimbToTopMontage);
-	}*/
-
+	if (!BatchedProbes.bHang && !BatchedProbes.bLedge) return false;
 
+	BatchedProbes.Frame = GFrameCounter;
+	BatchedProbes.Ledge = FLedgeProbe();
 
+	// Workers only see static geometry, pawns and anything else that moves are checked on the game thread when the probe is used
+	BatchedProbes.StaticParams = CustomCharacterOwner->GetIgnoreCharacterParams();
+	BatchedProbes.StaticParams.MobilityType = EQueryMobilityType::Static;
+	BatchedProbes.DynamicParams = CustomCharacterOwner->GetIgnoreCharacterParams();
+	BatchedProbes.DynamicParams.MobilityType = EQueryMobilityType::Dynamic;
+	return true;
+}
 
-	/* Prev Imp with some additions. I may revert back to this
-	// Smoothly blend toward the current surface’s new tangent:
-	
-	// Perform the move
-	bJustTeleported = false;
-	Iterations++;
-	const FVector OldLocation = UpdatedComponent->GetComponentLocation();
-	FHitResult SurfHit, FloorHit;
-	GetWorld()->LineTraceSingleByProfile(SurfHit, OldLocation, OldLocation + UpdatedComponent->GetForwardVector() * MaxLedgeGrabDistance, "BlockAll", CustomCharacterOwner->GetIgnoreCharacterParams());
-	GetWorld()->LineTraceSingleByProfile(FloorHit, OldLocation, OldLocation + FVector::DownVector * CapHH() * 1.2f, "BlockAll", CustomCharacterOwner->GetIgnoreCharacterParams());
-	if (!SurfHit.IsValidBlockingHit() || FloorHit.IsValidBlockingHit())
-	{
-		//in on frame you could go from falling to walking
-		SetMovementMode(MOVE_Falling);
-		StartNewPhysics(deltaTime, Iterations);
-		return;
+void UCustomCharacterMovementComponent::RunBatchedProbes()
+{
+	if (BatchedProbes.bHang)
+	{
+		ProbeHang(BatchedProbes.HangLocation, BatchedProbes.HangRotation, BatchedProbes.StaticParams, StaticClimbableQueryParams, BatchedProbes.Hang);
 	}
-	// Apply acceleration
-	CalcVelocity(deltaTime, 0.f, false, GetMaxBrakingDeceleration());
-	Velocity = FVector::VectorPlaneProject(Velocity, SurfHit.Normal);
-
-	// Compute move parameters
-	const FVector Delta = deltaTime * Velocity; // dx = v * dt
-	if (!Delta.IsNearlyZero())
+	if (BatchedProbes.bLedge)
 	{
-		FHitResult Hit;
-		SafeMoveUpdatedComponent(Delta, UpdatedComponent->GetComponentQuat(), true, Hit);
-		FVector WallAttractionDelta = -SurfHit.Normal * 30.f * deltaTime;
-		SafeMoveUpdatedComponent(WallAttractionDelta, UpdatedComponent->GetComponentQuat(), true, Hit);
+		ProbeLedge(BatchedProbes.LedgeBaseLoc, BatchedProbes.LedgeFwd, BatchedProbes.LedgeCheckDistance, BatchedProbes.StaticParams, BatchedProbes.Ledge);
 	}
-
-	//ik
-	Velocity = (UpdatedComponent->GetComponentLocation() - OldLocation) / deltaTime; // v = dx / dt
-	*/
 }
 
-FVector UCustomCharacterMovementComponent::GetLedgeGrabStartLocation(FHitResult FrontHit, FHitResult SurfaceHit) const
+bool UCustomCharacterMovementComponent::ConsumeBatchedHangProbe(const FVector& Location, const FQuat& Rotation, FHangProbe& Out)
 {
-	float CosWallSteepnessAngle = FrontHit.Normal | FVector::UpVector;
-	//Probably needs adjusting
-	float DownDistance =  CapHH() * 2.f;
-	FVector EdgeTangent = FVector::CrossProduct(SurfaceHit.Normal, FrontHit.Normal).GetSafeNormal();
-
-	// 
-	if (GEngine)
-	{
-		// -1 = auto key, 1.5f = stays on screen for 1.5 seconds
-		GEngine->AddOnScreenDebugMessage(
-			-1,
-			1.5f,
-			FColor::Magenta,
-			FString::Printf(TEXT("Tangent = %s"), *EdgeTangent.ToString())
-		);
-	}
-	
-	DrawDebugLine(
-	GetWorld(),
-	UpdatedComponent->GetComponentLocation(),
-	UpdatedComponent->GetComponentLocation() + EdgeTangent * 1000.0f,
-	FColor::Magenta,
-	false, 1.0f, 0, 10.0f
-);
+	// Only valid for the frame it was gathered in and for the exact same inputs
+	if (!BatchedProbes.bHang || BatchedProbes.Frame != GFrameCounter || BatchedProbes.HangLocation != Location || !(BatchedProbes.HangRotation == Rotation)) return false;
+	BatchedProbes.bHang = false;
 
-	FVector LedgeGrabStart = SurfaceHit.Location;
-	LedgeGrabStart += FrontHit.Normal.GetSafeNormal2D() * (2.f + CapR());
-	LedgeGrabStart += UpdatedComponent->GetForwardVector().GetSafeNormal2D().ProjectOnTo(EdgeTangent) * CapR() * .3f;
-	LedgeGrabStart += FVector::UpVector * CapHH();
-	LedgeGrabStart += FVector::DownVector * DownDistance;
-	LedgeGrabStart += FrontHit.Normal.GetSafeNormal2D() * CosWallSteepnessAngle * DownDistance;
+	// The batch saw static geometry only, anything dynamic in reach means the synchronous probe has to run
+	if (HasDynamicGeometryIn(BatchedProbes.HangBounds)) return false;
 
-	return LedgeGrabStart;
+	// Swap so both probes keep their hit array allocations
+	Swap(Out, BatchedProbes.Hang);
+	return true;
 }
 
-FVector UCustomCharacterMovementComponent::GetLedgeGrabCurrentLocation(FHitResult FrontHit, FHitResult SurfaceHit) const
+bool UCustomCharacterMovementComponent::ConsumeBatchedLedgeProbe(const FVector& BaseLoc, const FVector& Fwd, float CheckDistance, FLedgeProbe& Out)
 {
-	float CosWallSteepnessAngle = FrontHit.Normal | FVector::UpVector;
-	//Probably needs adjusting
-	float DownDistance =  CapHH() * 2.f;
-	FVector EdgeTangent = FVector::CrossProduct(SurfaceHit.Normal, FrontHit.Normal).GetSafeNormal();
+	if (!BatchedProbes.bLedge || BatchedProbes.Frame != GFrameCounter || BatchedProbes.LedgeBaseLoc != BaseLoc
+		|| BatchedProbes.LedgeFwd != Fwd || BatchedProbes.LedgeCheckDistance != CheckDistance) return false;
+	BatchedProbes.bLedge = false;
 
-	FVector LedgeGrabStart = SurfaceHit.Location;
-	LedgeGrabStart += FrontHit.Normal.GetSafeNormal2D() * (2.f + CapR());
-	LedgeGrabStart += UpdatedComponent->GetForwardVector().GetSafeNormal2D().ProjectOnTo(EdgeTangent) * CapR() * .3f;
-	LedgeGrabStart += FVector::UpVector * CapHH();
-	LedgeGrabStart += FVector::DownVector * DownDistance;
-	LedgeGrabStart += FrontHit.Normal.GetSafeNormal2D() * CosWallSteepnessAngle * DownDistance;
+	if (HasDynamicGeometryIn(BatchedProbes.LedgeBounds)) return false;
 
-	return LedgeGrabStart;
+	Out = MoveTemp(BatchedProbes.Ledge);
+	return true;
 }
 
-void UCustomCharacterMovementComponent::SnapMovementToClimableSurfaces(float DeltaTime)
+bool UCustomCharacterMovementComponent::HasDynamicGeometryIn(const FBox& Bounds) const
 {
-	const FVector ComponentForward = UpdatedComponent->GetForwardVector();
-	const FVector ComponentLocation = UpdatedComponent->GetComponentLocation();
-
-	const FVector ProjectedCharacterToSurface = 
-	(CurrentClimbableSurfaceLocation - ComponentLocation).ProjectOnTo(ComponentForward);
+	// No scene query here, the subsystem gathered the movable primitives around the whole batch once this frame
+	const ULedgeProbeSubsystem* ProbeSubsystem = GetWorld()->GetSubsystem<ULedgeProbeSubsystem>();
+	return !ProbeSubsystem || ProbeSubsystem->HasDynamicPrimitiveIn(Bounds, BatchedProbes.DynamicParams);
+}
 
-	const FVector SnapVector = -CurrentClimbableSurfaceNormal * ProjectedCharacterToSurface.Length();
+FBox UCustomCharacterMovementComponent::GetLedgeProbeBounds(const FVector& BaseLoc, const FVector& Fwd, float CheckDistance) const
+{
+	// Front traces, the height trace down onto the top face and the clearance capsule above it. The height trace
+	// follows the wall up, which leans by at most LedgeGrabMinWallSteepnessAngle, hence the extra horizontal reach
+	const float MaxHeight = CapHH() * 2 + LedgeGrabReachHeight;
+	const float WallLean = MaxHeight * FMath::Cos(FMath::DegreesToRadians(LedgeGrabMinWallSteepnessAngle));
+	FBox Bounds(BaseLoc, BaseLoc);
+	Bounds += BaseLoc + Fwd * (CheckDistance + CapR() * 2.f) + FVector::UpVector * (MaxHeight + CapHH() * 2.f + CapR() * 3.f + 1.f);
+	return Bounds.ExpandBy(CapR() + WallLean);
+}
 
-	UpdatedComponent->MoveComponent(
-	SnapVector*DeltaTime*100.f,
-	UpdatedComponent->GetComponentQuat(),
-	true);
+FBox UCustomCharacterMovementComponent::GetHangProbeBounds(const FVector& Location, const FQuat& Rotation) const
+{
+	// Wall and top traces in front of the eyes, the climbable and floor sweeps around the capsule
+	const FVector Forward = Rotation.GetForwardVector();
+	const FVector Up = Rotation.GetUpVector();
+	const float ProbeHeight = CapHH() * 2.f + 10.f;
+	const float Reach = 30.f + MaxLedgeGrabDistance + 20.f;
+	const float Top = CharacterOwner->BaseEyeHeight + ProbeHeight;
+	const float Bottom = FMath::Min(CharacterOwner->BaseEyeHeight - ProbeHeight, -51.f);
+
+	FBox Bounds(Location, Location);
+	Bounds += Location + Forward * Reach + Up * Top;
+	Bounds += Location + Forward * Reach + Up * Bottom;
+	Bounds += Location + Up * Top;
+	Bounds += Location + Up * Bottom;
+	return Bounds.ExpandBy(FMath::Max(ClimbCapsuleTraceRadius, ClimbCapsuleTraceHalfHeight) + ProbeHeight);
 }
 
-FQuat UCustomCharacterMovementComponent::GetClimbRotation(float DeltaTime)
-{	
-	const FQuat CurrentQuat = UpdatedComponent->GetComponentQuat();
+const FLedgeCacheEntry* UCustomCharacterMovementComponent::FindCachedLedge(const FVector& BaseLoc, const FVector& Fwd)
+{
+	const double Now = GetWorld()->GetTimeSeconds();
 
-	if(HasAnimRootMotion() || CurrentRootMotion.HasOverrideVelocity())
+	for (int32 i = LedgeCache.Num() - 1; i >= 0; --i)
 	{
-		return CurrentQuat;
-	}
-
-	const FQuat TargetQuat = FRotationMatrix::MakeFromX(-CurrentClimbableSurfaceNormal).ToQuat();
+		const FLedgeCacheEntry& Entry = LedgeCache[i];
+		const UPrimitiveComponent* Component = Entry.Component.Get();
+		const UPrimitiveComponent* SurfaceComponent = Entry.SurfaceComponent.Get();
+
+		// Drop ledges whose front or top component was destroyed or moved, or that are too old to trust
+		if (!Component || !Component->GetComponentTransform().Equals(Entry.ComponentTransform)
+			|| !SurfaceComponent || !SurfaceComponent->GetComponentTransform().Equals(Entry.SurfaceComponentTransform)
+			|| Now - Entry.TimeStamp > LedgeCacheLifetime)
+		{
+			LedgeCache.RemoveAtSwap(i, 1, EAllowShrinking::No);
+			continue;
+		}
 
-	return FMath::QInterpTo(CurrentQuat,TargetQuat,DeltaTime,5.f);
+		if (Entry.ValidityVolume.IsInsideOrOn(BaseLoc) && (Fwd | Entry.TraceDirection) >= LedgeCacheMinDirectionDot)
+		{
+			return &Entry;
+		}
+	}
+	return nullptr;
 }
 
-bool UCustomCharacterMovementComponent::CheckShouldStopHanging()
+void UCustomCharacterMovementComponent::CacheLedge(const FHitResult& FrontHit, const FHitResult& SurfaceHit, const FVector& BaseLoc, const FVector& Fwd)
 {
-	if(ClimbableSurfacesTracedResults.IsEmpty()) return true;
+	UPrimitiveComponent* Component = FrontHit.GetComponent();
+	UPrimitiveComponent* SurfaceComponent = SurfaceHit.GetComponent();
+	if (!Component || !SurfaceComponent) return;
 
-	const float DotResult = FVector::DotProduct(CurrentClimbableSurfaceNormal,FVector::UpVector);
-	const float DegreeDiff = FMath::RadiansToDegrees(FMath::Acos(DotResult));
+	const FVector EdgeTangent = FLedgeMath::GetEdgeTangent(SurfaceHit.Normal, FrontHit.Normal);
+	const int32 SegmentIndex = FMath::FloorToInt32((SurfaceHit.Location | EdgeTangent) / FMath::Max(LedgeCacheSegmentLength, 1.f));
 
-	if(DegreeDiff<=60.f)
+	// One entry per component segment, the newest trace wins
+	FLedgeCacheEntry* Entry = LedgeCache.FindByPredicate([Component, SegmentIndex](const FLedgeCacheEntry& Other)
 	{
-		return true;
+		return Other.Component.Get() == Component && Other.SegmentIndex == SegmentIndex;
+	});
+	if (!Entry)
+	{
+		if (LedgeCache.Num() >= MaxLedgeCacheEntries)
+		{
+			// Evict the oldest entry
+			int32 OldestIndex = 0;
+			for (int32 i = 1; i < LedgeCache.Num(); ++i)
+			{
+				if (LedgeCache[i].TimeStamp < LedgeCache[OldestIndex].TimeStamp) OldestIndex = i;
+			}
+			LedgeCache.RemoveAtSwap(OldestIndex, 1, EAllowShrinking::No);
+		}
+		Entry = &LedgeCache.AddDefaulted_GetRef();
 	}
-	
 
-	return false;
+	Entry->Component = Component;
+	Entry->ComponentTransform = Component->GetComponentTransform();
+	Entry->SurfaceComponent = SurfaceComponent;
+	Entry->SurfaceComponentTransform = SurfaceComponent->GetComponentTransform();
+	Entry->SegmentIndex = SegmentIndex;
+	Entry->FrontHit = FrontHit;
+	Entry->SurfaceHit = SurfaceHit;
+	Entry->EdgeTangent = EdgeTangent;
+	Entry->ValidityVolume = FBox::BuildAABB(BaseLoc, FVector(LedgeCacheValidityExtent));
+	Entry->TraceDirection = Fwd;
+	Entry->TimeStamp = GetWorld()->GetTimeSeconds();
 }
 
-bool UCustomCharacterMovementComponent::CheckHasReachedFloor()
+bool UCustomCharacterMovementComponent::FindIndexedLedge(const FVector& BaseLoc, const FVector& Fwd, float CheckDistance,
+	FHitResult& OutFrontHit, FHitResult& OutSurfaceHit, float& OutClearance) const
 {
-	const FVector DownVector = -UpdatedComponent->GetUpVector();
-	const FVector StartOffset = DownVector * 50.f;
-
-	const FVector Start = UpdatedComponent->GetComponentLocation() + StartOffset;
-	const FVector End = Start + DownVector;
+	if (!LedgeIndexSubsystem || !LedgeIndexSubsystem->HasIndexData() || !CVarUseLedgeIndex.GetValueOnAnyThread()) return false;
 
-	TArray<FHitResult> PossibleFloorHits = DoCapsuleTraceMultiByObject(Start,End);
+	// Same window the front and height traces cover
+	const float MinZ = BaseLoc.Z + MaxStepHeight - 1;
+	const float MaxZ = BaseLoc.Z + CapHH() * 2 + LedgeGrabReachHeight;
+	const float CosMMAA = FMath::Cos(FMath::DegreesToRadians(LedgeGrabMaxAlignmentAngle));
 
-	if(PossibleFloorHits.IsEmpty()) return false;
+	FLedgeIndexHit IndexHit;
+	if (!LedgeIndexSubsystem->FindLedge(BaseLoc, Fwd, CheckDistance, CapR(), MinZ, MaxZ, CosMMAA, IndexHit)) return false;
 
-	for(const FHitResult& PossibleFloorHit:PossibleFloorHits)
-	{	
-		const bool bFloorReached =
-		FVector::Parallel(-PossibleFloorHit.ImpactNormal,FVector::UpVector) &&
-		GetUnrotatedClimbVelocity().Z<-10.f;
+	// Build the hits the traces would have produced
+	OutFrontHit = FHitResult(1.f);
+	OutFrontHit.bBlockingHit = true;
+	OutFrontHit.Location = OutFrontHit.ImpactPoint = IndexHit.Point;
+	OutFrontHit.Normal = OutFrontHit.ImpactNormal = IndexHit.Edge->GetWallNormal();
 
-		if(bFloorReached)
-		{
-			return true;
-		}
-	}
+	OutSurfaceHit = FHitResult(1.f);
+	OutSurfaceHit.bBlockingHit = true;
+	OutSurfaceHit.Location = OutSurfaceHit.ImpactPoint = IndexHit.Point - OutFrontHit.Normal;
+	OutSurfaceHit.Normal = OutSurfaceHit.ImpactNormal = IndexHit.Edge->GetTopNormal();
 
-	return false;
+	OutClearance = IndexHit.Edge->Clearance;
+	return true;
 }
 
-void UCustomCharacterMovementComponent::StopHanging()
+bool UCustomCharacterMovementComponent::ConfirmIndexedLedge(FHitResult& FrontHit, FHitResult& SurfaceHit, const FCollisionQueryParams& Params) const
 {
-	SetMovementMode(MOVE_Falling);
+	CUSTOMCMC_SCOPE(STAT_LedgeGrabHeight);
+
+	// Short trace down onto the top face just behind the edge. Anything moved onto or over the ledge is hit first
+	const FVector Expected = SurfaceHit.Location;
+	const FVector TraceStart = Expected + FVector::UpVector * IndexedLedgeConfirmDistance;
+	const FVector TraceEnd = Expected - FVector::UpVector * IndexedLedgeConfirmDistance;
+	FHitResult Hit;
+	LINE(TraceStart, TraceEnd, FColor::Orange)
+	COUNT_SCENE_QUERY(STAT_QueriesLedgeGrab)
+	if (!GetWorld()->LineTraceSingleByProfile(Hit, TraceStart, TraceEnd, "BlockAll", Params)) return false;
+	if (!Hit.IsValidBlockingHit() || FMath::Abs(Hit.Location.Z - Expected.Z) > IndexedLedgeTolerance) return false;
+
+	SurfaceHit = Hit;
+	// Edges are extracted per component, the wall belongs to the same one as the top
+	FrontHit.Component = Hit.Component;
+	FrontHit.HitObjectHandle = Hit.HitObjectHandle;
+	FrontHit.PhysMaterial = Hit.PhysMaterial;
+	return true;
 }
 
-void UCustomCharacterMovementComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+bool UCustomCharacterMovementComponent::FindIndexedHangLedge(const FVector& Location, const FQuat& Rotation, FLedgeIndexHit& OutHit) const
 {
-	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
-	//boolean to call replicated animation from movement component
-	DOREPLIFETIME_CONDITION(UCustomCharacterMovementComponent, Proxy_bLedgeGrabbed, COND_SkipOwner)
-}
+	if (!LedgeIndexSubsystem || !LedgeIndexSubsystem->HasIndexData() || !CVarUseLedgeIndex.GetValueOnAnyThread()) return false;
 
-FVector UCustomCharacterMovementComponent::GetUnrotatedClimbVelocity() const
-{
-	return UKismetMathLibrary::Quat_UnrotateVector(UpdatedComponent->GetComponentQuat(),Velocity);
-}
+	// Mirrors the wall and top traces in ProbeHang
+	const FVector Forward = Rotation.GetForwardVector();
+	const FVector WallStartEye = Location
+		+ Rotation.GetUpVector() * CharacterOwner->BaseEyeHeight
+		+ Forward * 30.f;
+	const float ProbeHeight = CapHH() * 2.f + 10.f;
 
+	return LedgeIndexSubsystem->FindLedge(WallStartEye, Forward, MaxLedgeGrabDistance, CapR(),
+		WallStartEye.Z - ProbeHeight, WallStartEye.Z + ProbeHeight, 0.f, OutHit);
+}
 
-#pragma region SavedMove_Custom
-UCustomCharacterMovementComponent::FSavedMove_Custom::FSavedMove_Custom()
+void UCustomCharacterMovementComponent::PhysHang(float deltaTime, int32 Iterations)
 {
-	Saved_bWantsToSprint=0;
-}
+	CUSTOMCMC_SCOPE(STAT_PhysHang);
 
-// can tell the server to play a move twice if it is similar enough
-bool UCustomCharacterMovementComponent::FSavedMove_Custom::CanCombineWith(const FSavedMovePtr& NewMove,
+	if (deltaTime < MIN_TICK_TIME)
+	{
+		return;
+	}
+	if (!CharacterOwner || (!CharacterOwner->Controller && !bRunPhysicsWithNoController && !HasAnimRootMotion() && !CurrentRootMotion.HasOverrideVelocity() && (CharacterOwner->GetLocalRole() != ROLE_SimulatedProxy)))
+	{
+		Acceleration = FVector::ZeroVector;
+		Velocity = FVector::ZeroVector;
+		return;
+	}
+
+	// --- 1) Probe the wall and top faces, climbable surfaces and floor from where we start this tick ---
+	// Last tick's probe still holds if we have barely moved and nothing it hit has moved
+	const FVector ProbeLocation = UpdatedComponent->GetComponentLocation();
+	const FQuat ProbeRotation = UpdatedComponent->GetComponentQuat();
+	bHangProbeReused = CanReuseHangProbe(ProbeLocation, ProbeRotation);
+	if (!bHangProbeReused && !ConsumeBatchedHangProbe(ProbeLocation, ProbeRotation, HangProbe))
+	{
+		ProbeHang(ProbeLocation, ProbeRotation, CustomCharacterOwner->GetIgnoreCharacterParams(), ClimbableQueryParams, HangProbe);
+	}
+	const FHangProbe& Probe = HangProbe;
+
+	if (!Probe.bIndexedLedge)
+	{
+		// draw the wall trace in magenta
+		MOVEMENT_DEBUG(Line(Probe.WallStart, Probe.WallEnd, FColor::Magenta, 0.1f, 5.f))
+
+		// draw the top trace in cyan
+		if (Probe.WallHit.IsValidBlockingHit())
+		{
+			MOVEMENT_DEBUG(Line(Probe.TopStart, Probe.TopEnd, FColor::Cyan, 0.1f, 5.f))
+		}
+	}
+
+	// only proceed if we have both normals
+	const bool bTracedLedge = Probe.WallHit.IsValidBlockingHit() && Probe.TopHit.IsValidBlockingHit();
+	const bool bHasLedge = Probe.bIndexedLedge || bTracedLedge;
+	FVector FreshTangent = CurrentLedgeTangent;
+	if (bHasLedge)
+	{
+		CurrentLedgeWallNormal = Probe.bIndexedLedge ? Probe.IndexHit.Edge->GetWallNormal() : Probe.WallHit.Normal.GetSafeNormal();
+		CurrentLedgeTopNormal  = Probe.bIndexedLedge ? Probe.IndexHit.Edge->GetTopNormal() : Probe.TopHit.Normal.GetSafeNormal();
+
+		// --- 2) Cross them to get the edge tangent, blended towards over the substeps below ---
+		FreshTangent = FLedgeMath::GetEdgeTangent(CurrentLedgeWallNormal, CurrentLedgeTopNormal);
+	}
+	
+	/*Process all the climbable surfaces info*/
+	ProcessClimbableSurfaceInfo();
+	
+	
+	// after you calculate CurrentLedgeTangent…
+	MOVEMENT_DEBUG(Message(FString::Printf(TEXT("Tangent = %s"), *CurrentLedgeTangent.ToString()), FColor::Green, .5f, 2))
+
+	// The floor only stops us while climbing down, its sweep waits until then and is kept with the probe
+	if (!HangProbe.bFloorProbed && GetUnrotatedClimbVelocity().Z < -HangFloorMinDescentSpeed)
+	{
+		ProbeHangFloor(ClimbableQueryParams, HangProbe);
+	}
+
+	/*Check if we should stop climbing*/
+	if(CheckShouldStopHanging() || CheckHasReachedFloor(Probe.FloorHits))
+	{
+		// Falling takes the whole tick, as it would have with no hang to leave
+		StopHanging();
+		StartNewPhysics(deltaTime, Iterations);
+		return;
+	}
+
+	// --- 3) Integrate against this probe in equal substeps, so the interpolations follow the same path at any tick rate ---
+	const int32 NumSubsteps = GetNumHangSubsteps(deltaTime);
+	const float Substep = deltaTime / NumSubsteps;
+	for (int32 SubstepIndex = 0; SubstepIndex < NumSubsteps; ++SubstepIndex)
+	{
+		if (bHasLedge)
+		{
+			CurrentLedgeTangent = FMath::VInterpTo(CurrentLedgeTangent, FreshTangent, Substep, CornerInterpSpeed);
+		}
+
+		RestorePreAdditiveRootMotionVelocity();
+
+		if( !HasAnimRootMotion() && !CurrentRootMotion.HasOverrideVelocity() )
+		{	//Define the max climb speed and acceleration
+			CalcVelocity(Substep, 0.f, true, LedgeBrakingDeceleration);
+		}
+
+		ApplyRootMotionToVelocity(Substep);
+
+		FVector OldLocation = UpdatedComponent->GetComponentLocation();
+		const FVector Adjusted = Velocity * Substep;
+		FHitResult Hit(1.f);
+
+		//Handle climb rotation
+		SafeMoveUpdatedComponent(Adjusted, GetClimbRotation(Substep), true, Hit);
+
+		if (Hit.Time < 1.f)
+		{
+			//adjust and try again
+			HandleImpact(Hit, Substep, Adjusted);
+			SlideAlongSurface(Adjusted, (1.f-Hit.Time), Hit.Normal, Hit, true);
+		}
+
+		if(!HasAnimRootMotion() && !CurrentRootMotion.HasOverrideVelocity() )
+		{
+			Velocity = (UpdatedComponent->GetComponentLocation() - OldLocation) / Substep;
+		}
+
+		// An impact can end the hang, the new mode takes the substeps left and there is no surface to snap to
+		if (!IsHanging())
+		{
+			StartNewPhysics((NumSubsteps - SubstepIndex - 1) * Substep, Iterations);
+			return;
+		}
+	}
+
+	// debug
+	if (bHasLedge)
+	{
+		MOVEMENT_DEBUG(Line(UpdatedComponent->GetComponentLocation(), UpdatedComponent->GetComponentLocation() + CurrentLedgeTangent * 200.f, FColor::Magenta, 0.1f, 5.f))
+	}
+
+	/*Snap movement to climbable surfaces*/
+	SnapMovementToClimableSurfaces(Substep, NumSubsteps);
+	
+	/*if(CheckHasReachedLedge())
+	{	
+		PlayClimbMontage(ClimbToTopMontage);
+	}*/
+}
+
+int32 UCustomCharacterMovementComponent::GetNumHangSubsteps(float DeltaTime) const
+{
+	// Just under whole multiples, so 1/30 s in 1/120 s substeps is 4 and not 5
+	const int32 NumSubsteps = FMath::CeilToInt32(DeltaTime / FMath::Max(MaxHangSubstepTime, UE_KINDA_SMALL_NUMBER) - UE_KINDA_SMALL_NUMBER);
+	return FMath::Clamp(NumSubsteps, 1, FMath::Max(MaxHangSubsteps, 1));
+}
+
+FVector UCustomCharacterMovementComponent::GetLedgeGrabStartLocation(FHitResult FrontHit, FHitResult SurfaceHit) const
+{
+	MOVEMENT_DEBUG(Message(FString::Printf(TEXT("Tangent = %s"), *FLedgeMath::GetEdgeTangent(SurfaceHit.Normal, FrontHit.Normal).ToString()), FColor::Magenta, 1.5f))
+	MOVEMENT_DEBUG(Line(UpdatedComponent->GetComponentLocation(), UpdatedComponent->GetComponentLocation() + FLedgeMath::GetEdgeTangent(SurfaceHit.Normal, FrontHit.Normal) * 1000.0f, FColor::Magenta, 1.0f, 10.0f))
+
+	//Probably needs adjusting
+	return FLedgeMath::GetLedgeGrabLocation(SurfaceHit.Location, FrontHit.Normal, SurfaceHit.Normal, UpdatedComponent->GetForwardVector(), CapR(), CapHH());
+}
+
+FVector UCustomCharacterMovementComponent::GetLedgeGrabCurrentLocation(FHitResult FrontHit, FHitResult SurfaceHit) const
+{
+	return FLedgeMath::GetLedgeGrabLocation(SurfaceHit.Location, FrontHit.Normal, SurfaceHit.Normal, UpdatedComponent->GetForwardVector(), CapR(), CapHH());
+}
+
+void UCustomCharacterMovementComponent::SnapMovementToClimableSurfaces(float DeltaTime, int32 NumSubsteps)
+{
+	CUSTOMCMC_SCOPE(STAT_SnapToClimbableSurfaces);
+	const FVector ComponentForward = UpdatedComponent->GetForwardVector();
+	const FVector ComponentLocation = UpdatedComponent->GetComponentLocation();
+
+	const FVector ProjectedCharacterToSurface = 
+	(CurrentClimbableSurfaceLocation - ComponentLocation).ProjectOnTo(ComponentForward);
+
+	const FVector SnapVector = -CurrentClimbableSurfaceNormal * ProjectedCharacterToSurface.Length();
+
+	// Already pressed against the same surfaces, the sweep would be blocked before moving again
+	if (bHangProbeReused && bHangSnapBlocked) return;
+
+	// Each substep closes DeltaTime * HangSnapSpeed of the gap, the probe holds the surface still so they compound into one sweep
+	const float SubstepFraction = FMath::Min(DeltaTime * HangSnapSpeed, 1.f);
+	const float SnapFraction = 1.f - FMath::Pow(1.f - SubstepFraction, static_cast<float>(NumSubsteps));
+
+	COUNT_SCENE_QUERY(STAT_QueriesHangSnap)
+	FHitResult SnapHit;
+	UpdatedComponent->MoveComponent(
+	SnapVector*SnapFraction,
+	UpdatedComponent->GetComponentQuat(),
+	true,
+	&SnapHit);
+	bHangSnapBlocked = SnapHit.bBlockingHit && SnapHit.Time <= UE_KINDA_SMALL_NUMBER;
+}
+
+FQuat UCustomCharacterMovementComponent::GetClimbRotation(float DeltaTime)
+{	
+	const FQuat CurrentQuat = UpdatedComponent->GetComponentQuat();
+
+	if(HasAnimRootMotion() || CurrentRootMotion.HasOverrideVelocity())
+	{
+		return CurrentQuat;
+	}
+
+	return FLedgeMath::GetClimbRotation(CurrentQuat, CurrentClimbableSurfaceNormal, DeltaTime, 5.f);
+}
+
+bool UCustomCharacterMovementComponent::CheckShouldStopHanging()
+{
+	if(HangProbe.ClimbableHits.IsEmpty()) return true;
+
+	const float DotResult = FVector::DotProduct(CurrentClimbableSurfaceNormal,FVector::UpVector);
+	const float DegreeDiff = FMath::RadiansToDegrees(FMath::Acos(DotResult));
+
+	if(DegreeDiff<=60.f)
+	{
+		return true;
+	}
+	
+
+	return false;
+}
+
+bool UCustomCharacterMovementComponent::CheckHasReachedFloor(TConstArrayView<FHitResult> PossibleFloorHits) const
+{
+	CUSTOMCMC_SCOPE(STAT_CheckHasReachedFloor);
+	if(PossibleFloorHits.IsEmpty()) return false;
+
+	for(const FHitResult& PossibleFloorHit:PossibleFloorHits)
+	{	
+		const bool bFloorReached =
+		FVector::Parallel(-PossibleFloorHit.ImpactNormal,FVector::UpVector) &&
+		GetUnrotatedClimbVelocity().Z<-HangFloorMinDescentSpeed;
+
+		if(bFloorReached)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void UCustomCharacterMovementComponent::StopHanging()
+{
+	SetMovementMode(MOVE_Falling);
+}
+
+void UCustomCharacterMovementComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+	// Pushed, only compared after TryLedgeGrab marks it dirty
+	FDoRepLifetimeParams LedgeGrabEventParams;
+	LedgeGrabEventParams.Condition = COND_SkipOwner;
+	LedgeGrabEventParams.bIsPushBased = true;
+	DOREPLIFETIME_WITH_PARAMS_FAST(UCustomCharacterMovementComponent, LedgeGrabEvent, LedgeGrabEventParams);
+}
+
+FVector UCustomCharacterMovementComponent::GetUnrotatedClimbVelocity() const
+{
+	return UKismetMathLibrary::Quat_UnrotateVector(UpdatedComponent->GetComponentQuat(),Velocity);
+}
+
+
+#pragma region SavedMove_Custom
+UCustomCharacterMovementComponent::FSavedMove_Custom::FSavedMove_Custom()
+{
+	Saved_bWantsToSprint=0;
+	DefaultAccelDotThresholdCombine = AccelDotThresholdCombine;
+}
+
+// can tell the server to play a move twice if it is similar enough
+bool UCustomCharacterMovementComponent::FSavedMove_Custom::CanCombineWith(const FSavedMovePtr& NewMove,
                                                                         ACharacter* InCharacter, float MaxDelta) const
 {
 	const FSavedMove_Custom* NewCustomMove = static_cast<FSavedMove_Custom*>(NewMove.Get());
@@ -713,9 +1263,35 @@ bool UCustomCharacterMovementComponent::FSavedMove_Custom::CanCombineWith(const
 		return false;
 	}
 
+	// Hang moves only combine with hang moves on the same ledge, and only while the input barely changes
+	const bool bHangMove = Saved_HangState.bHanging || NewCustomMove->Saved_HangState.bHanging;
+	if (bHangMove && CVarHangMoveCoalescing.GetValueOnGameThread())
+	{
+		if (Saved_HangState.bHanging != NewCustomMove->Saved_HangState.bHanging || Saved_HangState.LedgeGrabID != NewCustomMove->Saved_HangState.LedgeGrabID)
+		{
+			return false;
+		}
+
+		const UCustomCharacterMovementComponent* CharacterMovement = Cast<UCustomCharacterMovementComponent>(InCharacter->GetCharacterMovement());
+		if (FVector::DistSquared(Acceleration, NewCustomMove->Acceleration) > FMath::Square(CharacterMovement->HangCombineMaxAccelDelta))
+		{
+			return false;
+		}
+	}
+
 	return FSavedMove_Character::CanCombineWith(NewMove, InCharacter, MaxDelta);
 }
 
+void UCustomCharacterMovementComponent::FSavedMove_Custom::CombineWith(const FSavedMove_Character* OldMove, ACharacter* InCharacter,
+	APlayerController* PC, const FVector& OldStartLocation)
+{
+	FSavedMove_Character::CombineWith(OldMove, InCharacter, PC, OldStartLocation);
+
+	// The combined move starts where the old one did, so does the hang state the server checks it against
+	const FSavedMove_Custom* OldCustomMove = static_cast<const FSavedMove_Custom*>(OldMove);
+	Saved_HangState = OldCustomMove->Saved_HangState;
+}
+
 //Reset Move To Be Empty
 void UCustomCharacterMovementComponent::FSavedMove_Custom::Clear()
 {
@@ -725,11 +1301,14 @@ void UCustomCharacterMovementComponent::FSavedMove_Custom::Clear()
 
 	Saved_bHadAnimRootMotion = 0;
 	Saved_bTransitionFinished = 0;
+
+	Saved_HangState = FCustomHangState();
 }
 
 // Can potentially add more of these for modes that need to be continuously updated
 uint8 UCustomCharacterMovementComponent::FSavedMove_Custom::GetCompressedFlags() const
 {
+	CUSTOMCMC_SCOPE(STAT_SavedMovePack);
 
 	uint8 Result = FSavedMove_Character::GetCompressedFlags();
 
@@ -744,6 +1323,7 @@ uint8 UCustomCharacterMovementComponent::FSavedMove_Custom::GetCompressedFlags()
 void UCustomCharacterMovementComponent::FSavedMove_Custom::SetMoveFor(ACharacter* C, float InDeltaTime,
 	FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData)
 {
+	CUSTOMCMC_SCOPE(STAT_SavedMovePack);
 	FSavedMove_Character::SetMoveFor(C, InDeltaTime, NewAccel, ClientData);
 
 	UCustomCharacterMovementComponent* CharacterMovement = Cast<UCustomCharacterMovementComponent>(C->GetCharacterMovement());
@@ -754,10 +1334,17 @@ void UCustomCharacterMovementComponent::FSavedMove_Custom::SetMoveFor(ACharacter
 	Saved_bHadAnimRootMotion = CharacterMovement->Safe_bHadAnimRootMotion;
 	Saved_bTransitionFinished = CharacterMovement->Safe_bTransitionFinished;
 
+	Saved_HangState = CharacterMovement->GetHangState();
+
+	// The engine's accel direction rule is too strict for slow shimmying, CanCombineWith bounds hang moves itself
+	AccelDotThresholdCombine = Saved_HangState.bHanging && CVarHangMoveCoalescing.GetValueOnGameThread()
+		? CharacterMovement->HangCombineAccelDotThreshold
+		: DefaultAccelDotThresholdCombine;
 }
 
 void UCustomCharacterMovementComponent::FSavedMove_Custom::PrepMoveFor(ACharacter* C)
 {
+	CUSTOMCMC_SCOPE(STAT_SavedMoveUnpack);
 	FSavedMove_Character::PrepMoveFor(C);
 	
 	UCustomCharacterMovementComponent* CharacterMovement = Cast<UCustomCharacterMovementComponent>(C->GetCharacterMovement());
@@ -768,19 +1355,429 @@ void UCustomCharacterMovementComponent::FSavedMove_Custom::PrepMoveFor(ACharacte
 	CharacterMovement->Safe_bHadAnimRootMotion = Saved_bHadAnimRootMotion;
 	CharacterMovement->Safe_bTransitionFinished = Saved_bTransitionFinished;
 
+	// LedgeGrabID is not restored, replay starts from the server's value and a replayed grab bumps it from there
 }
 
 #pragma endregion SavedMove_Custom
 
+#pragma region NetworkMoveData
+void FCustomHangState::Serialize(FArchive& Ar)
+{
+	uint8 bHangingBit = bHanging;
+	Ar.SerializeBits(&bHangingBit, 1);
+	bHanging = bHangingBit != 0;
+	if (!bHanging) return;
+
+	Ar << LedgeGrabID;
+	Ar << PackedTangent;
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		int16 AxisOffset = static_cast<int16>(LedgeOffset[Axis]);
+		Ar << AxisOffset;
+		LedgeOffset[Axis] = AxisOffset;
+	}
+}
+
+void UCustomCharacterMovementComponent::FCustomNetworkMoveData::ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType)
+{
+	FCharacterNetworkMoveData::ClientFillNetworkMoveData(ClientMove, MoveType);
+
+	HangState = static_cast<const FSavedMove_Custom&>(ClientMove).Saved_HangState;
+}
+
+bool UCustomCharacterMovementComponent::FCustomNetworkMoveData::Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap, ENetworkMoveType MoveType)
+{
+	FCharacterNetworkMoveData::Serialize(CharacterMovement, Ar, PackageMap, MoveType);
+
+	HangState.Serialize(Ar);
+	return !Ar.IsError();
+}
+
+void UCustomCharacterMovementComponent::FCustomMoveResponseDataContainer::ServerFillResponseData(const UCharacterMovementComponent& CharacterMovement,
+	const FClientAdjustment& PendingAdjustment)
+{
+	FCharacterMoveResponseDataContainer::ServerFillResponseData(CharacterMovement, PendingAdjustment);
+
+	LedgeGrabID = static_cast<const UCustomCharacterMovementComponent&>(CharacterMovement).LedgeGrabID;
+}
+
+bool UCustomCharacterMovementComponent::FCustomMoveResponseDataContainer::Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap)
+{
+	if (!FCharacterMoveResponseDataContainer::Serialize(CharacterMovement, Ar, PackageMap)) return false;
+
+	// Acks leave the client's count alone, only corrections carry it
+	if (IsCorrection())
+	{
+		Ar << LedgeGrabID;
+	}
+	return !Ar.IsError();
+}
+
+UCustomCharacterMovementComponent::FCustomNetworkMoveDataContainer::FCustomNetworkMoveDataContainer()
+{
+	NewMoveData = &CustomMoves[0];
+	PendingMoveData = &CustomMoves[1];
+	OldMoveData = &CustomMoves[2];
+}
+
+FCustomHangState UCustomCharacterMovementComponent::GetHangState() const
+{
+	FCustomHangState State;
+	State.bHanging = IsHanging();
+	if (!State.bHanging) return State;
+
+	State.LedgeGrabID = LedgeGrabID;
+	State.PackedTangent = FLedgeMath::PackDirection(CurrentLedgeTangent);
+
+	const FVector Offset = UpdatedComponent->GetComponentLocation() - CurrentLedgeAnchor;
+	for (int32 Axis = 0; Axis < 3; ++Axis)
+	{
+		State.LedgeOffset[Axis] = FMath::Clamp(FMath::RoundToInt32(Offset[Axis]), MIN_int16, MAX_int16);
+	}
+	return State;
+}
+
+bool UCustomCharacterMovementComponent::ValidateClientHangState(const FCustomHangState& ClientState) const
+{
+	if (!ClientState.bHanging || !IsHanging()) return false;
+
+	// Same grab, same anchor, so the offsets are comparable
+	const FCustomHangState ServerState = GetHangState();
+	if (ClientState.LedgeGrabID != ServerState.LedgeGrabID) return false;
+	if (FVector(ClientState.LedgeOffset - ServerState.LedgeOffset).Size() > HangStateMaxOffsetError) return false;
+
+	const float TangentDot = FLedgeMath::UnpackDirection(ClientState.PackedTangent) | FLedgeMath::UnpackDirection(ServerState.PackedTangent);
+	return TangentDot >= FMath::Cos(FMath::DegreesToRadians(HangStateMaxTangentError));
+}
+
+void UCustomCharacterMovementComponent::MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel)
+{
+	// The client took its hang state where this move starts, which is where the server is now if the two agree
+	const FCustomNetworkMoveData* MoveData = static_cast<const FCustomNetworkMoveData*>(GetCurrentNetworkMoveData());
+	bClientHangStateValidated = MoveData && ValidateClientHangState(MoveData->HangState);
+	bMovementModeChangedInMove = false;
+
+#if !UE_BUILD_SHIPPING
+	if (FMovementMoveRecorder::IsRecording() && MoveData)
+	{
+		FMovementMoveRecorder::RecordMove(*this, ClientTimeStamp, DeltaTime, CompressedFlags, NewAccel, MoveData->ControlRotation, MoveData->HangState);
+	}
+#endif
+
+	Super::MoveAutonomous(ClientTimeStamp, DeltaTime, CompressedFlags, NewAccel);
+
+	bClientHangStateValidated = false;
+}
+
+#if !UE_BUILD_SHIPPING
+void UCustomCharacterMovementComponent::MeasureServerMoveBits(int32& OutFlagsOnlyBits, int32& OutHangStateBits)
+{
+	FSavedMove_Custom Move;
+	Move.SetMoveFor(CharacterOwner, 1.f / 60.f, Acceleration, *GetPredictionData_Client_Character());
+	Move.PostUpdate(CharacterOwner, FSavedMove_Character::PostUpdate_Record);
+
+	// Bases go through the package map, which a measurement does not have. A hanging character has no base anyway
+	FCharacterNetworkMoveData FlagsOnly;
+	FlagsOnly.ClientFillNetworkMoveData(Move, FCharacterNetworkMoveData::ENetworkMoveType::NewMove);
+	FlagsOnly.MovementBase = nullptr;
+	FNetBitWriter FlagsOnlyWriter(nullptr, 1024);
+	FlagsOnly.Serialize(*this, FlagsOnlyWriter, nullptr, FCharacterNetworkMoveData::ENetworkMoveType::NewMove);
+
+	FCustomNetworkMoveData WithHangState;
+	WithHangState.ClientFillNetworkMoveData(Move, FCharacterNetworkMoveData::ENetworkMoveType::NewMove);
+	WithHangState.MovementBase = nullptr;
+	FNetBitWriter HangStateWriter(nullptr, 1024);
+	WithHangState.Serialize(*this, HangStateWriter, nullptr, FCharacterNetworkMoveData::ENetworkMoveType::NewMove);
+
+	OutFlagsOnlyBits = FlagsOnlyWriter.GetNumBits();
+	OutHangStateBits = HangStateWriter.GetNumBits();
+}
+#endif
+#pragma endregion NetworkMoveData
+
 #pragma region NetworkPredictionData
 UCustomCharacterMovementComponent::FNetworkPredictionData_Client_Custom::FNetworkPredictionData_Client_Custom(const UCharacterMovementComponent& ClientMovement)
 : Super(ClientMovement)
 {
 }
 
+UCustomCharacterMovementComponent::FNetworkPredictionData_Client_Custom::~FNetworkPredictionData_Client_Custom()
+{
+	// Drop the engine's references before the slab moves go away
+	SavedMoves.Empty();
+	FreeMoves.Empty();
+	PendingMove.Reset();
+	LastAckedMove.Reset();
+
+	for (FSavedMovePtr& SlotMove : SlotMoves)
+	{
+		FSavedMove_Custom* Move = static_cast<FSavedMove_Custom*>(SlotMove.Get());
+		SlotMove.Reset();
+		Move->~FSavedMove_Custom();
+	}
+}
+
+void UCustomCharacterMovementComponent::FNetworkPredictionData_Client_Custom::CreateSlab()
+{
+	// Every move the engine can hold at once, the saved moves plus the pending and last acked ones
+	const int32 Capacity = MaxSavedMoveCount + 2;
+	MoveSlab = MakeUnique<FSavedMoveSlot[]>(Capacity);
+	SlotMoves.Reserve(Capacity);
+	for (int32 Slot = 0; Slot < Capacity; ++Slot)
+	{
+		// The deleter never runs while SlotMoves holds its reference, the destructor destroys the moves itself
+		FSavedMove_Custom* Move = new (MoveSlab[Slot].Move.GetTypedPtr()) FSavedMove_Custom();
+		SlotMoves.Emplace(Move, [](FSavedMove_Character*) {});
+	}
+
+	// The slab, SlotMoves and each slot's reference controller, once per client
+	INC_DWORD_STAT_BY(STAT_SavedMoveHeapAllocations, Capacity + 2);
+}
+
 FSavedMovePtr UCustomCharacterMovementComponent::FNetworkPredictionData_Client_Custom::AllocateNewMove()
 {
-	return FSavedMovePtr(new FSavedMove_Custom());
+	if (SlotMoves.IsEmpty())
+	{
+		CreateSlab();
+	}
+
+	// Only called once FreeMoves is empty, so the scan is rare
+	int32 FreeSlot = INDEX_NONE;
+	int32 NumSlotsInUse = 0;
+	for (int32 Offset = 0; Offset < SlotMoves.Num(); ++Offset)
+	{
+		const int32 Slot = (NextSlot + Offset) % SlotMoves.Num();
+		if (SlotMoves[Slot].GetSharedReferenceCount() > 1)
+		{
+			++NumSlotsInUse;
+		}
+		else if (FreeSlot == INDEX_NONE)
+		{
+			FreeSlot = Slot;
+		}
+	}
+
+	if (FreeSlot == INDEX_NONE)
+	{
+		// One allocation, the move and its reference controller together
+		INC_DWORD_STAT(STAT_SavedMoveHeapAllocations);
+		return MakeShared<FSavedMove_Custom>();
+	}
+
+	if (++NumSlotsInUse > HighWaterMark)
+	{
+		HighWaterMark = NumSlotsInUse;
+		static int32 HighestWaterMark = 0;
+		if (HighWaterMark > HighestWaterMark)
+		{
+			HighestWaterMark = HighWaterMark;
+			SET_DWORD_STAT(STAT_SavedMovePoolHighWater, HighestWaterMark);
+		}
+	}
+
+	NextSlot = (FreeSlot + 1) % SlotMoves.Num();
+	const FSavedMovePtr& Move = SlotMoves[FreeSlot];
+	Move->Clear();
+	return Move;
+}
+
+float UCustomCharacterMovementComponent::GetClientNetSendDeltaTime(const APlayerController* PC,
+	const FNetworkPredictionData_Client_Character* ClientData, const FSavedMovePtr& NewMove) const
+{
+	const float NetSendDeltaTime = Super::GetClientNetSendDeltaTime(PC, ClientData, NewMove);
+
+	// Jumping off the ledge still goes out at the normal rate
+	const FSavedMove_Custom* NewCustomMove = static_cast<const FSavedMove_Custom*>(NewMove.Get());
+	if (NewCustomMove && NewCustomMove->Saved_HangState.bHanging && !NewCustomMove->HasJumpInput() && CVarHangMoveCoalescing.GetValueOnGameThread())
+	{
+		return FMath::Max(NetSendDeltaTime, HangMinNetSendInterval);
+	}
+	return NetSendDeltaTime;
+}
+
+void UCustomCharacterMovementComponent::CallServerMovePacked(const FSavedMove_Character* NewMove, const FSavedMove_Character* PendingMove,
+	const FSavedMove_Character* OldMove)
+{
+	INC_DWORD_STAT(STAT_ServerMovesSent);
+#if !UE_BUILD_SHIPPING
+	++GetModeCounters().Get(FMovementModeCounters::GetMode(*this)).ServerMoves;
+#endif
+
+	Super::CallServerMovePacked(NewMove, PendingMove, OldMove);
+}
+
+void UCustomCharacterMovementComponent::ServerSendMoveResponse(const FClientAdjustment& PendingAdjustment)
+{
+	if (!PendingAdjustment.bAckGoodMove)
+	{
+		INC_DWORD_STAT(STAT_ServerCorrectionsSent);
+#if !UE_BUILD_SHIPPING
+		++ServerCorrections;
+		++GetModeCounters().Get(FMovementModeCounters::GetMode(*this)).Corrections;
+#endif
+	}
+
+	Super::ServerSendMoveResponse(PendingAdjustment);
+}
+
+void UCustomCharacterMovementComponent::ClientAdjustPosition_Implementation(float TimeStamp, FVector NewLoc, FVector NewVel, UPrimitiveComponent* NewBase,
+	FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode, TOptional<FRotator> OptionalRotation)
+{
+	// Super ignores a correction for a move that was already acknowledged, and so does the ID
+	const FNetworkPredictionData_Client_Character* ClientData = GetPredictionData_Client_Character();
+	const bool bStaleCorrection = ClientData && ClientData->GetSavedMoveIndex(TimeStamp) == INDEX_NONE && ClientData->LastAckedMove.IsValid();
+
+	Super::ClientAdjustPosition_Implementation(TimeStamp, NewLoc, NewVel, NewBase, NewBaseBoneName, bHasBase, bBaseRelativePosition, ServerMovementMode, OptionalRotation);
+
+	// The legacy unpacked RPCs bypass the response container, its ID then belongs to an older response
+	const FCharacterMoveResponseDataContainer& MoveResponse = GetMoveResponseDataContainer();
+	if (!bStaleCorrection && MoveResponse.IsCorrection() && MoveResponse.ClientAdjustment.TimeStamp == TimeStamp)
+	{
+		LedgeGrabID = static_cast<const FCustomMoveResponseDataContainer&>(MoveResponse).LedgeGrabID;
+	}
+}
+
+bool UCustomCharacterMovementComponent::ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientWorldLocation,
+	const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode)
+{
+	const bool bClientError = Super::ServerCheckClientError(ClientTimeStamp, DeltaTime, Accel, ClientWorldLocation, RelativeClientLocation,
+		ClientMovementBase, ClientBaseBoneName, ClientMovementMode);
+
+#if !UE_BUILD_SHIPPING
+	if (bClientError)
+	{
+		TEnumAsByte<EMovementMode> ClientMode;
+		TEnumAsByte<EMovementMode> ClientGroundMode;
+		uint8 ClientCustomMode;
+		UnpackNetworkMovementMode(ClientMovementMode, ClientMode, ClientCustomMode, ClientGroundMode);
+
+		using ECause = FMovementCorrectionTelemetry::ECause;
+		FMovementCorrectionTelemetry::FCorrection Correction;
+		Correction.Mode = FMovementModeCounters::GetMode(*this);
+		Correction.MovementMode = MovementMode;
+		Correction.CustomMode = CustomMovementMode;
+		Correction.PositionError = FVector::Dist(UpdatedComponent->GetComponentLocation(), ClientWorldLocation);
+		Correction.bRootMotion = HasRootMotionSources() || HasAnimRootMotion();
+		Correction.Cause =
+			ClientMode != MovementMode || (MovementMode == MOVE_Custom && ClientCustomMode != CustomMovementMode) ? ECause::ModeMismatch :
+			bMovementModeChangedInMove ? ECause::ModeChange :
+			Correction.bRootMotion ? ECause::RootMotion :
+			IsHanging() ? ECause::Hang :
+			Safe_bWantsToSprint ? ECause::Sprint :
+			ECause::Other;
+		FMovementCorrectionTelemetry::Record(Correction);
+	}
+#endif
+
+	return bClientError;
+}
+
+void UCustomCharacterMovementComponent::ServerMove_HandleMoveData(const FCharacterNetworkMoveDataContainer& MoveDataContainer)
+{
+	if (!ServerMoveScheduler || !ServerMoveScheduler->IsActive())
+	{
+		Super::ServerMove_HandleMoveData(MoveDataContainer);
+		return;
+	}
+
+	// Deserialized into CustomNetworkMoveDataContainer, see SetNetworkMoveDataContainer
+	const FCustomNetworkMoveDataContainer& Container = static_cast<const FCustomNetworkMoveDataContainer&>(MoveDataContainer);
+	const bool bIdle = !Container.bHasPendingMove && !Container.bHasOldMove && !Container.bIsDualHybridRootMotionMove
+		&& IsIdleServerMove(Container.CustomMoves[0]);
+
+	if (DeferredServerMoves.IsEmpty() && !bIdle && ServerMoveScheduler->HasBudget())
+	{
+		UServerMoveScheduler::FScopedCharge Charge(*ServerMoveScheduler);
+		Super::ServerMove_HandleMoveData(MoveDataContainer);
+		return;
+	}
+
+	FDeferredServerMove& Deferred = DeferredServerMoves.AddDefaulted_GetRef();
+	for (int32 MoveIndex = 0; MoveIndex < UE_ARRAY_COUNT(Deferred.Moves); ++MoveIndex)
+	{
+		Deferred.Moves[MoveIndex] = Container.CustomMoves[MoveIndex];
+		Deferred.MovementBases[MoveIndex] = Container.CustomMoves[MoveIndex].MovementBase;
+		Deferred.Moves[MoveIndex].MovementBase = nullptr;
+	}
+	Deferred.ArrivalTime = FPlatformTime::Seconds();
+	Deferred.bHasPendingMove = Container.bHasPendingMove;
+	Deferred.bHasOldMove = Container.bHasOldMove;
+	Deferred.bIsDualHybridRootMotionMove = Container.bIsDualHybridRootMotionMove;
+	Deferred.bDisableCombinedScopedMove = Container.bDisableCombinedScopedMove;
+	Deferred.bIdle = bIdle;
+
+	ServerMoveScheduler->MarkWaiting(this, bIdle);
+}
+
+void UCustomCharacterMovementComponent::RunDeferredServerMoves()
+{
+	const float MaxMoveDeltaTime = GetDefault<AGameNetworkManager>()->MaxMoveDeltaTime;
+
+	for (int32 Index = 0; Index < DeferredServerMoves.Num(); ++Index)
+	{
+		const FDeferredServerMove& Deferred = DeferredServerMoves[Index];
+
+		// An idle move the next one repeats is left out, the next move's timestamp delta covers its time.
+		// Only while the server is still too, and not past the delta the server would clamp
+		if (Deferred.bIdle && DeferredServerMoves.IsValidIndex(Index + 1) && DeferredServerMoves[Index + 1].bIdle)
+		{
+			const FCustomNetworkMoveData& Move = Deferred.Moves[0];
+			const FCustomNetworkMoveData& Next = DeferredServerMoves[Index + 1].Moves[0];
+			const float CurrentClientTimeStamp = GetPredictionData_Server_Character()->CurrentClientTimeStamp;
+			if (Next.CompressedMoveFlags == Move.CompressedMoveFlags
+				&& Next.MovementMode == Move.MovementMode
+				&& DeferredServerMoves[Index + 1].MovementBases[0] == Deferred.MovementBases[0]
+				&& Next.MovementBaseBoneName == Move.MovementBaseBoneName
+				&& Next.HangState == Move.HangState
+				&& FVector::DistSquared(Next.Location, Move.Location) <= 1.f
+				&& Next.TimeStamp > Move.TimeStamp
+				&& Next.TimeStamp > CurrentClientTimeStamp
+				&& Next.TimeStamp - CurrentClientTimeStamp <= MaxMoveDeltaTime
+				&& IsServerStateIdle(Move.MovementMode))
+			{
+				INC_DWORD_STAT(STAT_ServerMovesFolded);
+				continue;
+			}
+		}
+
+		for (int32 MoveIndex = 0; MoveIndex < UE_ARRAY_COUNT(Deferred.Moves); ++MoveIndex)
+		{
+			// A base destroyed while the move waited runs as no base, as if the move had arrived after it was gone
+			FCustomNetworkMoveData& Move = CustomNetworkMoveDataContainer.CustomMoves[MoveIndex];
+			Move = Deferred.Moves[MoveIndex];
+			Move.MovementBase = Deferred.MovementBases[MoveIndex].Get();
+		}
+		CustomNetworkMoveDataContainer.bHasPendingMove = Deferred.bHasPendingMove;
+		CustomNetworkMoveDataContainer.bHasOldMove = Deferred.bHasOldMove;
+		CustomNetworkMoveDataContainer.bIsDualHybridRootMotionMove = Deferred.bIsDualHybridRootMotionMove;
+		CustomNetworkMoveDataContainer.bDisableCombinedScopedMove = Deferred.bDisableCombinedScopedMove;
+
+		Super::ServerMove_HandleMoveData(CustomNetworkMoveDataContainer);
+	}
+
+	DeferredServerMoves.Reset();
+}
+
+bool UCustomCharacterMovementComponent::HasActiveDeferredServerMove() const
+{
+	return DeferredServerMoves.ContainsByPredicate([](const FDeferredServerMove& Deferred) { return !Deferred.bIdle; });
+}
+
+bool UCustomCharacterMovementComponent::IsIdleServerMove(const FCustomNetworkMoveData& Move) const
+{
+	constexpr uint8 InputFlags = FSavedMove_Character::FLAG_JumpPressed | FSavedMove_Character::FLAG_Custom_1
+		| FSavedMove_Character::FLAG_Custom_2 | FSavedMove_Character::FLAG_Custom_3;
+
+	return Move.Acceleration.IsNearlyZero() && (Move.CompressedMoveFlags & InputFlags) == 0 && IsServerStateIdle(Move.MovementMode);
+}
+
+bool UCustomCharacterMovementComponent::IsServerStateIdle(uint8 ClientMovementMode) const
+{
+	return ClientMovementMode == PackNetworkMovementMode()
+		&& (IsMovingOnGround() || IsHanging())
+		&& Velocity.IsNearlyZero(1.f)
+		&& !HasAnimRootMotion()
+		&& !HasRootMotionSources();
 }
 
 //Create Client Prediction Data that references our movement component
@@ -802,14 +1799,135 @@ FNetworkPredictionData_Client* UCustomCharacterMovementComponent::GetPredictionD
 void UCustomCharacterMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType,
 	FActorComponentTickFunction* ThisTickFunction)
 {
+#if !UE_BUILD_SHIPPING
+	const FMovementModeCounters::EMode CounterMode = FMovementModeCounters::GetMode(*this);
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+#endif
+
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	// Speed changes within a mode move the rate between moving and idle
+	if (CustomCharacterOwner && CustomCharacterOwner->HasAuthority() && !IsNetMode(NM_Standalone))
+	{
+		CustomCharacterOwner->UpdateNetUpdateRate(false);
+	}
+
+#if !UE_BUILD_SHIPPING
+	// Attributed to the mode the tick started in
+	FMovementModeCounters::FTotals& ModeTotals = GetModeCounters().Get(CounterMode);
+	++ModeTotals.Ticks;
+	ModeTotals.Cycles += FPlatformTime::Cycles64() - StartCycles;
+	if (CharacterOwner && CharacterOwner->GetLocalRole() == ROLE_AutonomousProxy)
+	{
+		ModeTotals.ClientMicroseconds += static_cast<uint64>(DeltaTime * 1e6f);
+	}
+	else if (CharacterOwner && CharacterOwner->HasAuthority() && !IsNetMode(NM_Standalone))
+	{
+		ModeTotals.ServerMicroseconds += static_cast<uint64>(DeltaTime * 1e6f);
+	}
+
+	if (FMovementDebugRecorder::ShouldDrawLive() && !IsNetMode(NM_DedicatedServer))
+	{
+		DebugRecorder.DrawPending(GetWorld());
+	}
+#endif
+}
+
+#if !UE_BUILD_SHIPPING
+FMovementModeCounters& UCustomCharacterMovementComponent::GetModeCounters() const
+{
+	return ModeCounters ? *ModeCounters : FMovementModeCounters::ForWorld(GetWorld());
+}
+
+double UCustomCharacterMovementComponent::GetLedgeQueriesSaved() const
+{
+	if (LedgeCacheMisses == 0) return 0.0;
+
+	// What the presses resolved from the index or the cache would have cost through the probe, less what they did cost
+	const double QueriesPerProbe = static_cast<double>(LedgeProbeQueries) / LedgeCacheMisses;
+	return (LedgeIndexHits + LedgeCacheHits) * QueriesPerProbe - static_cast<double>(LedgeIndexQueries + LedgeCacheQueries);
+}
+
+void UCustomCharacterMovementComponent::DumpMovementDebug() const
+{
+	const FString FilePath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MovementDebug"),
+		FString::Printf(TEXT("%s_%s.txt"), *GetNameSafe(CharacterOwner), *FDateTime::Now().ToString()));
+
+	if (DebugRecorder.Dump(FilePath))
+	{
+		UE_LOG(LogTemp, Log, TEXT("Wrote movement debug to %s"), *IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*FilePath));
+	}
 }
 
+static FAutoConsoleCommandWithWorld DumpMovementDebugCommand(
+	TEXT("CustomCMC.Debug.DumpMovement"),
+	TEXT("Writes every character's recorded movement debug to Saved/MovementDebug"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		for (TActorIterator<ACustomCMCCharacter> It(World); It; ++It)
+		{
+			if (const UCustomCharacterMovementComponent* Movement = It->GetCustomMovementComponent())
+			{
+				Movement->DumpMovementDebug();
+			}
+		}
+	}));
+#endif
+
 void UCustomCharacterMovementComponent::InitializeComponent()
 {
 	Super::InitializeComponent();
 	
 	CustomCharacterOwner = Cast<ACustomCMCCharacter>(GetOwner());
+	LedgeIndexSubsystem = GetWorld() ? GetWorld()->GetSubsystem<ULedgeIndexSubsystem>() : nullptr;
+
+	// Same settings CapsuleTraceMultiForObjects would build on every call
+	ClimbableObjectQueryParams = FCollisionObjectQueryParams(ClimbableSurfaceTraceTypes);
+	ClimbableQueryParams = FCollisionQueryParams(SCENE_QUERY_STAT(ClimbableSurfaces), false);
+	ClimbableQueryParams.bReturnPhysicalMaterial = true;
+	StaticClimbableQueryParams = ClimbableQueryParams;
+	StaticClimbableQueryParams.MobilityType = EQueryMobilityType::Static;
+	ClimbableSweepScratch.Reserve(MaxHangProbeHits);
+
+#if !UE_BUILD_SHIPPING
+	ModeCounters = &FMovementModeCounters::ForWorld(GetWorld());
+#endif
+}
+
+void UCustomCharacterMovementComponent::RegisterComponentTickFunctions(bool bRegister)
+{
+	Super::RegisterComponentTickFunctions(bRegister);
+
+	// Moves held by the scheduler are dropped with the registration, the component is going away
+	ServerMoveScheduler = GetWorld() ? GetWorld()->GetSubsystem<UServerMoveScheduler>() : nullptr;
+	if (ServerMoveScheduler)
+	{
+		if (bRegister)
+		{
+			ServerMoveScheduler->RegisterComponent(this);
+		}
+		else
+		{
+			ServerMoveScheduler->UnregisterComponent(this);
+			DeferredServerMoves.Reset();
+			ServerMoveScheduler = nullptr;
+		}
+	}
+
+	// Batched ledge probes have to finish before this component moves
+	ULedgeProbeSubsystem* ProbeSubsystem = GetWorld() ? GetWorld()->GetSubsystem<ULedgeProbeSubsystem>() : nullptr;
+	if (!ProbeSubsystem) return;
+
+	if (bRegister)
+	{
+		PrimaryComponentTick.AddPrerequisite(ProbeSubsystem, ProbeSubsystem->GetTickFunction());
+		ProbeSubsystem->RegisterComponent(this);
+	}
+	else
+	{
+		PrimaryComponentTick.RemovePrerequisite(ProbeSubsystem, ProbeSubsystem->GetTickFunction());
+		ProbeSubsystem->UnregisterComponent(this);
+	}
 }
 #pragma endregion NetworkPredictionData
 // FirstThingCalledInPerformMovement
@@ -879,6 +1997,7 @@ bool UCustomCharacterMovementComponent::IsMovementMode(EMovementMode InMovementM
 // Network
 void UCustomCharacterMovementComponent::UpdateFromCompressedFlags(uint8 Flags)
 {
+	CUSTOMCMC_SCOPE(STAT_SavedMoveUnpack);
 	Super::UpdateFromCompressedFlags(Flags);
 
 	Safe_bWantsToSprint = (Flags & FSavedMove_Custom::FLAG_Custom_0) != 0;
@@ -912,72 +2031,80 @@ float UCustomCharacterMovementComponent::CapHH() const
 
 void UCustomCharacterMovementComponent::OnRep_LedgeGrab()
 {
-	//Probably need a different specifier here
-	CharacterOwner->PlayAnimMontage(TallLedgeGrabMontage);
-}
-
-
-void UCustomCharacterMovementComponent::ProcessClimbableSurfaceInfo()
-{
-	CurrentClimbableSurfaceLocation = FVector::ZeroVector;
-	CurrentClimbableSurfaceNormal = FVector::ZeroVector;
-
-	if(ClimbableSurfacesTracedResults.IsEmpty()) return;
-
-	for(const FHitResult& TracedHitResult:ClimbableSurfacesTracedResults)
+	// Simulated proxies only, a server never plays it
+#if !UE_SERVER
+	// Only the latest grab replicates, one that never played is superseded by it
+	if (LedgeGrabEvent.Sequence == LastLedgeGrabSequence) return;
+	LastLedgeGrabSequence = LedgeGrabEvent.Sequence;
+
+	const AGameStateBase* GameState = GetWorld()->GetGameState();
+	const float Duration = LedgeGrabEvent.DurationMs / 1000.f;
+	// Unsigned difference, correct across the wrap of the ms clock
+	const uint32 ElapsedMs = GameState ? GetLedgeGrabTimeMs(GameState->GetServerWorldTimeSeconds()) - LedgeGrabEvent.ServerStartTimeMs : 0;
+	// A start time ahead of ours is clock error, not a grab from the future
+	const float Elapsed = ElapsedMs < MAX_uint32 / 2 ? ElapsedMs / 1000.f : 0.f;
+	// Became relevant long after the grab, whatever the character does now has nothing to do with it
+	if (Elapsed >= Duration + LedgeGrabLateBlendWindow) return;
+
+	CurrentLedgeTangent = FLedgeMath::UnpackDirection(LedgeGrabEvent.PackedTangent);
+	CAPSULE(LedgeGrabEvent.TargetLocation, FColor::Yellow)
+
+	// Tall grabs play the owning client's transition montage at its rate, short grabs have no montage on the
+	// owner and play the proxy one stretched over the same duration. Either starts as far in as the server already is
+	UAnimMontage* Montage = LedgeGrabEvent.Montage == ELedgeGrabMontage::Tall ? TransitionTallLedgeGrabMontage : ProxyShortLedgeGrabMontage;
+	if (!Montage) return;
+
+	const float PlayRate = 1.f / Duration;
+	CharacterOwner->PlayAnimMontage(Montage, PlayRate);
+	if (UAnimInstance* AnimInstance = CharacterOwner->GetMesh() ? CharacterOwner->GetMesh()->GetAnimInstance() : nullptr)
 	{
-		CurrentClimbableSurfaceLocation += TracedHitResult.ImpactPoint;
-		CurrentClimbableSurfaceNormal += TracedHitResult.ImpactNormal;
+		// Relevant or updated after the transition was over, typically at more latency than its 0.1-0.25s. Start
+		// from the final pose and let the montage blend out into the hang rather than pop from the jump
+		const float FinalPosition = FMath::Max(0.f, Montage->GetPlayLength() - Montage->GetDefaultBlendOutTime());
+		AnimInstance->Montage_SetPosition(Montage, FMath::Min(Elapsed * PlayRate, FinalPosition));
 	}
-
-	CurrentClimbableSurfaceLocation /= ClimbableSurfacesTracedResults.Num();
-	CurrentClimbableSurfaceNormal = CurrentClimbableSurfaceNormal.GetSafeNormal();
+#endif
 }
 
-//Trace for climbable surfaces, return true if there are indeed valid surfaces, false otherwise
-bool UCustomCharacterMovementComponent::TraceClimbableSurfaces()
+bool FLedgeGrabEvent::NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess)
 {
-	// BASE CODE IS SHORT BLURB BELOW
-	const FVector StartOffset = UpdatedComponent->GetForwardVector() * 30.f;
-	const FVector Start = UpdatedComponent->GetComponentLocation() + StartOffset;
-	const FVector End = Start + UpdatedComponent->GetForwardVector();
-	
-	ClimbableSurfacesTracedResults = DoCapsuleTraceMultiByObject(Start,End);
-	
-	
-	return !ClimbableSurfacesTracedResults.IsEmpty();
-}
+	Ar << Sequence;
+	TargetLocation.NetSerialize(Ar, Map, bOutSuccess);
+	Ar << PackedTangent;
 
+	uint8 MontageBit = static_cast<uint8>(Montage);
+	Ar.SerializeBits(&MontageBit, 1);
+	Montage = static_cast<ELedgeGrabMontage>(MontageBit);
 
-TArray<FHitResult> UCustomCharacterMovementComponent::DoCapsuleTraceMultiByObject(const FVector & Start, const FVector & End, bool bShowDebugShape,bool bDrawPersistantShapes)
-{	
-	TArray<FHitResult> OutCapsuleTraceHitResults;
+	Ar << DurationMs;
+	Ar << ServerStartTimeMs;
+	return true;
+}
 
-	EDrawDebugTrace::Type DebugTraceType = EDrawDebugTrace::None;
 
-	if(bShowDebugShape)
-	{
-		DebugTraceType = EDrawDebugTrace::ForOneFrame;
+void UCustomCharacterMovementComponent::ProcessClimbableSurfaceInfo()
+{
+	CUSTOMCMC_SCOPE(STAT_ProcessClimbableSurfaceInfo);
+	FLedgeMath::AverageHitSurfaces(HangProbe.ClimbableHits, CurrentClimbableSurfaceLocation, CurrentClimbableSurfaceNormal);
+}
 
-		if(bDrawPersistantShapes)
-		{
-			DebugTraceType = EDrawDebugTrace::Persistent;
-		}
-	}
+void UCustomCharacterMovementComponent::DoCapsuleTraceMultiByObject(const FVector& Start, const FVector& End, const FCollisionQueryParams& QueryParams, FHangProbeHits& OutHits) const
+{
+	CUSTOMCMC_SCOPE(STAT_ClimbableSurfaceSweep);
+	OutHits.Reset();
+	if (!ClimbableObjectQueryParams.IsValid()) return;
 
-	UKismetSystemLibrary::CapsuleTraceMultiForObjects(
-		this,
+	GetWorld()->SweepMultiByObjectType(
+		ClimbableSweepScratch,
 		Start,
 		End,
-		ClimbCapsuleTraceRadius,
-		ClimbCapsuleTraceHalfHeight,
-		ClimbableSurfaceTraceTypes,
-		false,
-		TArray<AActor*>(),
-		DebugTraceType,
-		OutCapsuleTraceHitResults,
-		false
+		FQuat::Identity,
+		ClimbableObjectQueryParams,
+		FCollisionShape::MakeCapsule(ClimbCapsuleTraceRadius, ClimbCapsuleTraceHalfHeight),
+		QueryParams
 	);
 
-	return OutCapsuleTraceHitResults;
+	// Hits come back nearest first
+	OutHits.Append(ClimbableSweepScratch.GetData(), FMath::Min(ClimbableSweepScratch.Num(), MaxHangProbeHits));
+	ClimbableSweepScratch.Reset();
 }
\ No newline at end of file
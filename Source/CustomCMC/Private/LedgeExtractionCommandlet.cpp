@@ -0,0 +1,287 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LedgeExtractionCommandlet.h"
+
+#include "CustomCharacterMovementComponent.h"
+#include "LedgeIndexAsset.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Misc/PackageName.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "UObject/Package.h"
+#include "UObject/SavePackage.h"
+#include "WorldPartition/WorldPartition.h"
+#if WITH_EDITOR
+#include "WorldPartition/LoaderAdapter/LoaderAdapterShape.h"
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(LogLedgeExtraction, Log, All);
+
+ULedgeExtractionCommandlet::ULedgeExtractionCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 ULedgeExtractionCommandlet::Main(const FString& Params)
+{
+#if WITH_EDITOR
+	// Use the same filter angles as TryLedgeGrab unless overridden
+	const UCustomCharacterMovementComponent* MovementDefaults = GetDefault<UCustomCharacterMovementComponent>();
+	MinWallSteepnessAngle = MovementDefaults->LedgeGrabMinWallSteepnessAngle;
+	MaxSurfaceAngle = MovementDefaults->LedgeGrabMaxSurfaceAngle;
+	FParse::Value(*Params, TEXT("MinWallSteepnessAngle="), MinWallSteepnessAngle);
+	FParse::Value(*Params, TEXT("MaxSurfaceAngle="), MaxSurfaceAngle);
+
+	TArray<FString> Maps = {
+		TEXT("/Game/ThirdPerson/Lvl_ThirdPerson"),
+		TEXT("/Game/ThirdPerson/FallToHang"),
+		TEXT("/Game/Variant_Platforming/Lvl_Platforming")
+	};
+	FString MapsParam;
+	if (FParse::Value(*Params, TEXT("Maps="), MapsParam, false))
+	{
+		Maps.Reset();
+		MapsParam.ParseIntoArray(Maps, TEXT("+"));
+	}
+
+	int32 NumFailed = 0;
+	for (const FString& Map : Maps)
+	{
+		if (!ExtractMap(Map)) ++NumFailed;
+	}
+	return NumFailed;
+#else
+	UE_LOG(LogLedgeExtraction, Error, TEXT("Ledge extraction needs an editor build"));
+	return 1;
+#endif
+}
+
+bool ULedgeExtractionCommandlet::ExtractMap(const FString& MapPackageName)
+{
+#if WITH_EDITOR
+	UPackage* MapPackage = LoadPackage(nullptr, *MapPackageName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World)
+	{
+		UE_LOG(LogLedgeExtraction, Error, TEXT("Could not load map %s"), *MapPackageName);
+		return false;
+	}
+
+	World->AddToRoot();
+	World->WorldType = EWorldType::Editor;
+	if (!World->bIsWorldInitialized)
+	{
+		World->InitWorld(UWorld::InitializationValues()
+			.AllowAudioPlayback(false)
+			.CreatePhysicsScene(true)
+			.RequiresHitProxies(false)
+			.CreateNavigation(false)
+			.CreateAISystem(false)
+			.ShouldSimulatePhysics(false)
+			.EnableTraceCollision(true)
+			.SetTransactional(false)
+			.CreateFXSystem(false));
+	}
+	World->UpdateWorldComponents(true, false);
+
+	// World partition maps keep their actors external, load all of them so clearance traces see every neighbour
+	TUniquePtr<FLoaderAdapterShape> LoaderAdapter;
+	if (World->GetWorldPartition())
+	{
+		LoaderAdapter = MakeUnique<FLoaderAdapterShape>(World, FBox(FVector(-HALF_WORLD_MAX), FVector(HALF_WORLD_MAX)), TEXT("Ledge Extraction"));
+		LoaderAdapter->Load();
+	}
+
+	TArray<FLedgeEdge> Edges;
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		TInlineComponentArray<UStaticMeshComponent*> Components(*It);
+		for (UStaticMeshComponent* Component : Components)
+		{
+			ExtractComponent(Component, Edges);
+		}
+	}
+
+	for (FLedgeEdge& Edge : Edges)
+	{
+		Edge.Clearance = MeasureClearance(World, Edge);
+	}
+
+	// Write the index next to the other content so it gets cooked with the map
+	const FString AssetPackageName = ULedgeIndexAsset::GetAssetPackageName(MapPackageName);
+	const FString AssetName = FPackageName::GetShortName(AssetPackageName);
+	UPackage* AssetPackage = CreatePackage(*AssetPackageName);
+	AssetPackage->FullyLoad();
+
+	ULedgeIndexAsset* Asset = FindObject<ULedgeIndexAsset>(AssetPackage, *AssetName);
+	if (!Asset)
+	{
+		Asset = NewObject<ULedgeIndexAsset>(AssetPackage, *AssetName, RF_Public | RF_Standalone);
+	}
+	Asset->SourceMap = MapPackageName;
+	Asset->MinWallSteepnessAngle = MinWallSteepnessAngle;
+	Asset->MaxSurfaceAngle = MaxSurfaceAngle;
+	Asset->Edges = MoveTemp(Edges);
+	AssetPackage->MarkPackageDirty();
+
+	FSavePackageArgs SaveArgs;
+	SaveArgs.TopLevelFlags = RF_Public | RF_Standalone;
+	SaveArgs.SaveFlags = SAVE_NoError;
+	const FString Filename = FPackageName::LongPackageNameToFilename(AssetPackageName, FPackageName::GetAssetPackageExtension());
+	const bool bSaved = UPackage::SavePackage(AssetPackage, Asset, *Filename, SaveArgs);
+
+	UE_LOG(LogLedgeExtraction, Display, TEXT("%s: %d ledges -> %s%s"), *MapPackageName, Asset->Edges.Num(), *Filename, bSaved ? TEXT("") : TEXT(" (save failed)"));
+
+	LoaderAdapter.Reset();
+	World->RemoveFromRoot();
+	World->DestroyWorld(false);
+	CollectGarbage(RF_NoFlags);
+
+	return bSaved;
+#else
+	return false;
+#endif
+}
+
+void ULedgeExtractionCommandlet::ExtractComponent(UStaticMeshComponent* Component, TArray<FLedgeEdge>& OutEdges) const
+{
+	// Only static geometry is indexed, anything that can move keeps using traces at runtime
+	if (!Component || Component->Mobility != EComponentMobility::Static || !Component->IsCollisionEnabled()) return;
+
+	const UBodySetup* BodySetup = Component->GetBodySetup();
+	if (!BodySetup) return;
+
+	const FTransform ComponentTransform = Component->GetComponentTransform();
+	TArray<FVector> Vertices;
+	TArray<int32> Indices;
+
+	for (const FKBoxElem& Box : BodySetup->AggGeom.BoxElems)
+	{
+		const FTransform ElemTransform = Box.GetTransform() * ComponentTransform;
+		const FVector Extent(Box.X * 0.5f, Box.Y * 0.5f, Box.Z * 0.5f);
+
+		Vertices.Reset();
+		for (int32 Corner = 0; Corner < 8; ++Corner)
+		{
+			const FVector Sign((Corner & 1) ? 1.f : -1.f, (Corner & 2) ? 1.f : -1.f, (Corner & 4) ? 1.f : -1.f);
+			Vertices.Add(ElemTransform.TransformPosition(Extent * Sign));
+		}
+
+		// Two triangles per face, winding is fixed up from the centroid in ExtractTriangles
+		static const int32 BoxIndices[] = {
+			0, 1, 3, 0, 3, 2,	// -Z
+			4, 5, 7, 4, 7, 6,	// +Z
+			0, 1, 5, 0, 5, 4,	// -Y
+			2, 3, 7, 2, 7, 6,	// +Y
+			0, 2, 6, 0, 6, 4,	// -X
+			1, 3, 7, 1, 7, 5	// +X
+		};
+		Indices = TArray<int32>(BoxIndices, UE_ARRAY_COUNT(BoxIndices));
+		ExtractTriangles(Vertices, Indices, OutEdges);
+	}
+
+	for (const FKConvexElem& Convex : BodySetup->AggGeom.ConvexElems)
+	{
+		const FTransform ElemTransform = Convex.GetTransform() * ComponentTransform;
+
+		Vertices.Reset();
+		for (const FVector& Vertex : Convex.VertexData)
+		{
+			Vertices.Add(ElemTransform.TransformPosition(Vertex));
+		}
+		Indices = Convex.IndexData;
+		ExtractTriangles(Vertices, Indices, OutEdges);
+	}
+}
+
+void ULedgeExtractionCommandlet::ExtractTriangles(const TArray<FVector>& Vertices, const TArray<int32>& Indices, TArray<FLedgeEdge>& OutEdges) const
+{
+	if (Vertices.IsEmpty() || Indices.Num() < 3) return;
+
+	// Same tests as TryLedgeGrab: the wall must be steep enough and the top flat enough
+	const float CosMMWSA = FMath::Cos(FMath::DegreesToRadians(MinWallSteepnessAngle));
+	const float CosMMSA = FMath::Cos(FMath::DegreesToRadians(MaxSurfaceAngle));
+
+	FVector Centroid = FVector::ZeroVector;
+	for (const FVector& Vertex : Vertices) Centroid += Vertex;
+	Centroid /= Vertices.Num();
+
+	// Outward face normals, elements are convex so outward is away from the centroid
+	const int32 NumTriangles = Indices.Num() / 3;
+	TArray<FVector> FaceNormals;
+	FaceNormals.SetNumUninitialized(NumTriangles);
+	for (int32 Tri = 0; Tri < NumTriangles; ++Tri)
+	{
+		const FVector& A = Vertices[Indices[Tri * 3]];
+		const FVector& B = Vertices[Indices[Tri * 3 + 1]];
+		const FVector& C = Vertices[Indices[Tri * 3 + 2]];
+		FVector Normal = FVector::CrossProduct(B - A, C - A).GetSafeNormal();
+		if ((Normal | ((A + B + C) / 3.f - Centroid)) < 0.f) Normal = -Normal;
+		FaceNormals[Tri] = Normal;
+	}
+
+	// Pair up triangles sharing an edge and keep the edges between a wall and a top face
+	TMap<uint64, int32> OpenEdges;
+	for (int32 Tri = 0; Tri < NumTriangles; ++Tri)
+	{
+		for (int32 Corner = 0; Corner < 3; ++Corner)
+		{
+			const int32 IndexA = Indices[Tri * 3 + Corner];
+			const int32 IndexB = Indices[Tri * 3 + (Corner + 1) % 3];
+			const uint64 Key = ((uint64)FMath::Min(IndexA, IndexB) << 32) | (uint32)FMath::Max(IndexA, IndexB);
+
+			int32 OtherTri;
+			if (!OpenEdges.RemoveAndCopyValue(Key, OtherTri))
+			{
+				OpenEdges.Add(Key, Tri);
+				continue;
+			}
+
+			const FVector& NormalA = FaceNormals[Tri];
+			const FVector& NormalB = FaceNormals[OtherTri];
+			const bool bAIsTop = (NormalA | FVector::UpVector) >= CosMMSA;
+			const bool bBIsTop = (NormalB | FVector::UpVector) >= CosMMSA;
+			const bool bAIsWall = FMath::Abs(NormalA | FVector::UpVector) <= CosMMWSA;
+			const bool bBIsWall = FMath::Abs(NormalB | FVector::UpVector) <= CosMMWSA;
+			if (!((bAIsTop && bBIsWall) || (bBIsTop && bAIsWall))) continue;
+
+			const FVector& Start = Vertices[IndexA];
+			const FVector& End = Vertices[IndexB];
+			if (FVector::DistSquared(Start, End) < FMath::Square(MinEdgeLength)) continue;
+
+			FLedgeEdge& Edge = OutEdges.AddDefaulted_GetRef();
+			Edge.Start = FVector3f(Start);
+			Edge.End = FVector3f(End);
+			Edge.SetWallNormal(bAIsTop ? NormalB : NormalA);
+			Edge.SetTopNormal(bAIsTop ? NormalA : NormalB);
+		}
+	}
+}
+
+float ULedgeExtractionCommandlet::MeasureClearance(UWorld* World, const FLedgeEdge& Edge) const
+{
+	const FVector WallNormal = Edge.GetWallNormal();
+	const FVector TopNormal = Edge.GetTopNormal();
+	const FCollisionShape Probe = FCollisionShape::MakeSphere(ClearanceProbeRadius);
+
+	// Sweep up from just inside both ends and the middle, the tightest sample wins
+	float Clearance = MaxClearance;
+	for (const float Alpha : {0.1f, 0.5f, 0.9f})
+	{
+		const FVector EdgePoint = FMath::Lerp(Edge.GetStart(), Edge.GetEnd(), Alpha);
+		const FVector Start = EdgePoint - WallNormal * (ClearanceProbeRadius + 2.f) + TopNormal * (ClearanceProbeRadius + 1.f);
+		const FVector End = Start + FVector::UpVector * MaxClearance;
+
+		FHitResult Hit;
+		if (World->SweepSingleByProfile(Hit, Start, End, FQuat::Identity, TEXT("BlockAll"), Probe))
+		{
+			Clearance = FMath::Min(Clearance, Hit.bStartPenetrating ? 0.f : Hit.Distance + 2.f * ClearanceProbeRadius + 1.f);
+		}
+	}
+	return Clearance;
+}
@@ -0,0 +1,19 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LedgeIndexAsset.h"
+
+#include "Misc/PackageName.h"
+
+void ULedgeIndexAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	// Edges are not reflected, write them as a flat block after the tagged properties
+	Ar << Edges;
+}
+
+FString ULedgeIndexAsset::GetAssetPackageName(const FString& MapPackageName)
+{
+	return FString::Printf(TEXT("/Game/LedgeIndex/LI_%s"), *FPackageName::GetShortName(MapPackageName));
+}
@@ -0,0 +1,157 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LedgeIndexSubsystem.h"
+
+#include "Engine/World.h"
+#include "Misc/PackageName.h"
+#include "UObject/Package.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogLedgeIndex, Log, All);
+
+// Keep the grid bounded on very large maps by growing the cell size instead
+static constexpr int32 MaxLedgeGridDim = 512;
+
+void FLedgeGrid::Build(TArray<FLedgeEdge>&& InEdges, float InCellSize)
+{
+	Reset();
+	Edges = MoveTemp(InEdges);
+	if (Edges.IsEmpty()) return;
+
+	// Bounds of every edge and of the whole set
+	EdgeBounds.Reserve(Edges.Num());
+	FBox3f TotalBounds(ForceInit);
+	for (const FLedgeEdge& Edge : Edges)
+	{
+		FBox3f& Bounds = EdgeBounds.Emplace_GetRef(ForceInit);
+		Bounds += Edge.Start;
+		Bounds += Edge.End;
+		TotalBounds += Bounds;
+	}
+
+	const FVector3f Size = TotalBounds.GetSize();
+	CellSize = FMath::Max3(InCellSize, Size.X / MaxLedgeGridDim, Size.Y / MaxLedgeGridDim);
+	Origin = FVector2D(TotalBounds.Min.X, TotalBounds.Min.Y);
+	Dims = FIntPoint(
+		FMath::Max(1, FMath::CeilToInt32(Size.X / CellSize)),
+		FMath::Max(1, FMath::CeilToInt32(Size.Y / CellSize)));
+
+	// Counting pass, then fill, so every cell's edges end up contiguous
+	const int32 NumCells = Dims.X * Dims.Y;
+	CellStart.SetNumZeroed(NumCells + 1);
+	for (const FBox3f& Bounds : EdgeBounds)
+	{
+		const FIntPoint Min = GetCell(FVector(Bounds.Min));
+		const FIntPoint Max = GetCell(FVector(Bounds.Max));
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			{
+				++CellStart[Y * Dims.X + X + 1];
+			}
+		}
+	}
+	for (int32 Cell = 0; Cell < NumCells; ++Cell)
+	{
+		CellStart[Cell + 1] += CellStart[Cell];
+	}
+
+	CellEdges.SetNumUninitialized(CellStart[NumCells]);
+	TArray<int32> CellFill(CellStart.GetData(), NumCells);
+	for (int32 EdgeIndex = 0; EdgeIndex < EdgeBounds.Num(); ++EdgeIndex)
+	{
+		const FIntPoint Min = GetCell(FVector(EdgeBounds[EdgeIndex].Min));
+		const FIntPoint Max = GetCell(FVector(EdgeBounds[EdgeIndex].Max));
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			{
+				CellEdges[CellFill[Y * Dims.X + X]++] = EdgeIndex;
+			}
+		}
+	}
+}
+
+void FLedgeGrid::Reset()
+{
+	Edges.Reset();
+	EdgeBounds.Reset();
+	CellStart.Reset();
+	CellEdges.Reset();
+	Dims = FIntPoint::ZeroValue;
+}
+
+bool ULedgeIndexSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) return false;
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void ULedgeIndexSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	const FString MapPackageName = UWorld::RemovePIEPrefix(InWorld.GetOutermost()->GetName());
+	const FString AssetPackageName = ULedgeIndexAsset::GetAssetPackageName(MapPackageName);
+	const FString AssetPath = AssetPackageName + TEXT(".") + FPackageName::GetShortName(AssetPackageName);
+
+	ULedgeIndexAsset* Asset = LoadObject<ULedgeIndexAsset>(nullptr, *AssetPath, nullptr, LOAD_NoWarn | LOAD_Quiet);
+	if (!Asset)
+	{
+		UE_LOG(LogLedgeIndex, Log, TEXT("No ledge index for %s, ledge detection will trace collision"), *MapPackageName);
+		return;
+	}
+
+	TArray<FLedgeEdge> Edges = Asset->Edges;
+	Grid.Build(MoveTemp(Edges), GridCellSize);
+	UE_LOG(LogLedgeIndex, Log, TEXT("Loaded %d ledges for %s"), Grid.Num(), *MapPackageName);
+}
+
+void ULedgeIndexSubsystem::Deinitialize()
+{
+	Grid.Reset();
+	Super::Deinitialize();
+}
+
+bool ULedgeIndexSubsystem::FindLedge(const FVector& Location, const FVector& Direction, float MaxDistance, float MaxLateral,
+	float MinZ, float MaxZ, float MinFacingDot, FLedgeIndexHit& OutHit) const
+{
+	const FVector Dir2D = Direction.GetSafeNormal2D();
+	const FVector Reach = Location + Dir2D * MaxDistance;
+
+	FBox QueryBox(ForceInit);
+	QueryBox += FVector(Location.X, Location.Y, MinZ);
+	QueryBox += FVector(Reach.X, Reach.Y, MaxZ);
+	QueryBox = QueryBox.ExpandBy(FVector(MaxLateral, MaxLateral, 0.f));
+
+	OutHit = FLedgeIndexHit();
+	float BestDistance = MaxDistance;
+
+	Grid.ForEachEdge(QueryBox, [&](const FLedgeEdge& Edge)
+	{
+		const FVector WallNormal = Edge.GetWallNormal();
+		if ((Dir2D | -WallNormal) < MinFacingDot) return;
+
+		// Closest point on the edge to the query location in XY, height interpolated along the edge
+		const FVector Start = Edge.GetStart();
+		const FVector Segment = Edge.GetEnd() - Start;
+		const float SegmentSizeSq = Segment.SizeSquared2D();
+		const float T = SegmentSizeSq > UE_SMALL_NUMBER ? FMath::Clamp(((Location - Start) | FVector(Segment.X, Segment.Y, 0.f)) / SegmentSizeSq, 0.f, 1.f) : 0.f;
+		const FVector Point = Start + Segment * T;
+		if (Point.Z < MinZ || Point.Z > MaxZ) return;
+
+		const FVector ToPoint = FVector(Point.X - Location.X, Point.Y - Location.Y, 0.f);
+		const float Distance = ToPoint | Dir2D;
+		if (Distance < 0.f || Distance > BestDistance) return;
+		if ((ToPoint - Dir2D * Distance).SizeSquared() > FMath::Square(MaxLateral)) return;
+
+		BestDistance = Distance;
+		OutHit.Edge = &Edge;
+		OutHit.Point = Point;
+		OutHit.Distance = Distance;
+	});
+
+	return OutHit.Edge != nullptr;
+}
@@ -0,0 +1,149 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LedgeProbeSubsystem.h"
+
+#include "CustomCharacterMovementComponent.h"
+#include "CustomCMC.h"
+#include "MovementModeCounters.h"
+#include "Async/ParallelFor.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Queries Probe Batch Dynamics"), STAT_QueriesProbeBatchDynamics, STATGROUP_CustomCMC);
+
+static TAutoConsoleVariable<bool> CVarBatchLedgeProbes(
+	TEXT("CustomCMC.BatchLedgeProbes"),
+	false,
+	TEXT("Run the static geometry part of ledge grab and hang probes for all characters as one parallel batch before movement (1) or every probe one at a time from each component (0). ")
+	TEXT("A batched probe is only used when nothing dynamic gathered with the batch is in its bounds"));
+
+static TAutoConsoleVariable<float> CVarBatchDynamicsMargin(
+	TEXT("CustomCMC.BatchLedgeProbes.DynamicsMargin"),
+	200.f,
+	TEXT("How far around the batch's probes movable primitives are gathered, it covers what moves into a probe's bounds before the probe is used"));
+
+void FLedgeProbeTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Subsystem && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Subsystem->RunBatch();
+	}
+}
+
+FString FLedgeProbeTickFunction::DiagnosticMessage()
+{
+	return TEXT("FLedgeProbeTickFunction");
+}
+
+bool ULedgeProbeSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) return false;
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void ULedgeProbeSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Components add this as a prerequisite when they register, which can happen before begin play
+	TickFunction.Subsystem = this;
+	TickFunction.TickGroup = TG_PrePhysics;
+	TickFunction.bCanEverTick = true;
+	TickFunction.bStartWithTickEnabled = true;
+	TickFunction.bRunOnAnyThread = false;
+}
+
+void ULedgeProbeSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	TickFunction.RegisterTickFunction(InWorld.PersistentLevel);
+}
+
+void ULedgeProbeSubsystem::Deinitialize()
+{
+	if (TickFunction.IsTickFunctionRegistered())
+	{
+		TickFunction.UnRegisterTickFunction();
+	}
+	Components.Reset();
+	Batch.Reset();
+	DynamicOverlaps.Reset();
+
+	Super::Deinitialize();
+}
+
+void ULedgeProbeSubsystem::RegisterComponent(UCustomCharacterMovementComponent* Component)
+{
+	Components.AddUnique(Component);
+}
+
+void ULedgeProbeSubsystem::UnregisterComponent(UCustomCharacterMovementComponent* Component)
+{
+	Components.RemoveSingleSwap(Component);
+}
+
+void ULedgeProbeSubsystem::RunBatch()
+{
+	DynamicOverlaps.Reset();
+	if (!CVarBatchLedgeProbes.GetValueOnGameThread()) return;
+
+	// Requests are built on the game thread from each component's state at the start of the frame
+	Batch.Reset();
+	FBox BatchBounds(ForceInit);
+	for (UCustomCharacterMovementComponent* Component : Components)
+	{
+		if (IsValid(Component) && Component->GatherBatchedProbes())
+		{
+			Batch.Add(Component);
+			const UCustomCharacterMovementComponent::FBatchedProbes& Probes = Component->BatchedProbes;
+			if (Probes.bHang)
+			{
+				BatchBounds += Probes.HangBounds;
+			}
+			if (Probes.bLedge)
+			{
+				BatchBounds += Probes.LedgeBounds;
+			}
+		}
+	}
+	if (Batch.IsEmpty()) return;
+
+	// One query for every component's dynamic check. Each one then tests these primitives' bounds, as they are when it
+	// uses its probe, against its own probe bounds
+	FCollisionQueryParams DynamicParams(SCENE_QUERY_STAT(LedgeProbeBatchDynamics), false);
+	DynamicParams.MobilityType = EQueryMobilityType::Dynamic;
+	const FBox GatherBounds = BatchBounds.ExpandBy(CVarBatchDynamicsMargin.GetValueOnGameThread());
+	INC_DWORD_STAT(STAT_QueriesProbeBatchDynamics);
+#if !UE_BUILD_SHIPPING
+	// Not any one character's, so it counts towards no movement mode
+	++FMovementModeCounters::ForWorld(GetWorld()).Get(FMovementModeCounters::EMode::Other).SceneQueries;
+#endif
+	GetWorld()->OverlapMultiByProfile(DynamicOverlaps, GatherBounds.GetCenter(), FQuat::Identity, "BlockAll",
+		FCollisionShape::MakeBox(GatherBounds.GetExtent()), DynamicParams);
+
+	// Workers only run UWorld queries against static geometry. Each component writes only its own results and static
+	// geometry does not move during the frame, so the order workers pick components up in does not change any result
+	ParallelFor(Batch.Num(), [this](int32 Index)
+	{
+		Batch[Index]->RunBatchedProbes();
+	});
+}
+
+bool ULedgeProbeSubsystem::HasDynamicPrimitiveIn(const FBox& Bounds, const FCollisionQueryParams& Params) const
+{
+	for (const FOverlapResult& Overlap : DynamicOverlaps)
+	{
+		const UPrimitiveComponent* Primitive = Overlap.GetComponent();
+		if (!IsValid(Primitive) || Params.GetIgnoredComponents().Contains(Primitive->GetUniqueID())) continue;
+
+		const AActor* Owner = Primitive->GetOwner();
+		if (Owner && Params.GetIgnoredSourceObjects().Contains(Owner->GetUniqueID())) continue;
+
+		if (Primitive->Bounds.GetBox().Intersect(Bounds)) return true;
+	}
+	return false;
+}
@@ -0,0 +1,575 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementBenchmarkCommandlet.h"
+
+#include "AIController.h"
+#include "CustomCMCCharacter.h"
+#include "CustomCharacterMovementComponent.h"
+#include "MovementModeCounters.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMovementBenchmark, Log, All);
+
+struct UMovementBenchmarkCommandlet::FBot
+{
+	enum class EPhase : uint8
+	{
+		Walk,
+		Jump,
+		Grab,
+		Hang,
+	};
+
+	ACustomCMCCharacter* Character = nullptr;
+	FTransform Start;
+	EPhase Phase = EPhase::Walk;
+	float PhaseTime = 0.f;
+
+	// Spreads the bots over the script so they do not all jump on the same frame
+	float StartDelay = 0.f;
+
+	// Right and forward, given to the character every frame
+	FVector2D MoveInput = FVector2D::ZeroVector;
+};
+
+struct UMovementBenchmarkCommandlet::FTrajectoryPoint
+{
+	FVector Location = FVector::ZeroVector;
+	FMovementModeCounters::EMode Mode = FMovementModeCounters::EMode::Other;
+};
+
+struct UMovementBenchmarkCommandlet::FRunResult
+{
+	int32 NumCharacters = 0;
+	// CustomCMC.BatchLedgeProbes for the run
+	bool bBatchedProbes = false;
+	double GameThreadMs = 0.0;
+	double MaxGameThreadMs = 0.0;
+	// Game thread ms per second of game time, comparable between tick rates
+	double GameThreadMsPerSecond = 0.0;
+	double SceneQueriesPerFrame = 0.0;
+
+	// NewMove ServerMove payload of hanging bots, flags only and with the hang state appended
+	uint64 HangServerMoves = 0;
+	double FlagsOnlyBitsPerMove = 0.0;
+	double HangStateBitsPerMove = 0.0;
+
+	// Jump presses of every bot since it spawned, warm-up included, by how the ledge was resolved
+	uint64 LedgeIndexHits = 0;
+	uint64 LedgeCacheHits = 0;
+	uint64 LedgeCacheMisses = 0;
+	double LedgeQueriesSaved = 0.0;
+
+	struct FMode
+	{
+		uint64 Ticks = 0;
+		double UsPerTick = 0.0;
+		double SceneQueriesPerFrame = 0.0;
+	};
+	FMode Modes[static_cast<int32>(FMovementModeCounters::EMode::Num)];
+};
+
+namespace MovementBenchmark
+{
+	// Bare game world with the engine game mode, so nothing project specific spawns
+	static UWorld* CreateWorld()
+	{
+		UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("MovementBenchmark"));
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+
+		const FURL URL(TEXT("?game=/Script/Engine.GameModeBase"));
+		World->SetGameMode(URL);
+		World->InitializeActorsForPlay(URL);
+		World->BeginPlay();
+		return World;
+	}
+
+	static void DestroyWorld(UWorld* World)
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+		CollectGarbage(RF_NoFlags);
+	}
+
+	static ACustomCMCCharacter* SpawnBotCharacter(UWorld* World, TSubclassOf<ACustomCMCCharacter> CharacterClass, const FTransform& Start)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		ACustomCMCCharacter* Character = World->SpawnActor<ACustomCMCCharacter>(CharacterClass, Start, SpawnParams);
+		if (!Character) return nullptr;
+
+		AAIController* Controller = World->SpawnActor<AAIController>();
+		Controller->Possess(Character);
+		Controller->SetControlRotation(Start.Rotator());
+		return Character;
+	}
+}
+
+UMovementBenchmarkCommandlet::UMovementBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = true;
+	LogToConsole = true;
+}
+
+int32 UMovementBenchmarkCommandlet::Main(const FString& Params)
+{
+#if !UE_BUILD_SHIPPING
+	FParse::Value(*Params, TEXT("Frames="), Frames);
+	FParse::Value(*Params, TEXT("WarmupFrames="), WarmupFrames);
+	float FPS = 60.f;
+	if (FParse::Value(*Params, TEXT("FPS="), FPS) && FPS > 0.f)
+	{
+		FrameDeltaTime = 1.f / FPS;
+	}
+
+	TArray<int32> Counts = { 1, 16, 64, 256 };
+	FString CountsParam;
+	if (FParse::Value(*Params, TEXT("Counts="), CountsParam, false))
+	{
+		TArray<FString> CountStrings;
+		CountsParam.ParseIntoArray(CountStrings, TEXT("+"));
+		Counts.Reset();
+		for (const FString& Count : CountStrings)
+		{
+			Counts.Add(FMath::Max(1, FCString::Atoi(*Count)));
+		}
+	}
+
+	// ACustomCMCCharacter is abstract, the blueprint carries the mesh, anim blueprint and montages
+	FString CharacterClassPath = TEXT("/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter.BP_ThirdPersonCharacter_C");
+	FParse::Value(*Params, TEXT("CharacterClass="), CharacterClassPath);
+	const TSubclassOf<ACustomCMCCharacter> CharacterClass = LoadClass<ACustomCMCCharacter>(nullptr, *CharacterClassPath);
+	if (!CharacterClass)
+	{
+		UE_LOG(LogMovementBenchmark, Error, TEXT("Could not load character class %s"), *CharacterClassPath);
+		return 1;
+	}
+
+	FString OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MovementBenchmark"),
+		FString::Printf(TEXT("MovementBenchmark_%s"), *FDateTime::Now().ToString()));
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	if (FParse::Param(*Params, TEXT("Trajectory")))
+	{
+		FParse::Value(*Params, TEXT("TrajectorySeconds="), TrajectorySeconds);
+		FParse::Value(*Params, TEXT("Tolerance="), TrajectoryTolerance);
+		return CompareTrajectories(CharacterClass, OutputPath) ? 0 : 1;
+	}
+
+	// -CompareBatching runs every count with the probe batch off and then on, otherwise the cvar is left as it is
+	IConsoleVariable* BatchProbesVar = IConsoleManager::Get().FindConsoleVariable(TEXT("CustomCMC.BatchLedgeProbes"));
+	const bool bPreviousBatchProbes = BatchProbesVar && BatchProbesVar->GetBool();
+	TArray<bool, TInlineAllocator<2>> BatchSettings = { bPreviousBatchProbes };
+	if (BatchProbesVar && FParse::Param(*Params, TEXT("CompareBatching")))
+	{
+		BatchSettings = { false, true };
+	}
+
+	TArray<FRunResult> Results;
+	for (const int32 Count : Counts)
+	{
+		for (const bool bBatchProbes : BatchSettings)
+		{
+			if (BatchProbesVar)
+			{
+				BatchProbesVar->Set(bBatchProbes, ECVF_SetByConsole);
+			}
+
+			FRunResult& Result = Results.AddDefaulted_GetRef();
+			Result.bBatchedProbes = bBatchProbes;
+			const bool bRan = RunCount(CharacterClass, Count, Result);
+			if (BatchProbesVar)
+			{
+				BatchProbesVar->Set(bPreviousBatchProbes, ECVF_SetByConsole);
+			}
+			if (!bRan)
+			{
+				return 1;
+			}
+			UE_LOG(LogMovementBenchmark, Display, TEXT("%4d characters, probe batch %s: %.3f ms/frame (max %.3f), %.1f ms/s, %.1f scene queries/frame, hanging ServerMove %.1f bits flags only / %.1f with hang state"),
+				Count, bBatchProbes ? TEXT("on") : TEXT("off"), Result.GameThreadMs, Result.MaxGameThreadMs, Result.GameThreadMsPerSecond, Result.SceneQueriesPerFrame, Result.FlagsOnlyBitsPerMove, Result.HangStateBitsPerMove);
+			UE_LOG(LogMovementBenchmark, Display, TEXT("                 ledge presses %llu from the index, %llu from the cache, %llu probed, %.0f scene queries saved"),
+				Result.LedgeIndexHits, Result.LedgeCacheHits, Result.LedgeCacheMisses, Result.LedgeQueriesSaved);
+		}
+	}
+
+	return WriteResults(OutputPath, Results) ? 0 : 1;
+#else
+	UE_LOG(LogMovementBenchmark, Error, TEXT("The movement benchmark reads counters that are compiled out of Shipping"));
+	return 1;
+#endif
+}
+
+bool UMovementBenchmarkCommandlet::RunCount(TSubclassOf<ACustomCMCCharacter> CharacterClass, int32 NumCharacters, FRunResult& OutResult) const
+{
+#if !UE_BUILD_SHIPPING
+	OutResult.NumCharacters = NumCharacters;
+
+	UWorld* World = MovementBenchmark::CreateWorld();
+
+	TArray<FTransform> Starts;
+	Course.Build(World, NumCharacters, Starts);
+
+	TArray<FBot> Bots;
+	for (int32 i = 0; i < NumCharacters; ++i)
+	{
+		ACustomCMCCharacter* Character = MovementBenchmark::SpawnBotCharacter(World, CharacterClass, Starts[i]);
+		if (!Character) continue;
+
+		FBot& Bot = Bots.AddDefaulted_GetRef();
+		Bot.Character = Character;
+		Bot.Start = Starts[i];
+		Bot.StartDelay = FMath::Frac(i * 0.618034f) * 2.f;
+	}
+	if (Bots.Num() != NumCharacters)
+	{
+		UE_LOG(LogMovementBenchmark, Error, TEXT("Spawned %d of %d characters"), Bots.Num(), NumCharacters);
+	}
+
+	auto TickFrame = [&]()
+	{
+		for (FBot& Bot : Bots)
+		{
+			DriveBot(Bot, FrameDeltaTime);
+			if (IsValid(Bot.Character))
+			{
+				Bot.Character->DoMove(Bot.MoveInput.X, Bot.MoveInput.Y);
+			}
+		}
+		// Batched probes are matched by frame number, there is no engine loop to advance it here
+		++GFrameCounter;
+		World->Tick(LEVELTICK_All, FrameDeltaTime);
+	};
+
+	for (int32 Frame = 0; Frame < WarmupFrames; ++Frame)
+	{
+		TickFrame();
+	}
+
+	FMovementModeCounters& Counters = FMovementModeCounters::ForWorld(World);
+	Counters.Reset();
+	double TotalSeconds = 0.0;
+	uint64 FlagsOnlyBits = 0;
+	uint64 HangStateBits = 0;
+	for (int32 Frame = 0; Frame < Frames; ++Frame)
+	{
+		const double FrameStart = FPlatformTime::Seconds();
+		TickFrame();
+		const double FrameSeconds = FPlatformTime::Seconds() - FrameStart;
+
+		TotalSeconds += FrameSeconds;
+		OutResult.MaxGameThreadMs = FMath::Max(OutResult.MaxGameThreadMs, FrameSeconds * 1000.0);
+
+		// Outside the timed frame, one ServerMove per hanging bot per frame
+		for (const FBot& Bot : Bots)
+		{
+			UCustomCharacterMovementComponent* Movement = IsValid(Bot.Character) ? Bot.Character->GetCustomMovementComponent() : nullptr;
+			if (!Movement || !Movement->IsHanging()) continue;
+
+			int32 MoveFlagsOnlyBits, MoveHangStateBits;
+			Movement->MeasureServerMoveBits(MoveFlagsOnlyBits, MoveHangStateBits);
+			FlagsOnlyBits += MoveFlagsOnlyBits;
+			HangStateBits += MoveHangStateBits;
+			++OutResult.HangServerMoves;
+		}
+	}
+	if (OutResult.HangServerMoves)
+	{
+		OutResult.FlagsOnlyBitsPerMove = static_cast<double>(FlagsOnlyBits) / OutResult.HangServerMoves;
+		OutResult.HangStateBitsPerMove = static_cast<double>(HangStateBits) / OutResult.HangServerMoves;
+	}
+
+	const int32 NumFrames = FMath::Max(Frames, 1);
+	OutResult.GameThreadMs = TotalSeconds * 1000.0 / NumFrames;
+	OutResult.GameThreadMsPerSecond = OutResult.GameThreadMs / FrameDeltaTime;
+	for (int32 Mode = 0; Mode < static_cast<int32>(FMovementModeCounters::EMode::Num); ++Mode)
+	{
+		const FMovementModeCounters::FTotals& Totals = Counters.Get(static_cast<FMovementModeCounters::EMode>(Mode));
+		FRunResult::FMode& ModeResult = OutResult.Modes[Mode];
+		ModeResult.Ticks = Totals.Ticks;
+		ModeResult.UsPerTick = ModeResult.Ticks ? FPlatformTime::ToMilliseconds64(Totals.Cycles) * 1000.0 / ModeResult.Ticks : 0.0;
+		ModeResult.SceneQueriesPerFrame = static_cast<double>(Totals.SceneQueries) / NumFrames;
+		OutResult.SceneQueriesPerFrame += ModeResult.SceneQueriesPerFrame;
+	}
+
+	for (const FBot& Bot : Bots)
+	{
+		if (const UCustomCharacterMovementComponent* Movement = IsValid(Bot.Character) ? Bot.Character->GetCustomMovementComponent() : nullptr)
+		{
+			OutResult.LedgeIndexHits += Movement->GetLedgeIndexHits();
+			OutResult.LedgeCacheHits += Movement->GetLedgeCacheHits();
+			OutResult.LedgeCacheMisses += Movement->GetLedgeCacheMisses();
+			OutResult.LedgeQueriesSaved += Movement->GetLedgeQueriesSaved();
+		}
+	}
+
+	MovementBenchmark::DestroyWorld(World);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void UMovementBenchmarkCommandlet::DriveBot(FBot& Bot, float DeltaTime) const
+{
+	ACustomCMCCharacter* Character = Bot.Character;
+	if (!IsValid(Character)) return;
+
+	if (Bot.StartDelay > 0.f)
+	{
+		Bot.StartDelay -= DeltaTime;
+		return;
+	}
+
+	const UCustomCharacterMovementComponent* Movement = Character->GetCustomMovementComponent();
+	Bot.PhaseTime += DeltaTime;
+
+	auto SetPhase = [&Bot](FBot::EPhase Phase)
+	{
+		Bot.Phase = Phase;
+		Bot.PhaseTime = 0.f;
+	};
+
+	switch (Bot.Phase)
+	{
+	case FBot::EPhase::Walk:
+		// Walk at the wall and jump just short of it
+		Bot.MoveInput = FVector2D(0.f, 1.f);
+		if (Character->GetActorLocation().X - Bot.Start.GetLocation().X > Course.WallDistance - 250.f || Bot.PhaseTime > 4.f)
+		{
+			Character->DoJumpStart();
+			SetPhase(FBot::EPhase::Jump);
+		}
+		break;
+
+	case FBot::EPhase::Jump:
+		Bot.MoveInput = FVector2D(0.f, 1.f);
+		if (Bot.PhaseTime > 0.1f)
+		{
+			Character->DoJumpEnd();
+		}
+		// Second press in the air is the ledge grab
+		if (Bot.PhaseTime > 0.3f)
+		{
+			Character->DoJumpStart();
+			SetPhase(FBot::EPhase::Grab);
+		}
+		break;
+
+	case FBot::EPhase::Grab:
+		Bot.MoveInput = FVector2D(0.f, 1.f);
+		if (Bot.PhaseTime > 0.1f)
+		{
+			Character->DoJumpEnd();
+		}
+		if (Movement->IsHanging())
+		{
+			SetPhase(FBot::EPhase::Hang);
+		}
+		else if (Bot.PhaseTime > 2.f)
+		{
+			// Missed the ledge, start over
+			Character->TeleportTo(Bot.Start.GetLocation(), Bot.Start.Rotator());
+			SetPhase(FBot::EPhase::Walk);
+		}
+		break;
+
+	case FBot::EPhase::Hang:
+		// Shimmy one way then the other
+		Bot.MoveInput = FVector2D(FMath::Fmod(Bot.PhaseTime, 2.f) < 1.f ? 1.f : -1.f, 0.f);
+		if (Bot.PhaseTime > 4.f || !Movement->IsHanging())
+		{
+			Character->TeleportTo(Bot.Start.GetLocation(), Bot.Start.Rotator());
+			Character->GetCharacterMovement()->SetMovementMode(MOVE_Falling);
+			SetPhase(FBot::EPhase::Walk);
+		}
+		break;
+	}
+}
+
+bool UMovementBenchmarkCommandlet::WriteResults(const FString& OutputPath, const TArray<FRunResult>& Results) const
+{
+#if !UE_BUILD_SHIPPING
+	constexpr int32 NumModes = static_cast<int32>(FMovementModeCounters::EMode::Num);
+
+	FString Csv = TEXT("Characters,BatchedProbes,GameThreadMs,MaxGameThreadMs,GameThreadMsPerSecond,SceneQueriesPerFrame,HangServerMoves,FlagsOnlyBitsPerMove,HangStateBitsPerMove,LedgeIndexHits,LedgeCacheHits,LedgeCacheMisses,LedgeQueriesSaved");
+	for (int32 Mode = 0; Mode < NumModes; ++Mode)
+	{
+		const TCHAR* ModeName = FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode));
+		Csv += FString::Printf(TEXT(",%sTicks,%sUsPerTick,%sSceneQueriesPerFrame"), ModeName, ModeName, ModeName);
+	}
+	Csv += TEXT("\n");
+
+	FString Json = FString::Printf(TEXT("{\n\t\"Build\": \"%s\",\n\t\"Configuration\": \"%s\",\n\t\"FrameDeltaTime\": %f,\n\t\"Frames\": %d,\n\t\"Runs\": [\n"),
+		FApp::GetBuildVersion(), LexToString(FApp::GetBuildConfiguration()), FrameDeltaTime, Frames);
+
+	for (int32 i = 0; i < Results.Num(); ++i)
+	{
+		const FRunResult& Result = Results[i];
+		Csv += FString::Printf(TEXT("%d,%d,%.4f,%.4f,%.3f,%.2f,%llu,%.2f,%.2f,%llu,%llu,%llu,%.1f"), Result.NumCharacters, Result.bBatchedProbes, Result.GameThreadMs, Result.MaxGameThreadMs, Result.GameThreadMsPerSecond, Result.SceneQueriesPerFrame,
+			Result.HangServerMoves, Result.FlagsOnlyBitsPerMove, Result.HangStateBitsPerMove, Result.LedgeIndexHits, Result.LedgeCacheHits, Result.LedgeCacheMisses, Result.LedgeQueriesSaved);
+		Json += FString::Printf(TEXT("\t\t{ \"Characters\": %d, \"BatchedProbes\": %s, \"GameThreadMs\": %.4f, \"MaxGameThreadMs\": %.4f, \"GameThreadMsPerSecond\": %.3f, \"SceneQueriesPerFrame\": %.2f, ")
+			TEXT("\"HangServerMoves\": %llu, \"FlagsOnlyBitsPerMove\": %.2f, \"HangStateBitsPerMove\": %.2f, ")
+			TEXT("\"LedgeIndexHits\": %llu, \"LedgeCacheHits\": %llu, \"LedgeCacheMisses\": %llu, \"LedgeQueriesSaved\": %.1f, \"Modes\": {"),
+			Result.NumCharacters, Result.bBatchedProbes ? TEXT("true") : TEXT("false"), Result.GameThreadMs, Result.MaxGameThreadMs, Result.GameThreadMsPerSecond, Result.SceneQueriesPerFrame,
+			Result.HangServerMoves, Result.FlagsOnlyBitsPerMove, Result.HangStateBitsPerMove,
+			Result.LedgeIndexHits, Result.LedgeCacheHits, Result.LedgeCacheMisses, Result.LedgeQueriesSaved);
+
+		for (int32 Mode = 0; Mode < NumModes; ++Mode)
+		{
+			const FRunResult::FMode& ModeResult = Result.Modes[Mode];
+			Csv += FString::Printf(TEXT(",%llu,%.3f,%.2f"), ModeResult.Ticks, ModeResult.UsPerTick, ModeResult.SceneQueriesPerFrame);
+			Json += FString::Printf(TEXT("%s \"%s\": { \"Ticks\": %llu, \"UsPerTick\": %.3f, \"SceneQueriesPerFrame\": %.2f }"),
+				Mode ? TEXT(",") : TEXT(""), FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode)),
+				ModeResult.Ticks, ModeResult.UsPerTick, ModeResult.SceneQueriesPerFrame);
+		}
+
+		Csv += TEXT("\n");
+		Json += FString::Printf(TEXT(" } }%s\n"), i + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+	}
+	Json += TEXT("\t]\n}\n");
+
+	const bool bSaved = FFileHelper::SaveStringToFile(Csv, *(OutputPath + TEXT(".csv")))
+		&& FFileHelper::SaveStringToFile(Json, *(OutputPath + TEXT(".json")));
+	UE_LOG(LogMovementBenchmark, Display, TEXT("Results %s %s.csv/.json"), bSaved ? TEXT("written to") : TEXT("could not be written to"), *OutputPath);
+	return bSaved;
+#else
+	return false;
+#endif
+}
+
+bool UMovementBenchmarkCommandlet::RunTrajectory(TSubclassOf<ACustomCMCCharacter> CharacterClass, int32 StepsPerSample, TArray<FTrajectoryPoint>& OutPoints) const
+{
+#if !UE_BUILD_SHIPPING
+	UWorld* World = MovementBenchmark::CreateWorld();
+
+	TArray<FTransform> Starts;
+	Course.Build(World, 1, Starts);
+
+	FBot Bot;
+	Bot.Character = MovementBenchmark::SpawnBotCharacter(World, CharacterClass, Starts[0]);
+	Bot.Start = Starts[0];
+	if (!Bot.Character)
+	{
+		UE_LOG(LogMovementBenchmark, Error, TEXT("Could not spawn %s"), *CharacterClass->GetName());
+		MovementBenchmark::DestroyWorld(World);
+		return false;
+	}
+
+	// The script decides on the shared sample steps, every rate ticks the same input in between
+	const float SampleDeltaTime = 1.f / TrajectorySampleRate;
+	const float StepDeltaTime = SampleDeltaTime / StepsPerSample;
+	const int32 NumSamples = FMath::Max(1, FMath::RoundToInt32(TrajectorySeconds * TrajectorySampleRate));
+	for (int32 Sample = 0; Sample < NumSamples; ++Sample)
+	{
+		DriveBot(Bot, SampleDeltaTime);
+		for (int32 Step = 0; Step < StepsPerSample && IsValid(Bot.Character); ++Step)
+		{
+			Bot.Character->DoMove(Bot.MoveInput.X, Bot.MoveInput.Y);
+			++GFrameCounter;
+			World->Tick(LEVELTICK_All, StepDeltaTime);
+		}
+		if (!IsValid(Bot.Character)) break;
+
+		FTrajectoryPoint& Point = OutPoints.AddDefaulted_GetRef();
+		Point.Location = Bot.Character->GetActorLocation();
+		Point.Mode = FMovementModeCounters::GetMode(*Bot.Character->GetCharacterMovement());
+	}
+
+	MovementBenchmark::DestroyWorld(World);
+	return OutPoints.Num() == NumSamples;
+#else
+	return false;
+#endif
+}
+
+bool UMovementBenchmarkCommandlet::CompareTrajectories(TSubclassOf<ACustomCMCCharacter> CharacterClass, const FString& OutputPath) const
+{
+#if !UE_BUILD_SHIPPING
+	constexpr int32 NumModes = static_cast<int32>(FMovementModeCounters::EMode::Num);
+	// Ticks per 30 Hz sample, the last rate is the reference
+	const int32 StepsPerSample[] = { 1, 2, 4 };
+	constexpr int32 NumRates = UE_ARRAY_COUNT(StepsPerSample);
+
+	TArray<FTrajectoryPoint> Trajectories[NumRates];
+	for (int32 Rate = 0; Rate < NumRates; ++Rate)
+	{
+		if (!RunTrajectory(CharacterClass, StepsPerSample[Rate], Trajectories[Rate]))
+		{
+			UE_LOG(LogMovementBenchmark, Error, TEXT("Trajectory at %.0f Hz did not complete"), TrajectorySampleRate * StepsPerSample[Rate]);
+			return false;
+		}
+	}
+
+	const TArray<FTrajectoryPoint>& Reference = Trajectories[NumRates - 1];
+	FString Csv = TEXT("Hz");
+	for (int32 Mode = 0; Mode < NumModes; ++Mode)
+	{
+		const TCHAR* ModeName = FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode));
+		Csv += FString::Printf(TEXT(",%sSamples,%sMaxDeviation"), ModeName, ModeName);
+	}
+	Csv += TEXT(",ModeMismatches,FinalDeviation\n");
+
+	bool bWithinTolerance = true;
+	for (int32 Rate = 0; Rate < NumRates - 1; ++Rate)
+	{
+		const TArray<FTrajectoryPoint>& Trajectory = Trajectories[Rate];
+		int32 Samples[NumModes] = {};
+		double MaxDeviation[NumModes] = {};
+		int32 ModeMismatches = 0;
+
+		// Samples where both runs were in the same mode, a late grab shows up as mismatches
+		for (int32 Sample = 0; Sample < Reference.Num(); ++Sample)
+		{
+			if (Trajectory[Sample].Mode != Reference[Sample].Mode)
+			{
+				++ModeMismatches;
+				continue;
+			}
+			const int32 Mode = static_cast<int32>(Reference[Sample].Mode);
+			++Samples[Mode];
+			MaxDeviation[Mode] = FMath::Max(MaxDeviation[Mode], FVector::Dist(Trajectory[Sample].Location, Reference[Sample].Location));
+		}
+
+		const float Hz = TrajectorySampleRate * StepsPerSample[Rate];
+		const double FinalDeviation = FVector::Dist(Trajectory.Last().Location, Reference.Last().Location);
+		Csv += FString::Printf(TEXT("%.0f"), Hz);
+		FString Summary;
+		for (int32 Mode = 0; Mode < NumModes; ++Mode)
+		{
+			Csv += FString::Printf(TEXT(",%d,%.3f"), Samples[Mode], MaxDeviation[Mode]);
+			if (Samples[Mode])
+			{
+				Summary += FString::Printf(TEXT(" %s %.2f cm"), FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode)), MaxDeviation[Mode]);
+			}
+		}
+		Csv += FString::Printf(TEXT(",%d,%.3f\n"), ModeMismatches, FinalDeviation);
+		UE_LOG(LogMovementBenchmark, Display, TEXT("%3.0f Hz against %.0f Hz, max deviation:%s, %d samples in another mode, %.2f cm apart at the end"),
+			Hz, TrajectorySampleRate * StepsPerSample[NumRates - 1], *Summary, ModeMismatches, FinalDeviation);
+
+		const int32 Hang = static_cast<int32>(FMovementModeCounters::EMode::Hang);
+		bWithinTolerance &= Samples[Hang] > 0 && MaxDeviation[Hang] <= TrajectoryTolerance;
+	}
+
+	const FString CsvPath = OutputPath + TEXT("_Trajectory.csv");
+	const bool bSaved = FFileHelper::SaveStringToFile(Csv, *CsvPath);
+	UE_LOG(LogMovementBenchmark, Display, TEXT("Results %s %s"), bSaved ? TEXT("written to") : TEXT("could not be written to"), *CsvPath);
+	if (!bWithinTolerance)
+	{
+		UE_LOG(LogMovementBenchmark, Error, TEXT("Hanging paths are further than %.2f cm from the reference, or the bot never hung"), TrajectoryTolerance);
+	}
+	return bSaved && bWithinTolerance;
+#else
+	return false;
+#endif
+}
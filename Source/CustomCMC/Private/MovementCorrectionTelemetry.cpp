@@ -0,0 +1,192 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementCorrectionTelemetry.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "CustomCMC.h"
+#include "CustomCharacterMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corrections Mode Mismatch"), STAT_CorrectionsModeMismatch, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corrections Mode Change"), STAT_CorrectionsModeChange, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corrections Root Motion"), STAT_CorrectionsRootMotion, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corrections Hang"), STAT_CorrectionsHang, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corrections Sprint"), STAT_CorrectionsSprint, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Corrections Other"), STAT_CorrectionsOther, STATGROUP_CustomCMC);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Correction Position Error"), STAT_CorrectionPositionError, STATGROUP_CustomCMC);
+
+CSV_DEFINE_CATEGORY(CustomCMCCorrections, true);
+
+FMovementCorrectionTelemetry::FModeTotals FMovementCorrectionTelemetry::Totals[NumModes];
+std::atomic<uint64> FMovementCorrectionTelemetry::ByMovementMode[MOVE_MAX];
+std::atomic<uint64> FMovementCorrectionTelemetry::ByCustomMode[256];
+
+void FMovementCorrectionTelemetry::Record(const FCorrection& Correction)
+{
+	FModeTotals& ModeTotals = Totals[static_cast<int32>(Correction.Mode)];
+	const int32 Cause = static_cast<int32>(Correction.Cause);
+	++ModeTotals.Corrections[Cause];
+	ModeTotals.ErrorCentiCm[Cause] += static_cast<uint64>(Correction.PositionError * 100.f);
+	ModeTotals.RootMotion += Correction.bRootMotion ? 1 : 0;
+	++ModeTotals.ErrorHistogram[GetErrorBucket(Correction.PositionError)];
+	++ByMovementMode[FMath::Min<int32>(Correction.MovementMode, MOVE_MAX - 1)];
+	if (Correction.MovementMode == MOVE_Custom)
+	{
+		++ByCustomMode[Correction.CustomMode];
+	}
+
+	INC_FLOAT_STAT_BY(STAT_CorrectionPositionError, Correction.PositionError);
+	CSV_CUSTOM_STAT(CustomCMCCorrections, Total, 1, ECsvCustomStatOp::Accumulate);
+	CSV_CUSTOM_STAT(CustomCMCCorrections, PositionError, Correction.PositionError, ECsvCustomStatOp::Accumulate);
+
+	switch (Correction.Cause)
+	{
+	case ECause::ModeMismatch:
+		INC_DWORD_STAT(STAT_CorrectionsModeMismatch);
+		CSV_CUSTOM_STAT(CustomCMCCorrections, ModeMismatch, 1, ECsvCustomStatOp::Accumulate);
+		break;
+	case ECause::ModeChange:
+		INC_DWORD_STAT(STAT_CorrectionsModeChange);
+		CSV_CUSTOM_STAT(CustomCMCCorrections, ModeChange, 1, ECsvCustomStatOp::Accumulate);
+		break;
+	case ECause::RootMotion:
+		INC_DWORD_STAT(STAT_CorrectionsRootMotion);
+		CSV_CUSTOM_STAT(CustomCMCCorrections, RootMotion, 1, ECsvCustomStatOp::Accumulate);
+		break;
+	case ECause::Hang:
+		INC_DWORD_STAT(STAT_CorrectionsHang);
+		CSV_CUSTOM_STAT(CustomCMCCorrections, Hang, 1, ECsvCustomStatOp::Accumulate);
+		break;
+	case ECause::Sprint:
+		INC_DWORD_STAT(STAT_CorrectionsSprint);
+		CSV_CUSTOM_STAT(CustomCMCCorrections, Sprint, 1, ECsvCustomStatOp::Accumulate);
+		break;
+	default:
+		INC_DWORD_STAT(STAT_CorrectionsOther);
+		CSV_CUSTOM_STAT(CustomCMCCorrections, Other, 1, ECsvCustomStatOp::Accumulate);
+		break;
+	}
+}
+
+void FMovementCorrectionTelemetry::Reset()
+{
+	for (FModeTotals& ModeTotals : Totals)
+	{
+		for (int32 Cause = 0; Cause < NumCauses; ++Cause)
+		{
+			ModeTotals.Corrections[Cause] = 0;
+			ModeTotals.ErrorCentiCm[Cause] = 0;
+		}
+		ModeTotals.RootMotion = 0;
+		for (std::atomic<uint64>& Bucket : ModeTotals.ErrorHistogram)
+		{
+			Bucket = 0;
+		}
+	}
+	for (std::atomic<uint64>& Count : ByMovementMode)
+	{
+		Count = 0;
+	}
+	for (std::atomic<uint64>& Count : ByCustomMode)
+	{
+		Count = 0;
+	}
+}
+
+void FMovementCorrectionTelemetry::Dump()
+{
+	struct FSource
+	{
+		int32 Mode;
+		int32 Cause;
+		uint64 Corrections;
+		double AverageError;
+	};
+
+	uint64 Total = 0;
+	TArray<FSource> Sources;
+	for (int32 Mode = 0; Mode < NumModes; ++Mode)
+	{
+		for (int32 Cause = 0; Cause < NumCauses; ++Cause)
+		{
+			const uint64 Corrections = Totals[Mode].Corrections[Cause];
+			if (!Corrections) continue;
+
+			Sources.Add({ Mode, Cause, Corrections, Totals[Mode].ErrorCentiCm[Cause] / (100.0 * Corrections) });
+			Total += Corrections;
+		}
+	}
+	Sources.Sort([](const FSource& A, const FSource& B) { return A.Corrections > B.Corrections; });
+
+	UE_LOG(LogTemp, Log, TEXT("%llu server corrections since the last reset"), Total);
+	for (const FSource& Source : Sources)
+	{
+		UE_LOG(LogTemp, Log, TEXT("  %-10s %-12s %8llu (%5.1f%%)  average error %7.2f cm"),
+			FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Source.Mode)), GetCauseName(static_cast<ECause>(Source.Cause)),
+			Source.Corrections, 100.0 * Source.Corrections / Total, Source.AverageError);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Position error histogram in cm, buckets <1 <2 <4 <8 <16 <32 <64 <128 <256 >=256, and corrections with root motion active"));
+	for (int32 Mode = 0; Mode < NumModes; ++Mode)
+	{
+		FString Histogram;
+		for (const std::atomic<uint64>& Bucket : Totals[Mode].ErrorHistogram)
+		{
+			Histogram += FString::Printf(TEXT(" %6llu"), Bucket.load());
+		}
+		UE_LOG(LogTemp, Log, TEXT("  %-10s%s  root motion %llu"),
+			FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode)), *Histogram, Totals[Mode].RootMotion.load());
+	}
+
+	const UEnum* MovementModeEnum = StaticEnum<EMovementMode>();
+	const UEnum* CustomModeEnum = StaticEnum<ECustomMovementMode>();
+	for (int32 MovementMode = 0; MovementMode < MOVE_MAX; ++MovementMode)
+	{
+		if (ByMovementMode[MovementMode] == 0 || MovementMode == MOVE_Custom) continue;
+		UE_LOG(LogTemp, Log, TEXT("  %-24s %8llu"), *MovementModeEnum->GetNameStringByValue(MovementMode), ByMovementMode[MovementMode].load());
+	}
+	for (int32 CustomMode = 0; CustomMode < UE_ARRAY_COUNT(ByCustomMode); ++CustomMode)
+	{
+		if (ByCustomMode[CustomMode] == 0) continue;
+		const FString Name = CustomModeEnum->IsValidEnumValue(CustomMode) ? CustomModeEnum->GetNameStringByValue(CustomMode) : FString::FromInt(CustomMode);
+		UE_LOG(LogTemp, Log, TEXT("  MOVE_Custom %-12s %8llu"), *Name, ByCustomMode[CustomMode].load());
+	}
+}
+
+const TCHAR* FMovementCorrectionTelemetry::GetCauseName(ECause Cause)
+{
+	switch (Cause)
+	{
+	case ECause::ModeMismatch:	return TEXT("ModeMismatch");
+	case ECause::ModeChange:	return TEXT("ModeChange");
+	case ECause::RootMotion:	return TEXT("RootMotion");
+	case ECause::Hang:			return TEXT("Hang");
+	case ECause::Sprint:		return TEXT("Sprint");
+	default:					return TEXT("Other");
+	}
+}
+
+int32 FMovementCorrectionTelemetry::GetErrorBucket(float PositionError)
+{
+	if (PositionError < 1.f) return 0;
+	return FMath::Min(1 + FMath::FloorToInt32(FMath::Log2(PositionError)), NumErrorBuckets - 1);
+}
+
+static FAutoConsoleCommand CorrectionsCommand(
+	TEXT("CustomCMC.Net.Corrections"),
+	TEXT("Logs the server corrections since the counters were last reset by movement mode and cause, largest first, with their position error. ")
+	TEXT("Pass reset to reset them afterwards"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FMovementCorrectionTelemetry::Dump();
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			FMovementCorrectionTelemetry::Reset();
+		}
+	}));
+
+#endif
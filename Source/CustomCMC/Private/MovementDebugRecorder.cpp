@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementDebugRecorder.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "DrawDebugHelpers.h"
+#include "Engine/Engine.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/ScopeLock.h"
+
+int32 GCustomCMCMovementDebug = 0;
+static FAutoConsoleVariableRef CVarCustomCMCMovementDebug(
+	TEXT("CustomCMC.Debug.Movement"),
+	GCustomCMCMovementDebug,
+	TEXT("Movement debug recorder. 0: off, 1: record into each character's ring buffer, 2: record and draw"));
+
+FMovementDebugEntry& FMovementDebugRecorder::Add(FMovementDebugEntry::EType Type, const FColor& Color, float Duration)
+{
+	if (Entries.Num() < Capacity)
+	{
+		Entries.Reserve(Capacity);
+		Entries.AddDefaulted();
+	}
+
+	FMovementDebugEntry& Entry = Entries[Head];
+	Head = (Head + 1) % Capacity;
+	++NumRecorded;
+
+	Entry.Type = Type;
+	Entry.Color = Color;
+	Entry.MessageKey = -1;
+	Entry.Time = FPlatformTime::Seconds();
+	Entry.Duration = Duration;
+	Entry.Thickness = 0.f;
+	Entry.Message.Reset();
+	return Entry;
+}
+
+void FMovementDebugRecorder::Message(const FString& Text, const FColor& Color, float Duration, int32 Key)
+{
+	FScopeLock ScopeLock(&Lock);
+	FMovementDebugEntry& Entry = Add(FMovementDebugEntry::EType::Message, Color, Duration);
+	Entry.MessageKey = Key;
+	Entry.Message = Text;
+}
+
+void FMovementDebugRecorder::Point(const FVector& Location, const FColor& Color, float Duration)
+{
+	FScopeLock ScopeLock(&Lock);
+	FMovementDebugEntry& Entry = Add(FMovementDebugEntry::EType::Point, Color, Duration);
+	Entry.A = Location;
+}
+
+void FMovementDebugRecorder::Line(const FVector& Start, const FVector& End, const FColor& Color, float Duration, float Thickness)
+{
+	FScopeLock ScopeLock(&Lock);
+	FMovementDebugEntry& Entry = Add(FMovementDebugEntry::EType::Line, Color, Duration);
+	Entry.A = Start;
+	Entry.B = End;
+	Entry.Thickness = Thickness;
+}
+
+void FMovementDebugRecorder::Capsule(const FVector& Center, float HalfHeight, float Radius, const FColor& Color, float Duration)
+{
+	FScopeLock ScopeLock(&Lock);
+	FMovementDebugEntry& Entry = Add(FMovementDebugEntry::EType::Capsule, Color, Duration);
+	Entry.A = Center;
+	Entry.B = FVector(HalfHeight, Radius, 0.f);
+}
+
+void FMovementDebugRecorder::DrawPending(UWorld* World)
+{
+	FScopeLock ScopeLock(&Lock);
+
+	// Anything overwritten before it was drawn is skipped
+	const int32 NumPending = static_cast<int32>(FMath::Min<uint64>(NumRecorded - NumDrawn, Entries.Num()));
+	NumDrawn = NumRecorded;
+
+	for (int32 i = 0; i < NumPending; ++i)
+	{
+		const FMovementDebugEntry& Entry = Entries[(Head - NumPending + i + Capacity) % Capacity];
+		switch (Entry.Type)
+		{
+		case FMovementDebugEntry::EType::Message:
+			if (GEngine) GEngine->AddOnScreenDebugMessage(Entry.MessageKey, Entry.Duration, Entry.Color, Entry.Message);
+			break;
+		case FMovementDebugEntry::EType::Point:
+			DrawDebugPoint(World, Entry.A, 10.f, Entry.Color, false, Entry.Duration);
+			break;
+		case FMovementDebugEntry::EType::Line:
+			DrawDebugLine(World, Entry.A, Entry.B, Entry.Color, false, Entry.Duration, 0, Entry.Thickness);
+			break;
+		case FMovementDebugEntry::EType::Capsule:
+			DrawDebugCapsule(World, Entry.A, Entry.B.X, Entry.B.Y, FQuat::Identity, Entry.Color, false, Entry.Duration);
+			break;
+		}
+	}
+}
+
+bool FMovementDebugRecorder::Dump(const FString& FilePath) const
+{
+	FScopeLock ScopeLock(&Lock);
+
+	FString Output;
+	const int32 Oldest = Entries.Num() < Capacity ? 0 : Head;
+	for (int32 i = 0; i < Entries.Num(); ++i)
+	{
+		const FMovementDebugEntry& Entry = Entries[(Oldest + i) % Capacity];
+		switch (Entry.Type)
+		{
+		case FMovementDebugEntry::EType::Message:
+			Output += FString::Printf(TEXT("%.4f Message %s \"%s\"\n"), Entry.Time, *Entry.Color.ToString(), *Entry.Message);
+			break;
+		case FMovementDebugEntry::EType::Point:
+			Output += FString::Printf(TEXT("%.4f Point %s %s\n"), Entry.Time, *Entry.Color.ToString(), *Entry.A.ToString());
+			break;
+		case FMovementDebugEntry::EType::Line:
+			Output += FString::Printf(TEXT("%.4f Line %s %s -> %s\n"), Entry.Time, *Entry.Color.ToString(), *Entry.A.ToString(), *Entry.B.ToString());
+			break;
+		case FMovementDebugEntry::EType::Capsule:
+			Output += FString::Printf(TEXT("%.4f Capsule %s %s HalfHeight=%.1f Radius=%.1f\n"), Entry.Time, *Entry.Color.ToString(), *Entry.A.ToString(), Entry.B.X, Entry.B.Y);
+			break;
+		}
+	}
+
+	return FFileHelper::SaveStringToFile(Output, *FilePath);
+}
+
+#endif
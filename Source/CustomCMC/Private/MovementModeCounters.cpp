@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementModeCounters.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "CustomCharacterMovementComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeRWLock.h"
+#include "UObject/ObjectKey.h"
+
+namespace MovementModeCounters
+{
+	struct FWorldCounters
+	{
+		FString WorldName;
+		FMovementModeCounters Counters;
+	};
+
+	// Looked up by components as they initialize and by the console commands, never per query
+	static FRWLock WorldsLock;
+	static TMap<TObjectKey<UWorld>, TUniquePtr<FWorldCounters>> Worlds;
+	static FDelegateHandle WorldCleanupHandle;
+
+	static void OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+	{
+		FWriteScopeLock WriteLock(WorldsLock);
+		Worlds.Remove(TObjectKey<UWorld>(World));
+	}
+}
+
+FMovementModeCounters& FMovementModeCounters::ForWorld(const UWorld* World)
+{
+	using namespace MovementModeCounters;
+	const TObjectKey<UWorld> Key(World);
+	{
+		FReadScopeLock ReadLock(WorldsLock);
+		if (const TUniquePtr<FWorldCounters>* Found = Worlds.Find(Key))
+		{
+			return (*Found)->Counters;
+		}
+	}
+
+	FWriteScopeLock WriteLock(WorldsLock);
+	if (!WorldCleanupHandle.IsValid())
+	{
+		WorldCleanupHandle = FWorldDelegates::OnWorldCleanup.AddStatic(&OnWorldCleanup);
+	}
+	TUniquePtr<FWorldCounters>& Entry = Worlds.FindOrAdd(Key);
+	if (!Entry)
+	{
+		Entry = MakeUnique<FWorldCounters>();
+		Entry->WorldName = !World ? FString(TEXT("No world")) : FString::Printf(TEXT("%s (%s)"), *World->GetName(),
+			World->IsNetMode(NM_Client) ? TEXT("client") : World->IsNetMode(NM_Standalone) ? TEXT("standalone") : TEXT("server"));
+	}
+	return Entry->Counters;
+}
+
+void FMovementModeCounters::ForEachWorld(TFunctionRef<void(const FString& WorldName, FMovementModeCounters& Counters)> Func)
+{
+	using namespace MovementModeCounters;
+	FReadScopeLock ReadLock(WorldsLock);
+	for (const TPair<TObjectKey<UWorld>, TUniquePtr<FWorldCounters>>& Pair : Worlds)
+	{
+		Func(Pair.Value->WorldName, Pair.Value->Counters);
+	}
+}
+
+void FMovementModeCounters::ResetAll()
+{
+	ForEachWorld([](const FString&, FMovementModeCounters& Counters)
+	{
+		Counters.Reset();
+	});
+}
+
+FMovementModeCounters::EMode FMovementModeCounters::GetMode(const UCharacterMovementComponent& Movement)
+{
+	switch (Movement.MovementMode)
+	{
+	case MOVE_Walking:
+	case MOVE_NavWalking:
+		return EMode::Walking;
+	case MOVE_Falling:
+		return EMode::Falling;
+	case MOVE_Flying:
+		return EMode::Transition;
+	case MOVE_Custom:
+		return Movement.CustomMovementMode == CMOVE_Hang ? EMode::Hang : EMode::Other;
+	default:
+		return EMode::Other;
+	}
+}
+
+const TCHAR* FMovementModeCounters::GetModeName(EMode Mode)
+{
+	switch (Mode)
+	{
+	case EMode::Walking:	return TEXT("Walking");
+	case EMode::Falling:	return TEXT("Falling");
+	case EMode::Transition:	return TEXT("Transition");
+	case EMode::Hang:		return TEXT("Hang");
+	default:				return TEXT("Other");
+	}
+}
+
+void FMovementModeCounters::Reset()
+{
+	for (FTotals& ModeTotals : Totals)
+	{
+		ModeTotals.Ticks = 0;
+		ModeTotals.Cycles = 0;
+		ModeTotals.SceneQueries = 0;
+		ModeTotals.ServerMoves = 0;
+		ModeTotals.ClientMicroseconds = 0;
+		ModeTotals.NetUpdates = 0;
+		ModeTotals.ServerMicroseconds = 0;
+		ModeTotals.NetBits = 0;
+		ModeTotals.Corrections = 0;
+	}
+}
+
+static FAutoConsoleCommand ServerMoveRateCommand(
+	TEXT("CustomCMC.Net.ServerMoveRate"),
+	TEXT("Logs ServerMoves per second per client in each movement mode and world since the counters were last reset. Pass reset to reset them afterwards"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FMovementModeCounters::ForEachWorld([](const FString& WorldName, FMovementModeCounters& Counters)
+		{
+			UE_LOG(LogTemp, Log, TEXT("%s"), *WorldName);
+			for (int32 Mode = 0; Mode < static_cast<int32>(FMovementModeCounters::EMode::Num); ++Mode)
+			{
+				const FMovementModeCounters::FTotals& ModeTotals = Counters.Get(static_cast<FMovementModeCounters::EMode>(Mode));
+				const double Seconds = ModeTotals.ClientMicroseconds / 1e6;
+				UE_LOG(LogTemp, Log, TEXT("  %-10s %8llu ServerMoves over %7.2f client seconds, %.2f per second"),
+					FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode)),
+					ModeTotals.ServerMoves.load(), Seconds, Seconds > 0.0 ? ModeTotals.ServerMoves / Seconds : 0.0);
+			}
+		});
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			FMovementModeCounters::ResetAll();
+		}
+	}));
+
+static FAutoConsoleCommand NetUpdateRateCommand(
+	TEXT("CustomCMC.Net.NetUpdateRate"),
+	TEXT("Logs net updates and bytes per second per server character in each movement mode and world since the counters were last reset. Pass reset to reset them afterwards"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		FMovementModeCounters::ForEachWorld([](const FString& WorldName, FMovementModeCounters& Counters)
+		{
+			UE_LOG(LogTemp, Log, TEXT("%s"), *WorldName);
+			for (int32 Mode = 0; Mode < static_cast<int32>(FMovementModeCounters::EMode::Num); ++Mode)
+			{
+				const FMovementModeCounters::FTotals& ModeTotals = Counters.Get(static_cast<FMovementModeCounters::EMode>(Mode));
+				const double Seconds = ModeTotals.ServerMicroseconds / 1e6;
+				const double Bytes = ModeTotals.NetBits / 8.0;
+				UE_LOG(LogTemp, Log, TEXT("  %-10s %8llu net updates over %7.2f character seconds, %.2f per second, %.0f bytes per second"),
+					FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode)),
+					ModeTotals.NetUpdates.load(), Seconds, Seconds > 0.0 ? ModeTotals.NetUpdates / Seconds : 0.0, Seconds > 0.0 ? Bytes / Seconds : 0.0);
+			}
+		});
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			FMovementModeCounters::ResetAll();
+		}
+	}));
+
+#endif
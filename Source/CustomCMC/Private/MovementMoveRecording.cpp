@@ -0,0 +1,235 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementMoveRecording.h"
+
+#if !UE_BUILD_SHIPPING
+
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMovementMoveRecording, Log, All);
+
+FRotator FMovementMoveRecording::FMove::GetControlRotation() const
+{
+	return FRotator(FRotator::DecompressAxisFromShort(ControlPitch), FRotator::DecompressAxisFromShort(ControlYaw), FRotator::DecompressAxisFromShort(ControlRoll));
+}
+
+void FMovementMoveRecording::FMove::Serialize(FArchive& Ar)
+{
+	Ar << TimeStamp;
+	Ar << DeltaTime;
+	Ar << Acceleration;
+	Ar << ControlPitch;
+	Ar << ControlYaw;
+	Ar << ControlRoll;
+	Ar << CompressedFlags;
+	HangState.Serialize(Ar);
+}
+
+bool FMovementMoveRecording::Save(const FString& Filename)
+{
+	TArray<uint8> Bytes;
+	FMemoryWriter Writer(Bytes);
+	Serialize(Writer);
+	return FFileHelper::SaveArrayToFile(Bytes, *Filename);
+}
+
+bool FMovementMoveRecording::Load(const FString& Filename)
+{
+	TArray<uint8> Bytes;
+	if (!FFileHelper::LoadFileToArray(Bytes, *Filename)) return false;
+
+	FMemoryReader Reader(Bytes);
+	Serialize(Reader);
+	return !Reader.IsError();
+}
+
+void FMovementMoveRecording::Serialize(FArchive& Ar)
+{
+	uint32 FileMagic = Magic;
+	uint16 FileVersion = Version;
+	Ar << FileMagic;
+	Ar << FileVersion;
+	if (FileMagic != Magic || FileVersion != Version)
+	{
+		Ar.SetError();
+		return;
+	}
+
+	Ar << Map;
+	Ar << bHasCourse;
+	if (bHasCourse)
+	{
+		Ar << Course.LaneWidth;
+		Ar << Course.LaneLength;
+		Ar << Course.WallDistance;
+		Ar << Course.LedgeHeight;
+		Ar << Course.Origin;
+		Ar << CourseLanes;
+	}
+
+	int32 NumTracks = Tracks.Num();
+	Ar << NumTracks;
+	if (Ar.IsLoading())
+	{
+		Tracks.SetNum(FMath::Max(NumTracks, 0));
+	}
+
+	for (FTrack& Track : Tracks)
+	{
+		Ar << Track.CharacterClass;
+		Ar << Track.StartLocation;
+		Ar << Track.StartRotation;
+		Ar << Track.StartVelocity;
+		Ar << Track.StartMovementMode;
+		Ar << Track.EndLocation;
+
+		int32 NumMoves = Track.Moves.Num();
+		Ar << NumMoves;
+		if (Ar.IsLoading())
+		{
+			Track.Moves.SetNum(FMath::Max(NumMoves, 0));
+		}
+		for (FMove& Move : Track.Moves)
+		{
+			Move.Serialize(Ar);
+		}
+		if (Ar.IsError()) return;
+	}
+}
+
+bool FMovementMoveRecorder::bRecording = false;
+
+namespace MovementMoveRecorder
+{
+	struct FActiveRecording
+	{
+		TWeakObjectPtr<UWorld> World;
+		FString Filename;
+		FMovementMoveRecording Recording;
+		TMap<TWeakObjectPtr<const UCustomCharacterMovementComponent>, int32> TrackIndices;
+	};
+
+	static TUniquePtr<FActiveRecording> Active;
+}
+
+void FMovementMoveRecorder::Start(UWorld* World, const FString& Filename, const FMovementTestCourse* Course, int32 CourseLanes)
+{
+	using namespace MovementMoveRecorder;
+
+	if (bRecording)
+	{
+		Stop();
+	}
+
+	Active = MakeUnique<FActiveRecording>();
+	Active->World = World;
+	Active->Filename = Filename;
+	Active->Recording.Map = UWorld::RemovePIEPrefix(World->GetOutermost()->GetName());
+	if (Course)
+	{
+		Active->Recording.bHasCourse = true;
+		Active->Recording.Course = *Course;
+		Active->Recording.CourseLanes = CourseLanes;
+	}
+	bRecording = true;
+
+	UE_LOG(LogMovementMoveRecording, Display, TEXT("Recording ServerMoves in %s to %s"), *Active->Recording.Map, *Filename);
+}
+
+bool FMovementMoveRecorder::Stop()
+{
+	using namespace MovementMoveRecorder;
+
+	if (!bRecording) return false;
+	bRecording = false;
+
+	FMovementMoveRecording& Recording = Active->Recording;
+	int32 NumMoves = 0;
+	for (const TPair<TWeakObjectPtr<const UCustomCharacterMovementComponent>, int32>& Pair : Active->TrackIndices)
+	{
+		FMovementMoveRecording::FTrack& Track = Recording.Tracks[Pair.Value];
+		if (const UCustomCharacterMovementComponent* Movement = Pair.Key.Get())
+		{
+			Track.EndLocation = Movement->UpdatedComponent->GetComponentLocation();
+		}
+		NumMoves += Track.Moves.Num();
+	}
+
+	const bool bSaved = Recording.Save(Active->Filename);
+	UE_LOG(LogMovementMoveRecording, Display, TEXT("%d characters, %d moves %s %s"), Recording.Tracks.Num(), NumMoves,
+		bSaved ? TEXT("written to") : TEXT("could not be written to"), *Active->Filename);
+
+	Active.Reset();
+	return bSaved;
+}
+
+void FMovementMoveRecorder::RecordMove(const UCustomCharacterMovementComponent& Movement, float TimeStamp, float DeltaTime, uint8 CompressedFlags,
+	const FVector& Acceleration, const FRotator& ControlRotation, const FCustomHangState& HangState)
+{
+	using namespace MovementMoveRecorder;
+
+	if (!Active || Movement.GetWorld() != Active->World.Get()) return;
+
+	FMovementMoveRecording& Recording = Active->Recording;
+	const int32* TrackIndex = Active->TrackIndices.Find(&Movement);
+	if (!TrackIndex)
+	{
+		// Wait for a state the replay can set up without a ledge or a montage
+		const bool bCanStart = (Movement.MovementMode == MOVE_Walking || Movement.MovementMode == MOVE_Falling)
+			&& !Movement.HasAnimRootMotion() && !Movement.HasRootMotionSources();
+		if (!bCanStart) return;
+
+		TrackIndex = &Active->TrackIndices.Add(&Movement, Recording.Tracks.Num());
+
+		const ACharacter* Character = Movement.GetCharacterOwner();
+		FMovementMoveRecording::FTrack& Track = Recording.Tracks.AddDefaulted_GetRef();
+		Track.CharacterClass = Character->GetClass()->GetPathName();
+		Track.StartLocation = Character->GetActorLocation();
+		Track.StartRotation = Character->GetActorRotation();
+		Track.StartVelocity = Movement.Velocity;
+		Track.StartMovementMode = Movement.MovementMode;
+	}
+
+	FMovementMoveRecording::FMove& Move = Recording.Tracks[*TrackIndex].Moves.AddDefaulted_GetRef();
+	Move.TimeStamp = TimeStamp;
+	Move.DeltaTime = DeltaTime;
+	Move.Acceleration = FVector3f(Acceleration);
+	Move.ControlPitch = FRotator::CompressAxisToShort(ControlRotation.Pitch);
+	Move.ControlYaw = FRotator::CompressAxisToShort(ControlRotation.Yaw);
+	Move.ControlRoll = FRotator::CompressAxisToShort(ControlRotation.Roll);
+	Move.CompressedFlags = CompressedFlags;
+	Move.HangState = HangState;
+}
+
+static FAutoConsoleCommandWithWorldAndArgs RecordMovesCommand(
+	TEXT("CustomCMC.Net.RecordMoves"),
+	TEXT("Records the ServerMoves this server runs for every remote character until stopped, for UMovementReplayCommandlet. ")
+	TEXT("Args: [Output=Path/To/File.moves] to start, stop to write the file"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (Args.Num() > 0 && Args[0] == TEXT("stop"))
+		{
+			FMovementMoveRecorder::Stop();
+			return;
+		}
+
+		if (!World || World->GetNetMode() == NM_Client || World->GetNetMode() == NM_Standalone)
+		{
+			UE_LOG(LogMovementMoveRecording, Error, TEXT("Moves are recorded on a listen or dedicated server"));
+			return;
+		}
+
+		FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MovementRecordings"),
+			FString::Printf(TEXT("Moves_%s.moves"), *FDateTime::Now().ToString()));
+		FParse::Value(*FString::Join(Args, TEXT(" ")), TEXT("Output="), Filename);
+		FMovementMoveRecorder::Start(World, Filename);
+	}));
+
+#endif
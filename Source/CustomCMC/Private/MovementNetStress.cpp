@@ -0,0 +1,826 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementNetStress.h"
+
+#if WITH_EDITOR
+
+#include "CustomCMCCharacter.h"
+#include "CustomCMCReplicationGraph.h"
+#include "CustomCharacterMovementComponent.h"
+#include "Editor.h"
+#include "MovementCorrectionTelemetry.h"
+#include "MovementMoveRecording.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/ReplicationDriver.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Settings/LevelEditorPlaySettings.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogMovementNetStress, Log, All);
+
+namespace MovementNetStress
+{
+	// Close to the editor's network emulation presets, Custom takes PktLag=, PktLagVariance=, PktLoss=, PktDup= and PktOrder= from the command
+	static TArray<FProfile> GetProfiles(const FString& Params)
+	{
+		TArray<FProfile> Profiles;
+		Profiles.Add({ TEXT("Off") });
+		Profiles.Add({ TEXT("Average"), 30, 10, 1, 0, false });
+		Profiles.Add({ TEXT("Bad"), 100, 40, 5, 1, true });
+
+		FProfile& Custom = Profiles.Add_GetRef({ TEXT("Custom") });
+		FParse::Value(*Params, TEXT("PktLag="), Custom.PktLag);
+		FParse::Value(*Params, TEXT("PktLagVariance="), Custom.PktLagVariance);
+		FParse::Value(*Params, TEXT("PktLoss="), Custom.PktLoss);
+		FParse::Value(*Params, TEXT("PktDup="), Custom.PktDup);
+		FParse::Bool(*Params, TEXT("PktOrder="), Custom.bPktOrder);
+		return Profiles;
+	}
+
+	FStressRun::FStressRun(const FString& Params)
+	{
+		FParse::Value(*Params, TEXT("Clients="), NumClients);
+		NumClients = FMath::Max(1, NumClients);
+		FParse::Value(*Params, TEXT("IdleClients="), NumIdleClients);
+		NumIdleClients = FMath::Clamp(NumIdleClients, 0, NumClients);
+		FParse::Value(*Params, TEXT("MoveBudgetMs="), MoveBudgetMs);
+		FParse::Value(*Params, TEXT("HangMoveCoalescing="), HangMoveCoalescing);
+		FParse::Value(*Params, TEXT("PushModel="), PushModel);
+		FParse::Value(*Params, TEXT("WarmupSeconds="), WarmupSeconds);
+		FParse::Value(*Params, TEXT("Duration="), MeasureSeconds);
+		FParse::Value(*Params, TEXT("JoinTimeout="), JoinTimeout);
+		FParse::Value(*Params, TEXT("MaxCorrectionsPerMinute="), MaxCorrectionsPerMinute);
+		FParse::Bool(*Params, TEXT("Dedicated="), bDedicatedServer);
+		FParse::Bool(*Params, TEXT("RepGraph="), bReplicationGraph);
+		FParse::Bool(*Params, TEXT("Quit="), bQuitWhenDone);
+		FParse::Bool(*Params, TEXT("Record="), bRecordMoves);
+
+		TArray<FString> ProfileNames = { TEXT("Off"), TEXT("Average"), TEXT("Bad") };
+		FString ProfilesParam;
+		if (FParse::Value(*Params, TEXT("Profiles="), ProfilesParam, false))
+		{
+			ProfilesParam.ParseIntoArray(ProfileNames, TEXT("+"));
+		}
+		const TArray<FProfile> AllProfiles = GetProfiles(Params);
+		for (const FString& ProfileName : ProfileNames)
+		{
+			if (const FProfile* Profile = AllProfiles.FindByPredicate([&ProfileName](const FProfile& Candidate) { return Candidate.Name == ProfileName; }))
+			{
+				Profiles.Add(*Profile);
+			}
+			else
+			{
+				UE_LOG(LogMovementNetStress, Warning, TEXT("Unknown emulation profile %s"), *ProfileName);
+			}
+		}
+
+		OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MovementNetStress"),
+			FString::Printf(TEXT("MovementNetStress_%s"), *FDateTime::Now().ToString()));
+		FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+		Course.Origin = FVector(0.f, 0.f, 20000.f);
+
+		if (IConsoleVariable* MoveBudgetVar = IConsoleManager::Get().FindConsoleVariable(TEXT("CustomCMC.Net.MoveBudgetMs")))
+		{
+			PreviousMoveBudgetMs = MoveBudgetVar->GetFloat();
+			if (MoveBudgetMs >= 0.f)
+			{
+				MoveBudgetVar->Set(MoveBudgetMs, ECVF_SetByConsole);
+			}
+			MoveBudgetMs = MoveBudgetVar->GetFloat();
+		}
+		if (IConsoleVariable* CoalescingVar = IConsoleManager::Get().FindConsoleVariable(TEXT("CustomCMC.Net.HangMoveCoalescing")))
+		{
+			bPreviousHangMoveCoalescing = CoalescingVar->GetBool();
+			if (HangMoveCoalescing >= 0)
+			{
+				CoalescingVar->Set(HangMoveCoalescing != 0, ECVF_SetByConsole);
+			}
+			HangMoveCoalescing = CoalescingVar->GetBool();
+		}
+		if (IConsoleVariable* PushModelVar = IConsoleManager::Get().FindConsoleVariable(TEXT("net.IsPushModelEnabled")))
+		{
+			bPreviousPushModel = PushModelVar->GetBool();
+			if (PushModel >= 0)
+			{
+				PushModelVar->Set(PushModel != 0, ECVF_SetByConsole);
+			}
+			PushModel = PushModelVar->GetBool();
+		}
+		else
+		{
+			// Built without push model support
+			PushModel = 0;
+		}
+
+		if (!bReplicationGraph)
+		{
+			// Without a replication driver the net driver falls back to its own actor prioritization
+			UReplicationDriver::CreateReplicationDriverDelegate().BindLambda([](UNetDriver*, const FURL&, UWorld*) -> UReplicationDriver* { return nullptr; });
+		}
+
+		TickerHandle = FTSTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FStressRun::Tick));
+		StartProfile();
+	}
+
+	FStressRun::~FStressRun()
+	{
+		if (bRecordMoves)
+		{
+			FMovementMoveRecorder::Stop();
+		}
+		if (TickerHandle.IsValid())
+		{
+			FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+			if (GEditor && GEditor->IsPlaySessionInProgress())
+			{
+				GEditor->RequestEndPlayMap();
+			}
+		}
+		FWorldDelegates::OnWorldTickStart.Remove(WorldTickStartHandle);
+		if (UWorld* World = ServerWorld.Get())
+		{
+			World->OnPostTickFlush().Remove(PostTickFlushHandle);
+		}
+		if (!bReplicationGraph)
+		{
+			UReplicationDriver::CreateReplicationDriverDelegate().Unbind();
+		}
+		if (IConsoleVariable* MoveBudgetVar = IConsoleManager::Get().FindConsoleVariable(TEXT("CustomCMC.Net.MoveBudgetMs")))
+		{
+			MoveBudgetVar->Set(PreviousMoveBudgetMs, ECVF_SetByConsole);
+		}
+		if (IConsoleVariable* CoalescingVar = IConsoleManager::Get().FindConsoleVariable(TEXT("CustomCMC.Net.HangMoveCoalescing")))
+		{
+			CoalescingVar->Set(bPreviousHangMoveCoalescing, ECVF_SetByConsole);
+		}
+		if (IConsoleVariable* PushModelVar = IConsoleManager::Get().FindConsoleVariable(TEXT("net.IsPushModelEnabled")))
+		{
+			PushModelVar->Set(bPreviousPushModel, ECVF_SetByConsole);
+		}
+	}
+
+	void FStressRun::StartProfile()
+	{
+		if (!Profiles.IsValidIndex(ProfileIndex))
+		{
+			Finish();
+			return;
+		}
+
+		const FProfile& Profile = Profiles[ProfileIndex];
+		UE_LOG(LogMovementNetStress, Display, TEXT("Profile %s: %d clients (%d idle), move budget %.2f ms, PktLag=%d PktLagVariance=%d PktLoss=%d PktDup=%d PktOrder=%d"),
+			*Profile.Name, NumClients, NumIdleClients, MoveBudgetMs, Profile.PktLag, Profile.PktLagVariance, Profile.PktLoss, Profile.PktDup, Profile.bPktOrder);
+
+		ULevelEditorPlaySettings* PlaySettings = DuplicateObject(GetDefault<ULevelEditorPlaySettings>(), GetTransientPackage());
+		// A listen server's own player counts as one of the PIE players but is not driven
+		PlaySettings->SetPlayNetMode(bDedicatedServer ? EPlayNetMode::PIE_Client : EPlayNetMode::PIE_ListenServer);
+		PlaySettings->SetPlayNumberOfClients(bDedicatedServer ? NumClients : NumClients + 1);
+		PlaySettings->SetRunUnderOneProcess(true);
+
+		FRequestPlaySessionParams SessionParams;
+		SessionParams.WorldType = EPlaySessionWorldType::PlayInEditor;
+		SessionParams.SessionDestination = EPlaySessionDestinationType::InProcess;
+		SessionParams.EditorPlaySettings = PlaySettings;
+		GEditor->RequestPlaySession(SessionParams);
+
+		Bots.Reset();
+		Players.Reset();
+		Starts.Reset();
+		ServerWorld.Reset();
+		State = EState::Join;
+		StateStartTime = FPlatformTime::Seconds();
+	}
+
+	void FStressRun::StopProfile(bool bCompleted)
+	{
+		if (bCompleted)
+		{
+			CollectResult();
+		}
+		else
+		{
+			FRunResult& Result = Results.AddDefaulted_GetRef();
+			Result.Profile = Profiles[ProfileIndex];
+		}
+
+		FWorldDelegates::OnWorldTickStart.Remove(WorldTickStartHandle);
+		if (UWorld* World = ServerWorld.Get())
+		{
+			World->OnPostTickFlush().Remove(PostTickFlushHandle);
+		}
+		if (bRecordMoves)
+		{
+			FMovementMoveRecorder::Stop();
+		}
+
+		GEditor->RequestEndPlayMap();
+		State = EState::Stop;
+		StateStartTime = FPlatformTime::Seconds();
+	}
+
+	void FStressRun::Finish()
+	{
+		const bool bWritten = WriteResults();
+
+		bPassed = bWritten;
+		for (const FRunResult& Result : Results)
+		{
+			bPassed &= Result.bCompleted;
+			for (const FClientResult& Client : Result.Clients)
+			{
+				if (MaxCorrectionsPerMinute >= 0.f && Client.CorrectionsPerMinute > MaxCorrectionsPerMinute)
+				{
+					UE_LOG(LogMovementNetStress, Error, TEXT("Profile %s lane %d: %.1f corrections per minute, more than the allowed %.1f"),
+						*Result.Profile.Name, Client.Lane, Client.CorrectionsPerMinute, MaxCorrectionsPerMinute);
+					bPassed = false;
+				}
+			}
+		}
+		UE_LOG(LogMovementNetStress, Display, TEXT("Network stress run %s"), bPassed ? TEXT("passed") : TEXT("failed"));
+
+		FTSTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+		TickerHandle.Reset();
+
+		if (bQuitWhenDone)
+		{
+			FPlatformMisc::RequestExitWithStatus(false, bPassed ? 0 : 1);
+		}
+	}
+
+	bool FStressRun::Tick(float DeltaTime)
+	{
+		const double StateSeconds = FPlatformTime::Seconds() - StateStartTime;
+
+		switch (State)
+		{
+		case EState::Join:
+		{
+			UWorld* World = nullptr;
+			if (IsJoined(World))
+			{
+				PlaceClients(World);
+				State = EState::Warmup;
+				StateStartTime = FPlatformTime::Seconds();
+			}
+			else if (StateSeconds > JoinTimeout)
+			{
+				UE_LOG(LogMovementNetStress, Error, TEXT("Profile %s: the clients did not all join within %.0f seconds"), *Profiles[ProfileIndex].Name, JoinTimeout);
+				StopProfile(false);
+			}
+			break;
+		}
+
+		case EState::Warmup:
+		case EState::Measure:
+			if (!ServerWorld.IsValid())
+			{
+				UE_LOG(LogMovementNetStress, Error, TEXT("Profile %s: the play session ended early"), *Profiles[ProfileIndex].Name);
+				StopProfile(false);
+				break;
+			}
+
+			for (FBot& Bot : Bots)
+			{
+				DriveBot(Bot, DeltaTime);
+			}
+
+			if (State == EState::Warmup && StateSeconds > WarmupSeconds)
+			{
+				StartMeasuring();
+			}
+			else if (State == EState::Measure)
+			{
+				SamplePlayers();
+				if (StateSeconds > MeasureSeconds)
+				{
+					StopProfile(true);
+				}
+			}
+			break;
+
+		case EState::Stop:
+			if (!GEditor->IsPlaySessionInProgress())
+			{
+				++ProfileIndex;
+				StartProfile();
+			}
+			break;
+		}
+
+		return TickerHandle.IsValid();
+	}
+
+	bool FStressRun::IsJoined(UWorld*& OutServerWorld)
+	{
+		OutServerWorld = nullptr;
+		int32 NumReadyClients = 0;
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			UWorld* World = Context.World();
+			if (Context.WorldType != EWorldType::PIE || !World) continue;
+
+			if (World->GetNetMode() == NM_ListenServer || World->GetNetMode() == NM_DedicatedServer)
+			{
+				OutServerWorld = World;
+			}
+			else if (World->GetNetMode() == NM_Client)
+			{
+				const APlayerController* Controller = World->GetFirstPlayerController();
+				NumReadyClients += Controller && Cast<ACustomCMCCharacter>(Controller->GetPawn()) ? 1 : 0;
+			}
+		}
+		if (!OutServerWorld || NumReadyClients < NumClients) return false;
+
+		// The map's game mode may fail to spawn everyone at its player starts, possess those here
+		int32 NumReadyPlayers = 0;
+		for (FConstPlayerControllerIterator It = OutServerWorld->GetPlayerControllerIterator(); It; ++It)
+		{
+			APlayerController* Controller = It->Get();
+			if (!Controller || Controller->IsLocalController()) continue;
+
+			if (!Controller->GetPawn())
+			{
+				AGameModeBase* GameMode = OutServerWorld->GetAuthGameMode();
+				UClass* PawnClass = GameMode ? GameMode->GetDefaultPawnClassForController(Controller) : nullptr;
+				if (PawnClass && PawnClass->IsChildOf<ACustomCMCCharacter>())
+				{
+					FActorSpawnParameters SpawnParams;
+					SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+					const FVector Location = Course.Origin + FVector(0.f, 0.f, 500.f + NumReadyPlayers * 200.f);
+					if (APawn* Pawn = OutServerWorld->SpawnActor<APawn>(PawnClass, Location, FRotator::ZeroRotator, SpawnParams))
+					{
+						Controller->Possess(Pawn);
+					}
+				}
+			}
+			NumReadyPlayers += Cast<ACustomCMCCharacter>(Controller->GetPawn()) ? 1 : 0;
+		}
+		return NumReadyPlayers >= NumClients;
+	}
+
+	void FStressRun::PlaceClients(UWorld* World)
+	{
+		ServerWorld = World;
+
+#if DO_ENABLE_NET_TEST
+		FPacketSimulationSettings PacketSettings;
+		const FProfile& Profile = Profiles[ProfileIndex];
+		PacketSettings.PktLag = Profile.PktLag;
+		PacketSettings.PktLagVariance = Profile.PktLagVariance;
+		PacketSettings.PktLoss = Profile.PktLoss;
+		PacketSettings.PktDup = Profile.PktDup;
+		PacketSettings.PktOrder = Profile.bPktOrder;
+#endif
+
+		// Every world builds its own copy of the course
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			UWorld* ContextWorld = Context.World();
+			if (Context.WorldType != EWorldType::PIE || !ContextWorld || !ContextWorld->GetNetDriver()) continue;
+
+			TArray<FTransform> WorldStarts;
+			Course.Build(ContextWorld, NumClients, WorldStarts);
+			if (ContextWorld == World)
+			{
+				Starts = MoveTemp(WorldStarts);
+			}
+
+#if DO_ENABLE_NET_TEST
+			ContextWorld->GetNetDriver()->SetPacketSimulationSettings(PacketSettings);
+#endif
+		}
+
+		// One lane per remote player, the client's bot finds its lane once the teleport reaches it
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			APlayerController* Controller = It->Get();
+			ACustomCMCCharacter* Character = Controller ? Cast<ACustomCMCCharacter>(Controller->GetPawn()) : nullptr;
+			if (!Character || Controller->IsLocalController() || Players.Num() == Starts.Num()) continue;
+
+			FPlayer& Player = Players.AddDefaulted_GetRef();
+			Player.Controller = Controller;
+			Player.Character = Character;
+			Player.Lane = Players.Num() - 1;
+
+			const FTransform& Start = Starts[Player.Lane];
+			Character->TeleportTo(Start.GetLocation(), Start.Rotator());
+			Controller->ClientSetRotation(Start.Rotator());
+		}
+
+		for (const FWorldContext& Context : GEngine->GetWorldContexts())
+		{
+			UWorld* ContextWorld = Context.World();
+			if (Context.WorldType != EWorldType::PIE || !ContextWorld || ContextWorld->GetNetMode() != NM_Client) continue;
+
+			FBot& Bot = Bots.AddDefaulted_GetRef();
+			Bot.World = ContextWorld;
+			Bot.StartDelay = FMath::Frac(Bots.Num() * 0.618034f) * 2.f;
+			Bot.bIdle = Bots.Num() <= NumIdleClients;
+		}
+	}
+
+	void FStressRun::StartMeasuring()
+	{
+		// Only the worlds of this run, PIE may be running others
+		FMovementModeCounters::ForWorld(ServerWorld.Get()).Reset();
+		for (const FBot& Bot : Bots)
+		{
+			if (const UWorld* ClientWorld = Bot.World.Get())
+			{
+				FMovementModeCounters::ForWorld(ClientWorld).Reset();
+			}
+		}
+		FMovementCorrectionTelemetry::Reset();
+		for (FPlayer& Player : Players)
+		{
+			const ACustomCMCCharacter* Character = Player.Character.Get();
+			Player.CorrectionsAtStart = Character ? Character->GetCustomMovementComponent()->GetServerCorrections() : 0;
+			Player.Resets = 0;
+		}
+		for (FBot& Bot : Bots)
+		{
+			Bot.Grabs = 0;
+		}
+
+		ServerSeconds = 0.0;
+		ServerSecondsSquared = 0.0;
+		MaxServerSeconds = 0.0;
+		ServerFrames = 0;
+		ReplicateSecondsAtStart = GetReplicateSeconds();
+		WorldTickStartHandle = FWorldDelegates::OnWorldTickStart.AddRaw(this, &FStressRun::OnWorldTickStart);
+		PostTickFlushHandle = ServerWorld->OnPostTickFlush().AddRaw(this, &FStressRun::OnServerPostTickFlush);
+
+		if (bRecordMoves)
+		{
+			FMovementMoveRecorder::Start(ServerWorld.Get(), FString::Printf(TEXT("%s_%s.moves"), *OutputPath, *Profiles[ProfileIndex].Name), &Course, NumClients);
+		}
+
+		State = EState::Measure;
+		StateStartTime = FPlatformTime::Seconds();
+	}
+
+	void FStressRun::OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+	{
+		if (World == ServerWorld.Get())
+		{
+			ServerTickStart = FPlatformTime::Seconds();
+		}
+	}
+
+	void FStressRun::OnServerPostTickFlush()
+	{
+		if (ServerTickStart <= 0.0) return;
+
+		// Actor ticks, movement and replication to every client
+		const double FrameSeconds = FPlatformTime::Seconds() - ServerTickStart;
+		ServerSeconds += FrameSeconds;
+		ServerSecondsSquared += FrameSeconds * FrameSeconds;
+		MaxServerSeconds = FMath::Max(MaxServerSeconds, FrameSeconds);
+		++ServerFrames;
+		ServerTickStart = 0.0;
+	}
+
+	double FStressRun::GetReplicateSeconds() const
+	{
+		const UNetDriver* NetDriver = ServerWorld.IsValid() ? ServerWorld->GetNetDriver() : nullptr;
+		const UCustomCMCReplicationGraph* Graph = NetDriver ? Cast<UCustomCMCReplicationGraph>(NetDriver->GetReplicationDriver()) : nullptr;
+		return Graph ? Graph->GetReplicateActorsSeconds() : 0.0;
+	}
+
+	void FStressRun::DriveBot(FBot& Bot, float DeltaTime) const
+	{
+		UWorld* World = Bot.World.Get();
+		if (!World) return;
+
+		// Bind once the server's teleport to a lane start has arrived
+		if (!Bot.Character.IsValid())
+		{
+			const APlayerController* Controller = World->GetFirstPlayerController();
+			ACustomCMCCharacter* Character = Controller ? Cast<ACustomCMCCharacter>(Controller->GetPawn()) : nullptr;
+			if (!Character) return;
+
+			for (int32 Lane = 0; Lane < Starts.Num(); ++Lane)
+			{
+				if (FVector::DistSquared(Character->GetActorLocation(), Starts[Lane].GetLocation()) < FMath::Square(100.f))
+				{
+					Bot.Character = Character;
+					Bot.Lane = Lane;
+				}
+			}
+			return;
+		}
+
+		if (Bot.bIdle) return;
+
+		if (Bot.StartDelay > 0.f)
+		{
+			Bot.StartDelay -= DeltaTime;
+			return;
+		}
+
+		ACustomCMCCharacter* Character = Bot.Character.Get();
+		UCustomCharacterMovementComponent* Movement = Character->GetCustomMovementComponent();
+		const FVector Start = Starts[Bot.Lane].GetLocation();
+		const FVector Location = Character->GetActorLocation();
+		Bot.PhaseTime += DeltaTime;
+
+		auto SetPhase = [&Bot](FBot::EPhase Phase)
+		{
+			Bot.Phase = Phase;
+			Bot.PhaseTime = 0.f;
+		};
+
+		// Steers back to the middle of the lane after shimmying
+		const float LaneSteer = FMath::Clamp((Start.Y - Location.Y) / 100.f, -1.f, 1.f);
+
+		switch (Bot.Phase)
+		{
+		case FBot::EPhase::Sprint:
+			Character->DoMove(LaneSteer, 1.f);
+			if (Location.X - Start.X > Course.WallDistance - 250.f || Bot.PhaseTime > 4.f)
+			{
+				Movement->SprintReleased();
+				Character->DoJumpStart();
+				SetPhase(FBot::EPhase::Jump);
+			}
+			break;
+
+		case FBot::EPhase::Jump:
+			Character->DoMove(0.f, 1.f);
+			if (Bot.PhaseTime > 0.1f)
+			{
+				Character->DoJumpEnd();
+			}
+			// Second press in the air is the ledge grab
+			if (Bot.PhaseTime > 0.3f)
+			{
+				Character->DoJumpStart();
+				SetPhase(FBot::EPhase::Grab);
+			}
+			break;
+
+		case FBot::EPhase::Grab:
+			Character->DoMove(0.f, 1.f);
+			if (Bot.PhaseTime > 0.1f)
+			{
+				Character->DoJumpEnd();
+			}
+			if (Movement->IsHanging())
+			{
+				++Bot.Grabs;
+				SetPhase(FBot::EPhase::Hang);
+			}
+			else if (Bot.PhaseTime > 2.f)
+			{
+				// Missed the ledge, walk back and try again
+				SetPhase(FBot::EPhase::Return);
+			}
+			break;
+
+		case FBot::EPhase::Hang:
+			// Shimmy one way then the other, then jump off
+			Character->DoMove(FMath::Fmod(Bot.PhaseTime, 2.f) < 1.f ? 1.f : -1.f, 0.f);
+			if (!Movement->IsHanging())
+			{
+				SetPhase(FBot::EPhase::Return);
+			}
+			else if (Bot.PhaseTime > 4.f)
+			{
+				Character->DoJumpStart();
+				SetPhase(FBot::EPhase::Release);
+			}
+			break;
+
+		case FBot::EPhase::Release:
+			Character->DoMove(0.f, -1.f);
+			if (Bot.PhaseTime > 0.1f)
+			{
+				Character->DoJumpEnd();
+			}
+			if (Bot.PhaseTime > 0.5f)
+			{
+				SetPhase(FBot::EPhase::Return);
+			}
+			break;
+
+		case FBot::EPhase::Return:
+			if (Movement->IsMovingOnGround())
+			{
+				Character->DoMove(LaneSteer, -1.f);
+			}
+			if ((Location.X - Start.X < 50.f && FMath::Abs(Start.Y - Location.Y) < 50.f) || Bot.PhaseTime > 8.f)
+			{
+				Movement->SprintPressed();
+				SetPhase(FBot::EPhase::Sprint);
+			}
+			break;
+		}
+	}
+
+	void FStressRun::SamplePlayers()
+	{
+		for (FPlayer& Player : Players)
+		{
+			ACustomCMCCharacter* Character = Player.Character.Get();
+			const APlayerController* Controller = Player.Controller.Get();
+			const UNetConnection* Connection = Controller ? Controller->GetNetConnection() : nullptr;
+			if (!Character || !Connection) continue;
+
+			Player.InBytesPerSecond += Connection->InBytesPerSecond;
+			Player.OutBytesPerSecond += Connection->OutBytesPerSecond;
+			Player.LagSeconds += Connection->AvgLag;
+			++Player.Samples;
+
+			// Fell off the course, the teleport shows up as a correction on the client
+			if (Character->GetActorLocation().Z < Course.Origin.Z - 1000.f)
+			{
+				const FTransform& Start = Starts[Player.Lane];
+				Character->TeleportTo(Start.GetLocation(), Start.Rotator());
+				++Player.Resets;
+			}
+		}
+	}
+
+	void FStressRun::CollectResult()
+	{
+		FRunResult& Result = Results.AddDefaulted_GetRef();
+		Result.Profile = Profiles[ProfileIndex];
+		Result.bCompleted = true;
+		Result.MeasuredSeconds = FPlatformTime::Seconds() - StateStartTime;
+
+		const UNetDriver* NetDriver = ServerWorld.IsValid() ? ServerWorld->GetNetDriver() : nullptr;
+		Result.bReplicationGraph = NetDriver && NetDriver->GetReplicationDriver();
+		Result.bPushModel = PushModel != 0;
+
+		if (ServerFrames)
+		{
+			Result.ServerMs = ServerSeconds * 1000.0 / ServerFrames;
+			Result.MaxServerMs = MaxServerSeconds * 1000.0;
+			const double MeanSeconds = ServerSeconds / ServerFrames;
+			Result.ServerMsStdDev = FMath::Sqrt(FMath::Max(ServerSecondsSquared / ServerFrames - MeanSeconds * MeanSeconds, 0.0)) * 1000.0;
+			Result.ServerMsPerClient = Result.ServerMs / NumClients;
+			Result.ReplicateMs = (GetReplicateSeconds() - ReplicateSecondsAtStart) * 1000.0 / ServerFrames;
+		}
+
+		const double Minutes = FMath::Max(Result.MeasuredSeconds, 1.0) / 60.0;
+		for (const FPlayer& Player : Players)
+		{
+			FClientResult& Client = Result.Clients.AddDefaulted_GetRef();
+			Client.Lane = Player.Lane;
+			Client.Resets = Player.Resets;
+			if (const ACustomCMCCharacter* Character = Player.Character.Get())
+			{
+				Client.Corrections = Character->GetCustomMovementComponent()->GetServerCorrections() - Player.CorrectionsAtStart;
+				Client.CorrectionsPerMinute = Client.Corrections / Minutes;
+			}
+			if (Player.Samples)
+			{
+				Client.InBytesPerSecond = Player.InBytesPerSecond / Player.Samples;
+				Client.OutBytesPerSecond = Player.OutBytesPerSecond / Player.Samples;
+				Client.PingMs = Player.LagSeconds * 1000.0 / Player.Samples;
+			}
+			if (const FBot* Bot = Bots.FindByPredicate([&Player](const FBot& Candidate) { return Candidate.Lane == Player.Lane; }))
+			{
+				Client.Grabs = Bot->Grabs;
+			}
+		}
+
+		// ServerMoves are counted in the client worlds, net updates and corrections in the server world
+		const FMovementModeCounters& ServerCounters = FMovementModeCounters::ForWorld(ServerWorld.Get());
+		for (int32 Mode = 0; Mode < static_cast<int32>(FMovementModeCounters::EMode::Num); ++Mode)
+		{
+			const FMovementModeCounters::EMode CounterMode = static_cast<FMovementModeCounters::EMode>(Mode);
+			uint64 ServerMoves = 0;
+			uint64 ClientMicroseconds = 0;
+			for (const FBot& Bot : Bots)
+			{
+				if (const UWorld* ClientWorld = Bot.World.Get())
+				{
+					const FMovementModeCounters::FTotals& ClientTotals = FMovementModeCounters::ForWorld(ClientWorld).Get(CounterMode);
+					ServerMoves += ClientTotals.ServerMoves;
+					ClientMicroseconds += ClientTotals.ClientMicroseconds;
+				}
+			}
+
+			const FMovementModeCounters::FTotals& ServerTotals = ServerCounters.Get(CounterMode);
+			FModeResult& ModeResult = Result.Modes[Mode];
+			ModeResult.Corrections = ServerTotals.Corrections;
+			ModeResult.ServerMovesPerSecond = ClientMicroseconds ? ServerMoves / (ClientMicroseconds / 1e6) : 0.0;
+			ModeResult.NetUpdatesPerSecond = ServerTotals.ServerMicroseconds ? ServerTotals.NetUpdates / (ServerTotals.ServerMicroseconds / 1e6) : 0.0;
+			ModeResult.BytesPerSecond = ServerTotals.ServerMicroseconds ? ServerTotals.NetBits / 8.0 / (ServerTotals.ServerMicroseconds / 1e6) : 0.0;
+		}
+
+		UE_LOG(LogMovementNetStress, Display, TEXT("Profile %s: server %.3f ms/frame (max %.3f, std dev %.3f), %.3f ms per client, replication %.3f ms/frame with push model %s"),
+			*Result.Profile.Name, Result.ServerMs, Result.MaxServerMs, Result.ServerMsStdDev, Result.ServerMsPerClient, Result.ReplicateMs, Result.bPushModel ? TEXT("on") : TEXT("off"));
+		for (const FClientResult& Client : Result.Clients)
+		{
+			UE_LOG(LogMovementNetStress, Display, TEXT("  lane %2d: %4u corrections (%.1f/min), in %.0f B/s, out %.0f B/s, ping %.0f ms, %u grabs, %u resets"),
+				Client.Lane, Client.Corrections, Client.CorrectionsPerMinute, Client.InBytesPerSecond, Client.OutBytesPerSecond, Client.PingMs, Client.Grabs, Client.Resets);
+		}
+		for (int32 Mode = 0; Mode < static_cast<int32>(FMovementModeCounters::EMode::Num); ++Mode)
+		{
+			const FModeResult& ModeResult = Result.Modes[Mode];
+			UE_LOG(LogMovementNetStress, Display, TEXT("  %-10s %.2f ServerMoves/s, %.2f net updates/s, %.0f B/s per character, %llu corrections"),
+				FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode)), ModeResult.ServerMovesPerSecond,
+				ModeResult.NetUpdatesPerSecond, ModeResult.BytesPerSecond, ModeResult.Corrections);
+		}
+		FMovementCorrectionTelemetry::Dump();
+	}
+
+	bool FStressRun::WriteResults() const
+	{
+		constexpr int32 NumModes = static_cast<int32>(FMovementModeCounters::EMode::Num);
+		FString Csv = TEXT("Profile,PktLag,PktLagVariance,PktLoss,PktDup,PktOrder,Completed,ReplicationGraph,PushModel,ServerMs,MaxServerMs,ServerMsStdDev,ServerMsPerClient,ReplicateMs,")
+			TEXT("Lane,Corrections,CorrectionsPerMinute,InBytesPerSecond,OutBytesPerSecond,PingMs,Grabs,Resets\n");
+
+		FString Json = FString::Printf(TEXT("{\n\t\"Build\": \"%s\",\n\t\"Configuration\": \"%s\",\n\t\"Clients\": %d,\n\t\"IdleClients\": %d,\n\t\"MoveBudgetMs\": %.2f,\n\t\"DedicatedServer\": %s,\n\t\"PushModel\": %s,\n\t\"Runs\": [\n"),
+			FApp::GetBuildVersion(), LexToString(FApp::GetBuildConfiguration()), NumClients, NumIdleClients, MoveBudgetMs, bDedicatedServer ? TEXT("true") : TEXT("false"), PushModel ? TEXT("true") : TEXT("false"));
+
+		for (int32 i = 0; i < Results.Num(); ++i)
+		{
+			const FRunResult& Result = Results[i];
+			const FProfile& Profile = Result.Profile;
+			const FString RunColumns = FString::Printf(TEXT("%s,%d,%d,%d,%d,%d,%d,%d,%d,%.4f,%.4f,%.4f,%.4f,%.4f"), *Profile.Name, Profile.PktLag, Profile.PktLagVariance,
+				Profile.PktLoss, Profile.PktDup, Profile.bPktOrder, Result.bCompleted, Result.bReplicationGraph, Result.bPushModel, Result.ServerMs, Result.MaxServerMs,
+				Result.ServerMsStdDev, Result.ServerMsPerClient, Result.ReplicateMs);
+
+			Json += FString::Printf(TEXT("\t\t{ \"Profile\": \"%s\", \"PktLag\": %d, \"PktLagVariance\": %d, \"PktLoss\": %d, \"PktDup\": %d, \"PktOrder\": %s, ")
+				TEXT("\"Completed\": %s, \"ReplicationGraph\": %s, \"MeasuredSeconds\": %.2f, \"ServerMs\": %.4f, \"MaxServerMs\": %.4f, \"ServerMsStdDev\": %.4f, \"ServerMsPerClient\": %.4f, \"ReplicateMs\": %.4f,\n\t\t  \"Clients\": ["),
+				*Profile.Name, Profile.PktLag, Profile.PktLagVariance, Profile.PktLoss, Profile.PktDup, Profile.bPktOrder ? TEXT("true") : TEXT("false"),
+				Result.bCompleted ? TEXT("true") : TEXT("false"), Result.bReplicationGraph ? TEXT("true") : TEXT("false"),
+				Result.MeasuredSeconds, Result.ServerMs, Result.MaxServerMs, Result.ServerMsStdDev, Result.ServerMsPerClient, Result.ReplicateMs);
+
+			for (int32 c = 0; c < Result.Clients.Num(); ++c)
+			{
+				const FClientResult& Client = Result.Clients[c];
+				Csv += FString::Printf(TEXT("%s,%d,%u,%.2f,%.1f,%.1f,%.1f,%u,%u\n"), *RunColumns, Client.Lane, Client.Corrections, Client.CorrectionsPerMinute,
+					Client.InBytesPerSecond, Client.OutBytesPerSecond, Client.PingMs, Client.Grabs, Client.Resets);
+				Json += FString::Printf(TEXT("%s\n\t\t\t{ \"Lane\": %d, \"Corrections\": %u, \"CorrectionsPerMinute\": %.2f, \"InBytesPerSecond\": %.1f, \"OutBytesPerSecond\": %.1f, ")
+					TEXT("\"PingMs\": %.1f, \"Grabs\": %u, \"Resets\": %u }"), c ? TEXT(",") : TEXT(""), Client.Lane, Client.Corrections, Client.CorrectionsPerMinute,
+					Client.InBytesPerSecond, Client.OutBytesPerSecond, Client.PingMs, Client.Grabs, Client.Resets);
+			}
+			if (Result.Clients.IsEmpty())
+			{
+				Csv += RunColumns + TEXT(",,,,,,,,\n");
+			}
+
+			Json += TEXT(" ],\n\t\t  \"Modes\": {");
+			for (int32 Mode = 0; Mode < NumModes; ++Mode)
+			{
+				const FModeResult& ModeResult = Result.Modes[Mode];
+				Json += FString::Printf(TEXT("%s \"%s\": { \"Corrections\": %llu, \"ServerMovesPerSecond\": %.2f, \"NetUpdatesPerSecond\": %.2f, \"BytesPerSecond\": %.1f }"),
+					Mode ? TEXT(",") : TEXT(""), FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode)),
+					ModeResult.Corrections, ModeResult.ServerMovesPerSecond, ModeResult.NetUpdatesPerSecond, ModeResult.BytesPerSecond);
+			}
+			Json += FString::Printf(TEXT(" } }%s\n"), i + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+		}
+		Json += TEXT("\t]\n}\n");
+
+		const bool bSaved = FFileHelper::SaveStringToFile(Csv, *(OutputPath + TEXT(".csv")))
+			&& FFileHelper::SaveStringToFile(Json, *(OutputPath + TEXT(".json")));
+		UE_LOG(LogMovementNetStress, Display, TEXT("Results %s %s.csv/.json"), bSaved ? TEXT("written to") : TEXT("could not be written to"), *OutputPath);
+		return bSaved;
+	}
+
+	static TUniquePtr<FStressRun> ActiveRun;
+}
+
+static FAutoConsoleCommand NetStressCommand(
+	TEXT("CustomCMC.Net.Stress"),
+	TEXT("Runs a PIE session with a server and simulated clients under one process, drives every client through ledge grabs, hanging, shimmying and sprinting ")
+	TEXT("and reports server corrections, bytes per second and server time per client, server replication time, and ServerMoves, net updates and bytes per character in each movement mode, for each packet emulation profile. ")
+	TEXT("Args: [Clients=8] [IdleClients=0] [MoveBudgetMs=N] [HangMoveCoalescing=0|1] [PushModel=0|1] [Profiles=Off+Average+Bad] [Duration=30] [WarmupSeconds=5] [JoinTimeout=60] [Dedicated=0] [RepGraph=1] ")
+	TEXT("[MaxCorrectionsPerMinute=N] [PktLag= PktLagVariance= PktLoss= PktDup= PktOrder= for the Custom profile] [Output=Path/Without/Extension] [Record=0] [Quit=0]. ")
+	TEXT("Record=1 writes each profile's ServerMoves to <Output>_<Profile>.moves for -run=MovementReplay. ")
+	TEXT("Pass stop to abort a run"),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		using namespace MovementNetStress;
+
+		const bool bStop = Args.Num() > 0 && Args[0] == TEXT("stop");
+		if (ActiveRun && !ActiveRun->IsFinished() && !bStop)
+		{
+			UE_LOG(LogMovementNetStress, Warning, TEXT("A network stress run is already in progress, pass stop to abort it"));
+			return;
+		}
+
+		ActiveRun.Reset();
+		if (bStop) return;
+
+		if (!GEditor || GEditor->IsPlaySessionInProgress())
+		{
+			UE_LOG(LogMovementNetStress, Error, TEXT("The network stress run needs the editor with no play session in progress"));
+			return;
+		}
+		ActiveRun = MakeUnique<FStressRun>(FString::Join(Args, TEXT(" ")));
+	}));
+
+#endif
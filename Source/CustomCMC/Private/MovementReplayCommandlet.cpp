@@ -0,0 +1,394 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementReplayCommandlet.h"
+
+#include "AIController.h"
+#include "CustomCharacterMovementComponent.h"
+#include "MovementModeCounters.h"
+#include "MovementMoveRecording.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "Misc/App.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/Package.h"
+#include "WorldPartition/WorldPartition.h"
+#if WITH_EDITOR
+#include "WorldPartition/LoaderAdapter/LoaderAdapterShape.h"
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(LogMovementReplay, Log, All);
+
+#if !UE_BUILD_SHIPPING
+
+struct UMovementReplayCommandlet::FRunResult
+{
+	struct FMoveCost
+	{
+		uint64 Moves = 0;
+		double MeanUs = 0.0;
+		double MedianUs = 0.0;
+		double P99Us = 0.0;
+		double MaxUs = 0.0;
+	};
+
+	double TotalMs = 0.0;
+	FMoveCost AllModes;
+	FMoveCost Modes[static_cast<int32>(FMovementModeCounters::EMode::Num)];
+
+	// Per track, in recording order
+	TArray<FVector> FinalLocations;
+};
+
+namespace MovementReplay
+{
+	// One world per run, so nothing carries over from the previous one
+	struct FReplayWorld
+	{
+		UWorld* World = nullptr;
+		bool bLoadedMap = false;
+#if WITH_EDITOR
+		// World partition maps keep their actors external, all of them are loaded for the replay
+		TUniquePtr<FLoaderAdapterShape> LoaderAdapter;
+#endif
+	};
+
+	static bool CreateWorld(const FMovementMoveRecording& Recording, FReplayWorld& Out)
+	{
+		if (Recording.bHasCourse)
+		{
+			// Recorded on a generated course, which was built away from the level's geometry
+			Out.World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("MovementReplay"));
+		}
+		else
+		{
+			UPackage* MapPackage = LoadPackage(nullptr, *Recording.Map, LOAD_None);
+			Out.World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+			if (!Out.World)
+			{
+				UE_LOG(LogMovementReplay, Error, TEXT("Could not load map %s"), *Recording.Map);
+				return false;
+			}
+
+			Out.bLoadedMap = true;
+			Out.World->AddToRoot();
+			Out.World->WorldType = EWorldType::Game;
+			if (!Out.World->bIsWorldInitialized)
+			{
+				Out.World->InitWorld(UWorld::InitializationValues()
+					.AllowAudioPlayback(false)
+					.CreatePhysicsScene(true)
+					.RequiresHitProxies(false)
+					.CreateNavigation(false)
+					.CreateAISystem(false)
+					.ShouldSimulatePhysics(false)
+					.EnableTraceCollision(true)
+					.SetTransactional(false)
+					.CreateFXSystem(false));
+			}
+			Out.World->UpdateWorldComponents(true, false);
+
+#if WITH_EDITOR
+			if (Out.World->GetWorldPartition())
+			{
+				Out.LoaderAdapter = MakeUnique<FLoaderAdapterShape>(Out.World, FBox(FVector(-HALF_WORLD_MAX), FVector(HALF_WORLD_MAX)), TEXT("Movement Replay"));
+				Out.LoaderAdapter->Load();
+			}
+#endif
+		}
+
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(Out.World);
+
+		// Engine game mode, so nothing project specific spawns
+		const FURL URL(TEXT("?game=/Script/Engine.GameModeBase"));
+		Out.World->SetGameMode(URL);
+		Out.World->InitializeActorsForPlay(URL);
+		Out.World->BeginPlay();
+
+		if (Recording.bHasCourse)
+		{
+			TArray<FTransform> Starts;
+			Recording.Course.Build(Out.World, Recording.CourseLanes, Starts);
+		}
+		return true;
+	}
+
+	static void DestroyWorld(FReplayWorld& ReplayWorld)
+	{
+#if WITH_EDITOR
+		ReplayWorld.LoaderAdapter.Reset();
+#endif
+		GEngine->DestroyWorldContext(ReplayWorld.World);
+		if (ReplayWorld.bLoadedMap)
+		{
+			ReplayWorld.World->RemoveFromRoot();
+		}
+		ReplayWorld.World->DestroyWorld(false);
+		ReplayWorld.World = nullptr;
+		CollectGarbage(RF_NoFlags);
+	}
+}
+
+#endif
+
+UMovementReplayCommandlet::UMovementReplayCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = true;
+	LogToConsole = true;
+}
+
+int32 UMovementReplayCommandlet::Main(const FString& Params)
+{
+#if !UE_BUILD_SHIPPING
+	using namespace MovementReplay;
+
+	FString RecordingPath;
+	if (!FParse::Value(*Params, TEXT("Recording="), RecordingPath))
+	{
+		UE_LOG(LogMovementReplay, Error, TEXT("Pass -Recording=Path/To/File.moves, see CustomCMC.Net.RecordMoves"));
+		return 1;
+	}
+	FParse::Value(*Params, TEXT("Runs="), Runs);
+	Runs = FMath::Max(1, Runs);
+	FParse::Value(*Params, TEXT("Tolerance="), Tolerance);
+
+	FMovementMoveRecording Recording;
+	if (!Recording.Load(RecordingPath))
+	{
+		UE_LOG(LogMovementReplay, Error, TEXT("Could not read the recording %s"), *RecordingPath);
+		return 1;
+	}
+
+	FString OutputPath = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("MovementReplay"),
+		FString::Printf(TEXT("MovementReplay_%s"), *FDateTime::Now().ToString()));
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	TArray<FRunResult> Results;
+	for (int32 Run = 0; Run < Runs; ++Run)
+	{
+		FReplayWorld ReplayWorld;
+		if (!CreateWorld(Recording, ReplayWorld))
+		{
+			return 1;
+		}
+
+		FRunResult& Result = Results.AddDefaulted_GetRef();
+		const bool bReplayed = RunReplay(ReplayWorld.World, Recording, Result);
+		DestroyWorld(ReplayWorld);
+		if (!bReplayed)
+		{
+			return 1;
+		}
+
+		UE_LOG(LogMovementReplay, Display, TEXT("Run %d: %llu moves in %.2f ms, %.2f us/move (median %.2f, p99 %.2f, max %.2f)"), Run,
+			Result.AllModes.Moves, Result.TotalMs, Result.AllModes.MeanUs, Result.AllModes.MedianUs, Result.AllModes.P99Us, Result.AllModes.MaxUs);
+	}
+
+	// Every run against the first, the characters should end in exactly the same place
+	double MaxDivergence = 0.0;
+	for (int32 Run = 1; Run < Results.Num(); ++Run)
+	{
+		for (int32 Track = 0; Track < Recording.Tracks.Num(); ++Track)
+		{
+			MaxDivergence = FMath::Max(MaxDivergence, FVector::Dist(Results[Run].FinalLocations[Track], Results[0].FinalLocations[Track]));
+		}
+	}
+	const bool bDeterministic = MaxDivergence <= Tolerance;
+	UE_LOG(LogMovementReplay, Display, TEXT("%d runs, largest difference in final location %.4f cm: %s"), Runs, MaxDivergence,
+		bDeterministic ? TEXT("deterministic") : TEXT("NOT deterministic"));
+
+	const bool bWritten = WriteResults(OutputPath, Recording, Results, MaxDivergence);
+	return bDeterministic && bWritten ? 0 : 1;
+#else
+	UE_LOG(LogMovementReplay, Error, TEXT("Move recordings are compiled out of Shipping"));
+	return 1;
+#endif
+}
+
+bool UMovementReplayCommandlet::RunReplay(UWorld* World, const FMovementMoveRecording& Recording, FRunResult& OutResult) const
+{
+#if !UE_BUILD_SHIPPING
+	struct FReplay
+	{
+		const FMovementMoveRecording::FTrack* Track = nullptr;
+		ACharacter* Character = nullptr;
+		AAIController* Controller = nullptr;
+		UCustomCharacterMovementComponent* Movement = nullptr;
+		// Move time so far, the world's time while this character moves
+		double Clock = 0.0;
+	};
+
+	TArray<FReplay> Replays;
+	int32 MaxMoves = 0;
+	for (const FMovementMoveRecording::FTrack& Track : Recording.Tracks)
+	{
+		const TSubclassOf<ACharacter> CharacterClass = LoadClass<ACharacter>(nullptr, *Track.CharacterClass);
+		if (!CharacterClass)
+		{
+			UE_LOG(LogMovementReplay, Error, TEXT("Could not load character class %s"), *Track.CharacterClass);
+			return false;
+		}
+
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		ACharacter* Character = World->SpawnActor<ACharacter>(CharacterClass, Track.StartLocation, Track.StartRotation, SpawnParams);
+		UCustomCharacterMovementComponent* Movement = Character ? Cast<UCustomCharacterMovementComponent>(Character->GetCharacterMovement()) : nullptr;
+		if (!Movement)
+		{
+			UE_LOG(LogMovementReplay, Error, TEXT("%s did not spawn with a UCustomCharacterMovementComponent"), *Track.CharacterClass);
+			return false;
+		}
+
+		FReplay& Replay = Replays.AddDefaulted_GetRef();
+		Replay.Track = &Track;
+		Replay.Character = Character;
+		Replay.Movement = Movement;
+		Replay.Controller = World->SpawnActor<AAIController>();
+		Replay.Controller->Possess(Character);
+
+		// As on a server for a remote client, the pose only ticks inside the moves
+		if (USkeletalMeshComponent* Mesh = Character->GetMesh())
+		{
+			Mesh->bOnlyAllowAutonomousTickPose = true;
+		}
+
+		Movement->SetMovementMode(static_cast<EMovementMode>(Track.StartMovementMode));
+		Movement->Velocity = Track.StartVelocity;
+		MaxMoves = FMath::Max(MaxMoves, Track.Moves.Num());
+	}
+
+	constexpr int32 NumModes = static_cast<int32>(FMovementModeCounters::EMode::Num);
+	TArray<float> ModeMoveUs[NumModes];
+	TArray<float> AllMoveUs;
+	AllMoveUs.Reserve(MaxMoves * Replays.Num());
+
+	// The characters take turns, one move each, the way a server interleaves its clients
+	UCustomCharacterMovementComponent::FCustomNetworkMoveData MoveData;
+	uint64 TotalCycles = 0;
+	for (int32 MoveIndex = 0; MoveIndex < MaxMoves; ++MoveIndex)
+	{
+		for (FReplay& Replay : Replays)
+		{
+			if (!Replay.Track->Moves.IsValidIndex(MoveIndex) || !IsValid(Replay.Character)) continue;
+
+			const FMovementMoveRecording::FMove& Move = Replay.Track->Moves[MoveIndex];
+			const FRotator ControlRotation = Move.GetControlRotation();
+			const FVector Acceleration(Move.Acceleration);
+
+			MoveData.TimeStamp = Move.TimeStamp;
+			MoveData.Acceleration = Acceleration;
+			MoveData.ControlRotation = ControlRotation;
+			MoveData.CompressedMoveFlags = Move.CompressedFlags;
+			MoveData.HangState = Move.HangState;
+
+			World->TimeSeconds = Replay.Clock;
+			Replay.Clock += Move.DeltaTime;
+			const int32 Mode = static_cast<int32>(FMovementModeCounters::GetMode(*Replay.Movement));
+
+			// ServerMove_PerformMovement from the control rotation on
+			const uint64 StartCycles = FPlatformTime::Cycles64();
+			Replay.Controller->SetControlRotation(ControlRotation);
+			Replay.Character->FaceRotation(ControlRotation, Move.DeltaTime);
+			Replay.Movement->SetCurrentNetworkMoveData(&MoveData);
+			Replay.Movement->MoveAutonomous(Move.TimeStamp, Move.DeltaTime, Move.CompressedFlags, Acceleration);
+			Replay.Movement->SetCurrentNetworkMoveData(nullptr);
+			const uint64 MoveCycles = FPlatformTime::Cycles64() - StartCycles;
+
+			TotalCycles += MoveCycles;
+			const float MoveUs = FPlatformTime::ToMilliseconds64(MoveCycles) * 1000.0;
+			ModeMoveUs[Mode].Add(MoveUs);
+			AllMoveUs.Add(MoveUs);
+		}
+	}
+
+	auto GetMoveCost = [](TArray<float>& MoveUs)
+	{
+		FRunResult::FMoveCost Cost;
+		Cost.Moves = MoveUs.Num();
+		if (MoveUs.IsEmpty()) return Cost;
+
+		MoveUs.Sort();
+		double TotalUs = 0.0;
+		for (const float Us : MoveUs)
+		{
+			TotalUs += Us;
+		}
+		Cost.MeanUs = TotalUs / MoveUs.Num();
+		Cost.MedianUs = MoveUs[MoveUs.Num() / 2];
+		Cost.P99Us = MoveUs[FMath::Min(MoveUs.Num() - 1, MoveUs.Num() * 99 / 100)];
+		Cost.MaxUs = MoveUs.Last();
+		return Cost;
+	};
+
+	OutResult.TotalMs = FPlatformTime::ToMilliseconds64(TotalCycles);
+	OutResult.AllModes = GetMoveCost(AllMoveUs);
+	for (int32 Mode = 0; Mode < NumModes; ++Mode)
+	{
+		OutResult.Modes[Mode] = GetMoveCost(ModeMoveUs[Mode]);
+	}
+	for (const FReplay& Replay : Replays)
+	{
+		OutResult.FinalLocations.Add(IsValid(Replay.Character) ? Replay.Character->GetActorLocation() : FVector::ZeroVector);
+	}
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool UMovementReplayCommandlet::WriteResults(const FString& OutputPath, const FMovementMoveRecording& Recording, const TArray<FRunResult>& Results, double MaxDivergence) const
+{
+#if !UE_BUILD_SHIPPING
+	constexpr int32 NumModes = static_cast<int32>(FMovementModeCounters::EMode::Num);
+
+	// LiveDrift is the distance to where the recording server had the character, which also moved it outside of ServerMoves
+	FString Csv = TEXT("Run,Track,CharacterClass,Moves,FinalX,FinalY,FinalZ,DivergenceCm,LiveDriftCm\n");
+	for (int32 Run = 0; Run < Results.Num(); ++Run)
+	{
+		for (int32 Track = 0; Track < Recording.Tracks.Num(); ++Track)
+		{
+			const FMovementMoveRecording::FTrack& RecordedTrack = Recording.Tracks[Track];
+			const FVector& Final = Results[Run].FinalLocations[Track];
+			Csv += FString::Printf(TEXT("%d,%d,%s,%d,%.4f,%.4f,%.4f,%.4f,%.4f\n"), Run, Track, *RecordedTrack.CharacterClass, RecordedTrack.Moves.Num(),
+				Final.X, Final.Y, Final.Z, FVector::Dist(Final, Results[0].FinalLocations[Track]), FVector::Dist(Final, RecordedTrack.EndLocation));
+		}
+	}
+
+	auto MoveCostJson = [](const FRunResult::FMoveCost& Cost)
+	{
+		return FString::Printf(TEXT("{ \"Moves\": %llu, \"MeanUs\": %.3f, \"MedianUs\": %.3f, \"P99Us\": %.3f, \"MaxUs\": %.3f }"),
+			Cost.Moves, Cost.MeanUs, Cost.MedianUs, Cost.P99Us, Cost.MaxUs);
+	};
+
+	FString Json = FString::Printf(TEXT("{\n\t\"Build\": \"%s\",\n\t\"Configuration\": \"%s\",\n\t\"Map\": \"%s\",\n\t\"Course\": %s,\n\t\"Tracks\": %d,\n")
+		TEXT("\t\"MaxDivergenceCm\": %.4f,\n\t\"Tolerance\": %.4f,\n\t\"Deterministic\": %s,\n\t\"Runs\": [\n"),
+		FApp::GetBuildVersion(), LexToString(FApp::GetBuildConfiguration()), *Recording.Map, Recording.bHasCourse ? TEXT("true") : TEXT("false"),
+		Recording.Tracks.Num(), MaxDivergence, Tolerance, MaxDivergence <= Tolerance ? TEXT("true") : TEXT("false"));
+
+	for (int32 Run = 0; Run < Results.Num(); ++Run)
+	{
+		const FRunResult& Result = Results[Run];
+		Json += FString::Printf(TEXT("\t\t{ \"TotalMs\": %.4f, \"All\": %s, \"Modes\": {"), Result.TotalMs, *MoveCostJson(Result.AllModes));
+		for (int32 Mode = 0; Mode < NumModes; ++Mode)
+		{
+			Json += FString::Printf(TEXT("%s \"%s\": %s"), Mode ? TEXT(",") : TEXT(""),
+				FMovementModeCounters::GetModeName(static_cast<FMovementModeCounters::EMode>(Mode)), *MoveCostJson(Result.Modes[Mode]));
+		}
+		Json += FString::Printf(TEXT(" } }%s\n"), Run + 1 < Results.Num() ? TEXT(",") : TEXT(""));
+	}
+	Json += TEXT("\t]\n}\n");
+
+	const bool bSaved = FFileHelper::SaveStringToFile(Csv, *(OutputPath + TEXT(".csv")))
+		&& FFileHelper::SaveStringToFile(Json, *(OutputPath + TEXT(".json")));
+	UE_LOG(LogMovementReplay, Display, TEXT("Results %s %s.csv/.json"), bSaved ? TEXT("written to") : TEXT("could not be written to"), *OutputPath);
+	return bSaved;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,41 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MovementTestCourse.h"
+
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+
+void FMovementTestCourse::Build(UWorld* World, int32 NumLanes, TArray<FTransform>& OutStarts) const
+{
+	UStaticMesh* Cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+
+	// The basic cube is 100cm with its pivot in the centre. Every world builds its own blocks, none replicate
+	auto SpawnBlock = [World, Cube](const FVector& Center, const FVector& Size)
+	{
+		const FTransform Transform(FRotator::ZeroRotator, Center, Size / 100.f);
+		AStaticMeshActor* Block = World->SpawnActorDeferred<AStaticMeshActor>(AStaticMeshActor::StaticClass(), Transform);
+		Block->SetReplicates(false);
+		Block->GetStaticMeshComponent()->SetStaticMesh(Cube);
+		Block->FinishSpawning(Transform);
+	};
+
+	// Lanes on a square grid, a wall with a ledge at the end of each
+	const int32 Columns = FMath::CeilToInt32(FMath::Sqrt(static_cast<float>(NumLanes)));
+	const int32 Rows = FMath::DivideAndRoundUp(NumLanes, Columns);
+	const FVector CourseSize(Rows * LaneLength, Columns * LaneWidth, 100.f);
+	SpawnBlock(Origin + FVector(CourseSize.X * 0.5f, CourseSize.Y * 0.5f, -50.f), CourseSize);
+
+	for (int32 Lane = 0; Lane < NumLanes; ++Lane)
+	{
+		const FVector LaneOrigin = Origin + FVector((Lane / Columns) * LaneLength, (Lane % Columns + 0.5f) * LaneWidth, 0.f);
+
+		// Wall as wide as the lane so the bots can shimmy along the ledge
+		const FVector WallSize(200.f, LaneWidth - 50.f, LedgeHeight);
+		SpawnBlock(LaneOrigin + FVector(WallDistance + WallSize.X * 0.5f, 0.f, LedgeHeight * 0.5f), WallSize);
+
+		OutStarts.Emplace(FRotator::ZeroRotator, LaneOrigin + FVector(100.f, 0.f, 100.f));
+	}
+}
@@ -0,0 +1,338 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PlatformingMovementComponent.h"
+
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimMontage.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "GameFramework/Character.h"
+
+#pragma region SavedMove
+UPlatformingMovementComponent::FSavedMove_Platforming::FSavedMove_Platforming()
+{
+	Saved_bWantsToDash = 0;
+	Saved_bWantsToAirJump = 0;
+	Saved_bHasDoubleJumped = 0;
+	Saved_bHasWallJumped = 0;
+	Saved_bHasDashed = 0;
+	Saved_bIsDashing = 0;
+}
+
+bool UPlatformingMovementComponent::FSavedMove_Platforming::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const
+{
+	const FSavedMove_Platforming* NewPlatformingMove = static_cast<FSavedMove_Platforming*>(NewMove.Get());
+
+	// A combined move has to start and run in one ability state, the timers may run on through it
+	if (Saved_bHasDoubleJumped != NewPlatformingMove->Saved_bHasDoubleJumped
+		|| Saved_bHasWallJumped != NewPlatformingMove->Saved_bHasWallJumped
+		|| Saved_bHasDashed != NewPlatformingMove->Saved_bHasDashed
+		|| Saved_bIsDashing != NewPlatformingMove->Saved_bIsDashing)
+	{
+		return false;
+	}
+
+	return FSavedMove_Character::CanCombineWith(NewMove, InCharacter, MaxDelta);
+}
+
+void UPlatformingMovementComponent::FSavedMove_Platforming::Clear()
+{
+	FSavedMove_Character::Clear();
+
+	Saved_bWantsToDash = 0;
+	Saved_bWantsToAirJump = 0;
+	Saved_bHasDoubleJumped = 0;
+	Saved_bHasWallJumped = 0;
+	Saved_bHasDashed = 0;
+	Saved_bIsDashing = 0;
+
+	Saved_WallJumpLockTime = 0.f;
+	Saved_DashTimeRemaining = 0.f;
+}
+
+uint8 UPlatformingMovementComponent::FSavedMove_Platforming::GetCompressedFlags() const
+{
+	uint8 Result = FSavedMove_Character::GetCompressedFlags();
+
+	if (Saved_bWantsToDash) Result |= FLAG_Dash;
+	if (Saved_bWantsToAirJump) Result |= FLAG_AirJump;
+
+	return Result;
+}
+
+void UPlatformingMovementComponent::FSavedMove_Platforming::SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData)
+{
+	FSavedMove_Character::SetMoveFor(C, InDeltaTime, NewAccel, ClientData);
+
+	const UPlatformingMovementComponent* CharacterMovement = Cast<UPlatformingMovementComponent>(C->GetCharacterMovement());
+
+	Saved_bWantsToDash = CharacterMovement->bWantsToDash;
+	Saved_bWantsToAirJump = CharacterMovement->bWantsToAirJump;
+
+	Saved_bHasDoubleJumped = CharacterMovement->bHasDoubleJumped;
+	Saved_bHasWallJumped = CharacterMovement->bHasWallJumped;
+	Saved_bHasDashed = CharacterMovement->bHasDashed;
+	Saved_bIsDashing = CharacterMovement->bIsDashing;
+
+	Saved_WallJumpLockTime = CharacterMovement->WallJumpLockTime;
+	Saved_DashTimeRemaining = CharacterMovement->DashTimeRemaining;
+}
+
+void UPlatformingMovementComponent::FSavedMove_Platforming::PrepMoveFor(ACharacter* C)
+{
+	FSavedMove_Character::PrepMoveFor(C);
+
+	UPlatformingMovementComponent* CharacterMovement = Cast<UPlatformingMovementComponent>(C->GetCharacterMovement());
+
+	CharacterMovement->bWantsToDash = Saved_bWantsToDash;
+	CharacterMovement->bWantsToAirJump = Saved_bWantsToAirJump;
+
+	CharacterMovement->bHasDoubleJumped = Saved_bHasDoubleJumped;
+	CharacterMovement->bHasWallJumped = Saved_bHasWallJumped;
+	CharacterMovement->bHasDashed = Saved_bHasDashed;
+	CharacterMovement->bIsDashing = Saved_bIsDashing;
+
+	CharacterMovement->WallJumpLockTime = Saved_WallJumpLockTime;
+	CharacterMovement->DashTimeRemaining = Saved_DashTimeRemaining;
+}
+#pragma endregion SavedMove
+
+#pragma region NetworkPredictionData
+UPlatformingMovementComponent::FNetworkPredictionData_Client_Platforming::FNetworkPredictionData_Client_Platforming(const UCharacterMovementComponent& ClientMovement)
+: Super(ClientMovement)
+{
+}
+
+FSavedMovePtr UPlatformingMovementComponent::FNetworkPredictionData_Client_Platforming::AllocateNewMove()
+{
+	return FSavedMovePtr(new FSavedMove_Platforming());
+}
+
+FNetworkPredictionData_Client* UPlatformingMovementComponent::GetPredictionData_Client() const
+{
+	check(PawnOwner != nullptr)
+
+	if (ClientPredictionData == nullptr)
+	{
+		UPlatformingMovementComponent* MutableThis = const_cast<UPlatformingMovementComponent*>(this);
+
+		MutableThis->ClientPredictionData = new FNetworkPredictionData_Client_Platforming(*this);
+	}
+	return ClientPredictionData;
+}
+#pragma endregion NetworkPredictionData
+
+void UPlatformingMovementComponent::DashPressed()
+{
+	bWantsToDash = true;
+}
+
+void UPlatformingMovementComponent::AirJumpPressed()
+{
+	bWantsToAirJump = true;
+}
+
+float UPlatformingMovementComponent::GetGravityZ() const
+{
+	// The dash montage carries the character, gravity would pull it off the authored path
+	return bIsDashing ? 0.f : Super::GetGravityZ();
+}
+
+bool UPlatformingMovementComponent::CanAttemptJump() const
+{
+	return !bIsDashing && Super::CanAttemptJump();
+}
+
+void UPlatformingMovementComponent::UpdateFromCompressedFlags(uint8 Flags)
+{
+	Super::UpdateFromCompressedFlags(Flags);
+
+	bWantsToDash = (Flags & FSavedMove_Character::FLAG_Custom_0) != 0;
+	bWantsToAirJump = (Flags & FSavedMove_Character::FLAG_Custom_1) != 0;
+}
+
+// Runs inside the move on the client, the server and during replays, before the launch is applied
+void UPlatformingMovementComponent::UpdateCharacterStateBeforeMovement(float DeltaSeconds)
+{
+	TickAbilityTimers(DeltaSeconds);
+
+	if (bWantsToDash && !bHasDashed)
+	{
+		StartDash();
+	}
+
+	if (bWantsToAirJump && !bIsDashing)
+	{
+		AirJump();
+	}
+
+	// Requests last one move, the saved move already holds them
+	bWantsToDash = false;
+	bWantsToAirJump = false;
+
+	Super::UpdateCharacterStateBeforeMovement(DeltaSeconds);
+}
+
+void UPlatformingMovementComponent::ProcessLanded(const FHitResult& Hit, float remainingTime, int32 Iterations)
+{
+	bHasDoubleJumped = false;
+	bHasDashed = false;
+
+	Super::ProcessLanded(Hit, remainingTime, Iterations);
+}
+
+void UPlatformingMovementComponent::TickAbilityTimers(float DeltaSeconds)
+{
+	if (bHasWallJumped)
+	{
+		WallJumpLockTime -= DeltaSeconds;
+		if (WallJumpLockTime <= 0.f)
+		{
+			WallJumpLockTime = 0.f;
+			bHasWallJumped = false;
+		}
+	}
+
+	if (bIsDashing)
+	{
+		DashTimeRemaining -= DeltaSeconds;
+		if (DashTimeRemaining <= 0.f)
+		{
+			EndDash();
+		}
+	}
+}
+
+void UPlatformingMovementComponent::StartDash()
+{
+	bIsDashing = true;
+	bHasDashed = true;
+	DashTimeRemaining = DashDuration;
+
+	// Don't carry momentum into the dash
+	Velocity = FVector::ZeroVector;
+
+	// Played on both sides so the server consumes the same root motion, a replay keeps the montage that is running
+	if (DashMontage && IsPlayingNewMove())
+	{
+		if (UAnimInstance* AnimInstance = CharacterOwner->GetMesh() ? CharacterOwner->GetMesh()->GetAnimInstance() : nullptr)
+		{
+			AnimInstance->Montage_Play(DashMontage, 1.f, EMontagePlayReturnType::MontageLength, 0.f, true);
+		}
+	}
+}
+
+void UPlatformingMovementComponent::EndDash()
+{
+	bIsDashing = false;
+	DashTimeRemaining = 0.f;
+
+	// Grounded after the dash, there won't be a landing to reset it
+	if (IsMovingOnGround())
+	{
+		bHasDashed = false;
+	}
+
+	if (IsPlayingNewMove())
+	{
+		OnDashEnded.Broadcast();
+	}
+}
+
+void UPlatformingMovementComponent::AirJump()
+{
+	// Landed since the press, a ground jump goes through the regular jump input
+	if (!IsFalling())
+	{
+		CharacterOwner->bPressedJump = true;
+		return;
+	}
+
+	if (bHasWallJumped)
+	{
+		return;
+	}
+
+	if ((TryWallJump() || TryDoubleJump()) && IsPlayingNewMove())
+	{
+		OnAirJumped.Broadcast();
+	}
+}
+
+bool UPlatformingMovementComponent::TryWallJump()
+{
+	FVector ProbeDirection = UpdatedComponent->GetForwardVector();
+	if (WallJumpProbe == EWallJumpProbe::Input)
+	{
+		ProbeDirection = Acceleration.GetSafeNormal2D();
+		if (ProbeDirection.IsZero())
+		{
+			return false;
+		}
+	}
+
+	const FVector Start = UpdatedComponent->GetComponentLocation();
+	const FVector End = Start + ProbeDirection * WallJumpTraceDistance;
+
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(WallJumpProbe), false, CharacterOwner);
+
+	FHitResult Hit;
+	const bool bHit = WallJumpTraceRadius > 0.f
+		? GetWorld()->SweepSingleByChannel(Hit, Start, End, FQuat::Identity, ECC_Visibility, FCollisionShape::MakeSphere(WallJumpTraceRadius), QueryParams)
+		: GetWorld()->LineTraceSingleByChannel(Hit, Start, End, ECC_Visibility, QueryParams);
+	if (!bHit)
+	{
+		return false;
+	}
+
+	// Face away from the wall, ready for the next wall jump
+	const FRotator WallOrientation(0.f, Hit.ImpactNormal.Rotation().Yaw, 0.f);
+	MoveUpdatedComponent(FVector::ZeroVector, WallOrientation.Quaternion(), false);
+
+	const float VerticalImpulse = WallJumpVerticalJumpZScale > 0.f ? JumpZVelocity * WallJumpVerticalJumpZScale : WallJumpVerticalImpulse;
+	FVector WallJumpImpulse = Hit.ImpactNormal * WallJumpHorizontalImpulse;
+	WallJumpImpulse.Z = bWallJumpKeepsNormalZ ? WallJumpImpulse.Z + VerticalImpulse : VerticalImpulse;
+
+	// Applied by HandlePendingLaunch later in this move
+	CharacterOwner->LaunchCharacter(WallJumpImpulse, true, true);
+
+	bHasWallJumped = true;
+	WallJumpLockTime = WallJumpLockout;
+	return true;
+}
+
+bool UPlatformingMovementComponent::TryDoubleJump()
+{
+	if (bHasDoubleJumped)
+	{
+		return false;
+	}
+
+	// ACharacter::CheckJumpInput for a fresh press, resolved in this move instead of the next one.
+	// bPressedJump stays up so holding the button extends the jump in the moves that follow
+	ACharacter* Character = CharacterOwner;
+	Character->bPressedJump = true;
+
+	// Falling without having jumped uses up the first jump
+	if (Character->JumpCurrentCount == 0)
+	{
+		++Character->JumpCurrentCount;
+	}
+
+	if (!Character->CanJump() || !DoJump(Character->bClientUpdating))
+	{
+		return false;
+	}
+	bHasDoubleJumped = true;
+
+	++Character->JumpCurrentCount;
+	Character->JumpForceTimeRemaining = Character->GetJumpMaxHoldTime();
+	Character->bWasJumping = true;
+	Character->OnJumped();
+	return true;
+}
+
+bool UPlatformingMovementComponent::IsPlayingNewMove() const
+{
+	return CharacterOwner && !CharacterOwner->bClientUpdating;
+}
@@ -0,0 +1,190 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ServerMoveScheduler.h"
+
+#include "CustomCMC.h"
+#include "CustomCharacterMovementComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+static TAutoConsoleVariable<float> CVarMoveBudgetMs(
+	TEXT("CustomCMC.Net.MoveBudgetMs"),
+	0.f,
+	TEXT("Server time per frame for running client ServerMoves, moves past it wait for a later frame. 0 runs every move as it arrives"));
+
+static TAutoConsoleVariable<float> CVarIdleMoveIntervalMs(
+	TEXT("CustomCMC.Net.IdleMoveIntervalMs"),
+	100.f,
+	TEXT("While the move budget is on, how long the moves of a client standing or hanging still are held and folded together"));
+
+static TAutoConsoleVariable<float> CVarMaxMoveDeferMs(
+	TEXT("CustomCMC.Net.MaxMoveDeferMs"),
+	100.f,
+	TEXT("Longest a held ServerMove waits before it runs regardless of the budget. ")
+	TEXT("Keep it plus the client's send interval under GameNetworkManager MAXCLIENTUPDATEINTERVAL or the server forces updates"));
+
+static TAutoConsoleVariable<float> CVarContestedRadius(
+	TEXT("CustomCMC.Net.ContestedRadius"),
+	1500.f,
+	TEXT("A client with another character this close runs its held moves ahead of the other active clients"));
+
+DECLARE_CYCLE_STAT(TEXT("ServerMove Scheduler"), STAT_ServerMoveScheduler, STATGROUP_CustomCMC);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("ServerMove ms"), STAT_ServerMoveMs, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("ServerMoves Held"), STAT_ServerMovesHeld, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("ServerMove Clients Over Budget"), STAT_ServerMoveClientsOverBudget, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("ServerMove Clients Overdue"), STAT_ServerMoveClientsOverdue, STATGROUP_CustomCMC);
+
+UServerMoveScheduler::FScopedCharge::FScopedCharge(UServerMoveScheduler& InScheduler)
+	: Scheduler(InScheduler)
+	, StartTime(FPlatformTime::Seconds())
+{
+}
+
+UServerMoveScheduler::FScopedCharge::~FScopedCharge()
+{
+	Scheduler.FrameSeconds += FPlatformTime::Seconds() - StartTime;
+}
+
+bool UServerMoveScheduler::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) return false;
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UServerMoveScheduler::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	WorldTickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &UServerMoveScheduler::OnWorldTickStart);
+	PostTickDispatchHandle = GetWorld()->OnPostTickDispatch().AddUObject(this, &UServerMoveScheduler::RunWaiting);
+}
+
+void UServerMoveScheduler::Deinitialize()
+{
+	FWorldDelegates::OnWorldTickStart.Remove(WorldTickStartHandle);
+	GetWorld()->OnPostTickDispatch().Remove(PostTickDispatchHandle);
+	Components.Reset();
+	Waiting.Reset();
+
+	Super::Deinitialize();
+}
+
+void UServerMoveScheduler::RegisterComponent(UCustomCharacterMovementComponent* Component)
+{
+	Components.AddUnique(Component);
+}
+
+void UServerMoveScheduler::UnregisterComponent(UCustomCharacterMovementComponent* Component)
+{
+	Components.RemoveSingleSwap(Component);
+	Waiting.RemoveSingleSwap(Component);
+}
+
+bool UServerMoveScheduler::IsActive() const
+{
+	const ENetMode NetMode = GetWorld()->GetNetMode();
+	return CVarMoveBudgetMs.GetValueOnGameThread() > 0.f && (NetMode == NM_DedicatedServer || NetMode == NM_ListenServer);
+}
+
+bool UServerMoveScheduler::HasBudget() const
+{
+	return FrameSeconds * 1000.0 < CVarMoveBudgetMs.GetValueOnGameThread();
+}
+
+void UServerMoveScheduler::MarkWaiting(UCustomCharacterMovementComponent* Component, bool bIdle)
+{
+	INC_DWORD_STAT(STAT_ServerMovesHeld);
+
+	// Queued behind held moves, they run first to keep the order
+	if (!bIdle && HasBudget())
+	{
+		FScopedCharge Charge(*this);
+		Component->RunDeferredServerMoves();
+		Waiting.RemoveSingleSwap(Component);
+		return;
+	}
+
+	Waiting.AddUnique(Component);
+}
+
+void UServerMoveScheduler::OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+{
+	if (World == GetWorld())
+	{
+		FrameSeconds = 0.0;
+	}
+}
+
+void UServerMoveScheduler::RunWaiting()
+{
+	CUSTOMCMC_SCOPE(STAT_ServerMoveScheduler);
+
+	if (!Waiting.IsEmpty())
+	{
+		const double Now = FPlatformTime::Seconds();
+		const double IdleInterval = CVarIdleMoveIntervalMs.GetValueOnGameThread() / 1000.0;
+		const double MaxDefer = CVarMaxMoveDeferMs.GetValueOnGameThread() / 1000.0;
+
+		Candidates.Reset();
+		for (UCustomCharacterMovementComponent* Component : Waiting)
+		{
+			if (!Component->HasDeferredServerMoves()) continue;
+
+			const double Age = Now - Component->GetOldestDeferredServerMoveTime();
+			const bool bActive = Component->HasActiveDeferredServerMove();
+
+			// Idle clients run at the lower rate
+			if (!bActive && Age < IdleInterval && Age < MaxDefer) continue;
+
+			const int32 Priority = Age >= MaxDefer ? 0 : !bActive ? 3 : IsContested(*Component) ? 1 : 2;
+			Candidates.Add({ Component, Age, Priority });
+		}
+
+		Candidates.Sort([](const FCandidate& A, const FCandidate& B)
+		{
+			return A.Priority != B.Priority ? A.Priority < B.Priority : A.Age > B.Age;
+		});
+
+		for (const FCandidate& Candidate : Candidates)
+		{
+			// Overdue clients run regardless, the rest wait for the next frame's budget
+			if (Candidate.Priority == 0)
+			{
+				INC_DWORD_STAT(STAT_ServerMoveClientsOverdue);
+			}
+			else if (!HasBudget())
+			{
+				INC_DWORD_STAT(STAT_ServerMoveClientsOverBudget);
+				continue;
+			}
+
+			FScopedCharge Charge(*this);
+			Candidate.Component->RunDeferredServerMoves();
+		}
+
+		Waiting.RemoveAllSwap([](const UCustomCharacterMovementComponent* Component) { return !Component->HasDeferredServerMoves(); });
+	}
+
+	SET_FLOAT_STAT(STAT_ServerMoveMs, FrameSeconds * 1000.0);
+}
+
+bool UServerMoveScheduler::IsContested(const UCustomCharacterMovementComponent& Component) const
+{
+	const AActor* Owner = Component.GetOwner();
+	if (!Owner) return false;
+
+	const FVector Location = Owner->GetActorLocation();
+	const float RadiusSquared = FMath::Square(CVarContestedRadius.GetValueOnGameThread());
+	for (const UCustomCharacterMovementComponent* Other : Components)
+	{
+		const AActor* OtherOwner = Other ? Other->GetOwner() : nullptr;
+		if (OtherOwner && OtherOwner != Owner && FVector::DistSquared(Location, OtherOwner->GetActorLocation()) < RadiusSquared)
+		{
+			return true;
+		}
+	}
+	return false;
+}
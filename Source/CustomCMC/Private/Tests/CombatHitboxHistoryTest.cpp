@@ -0,0 +1,268 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CombatHitboxHistory.h"
+#include "Engine/EngineTypes.h"
+#include "Math/RandomStream.h"
+
+namespace CombatHitboxHistoryTest
+{
+	static constexpr float CapsuleRadius = 40.f;
+	static constexpr float CapsuleHalfHeight = 100.f;
+	static const uint32 PawnBit = ECC_TO_BITFIELD(ECC_Pawn);
+
+	// One pawn capsule moving from X=0 at Time 0 to X=1000 at Time 1
+	static void MakeTwoSampleHistory(FCombatHitboxHistory& History)
+	{
+		History.AddSlot(CapsuleRadius, CapsuleHalfHeight, PawnBit);
+		const FVector Older[] = { FVector(0.f, 0.f, 0.f) };
+		const FVector Newer[] = { FVector(1000.f, 0.f, 0.f) };
+		History.AddSample(0.0, Older);
+		History.AddSample(1.0, Newer);
+	}
+
+	// X of the capsule the history holds at Time, from a thin sweep across the X axis at every X it could be at
+	static TOptional<float> FindCapsuleX(FAutomationTestBase& Test, const FCombatHitboxHistory& History, double Time)
+	{
+		TArray<FCombatHitboxHistory::FHit> Hits;
+		History.SweepSphere(Time, FVector(-500.f, 0.f, 0.f), FVector(1500.f, 0.f, 0.f), 1.f, PawnBit, INDEX_NONE, Hits);
+		if (!Test.TestEqual(FString::Printf(TEXT("Hits at time %.2f"), Time), Hits.Num(), 1)) return {};
+
+		// The sweep runs along the capsule's axis line, so it is hit on the face towards the start
+		return float(Hits[0].ImpactPoint.X + CapsuleRadius);
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCombatHitboxSweepSphereCapsuleTest, "CustomCMC.Combat.HitboxHistory.SweepSphereCapsule",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FCombatHitboxSweepSphereCapsuleTest::RunTest(const FString& Parameters)
+{
+	using namespace CombatHitboxHistoryTest;
+
+	FCombatHitboxHistory::FCapsule Capsule;
+	Capsule.Center = FVector(0.f, 0.f, 0.f);
+	Capsule.Radius = CapsuleRadius;
+	Capsule.HalfHeight = CapsuleHalfHeight;
+	constexpr float SphereRadius = 10.f;
+
+	FCombatHitboxHistory::FHit Hit;
+
+	// Straight through the axis, pushed back towards the start
+	TestTrue(TEXT("Sweep through the axis hits"), FCombatHitboxHistory::SweepSphereCapsule(FVector(-200.f, 0.f, 0.f), FVector(200.f, 0.f, 0.f), SphereRadius, Capsule, Hit));
+	TestEqual(TEXT("Through the axis, normal"), Hit.ImpactNormal, FVector(-1.f, 0.f, 0.f));
+	TestEqual(TEXT("Through the axis, impact point"), Hit.ImpactPoint, FVector(-CapsuleRadius, 0.f, 0.f));
+
+	// Grazing the side within both radii, and just past them
+	TestTrue(TEXT("Grazing the side hits"), FCombatHitboxHistory::SweepSphereCapsule(FVector(-200.f, 45.f, 0.f), FVector(200.f, 45.f, 0.f), SphereRadius, Capsule, Hit));
+	TestEqual(TEXT("Grazing the side, normal"), Hit.ImpactNormal, FVector(0.f, 1.f, 0.f));
+	TestEqual(TEXT("Grazing the side, impact point"), Hit.ImpactPoint, FVector(0.f, CapsuleRadius, 0.f));
+	TestFalse(TEXT("Passing the side misses"), FCombatHitboxHistory::SweepSphereCapsule(FVector(-200.f, 51.f, 0.f), FVector(200.f, 51.f, 0.f), SphereRadius, Capsule, Hit));
+
+	// Over the top hemisphere, centered HalfHeight - Radius above the capsule's center
+	TestTrue(TEXT("Skimming the top hits"), FCombatHitboxHistory::SweepSphereCapsule(FVector(-200.f, 0.f, 105.f), FVector(200.f, 0.f, 105.f), SphereRadius, Capsule, Hit));
+	TestEqual(TEXT("Skimming the top, normal"), Hit.ImpactNormal, FVector(0.f, 0.f, 1.f));
+	TestEqual(TEXT("Skimming the top, impact point"), Hit.ImpactPoint, FVector(0.f, 0.f, CapsuleHalfHeight));
+	TestFalse(TEXT("Passing over the top misses"), FCombatHitboxHistory::SweepSphereCapsule(FVector(-200.f, 0.f, 111.f), FVector(200.f, 0.f, 111.f), SphereRadius, Capsule, Hit));
+
+	// Stopping short of the capsule
+	TestFalse(TEXT("Sweep ending short misses"), FCombatHitboxHistory::SweepSphereCapsule(FVector(-200.f, 0.f, 0.f), FVector(-51.f, 0.f, 0.f), SphereRadius, Capsule, Hit));
+
+	// Down the axis itself, the normal still points out of the capsule
+	TestTrue(TEXT("Sweep down the axis hits"), FCombatHitboxHistory::SweepSphereCapsule(FVector(0.f, 0.f, 300.f), FVector(0.f, 0.f, -300.f), SphereRadius, Capsule, Hit));
+	TestTrue(TEXT("Down the axis, normal is a unit vector"), Hit.ImpactNormal.IsNormalized());
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCombatHitboxInterpolationTest, "CustomCMC.Combat.HitboxHistory.Interpolation",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FCombatHitboxInterpolationTest::RunTest(const FString& Parameters)
+{
+	using namespace CombatHitboxHistoryTest;
+
+	FCombatHitboxHistory History;
+	MakeTwoSampleHistory(History);
+
+	for (const double Time : { 0.0, 0.25, 0.5, 0.75, 1.0 })
+	{
+		if (const TOptional<float> X = FindCapsuleX(*this, History, Time))
+		{
+			TestNearlyEqual(FString::Printf(TEXT("Capsule X at time %.2f"), Time), *X, float(Time * 1000.0), 0.01f);
+		}
+	}
+
+	// Only the slots asked for, and never the ignored one
+	TArray<FCombatHitboxHistory::FHit> Hits;
+	History.SweepSphere(0.5, FVector(500.f, -200.f, 0.f), FVector(500.f, 200.f, 0.f), 1.f, ECC_TO_BITFIELD(ECC_WorldDynamic), INDEX_NONE, Hits);
+	TestEqual(TEXT("Hits filtered by object type"), Hits.Num(), 0);
+	History.SweepSphere(0.5, FVector(500.f, -200.f, 0.f), FVector(500.f, 200.f, 0.f), 1.f, PawnBit, 0, Hits);
+	TestEqual(TEXT("Hits on the ignored slot"), Hits.Num(), 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCombatHitboxClampTest, "CustomCMC.Combat.HitboxHistory.Clamp",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FCombatHitboxClampTest::RunTest(const FString& Parameters)
+{
+	using namespace CombatHitboxHistoryTest;
+
+	{
+		FCombatHitboxHistory History;
+		MakeTwoSampleHistory(History);
+
+		if (const TOptional<float> X = FindCapsuleX(*this, History, -5.0))
+		{
+			TestNearlyEqual(TEXT("Before the oldest sample, capsule X"), *X, 0.f, 0.01f);
+		}
+		if (const TOptional<float> X = FindCapsuleX(*this, History, 10.0))
+		{
+			TestNearlyEqual(TEXT("After the newest sample, capsule X"), *X, 1000.f, 0.01f);
+		}
+	}
+
+	// Past the ring's capacity the oldest samples are dropped, a rewind that far gets the oldest one left
+	{
+		FCombatHitboxHistory History;
+		History.AddSlot(CapsuleRadius, CapsuleHalfHeight, PawnBit);
+		constexpr int32 NumSamples = FCombatHitboxHistory::Capacity + 10;
+		for (int32 Sample = 0; Sample < NumSamples; ++Sample)
+		{
+			const FVector Centers[] = { FVector(Sample * 10.f, 0.f, 0.f) };
+			History.AddSample(Sample, Centers);
+		}
+
+		TestEqual(TEXT("Oldest time kept"), History.GetOldestTime(), double(NumSamples - FCombatHitboxHistory::Capacity));
+		TestEqual(TEXT("Newest time kept"), History.GetNewestTime(), double(NumSamples - 1));
+
+		if (const TOptional<float> X = FindCapsuleX(*this, History, 0.0))
+		{
+			TestNearlyEqual(TEXT("Before the oldest sample kept, capsule X"), *X, (NumSamples - FCombatHitboxHistory::Capacity) * 10.f, 0.01f);
+		}
+		if (const TOptional<float> X = FindCapsuleX(*this, History, 40.5))
+		{
+			TestNearlyEqual(TEXT("Between samples after wrapping, capsule X"), *X, 405.f, 0.01f);
+		}
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FCombatHitboxPerfTest, "CustomCMC.Combat.HitboxHistory.Perf",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FCombatHitboxPerfTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 NumActors = 200;
+	constexpr int32 NumQueries = 10000;
+	constexpr double SampleInterval = 1.0 / 60.0;
+	const uint32 ObjectTypes = ECC_TO_BITFIELD(ECC_Pawn) | ECC_TO_BITFIELD(ECC_WorldDynamic);
+
+	// Characters wandering a 40 m square at up to 6 m/s, sampled at 60 Hz for a full history
+	FRandomStream Random(1234);
+	FCombatHitboxHistory History;
+	TArray<FVector> Centers, Velocities;
+	TArray<uint32> ObjectTypeBits;
+	for (int32 Actor = 0; Actor < NumActors; ++Actor)
+	{
+		ObjectTypeBits.Add(ECC_TO_BITFIELD(Actor % 4 == 0 ? ECC_WorldDynamic : ECC_Pawn));
+		History.AddSlot(42.f, 96.f, ObjectTypeBits.Last());
+		Centers.Add(FVector(Random.FRandRange(-2000.f, 2000.f), Random.FRandRange(-2000.f, 2000.f), 96.f));
+		Velocities.Add(FVector(Random.GetUnitVector().GetSafeNormal2D() * Random.FRandRange(0.f, 600.f)));
+	}
+
+	// Every sample kept as the history stores it, for the reference
+	TArray<TArray<FVector3f>> SampleCenters;
+	double SampleSeconds = 0.0;
+	for (int32 Sample = 0; Sample < FCombatHitboxHistory::Capacity; ++Sample)
+	{
+		for (int32 Actor = 0; Actor < NumActors; ++Actor)
+		{
+			Centers[Actor] += Velocities[Actor] * SampleInterval;
+		}
+		TArray<FVector3f>& Stored = SampleCenters.AddDefaulted_GetRef();
+		for (const FVector& Center : Centers)
+		{
+			Stored.Add(FVector3f(Center));
+		}
+		const double Start = FPlatformTime::Seconds();
+		History.AddSample(Sample * SampleInterval, Centers);
+		SampleSeconds += FPlatformTime::Seconds() - Start;
+	}
+
+	// Melee swings from random attackers, rewound up to the default 250 ms
+	struct FQuery
+	{
+		double Time;
+		FVector Start;
+		FVector End;
+	};
+	TArray<FQuery> Queries;
+	for (int32 Query = 0; Query < NumQueries; ++Query)
+	{
+		const FVector From = Centers[Random.RandHelper(NumActors)];
+		Queries.Add({ History.GetNewestTime() - Random.FRandRange(0.f, 0.25f), From, From + Random.GetUnitVector().GetSafeNormal2D() * 150.f });
+	}
+
+	TArray<TArray<int32>> QueryHits;
+	QueryHits.SetNum(NumQueries);
+	TArray<FCombatHitboxHistory::FHit> Hits;
+	int64 NumHits = 0;
+	const double Start = FPlatformTime::Seconds();
+	for (int32 Query = 0; Query < NumQueries; ++Query)
+	{
+		Hits.Reset();
+		History.SweepSphere(Queries[Query].Time, Queries[Query].Start, Queries[Query].End, 20.f, ObjectTypes, INDEX_NONE, Hits);
+		NumHits += Hits.Num();
+		for (const FCombatHitboxHistory::FHit& Hit : Hits)
+		{
+			QueryHits[Query].Add(Hit.Slot);
+		}
+	}
+	const double QuerySeconds = FPlatformTime::Seconds() - Start;
+
+	// Same queries against every capsule, interpolated the way the history does it
+	int32 Mismatches = 0;
+	for (int32 Query = 0; Query < NumQueries; ++Query)
+	{
+		const double Time = Queries[Query].Time;
+		int32 Older = FCombatHitboxHistory::Capacity - 1;
+		while (Older > 0 && Older * SampleInterval > Time)
+		{
+			--Older;
+		}
+		const int32 Newer = FMath::Min(Older + 1, FCombatHitboxHistory::Capacity - 1);
+		const double TimeSpan = Newer * SampleInterval - Older * SampleInterval;
+		const float Alpha = TimeSpan > 0.0 ? float(FMath::Clamp((Time - Older * SampleInterval) / TimeSpan, 0.0, 1.0)) : 0.f;
+
+		TArray<int32> Expected;
+		for (int32 Actor = 0; Actor < NumActors; ++Actor)
+		{
+			FCombatHitboxHistory::FCapsule Capsule;
+			Capsule.Center = FVector(FMath::Lerp(SampleCenters[Older][Actor], SampleCenters[Newer][Actor], Alpha));
+			Capsule.Radius = 42.f;
+			Capsule.HalfHeight = 96.f;
+			FCombatHitboxHistory::FHit Hit;
+			if ((ObjectTypeBits[Actor] & ObjectTypes) && FCombatHitboxHistory::SweepSphereCapsule(Queries[Query].Start, Queries[Query].End, 20.f, Capsule, Hit))
+			{
+				Expected.Add(Actor);
+			}
+		}
+		Mismatches += Expected != QueryHits[Query] ? 1 : 0;
+	}
+
+	AddInfo(FString::Printf(TEXT("%d actors, %d samples, %d queries"), NumActors, FCombatHitboxHistory::Capacity, NumQueries));
+	AddInfo(FString::Printf(TEXT("Rewind sweep %.1f ns/query (%.2f hits/query)  Sample %.1f ns/sample"),
+		QuerySeconds * 1e9 / NumQueries, double(NumHits) / NumQueries, SampleSeconds * 1e9 / FCombatHitboxHistory::Capacity));
+
+	// Well inside the history, the hits must be the ones every capsule gives on its own
+	TestEqual(TEXT("Queries whose hits differ from the reference"), Mismatches, 0);
+	return true;
+}
+
+#endif
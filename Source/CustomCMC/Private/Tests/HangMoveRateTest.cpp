@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_EDITOR
+
+#include "Editor.h"
+#include "MovementNetStress.h"
+#include "Tests/MovementTestWorld.h"
+
+namespace HangMoveRateTest
+{
+	// Limits the run must stay under with lag and loss emulated, not measurements: tighten them to a margin over
+	// the numbers the run reports on the build machine
+	static constexpr double RateMargin = 1.25;
+	static constexpr uint64 MaxHangCorrections = 10;
+	static constexpr double MaxCorrectionsPerMinute = 20.0;
+
+	static constexpr int32 NumClients = 4;
+	static const TCHAR* EmulationParams = TEXT("Profiles=Custom PktLag=60 PktLagVariance=10 PktLoss=2 WarmupSeconds=5 Duration=20");
+
+	// One stress run with hang move coalescing off, then one with it on
+	struct FState
+	{
+		TUniquePtr<MovementNetStress::FStressRun> Run;
+		TOptional<MovementNetStress::FRunResult> Uncoalesced;
+		TOptional<MovementNetStress::FRunResult> Coalesced;
+	};
+
+	static TUniquePtr<MovementNetStress::FStressRun> StartRun(bool bCoalescing)
+	{
+		return MakeUnique<MovementNetStress::FStressRun>(FString::Printf(TEXT("%s Clients=%d HangMoveCoalescing=%d"),
+			EmulationParams, NumClients, bCoalescing ? 1 : 0));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHangMoveRateTest, "CustomCMC.Net.HangMoveRate",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::StressFilter)
+
+bool FHangMoveRateTest::RunTest(const FString& Parameters)
+{
+	using namespace HangMoveRateTest;
+
+	if (!TestTrue(TEXT("Editor with no play session in progress"), GEditor && !GEditor->IsPlaySessionInProgress())) return false;
+
+	const TSharedRef<FState> State = MakeShared<FState>();
+	State->Run = StartRun(false);
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, State]()
+	{
+		if (!State->Run->IsFinished()) return false;
+
+		const TArray<MovementNetStress::FRunResult>& Results = State->Run->GetResults();
+		TOptional<MovementNetStress::FRunResult>& Slot = State->Uncoalesced.IsSet() ? State->Coalesced : State->Uncoalesced;
+		if (Results.Num() == 1)
+		{
+			Slot = Results[0];
+		}
+		State->Run.Reset();
+
+		if (!State->Coalesced.IsSet() && State->Uncoalesced.IsSet() && State->Uncoalesced->bCompleted)
+		{
+			State->Run = StartRun(true);
+			return false;
+		}
+
+		if (!TestTrue(TEXT("Run without coalescing completed"), State->Uncoalesced.IsSet() && State->Uncoalesced->bCompleted)) return true;
+		if (!TestTrue(TEXT("Run with coalescing completed"), State->Coalesced.IsSet() && State->Coalesced->bCompleted)) return true;
+
+		constexpr int32 Hang = static_cast<int32>(FMovementModeCounters::EMode::Hang);
+		const MovementNetStress::FModeResult& Before = State->Uncoalesced->Modes[Hang];
+		const MovementNetStress::FModeResult& After = State->Coalesced->Modes[Hang];
+		AddInfo(FString::Printf(TEXT("Hang ServerMoves/s %.2f without coalescing, %.2f with it; hang corrections %llu and %llu"),
+			Before.ServerMovesPerSecond, After.ServerMovesPerSecond, Before.Corrections, After.Corrections));
+
+		// Otherwise no bot hung long enough for the rates to mean anything
+		TestTrue(TEXT("Hang ServerMoves measured"), Before.ServerMovesPerSecond > 0.0 && After.ServerMovesPerSecond > 0.0);
+
+		const float MinSendInterval = FCustomMovementTestAccess::GetHangMinNetSendInterval(*GetDefault<UCustomCharacterMovementComponent>());
+		const double MaxRate = RateMargin / MinSendInterval;
+		TestTrue(FString::Printf(TEXT("Hang ServerMoves/s %.2f with coalescing, at most %.2f"), After.ServerMovesPerSecond, MaxRate),
+			After.ServerMovesPerSecond <= MaxRate);
+		TestTrue(TEXT("Coalescing lowers the hang ServerMove rate"), After.ServerMovesPerSecond < Before.ServerMovesPerSecond);
+
+		TestTrue(FString::Printf(TEXT("Hang corrections %llu with coalescing, at most %llu"), After.Corrections, MaxHangCorrections),
+			After.Corrections <= MaxHangCorrections);
+		for (const MovementNetStress::FClientResult& Client : State->Coalesced->Clients)
+		{
+			TestTrue(FString::Printf(TEXT("Lane %d grabbed a ledge"), Client.Lane), Client.Grabs > 0);
+			TestTrue(FString::Printf(TEXT("Lane %d: %.1f corrections per minute, at most %.1f"), Client.Lane, Client.CorrectionsPerMinute, MaxCorrectionsPerMinute),
+				Client.CorrectionsPerMinute <= MaxCorrectionsPerMinute);
+		}
+		return true;
+	}));
+	return true;
+}
+
+#endif
@@ -0,0 +1,311 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CustomCMCCharacter.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "MovementModeCounters.h"
+#include "Tests/MovementTestWorld.h"
+
+namespace HangProbeTest
+{
+	// Where the lane's blocks are, from the course settings rather than from any query
+	struct FCourseGeometry
+	{
+		FVector LaneStart = FVector::ZeroVector;
+		float WallFace = 0.f;
+		float HalfWallWidth = 0.f;
+		float LedgeHeight = 0.f;
+		FBox WallBox = FBox(ForceInit);
+		FBox FloorBox = FBox(ForceInit);
+
+		explicit FCourseGeometry(const FMovementTestWorld& TestWorld)
+		{
+			const FMovementTestCourse& Course = TestWorld.Course;
+			LaneStart = TestWorld.Starts[0].GetLocation();
+			WallFace = LaneStart.X - 100.f + Course.WallDistance;
+			HalfWallWidth = (Course.LaneWidth - 50.f) * 0.5f;
+			LedgeHeight = Course.LedgeHeight;
+			WallBox = FBox(FVector(WallFace, LaneStart.Y - HalfWallWidth, 0.f), FVector(WallFace + 200.f, LaneStart.Y + HalfWallWidth, LedgeHeight));
+			// One lane, the floor is a single lane sized block 100cm thick
+			FloorBox = FBox(Course.Origin - FVector(0.f, 0.f, 100.f), Course.Origin + FVector(Course.LaneLength, Course.LaneWidth, 0.f));
+		}
+	};
+
+	static bool IsBlock(const UPrimitiveComponent* Component, const FBox& Box)
+	{
+		if (!Component) return false;
+
+		const FBox Bounds = Component->Bounds.GetBox();
+		return Bounds.Min.Equals(Box.Min, 1.f) && Bounds.Max.Equals(Box.Max, 1.f);
+	}
+
+	static void TestExpectedHit(FAutomationTestBase& Test, const FString& What, const FHitResult& Actual, const FBox& Block,
+		const FVector& ImpactPoint, const FVector& ImpactNormal)
+	{
+		if (!Test.TestTrue(What + TEXT(" blocking"), Actual.IsValidBlockingHit())) return;
+
+		Test.TestTrue(What + TEXT(" component"), IsBlock(Actual.GetComponent(), Block));
+		Test.TestEqual(What + TEXT(" impact point"), Actual.ImpactPoint, ImpactPoint, 0.1f);
+		Test.TestEqual(What + TEXT(" impact normal"), Actual.ImpactNormal, ImpactNormal, 1e-3f);
+	}
+
+	// A hit on Block among Hits, facing along Normal when one is given
+	static bool HasBlockHit(TConstArrayView<FHitResult> Hits, const FBox& Block, const FVector& Normal = FVector::ZeroVector)
+	{
+		return Hits.ContainsByPredicate([&Block, &Normal](const FHitResult& Hit)
+		{
+			return IsBlock(Hit.GetComponent(), Block) && (Normal.IsZero() || (Hit.ImpactNormal | Normal) > 0.99f);
+		});
+	}
+
+	static void TestHit(FAutomationTestBase& Test, const FString& What, const FHitResult& Actual, const FHitResult& Expected, float Tolerance)
+	{
+		Test.TestEqual(What + TEXT(" blocking"), Actual.bBlockingHit, Expected.bBlockingHit);
+		if (!Actual.bBlockingHit || !Expected.bBlockingHit) return;
+
+		Test.TestTrue(What + TEXT(" component"), Actual.GetComponent() == Expected.GetComponent());
+		Test.TestEqual(What + TEXT(" start penetrating"), Actual.bStartPenetrating, Expected.bStartPenetrating);
+		Test.TestEqual(What + TEXT(" impact point"), Actual.ImpactPoint, Expected.ImpactPoint, Tolerance);
+		Test.TestEqual(What + TEXT(" impact normal"), Actual.ImpactNormal, Expected.ImpactNormal, 1e-3f);
+	}
+
+	static void TestHits(FAutomationTestBase& Test, const FString& What, TConstArrayView<FHitResult> Actual, TConstArrayView<FHitResult> Expected, float Tolerance)
+	{
+		if (!Test.TestEqual(What + TEXT(" count"), Actual.Num(), Expected.Num())) return;
+
+		for (int32 i = 0; i < Actual.Num(); ++i)
+		{
+			TestHit(Test, FString::Printf(TEXT("%s %d"), *What, i), Actual[i], Expected[i], Tolerance);
+		}
+	}
+
+#if !UE_BUILD_SHIPPING
+	static uint64 CountSceneQueries(const UCustomCharacterMovementComponent& Movement)
+	{
+		uint64 SceneQueries = 0;
+		for (int32 Mode = 0; Mode < static_cast<int32>(FMovementModeCounters::EMode::Num); ++Mode)
+		{
+			SceneQueries += Movement.GetModeCounters().Get(static_cast<FMovementModeCounters::EMode>(Mode)).SceneQueries;
+		}
+		return SceneQueries;
+	}
+#endif
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHangProbeMatchesQueriesTest, "CustomCMC.Movement.HangProbe.MatchesQueries",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHangProbeMatchesQueriesTest::RunTest(const FString& Parameters)
+{
+	FMovementTestWorld TestWorld(1);
+	if (!TestTrue(TEXT("Test world created"), TestWorld.IsValid())) return false;
+
+	// Let the course's collision settle into the scene
+	TestWorld.Tick(1.f / 60.f);
+
+	const UCustomCharacterMovementComponent& Movement = *TestWorld.GetMovement(0);
+	const HangProbeTest::FCourseGeometry Course(TestWorld);
+	const float EyeHeight = Movement.GetCharacterOwner()->BaseEyeHeight;
+	const float CapsuleRadius = FCustomMovementTestAccess::GetCapsuleRadius(Movement);
+	const float ClimbRadius = FCustomMovementTestAccess::GetClimbCapsuleTraceRadius(Movement);
+	const float ClimbHalfHeight = FCustomMovementTestAccess::GetClimbCapsuleTraceHalfHeight(Movement);
+	const float MaxLedgeGrabDistance = FCustomMovementTestAccess::GetMaxLedgeGrabDistance(Movement);
+
+	// Each query's hit is only asserted where the course decides it clearly, samples on a boundary check the rest
+	int32 NumWalls = 0;
+	int32 NumClimbable = 0;
+	int32 NumFloors = 0;
+	FHangProbe Probe;
+	auto CheckSample = [&](const FVector& Location)
+	{
+		// A fresh probe each time, so no sample carries the ledge over from the one before
+		Probe = FHangProbe();
+		FCustomMovementTestAccess::ProbeHang(Movement, Location, FQuat::Identity, Probe);
+		const FString Where = Location.ToCompactString();
+		const float Along = FMath::Abs(Location.Y - Course.LaneStart.Y);
+
+		// Wall trace runs forward from eye height, 30cm ahead of the capsule
+		const float EyeZ = Location.Z + EyeHeight;
+		const float WallDistance = Course.WallFace - (Location.X + 30.f);
+		const bool bFacesWall = Along < Course.HalfWallWidth - 1.f && EyeZ > 1.f && EyeZ < Course.LedgeHeight - 1.f
+			&& WallDistance > 1.f && WallDistance < MaxLedgeGrabDistance - 1.f;
+		const bool bMissesWall = Along > Course.HalfWallWidth + 1.f || EyeZ > Course.LedgeHeight + 1.f || WallDistance > MaxLedgeGrabDistance + 1.f;
+		if (bFacesWall)
+		{
+			HangProbeTest::TestExpectedHit(*this, Where + TEXT(" wall"), Probe.WallHit, Course.WallBox,
+				FVector(Course.WallFace, Location.Y, EyeZ), FVector(-1.f, 0.f, 0.f));
+			// Top trace comes down 20cm past the wall face
+			HangProbeTest::TestExpectedHit(*this, Where + TEXT(" top"), Probe.TopHit, Course.WallBox,
+				FVector(Course.WallFace + 20.f, Location.Y, Course.LedgeHeight), FVector(0.f, 0.f, 1.f));
+			++NumWalls;
+		}
+		else if (bMissesWall)
+		{
+			TestFalse(Where + TEXT(" wall missed"), Probe.WallHit.bBlockingHit);
+			TestFalse(Where + TEXT(" top missed"), Probe.TopHit.bBlockingHit);
+		}
+
+		// Climb capsule pushed into the wall face, well inside its width and height, is pushed straight back out
+		const float ClimbFront = Location.X + 30.f + ClimbRadius;
+		const bool bClimbInWall = ClimbFront > Course.WallFace + 1.f && Along < Course.HalfWallWidth - ClimbRadius - 1.f
+			&& Location.Z - ClimbHalfHeight > 10.f && Location.Z + ClimbHalfHeight < Course.LedgeHeight - 10.f;
+		const bool bClimbClear = ClimbFront < Course.WallFace - 2.f && Location.Z - ClimbHalfHeight > 2.f;
+		if (bClimbInWall)
+		{
+			TestTrue(Where + TEXT(" climbable wall"), HangProbeTest::HasBlockHit(Probe.ClimbableHits, Course.WallBox, FVector(-1.f, 0.f, 0.f)));
+			++NumClimbable;
+		}
+		else if (bClimbClear)
+		{
+			TestTrue(Where + TEXT(" climbable missed"), Probe.ClimbableHits.IsEmpty());
+		}
+
+		// Floor sweep: the climb capsule 50cm below the character, 1cm down
+		const float FloorSweepBottom = Location.Z - 50.f - ClimbHalfHeight - 1.f;
+		if (FloorSweepBottom < -5.f && FloorSweepBottom > -ClimbRadius && Along < Course.HalfWallWidth * 0.5f + 1.f)
+		{
+			TestTrue(Where + TEXT(" floor"), HangProbeTest::HasBlockHit(Probe.FloorHits, Course.FloorBox, FVector(0.f, 0.f, 1.f)));
+			++NumFloors;
+		}
+		else if (FloorSweepBottom > 2.f)
+		{
+			TestFalse(Where + TEXT(" floor missed"), HangProbeTest::HasBlockHit(Probe.FloorHits, Course.FloorBox));
+		}
+	};
+
+	// Against the lane's wall at several heights, along it, near its ends and past them
+	for (const float Gap : { 2.f, 15.f })
+	{
+		for (const float Along : { 0.f, Course.HalfWallWidth * 0.5f, Course.HalfWallWidth - 10.f, Course.HalfWallWidth + 30.f })
+		{
+			for (float Height = 40.f; Height <= Course.LedgeHeight; Height += 30.f)
+			{
+				CheckSample(FVector(Course.WallFace - CapsuleRadius - Gap, Course.LaneStart.Y + Along, Height));
+			}
+		}
+	}
+	// In the open, nothing in reach
+	CheckSample(Course.LaneStart + FVector(0.f, 0.f, 200.f));
+
+	// Otherwise the samples missed the course and the checks above prove nothing
+	TestTrue(TEXT("Some samples faced the wall"), NumWalls > 0);
+	TestTrue(TEXT("Some samples pressed into the wall"), NumClimbable > 0);
+	TestTrue(TEXT("Some samples found the floor"), NumFloors > 0);
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHangProbeCarriedLedgeTest, "CustomCMC.Movement.HangProbe.CarriedLedge",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHangProbeCarriedLedgeTest::RunTest(const FString& Parameters)
+{
+	FMovementTestWorld TestWorld(1);
+	if (!TestTrue(TEXT("Test world created"), TestWorld.IsValid())) return false;
+	TestWorld.Tick(1.f / 60.f);
+
+	UCustomCharacterMovementComponent& Movement = *TestWorld.GetMovement(0);
+	const HangProbeTest::FCourseGeometry Course(TestWorld);
+	const float CarryDistance = FCustomMovementTestAccess::GetHangLedgeCarryDistance(Movement);
+	const FVector Location(Course.WallFace - FCustomMovementTestAccess::GetCapsuleRadius(Movement) - 2.f, Course.LaneStart.Y, Course.LedgeHeight - 60.f);
+	const FQuat Rotation = FQuat::Identity;
+
+	FHangProbe Probe;
+	FCustomMovementTestAccess::ProbeHang(Movement, Location, Rotation, Probe);
+	if (!TestTrue(TEXT("Probe found the ledge"), Probe.TopHit.IsValidBlockingHit() && !Probe.ClimbableHits.IsEmpty())) return false;
+	TestFalse(TEXT("First probe traced the ledge"), Probe.bLedgeCarried);
+
+	// A shimmy along the wall keeps the faces, and they match what tracing from there finds
+	const FVector Shimmied = Location + FVector(0.f, CarryDistance * 0.5f, 0.f);
+#if !UE_BUILD_SHIPPING
+	const uint64 CarriedStart = HangProbeTest::CountSceneQueries(Movement);
+#endif
+	FCustomMovementTestAccess::ProbeHang(Movement, Shimmied, Rotation, Probe);
+#if !UE_BUILD_SHIPPING
+	const uint64 CarriedQueries = HangProbeTest::CountSceneQueries(Movement) - CarriedStart;
+#endif
+	TestTrue(TEXT("Ledge carried along the wall"), Probe.bLedgeCarried);
+
+	FHangProbe Fresh;
+#if !UE_BUILD_SHIPPING
+	const uint64 FreshStart = HangProbeTest::CountSceneQueries(Movement);
+#endif
+	FCustomMovementTestAccess::ProbeHang(Movement, Shimmied, Rotation, Fresh);
+#if !UE_BUILD_SHIPPING
+	const uint64 FreshQueries = HangProbeTest::CountSceneQueries(Movement) - FreshStart;
+	// Climbable and floor sweeps against the wall, floor, climbable, wall and top
+	TestEqual(TEXT("Carried probe only sweeps"), CarriedQueries, static_cast<uint64>(2));
+	TestEqual(TEXT("Fresh probe traces the ledge too"), FreshQueries, static_cast<uint64>(4));
+#endif
+	TestEqual(TEXT("Wall normal"), Probe.WallHit.Normal, Fresh.WallHit.Normal, 1e-3f);
+	TestEqual(TEXT("Top normal"), Probe.TopHit.Normal, Fresh.TopHit.Normal, 1e-3f);
+	TestTrue(TEXT("Same wall"), Probe.WallHit.GetComponent() == Fresh.WallHit.GetComponent());
+	HangProbeTest::TestHits(*this, TEXT("Climbable"), Probe.ClimbableHits, Fresh.ClimbableHits, KINDA_SMALL_NUMBER);
+
+	// Past the carry distance from where the faces were traced they are traced again
+	FCustomMovementTestAccess::ProbeHang(Movement, Location + FVector(0.f, CarryDistance * 1.5f, 0.f), Rotation, Probe);
+	TestFalse(TEXT("Ledge traced again past the carry distance"), Probe.bLedgeCarried);
+
+	// As they are once the wall moves
+	UPrimitiveComponent* Wall = Probe.WallHit.GetComponent();
+	if (TestNotNull(TEXT("Wall component"), Wall))
+	{
+		Wall->SetMobility(EComponentMobility::Movable);
+		Wall->SetWorldLocation(Wall->GetComponentLocation() + FVector(0.f, 0.f, 1.f));
+		FCustomMovementTestAccess::ProbeHang(Movement, Location + FVector(0.f, CarryDistance * 1.6f, 0.f), Rotation, Probe);
+		TestFalse(TEXT("Ledge traced again once the wall moved"), Probe.bLedgeCarried);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FHangProbeReuseTest, "CustomCMC.Movement.HangProbe.Reuse",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FHangProbeReuseTest::RunTest(const FString& Parameters)
+{
+	FMovementTestWorld TestWorld(1);
+	if (!TestTrue(TEXT("Test world created"), TestWorld.IsValid())) return false;
+	TestWorld.Tick(1.f / 60.f);
+
+	UCustomCharacterMovementComponent& Movement = *TestWorld.GetMovement(0);
+	const float ReuseDistance = FCustomMovementTestAccess::GetHangProbeReuseDistance(Movement);
+	const FVector LaneStart = TestWorld.Starts[0].GetLocation();
+	const FVector Location(LaneStart.X - 100.f + TestWorld.Course.WallDistance - FCustomMovementTestAccess::GetCapsuleRadius(Movement) - 2.f,
+		LaneStart.Y, TestWorld.Course.LedgeHeight - 60.f);
+	const FQuat Rotation = FQuat::Identity;
+
+	FHangProbe& Kept = FCustomMovementTestAccess::GetHangProbe(Movement);
+	FCustomMovementTestAccess::ProbeHang(Movement, Location, Rotation, Kept);
+	if (!TestTrue(TEXT("Probe found the ledge"), Kept.TopHit.IsValidBlockingHit() && !Kept.ClimbableHits.IsEmpty())) return false;
+
+	// Within the reuse distance the kept probe must describe the same surfaces a fresh one finds
+	const FVector Moved = Location + FVector(0.f, 1.f, 0.f) * ReuseDistance * 0.5f;
+	TestTrue(TEXT("Probe reused within the reuse distance"), FCustomMovementTestAccess::CanReuseHangProbe(Movement, Moved, Rotation));
+
+	FHangProbe Fresh;
+	FCustomMovementTestAccess::ProbeHang(Movement, Moved, Rotation, Fresh);
+	HangProbeTest::TestHit(*this, TEXT("Wall"), Kept.WallHit, Fresh.WallHit, ReuseDistance);
+	HangProbeTest::TestHit(*this, TEXT("Top"), Kept.TopHit, Fresh.TopHit, ReuseDistance);
+	HangProbeTest::TestHits(*this, TEXT("Climbable"), Kept.ClimbableHits, Fresh.ClimbableHits, ReuseDistance);
+	HangProbeTest::TestHits(*this, TEXT("Floor"), Kept.FloorHits, Fresh.FloorHits, ReuseDistance);
+
+	// Past it, or once anything the probe hit moves, the probe is taken again
+	TestFalse(TEXT("Probe not reused past the reuse distance"),
+		FCustomMovementTestAccess::CanReuseHangProbe(Movement, Location + FVector(0.f, 1.f, 0.f) * ReuseDistance * 2.f, Rotation));
+
+	UPrimitiveComponent* Wall = Kept.WallHit.GetComponent();
+	if (TestNotNull(TEXT("Wall component"), Wall))
+	{
+		Wall->SetMobility(EComponentMobility::Movable);
+		Wall->SetWorldLocation(Wall->GetComponentLocation() + FVector(0.f, 0.f, 1.f));
+		TestFalse(TEXT("Probe not reused once the wall moved"), FCustomMovementTestAccess::CanReuseHangProbe(Movement, Location, Rotation));
+	}
+	return true;
+}
+
+#endif
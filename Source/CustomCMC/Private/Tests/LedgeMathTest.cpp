@@ -0,0 +1,231 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CustomCMCCharacter.h"
+#include "LedgeMath.h"
+#include "Math/RandomStream.h"
+#include "Tests/MovementTestWorld.h"
+
+namespace LedgeMathTest
+{
+	// What the component computed inline before the math moved into FLedgeMath
+	static FVector ReferenceEdgeTangent(const FVector& FirstNormal, const FVector& SecondNormal)
+	{
+		return FVector::CrossProduct(FirstNormal, SecondNormal).GetSafeNormal();
+	}
+
+	static FVector ReferenceLedgeGrabLocation(const FVector& SurfaceLocation, const FVector& WallNormal, const FVector& SurfaceNormal,
+		const FVector& Forward, float CapR, float CapHH)
+	{
+		float CosWallSteepnessAngle = WallNormal | FVector::UpVector;
+		float DownDistance = CapHH * 2.f;
+		FVector EdgeTangent = FVector::CrossProduct(SurfaceNormal, WallNormal).GetSafeNormal();
+
+		FVector LedgeGrabStart = SurfaceLocation;
+		LedgeGrabStart += WallNormal.GetSafeNormal2D() * (2.f + CapR);
+		LedgeGrabStart += Forward.GetSafeNormal2D().ProjectOnTo(EdgeTangent) * CapR * .3f;
+		LedgeGrabStart += FVector::UpVector * CapHH;
+		LedgeGrabStart += FVector::DownVector * DownDistance;
+		LedgeGrabStart += WallNormal.GetSafeNormal2D() * CosWallSteepnessAngle * DownDistance;
+		return LedgeGrabStart;
+	}
+
+	static FQuat ReferenceClimbRotation(const FQuat& CurrentQuat, const FVector& SurfaceNormal, float DeltaTime)
+	{
+		const FQuat TargetQuat = FRotationMatrix::MakeFromX(-SurfaceNormal).ToQuat();
+		return FMath::QInterpTo(CurrentQuat, TargetQuat, DeltaTime, 5.f);
+	}
+
+	static void ReferenceAverageSurfaces(TConstArrayView<FHitResult> Hits, FVector& OutLocation, FVector& OutNormal)
+	{
+		OutLocation = FVector::ZeroVector;
+		OutNormal = FVector::ZeroVector;
+		if (Hits.IsEmpty()) return;
+
+		for (const FHitResult& Hit : Hits)
+		{
+			OutLocation += Hit.ImpactPoint;
+			OutNormal += Hit.ImpactNormal;
+		}
+		OutLocation /= Hits.Num();
+		OutNormal = OutNormal.GetSafeNormal();
+	}
+
+	// Walls lean at most 30 degrees off vertical and tops at most 30 off flat, every 64th pair is degenerate
+	struct FSurfaces
+	{
+		TArray<FVector> WallNormals;
+		TArray<FVector> TopNormals;
+		TArray<FVector> Locations;
+		TArray<FVector> Forwards;
+
+		FSurfaces(int32 Num, int32 Seed)
+		{
+			FRandomStream Random(Seed);
+			for (int32 i = 0; i < Num; ++i)
+			{
+				const FVector Wall = (Random.GetUnitVector() * FVector(1, 1, 0.5)).GetSafeNormal();
+				WallNormals.Add(Wall);
+				TopNormals.Add(i % 64 == 0 ? Wall : (FVector::UpVector + Random.GetUnitVector() * 0.5).GetSafeNormal());
+				Locations.Add(Random.GetUnitVector() * Random.FRandRange(0.f, 10000.f));
+				Forwards.Add(-Wall + Random.GetUnitVector() * 0.3);
+			}
+		}
+	};
+
+	static FHitResult MakeHit(const FVector& Location, const FVector& Normal)
+	{
+		FHitResult Hit;
+		Hit.bBlockingHit = true;
+		Hit.Location = Hit.ImpactPoint = Location;
+		Hit.Normal = Hit.ImpactNormal = Normal;
+		return Hit;
+	}
+
+	template<typename FuncType>
+	static double NanosecondsPerOp(int32 NumOps, int32 Repeats, FuncType&& Func)
+	{
+		const double Start = FPlatformTime::Seconds();
+		for (int32 i = 0; i < Repeats; ++i)
+		{
+			Func();
+		}
+		return (FPlatformTime::Seconds() - Start) * 1e9 / (double(NumOps) * Repeats);
+	}
+
+	// Locations are up to 10 m out, so this is rounding and not a changed formula
+	static constexpr float LocationTolerance = 1e-3f;
+	static constexpr float DirectionTolerance = 1e-5f;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLedgeMathMatchesComponentTest, "CustomCMC.LedgeMath.MatchesComponent",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FLedgeMathMatchesComponentTest::RunTest(const FString& Parameters)
+{
+	FMovementTestWorld TestWorld(1);
+	if (!TestTrue(TEXT("Test world created"), TestWorld.IsValid())) return false;
+	TestWorld.Tick(1.f / 60.f);
+
+	ACustomCMCCharacter* Character = TestWorld.Characters[0];
+	UCustomCharacterMovementComponent& Movement = *TestWorld.GetMovement(0);
+	const float CapR = FCustomMovementTestAccess::GetCapsuleRadius(Movement);
+	const float CapHH = FCustomMovementTestAccess::GetCapsuleHalfHeight(Movement);
+
+	const LedgeMathTest::FSurfaces Surfaces(256, 1234);
+	for (int32 i = 0; i < Surfaces.WallNormals.Num(); ++i)
+	{
+		const FVector& Wall = Surfaces.WallNormals[i];
+		const FVector& Top = Surfaces.TopNormals[i];
+		const FVector& Location = Surfaces.Locations[i];
+		const FString What = FString::Printf(TEXT("Pair %d"), i);
+
+		// The grab locations read the character's facing, turn it the way the pair's forward points
+		Character->SetActorRotation(Surfaces.Forwards[i].Rotation(), ETeleportType::TeleportPhysics);
+		const FVector Forward = Character->GetActorForwardVector();
+		const FHitResult FrontHit = LedgeMathTest::MakeHit(Location, Wall);
+		const FHitResult SurfaceHit = LedgeMathTest::MakeHit(Location, Top);
+		const FVector Expected = LedgeMathTest::ReferenceLedgeGrabLocation(Location, Wall, Top, Forward, CapR, CapHH);
+		TestEqual(What + TEXT(" grab start location"), FCustomMovementTestAccess::GetLedgeGrabStartLocation(Movement, FrontHit, SurfaceHit),
+			Expected, LedgeMathTest::LocationTolerance);
+		TestEqual(What + TEXT(" grab current location"), FCustomMovementTestAccess::GetLedgeGrabCurrentLocation(Movement, FrontHit, SurfaceHit),
+			Expected, LedgeMathTest::LocationTolerance);
+
+		// TryLedgeGrab crosses (top, wall) and PhysHang (wall, top)
+		TestEqual(What + TEXT(" grab tangent"), FLedgeMath::GetEdgeTangent(Top, Wall), LedgeMathTest::ReferenceEdgeTangent(Top, Wall),
+			LedgeMathTest::DirectionTolerance);
+		TestEqual(What + TEXT(" hang tangent"), FLedgeMath::GetEdgeTangent(Wall, Top), LedgeMathTest::ReferenceEdgeTangent(Wall, Top),
+			LedgeMathTest::DirectionTolerance);
+
+		const FQuat CurrentQuat = Character->GetActorQuat();
+		const FQuat ExpectedRotation = LedgeMathTest::ReferenceClimbRotation(CurrentQuat, Wall, 1.f / 60.f);
+		const FQuat Rotation = FCustomMovementTestAccess::GetClimbRotation(Movement, Wall, 1.f / 60.f);
+		TestTrue(What + TEXT(" climb rotation"), Rotation.Equals(ExpectedRotation, LedgeMathTest::DirectionTolerance));
+	}
+
+	// Climbable surface averaging over every hit count the probe keeps, and none
+	for (int32 NumHits = 0; NumHits <= MaxHangProbeHits; ++NumHits)
+	{
+		TArray<FHitResult> Hits;
+		for (int32 i = 0; i < NumHits; ++i)
+		{
+			Hits.Add(LedgeMathTest::MakeHit(Surfaces.Locations[i], Surfaces.WallNormals[i]));
+		}
+
+		FVector ExpectedLocation, ExpectedNormal, Location, Normal;
+		LedgeMathTest::ReferenceAverageSurfaces(Hits, ExpectedLocation, ExpectedNormal);
+		FCustomMovementTestAccess::ProcessClimbableSurfaceInfo(Movement, Hits, Location, Normal);
+		TestEqual(FString::Printf(TEXT("%d hits average location"), NumHits), Location, ExpectedLocation, LedgeMathTest::LocationTolerance);
+		TestEqual(FString::Printf(TEXT("%d hits average normal"), NumHits), Normal, ExpectedNormal, LedgeMathTest::DirectionTolerance);
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLedgeMathBatchTest, "CustomCMC.LedgeMath.Batch",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FLedgeMathBatchTest::RunTest(const FString& Parameters)
+{
+	const LedgeMathTest::FSurfaces Surfaces(4096, 1234);
+	const int32 Num = Surfaces.WallNormals.Num();
+
+	TArray<FVector> ScalarTangents, VectorTangents;
+	ScalarTangents.SetNumZeroed(Num);
+	VectorTangents.SetNumZeroed(Num);
+	FLedgeMath::GetEdgeTangents(Surfaces.TopNormals, Surfaces.WallNormals, ScalarTangents);
+	FLedgeMath::GetEdgeTangentsVectorized(Surfaces.TopNormals, Surfaces.WallNormals, VectorTangents);
+
+	for (int32 i = 0; i < Num; ++i)
+	{
+		const FVector Expected = LedgeMathTest::ReferenceEdgeTangent(Surfaces.TopNormals[i], Surfaces.WallNormals[i]);
+		TestEqual(FString::Printf(TEXT("Pair %d scalar tangent"), i), ScalarTangents[i], Expected, LedgeMathTest::DirectionTolerance);
+		TestEqual(FString::Printf(TEXT("Pair %d vectorized tangent"), i), VectorTangents[i], Expected, LedgeMathTest::DirectionTolerance);
+	}
+	TestTrue(TEXT("Degenerate pair gives a zero tangent"), VectorTangents[0].IsZero() && ScalarTangents[0].IsZero());
+
+	// Summed in the same order, the vectorized average is exact
+	FVector ScalarLocation, ScalarNormal, VectorLocation, VectorNormal;
+	FLedgeMath::AverageSurfaces(Surfaces.Locations, Surfaces.WallNormals, ScalarLocation, ScalarNormal);
+	FLedgeMath::AverageSurfacesVectorized(Surfaces.Locations, Surfaces.WallNormals, VectorLocation, VectorNormal);
+	TestEqual(TEXT("Vectorized average location"), VectorLocation, ScalarLocation, 0.f);
+	TestEqual(TEXT("Vectorized average normal"), VectorNormal, ScalarNormal, 0.f);
+
+	FLedgeMath::AverageSurfacesVectorized({}, {}, VectorLocation, VectorNormal);
+	TestTrue(TEXT("Empty average is zero"), VectorLocation.IsZero() && VectorNormal.IsZero());
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FLedgeMathPerfTest, "CustomCMC.LedgeMath.Perf",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::PerfFilter)
+
+bool FLedgeMathPerfTest::RunTest(const FString& Parameters)
+{
+	constexpr int32 Num = 4096;
+	constexpr int32 Repeats = 100;
+	const LedgeMathTest::FSurfaces Surfaces(Num, 1234);
+
+	TArray<FVector> Tangents;
+	Tangents.SetNumZeroed(Num);
+	const double ScalarTangentNs = LedgeMathTest::NanosecondsPerOp(Num, Repeats, [&] { FLedgeMath::GetEdgeTangents(Surfaces.TopNormals, Surfaces.WallNormals, Tangents); });
+	const double VectorTangentNs = LedgeMathTest::NanosecondsPerOp(Num, Repeats, [&] { FLedgeMath::GetEdgeTangentsVectorized(Surfaces.TopNormals, Surfaces.WallNormals, Tangents); });
+
+	FVector Location, Normal;
+	const double ScalarAverageNs = LedgeMathTest::NanosecondsPerOp(Num, Repeats, [&] { FLedgeMath::AverageSurfaces(Surfaces.Locations, Surfaces.WallNormals, Location, Normal); });
+	const double VectorAverageNs = LedgeMathTest::NanosecondsPerOp(Num, Repeats, [&] { FLedgeMath::AverageSurfacesVectorized(Surfaces.Locations, Surfaces.WallNormals, Location, Normal); });
+
+	AddInfo(FString::Printf(TEXT("EdgeTangents     scalar %.2f ns/op  vectorized %.2f ns/op"), ScalarTangentNs, VectorTangentNs));
+	AddInfo(FString::Printf(TEXT("AverageSurfaces  scalar %.2f ns/op  vectorized %.2f ns/op"), ScalarAverageNs, VectorAverageNs));
+
+	// The vectorized variants exist to be faster, allow for timer noise but fail a clear regression
+	constexpr double MaxSlowdown = 1.5;
+	TestTrue(TEXT("Vectorized edge tangents not slower than scalar"), VectorTangentNs <= ScalarTangentNs * MaxSlowdown);
+	TestTrue(TEXT("Vectorized surface averaging not slower than scalar"), VectorAverageNs <= ScalarAverageNs * MaxSlowdown);
+	return true;
+}
+
+#endif
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_EDITOR
+
+#include "Editor.h"
+#include "MovementNetStress.h"
+#include "Algo/Find.h"
+
+namespace MovementNetStressTest
+{
+	// The gate for movement and net changes, one entry per emulation profile. These are limits a change must stay
+	// under, not measurements: tighten them to a margin over the numbers the run reports on the build machine
+	struct FThresholds
+	{
+		const TCHAR* Profile;
+		double MaxCorrectionsPerMinute;
+		double MaxServerMsPerClient;
+	};
+
+	static const FThresholds Thresholds[] =
+	{
+		{ TEXT("Off"), 6.0, 1.0 },
+		{ TEXT("Average"), 12.0, 1.0 },
+		{ TEXT("Bad"), 30.0, 1.0 },
+	};
+
+	static constexpr int32 NumClients = 4;
+	static constexpr float WarmupSeconds = 5.f;
+	static constexpr float MeasureSeconds = 20.f;
+}
+
+IMPLEMENT_COMPLEX_AUTOMATION_TEST(FMovementNetStressTest, "CustomCMC.Net.Stress",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::StressFilter)
+
+void FMovementNetStressTest::GetTests(TArray<FString>& OutBeautifiedNames, TArray<FString>& OutTestCommands) const
+{
+	for (const MovementNetStressTest::FThresholds& Threshold : MovementNetStressTest::Thresholds)
+	{
+		OutBeautifiedNames.Add(Threshold.Profile);
+		OutTestCommands.Add(Threshold.Profile);
+	}
+}
+
+bool FMovementNetStressTest::RunTest(const FString& Parameters)
+{
+	using namespace MovementNetStressTest;
+
+	const FThresholds* Threshold = Algo::FindByPredicate(Thresholds, [&Parameters](const FThresholds& Candidate) { return Parameters == Candidate.Profile; });
+	if (!TestNotNull(TEXT("Thresholds for the profile"), Threshold)) return false;
+	if (!TestTrue(TEXT("Editor with no play session in progress"), GEditor && !GEditor->IsPlaySessionInProgress())) return false;
+
+	const TSharedRef<MovementNetStress::FStressRun> Run = MakeShared<MovementNetStress::FStressRun>(FString::Printf(
+		TEXT("Profiles=%s Clients=%d WarmupSeconds=%.0f Duration=%.0f"), Threshold->Profile, NumClients, WarmupSeconds, MeasureSeconds));
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, Run, Threshold]()
+	{
+		if (!Run->IsFinished()) return false;
+
+		const TArray<MovementNetStress::FRunResult>& Results = Run->GetResults();
+		if (!TestEqual(TEXT("Profiles run"), Results.Num(), 1)) return true;
+
+		const MovementNetStress::FRunResult& Result = Results[0];
+		if (!TestTrue(TEXT("Run completed"), Result.bCompleted)) return true;
+		TestEqual(TEXT("Clients measured"), Result.Clients.Num(), NumClients);
+
+		AddInfo(FString::Printf(TEXT("Server %.3f ms per client"), Result.ServerMsPerClient));
+		TestTrue(FString::Printf(TEXT("Server %.3f ms per client, at most %.3f"), Result.ServerMsPerClient, Threshold->MaxServerMsPerClient),
+			Result.ServerMsPerClient <= Threshold->MaxServerMsPerClient);
+
+		for (const MovementNetStress::FClientResult& Client : Result.Clients)
+		{
+			AddInfo(FString::Printf(TEXT("Lane %d: %.1f corrections per minute, in %.0f B/s, out %.0f B/s, %u grabs"),
+				Client.Lane, Client.CorrectionsPerMinute, Client.InBytesPerSecond, Client.OutBytesPerSecond, Client.Grabs));
+
+			// Otherwise the bot never got through the script and the other numbers prove nothing
+			TestTrue(FString::Printf(TEXT("Lane %d grabbed a ledge"), Client.Lane), Client.Grabs > 0);
+			TestTrue(FString::Printf(TEXT("Lane %d: %.1f corrections per minute, at most %.1f"), Client.Lane, Client.CorrectionsPerMinute, Threshold->MaxCorrectionsPerMinute),
+				Client.CorrectionsPerMinute <= Threshold->MaxCorrectionsPerMinute);
+		}
+		return true;
+	}));
+	return true;
+}
+
+#endif
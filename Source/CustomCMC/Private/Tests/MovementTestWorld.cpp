@@ -0,0 +1,105 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "Tests/MovementTestWorld.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "AIController.h"
+#include "CustomCMCCharacter.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/GameModeBase.h"
+
+// ACustomCMCCharacter is abstract, the blueprint carries the mesh, anim blueprint and montages
+static const TCHAR* MovementTestCharacterClass = TEXT("/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter.BP_ThirdPersonCharacter_C");
+
+FMovementTestWorld::FMovementTestWorld(int32 NumCharacters, const FMovementTestCourse& InCourse)
+	: Course(InCourse)
+	, NumRequested(NumCharacters)
+{
+	const TSubclassOf<ACustomCMCCharacter> CharacterClass = LoadClass<ACustomCMCCharacter>(nullptr, MovementTestCharacterClass);
+	if (!CharacterClass) return;
+
+	// Bare game world with the engine game mode, so nothing project specific spawns
+	World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("MovementTest"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	const FURL URL(TEXT("?game=/Script/Engine.GameModeBase"));
+	World->SetGameMode(URL);
+	World->InitializeActorsForPlay(URL);
+	World->BeginPlay();
+
+	Course.Build(World, NumCharacters, Starts);
+
+	for (const FTransform& Start : Starts)
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		ACustomCMCCharacter* Character = World->SpawnActor<ACustomCMCCharacter>(CharacterClass, Start, SpawnParams);
+		if (!Character) continue;
+
+		AAIController* Controller = World->SpawnActor<AAIController>();
+		Controller->Possess(Character);
+		Controller->SetControlRotation(Start.Rotator());
+		Characters.Add(Character);
+	}
+}
+
+FMovementTestWorld::~FMovementTestWorld()
+{
+	if (!World) return;
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+	CollectGarbage(RF_NoFlags);
+}
+
+void FMovementTestWorld::Tick(float DeltaTime)
+{
+	++GFrameCounter;
+	World->Tick(LEVELTICK_All, DeltaTime);
+}
+
+FScopedAllocationCounter::FScopedAllocationCounter()
+	: Inner(GMalloc)
+{
+	GMalloc = this;
+}
+
+FScopedAllocationCounter::~FScopedAllocationCounter()
+{
+	GMalloc = Inner;
+}
+
+void* FScopedAllocationCounter::Malloc(SIZE_T Size, uint32 Alignment)
+{
+	if (IsInGameThread())
+	{
+		++NumAllocations;
+	}
+	return Inner->Malloc(Size, Alignment);
+}
+
+void* FScopedAllocationCounter::Realloc(void* Original, SIZE_T Size, uint32 Alignment)
+{
+	// Shrinking to nothing is a free, anything else may move the block
+	if (Size && IsInGameThread())
+	{
+		++NumAllocations;
+	}
+	return Inner->Realloc(Original, Size, Alignment);
+}
+
+void FScopedAllocationCounter::Free(void* Original)
+{
+	Inner->Free(Original);
+}
+
+UCustomCharacterMovementComponent* FMovementTestWorld::GetMovement(int32 Index) const
+{
+	return Characters.IsValidIndex(Index) ? Characters[Index]->GetCustomMovementComponent() : nullptr;
+}
+
+#endif
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CustomCharacterMovementComponent.h"
+#include "MovementTestCourse.h"
+#include "HAL/MemoryBase.h"
+#include <atomic>
+
+class ACustomCMCCharacter;
+class UWorld;
+
+/**
+ * Game world with the movement test course and one AI possessed character per lane, for automation tests that
+ * tick movement themselves. Destroying this destroys the world
+ */
+struct FMovementTestWorld
+{
+	explicit FMovementTestWorld(int32 NumCharacters, const FMovementTestCourse& InCourse = FMovementTestCourse());
+	~FMovementTestWorld();
+
+	FMovementTestWorld(const FMovementTestWorld&) = delete;
+	FMovementTestWorld& operator=(const FMovementTestWorld&) = delete;
+
+	// False when the character blueprint could not be loaded or not every character spawned
+	bool IsValid() const { return World && Characters.Num() == NumRequested; }
+
+	// Advances the frame counter batched probes are matched on, then ticks the world
+	void Tick(float DeltaTime);
+
+	UCustomCharacterMovementComponent* GetMovement(int32 Index) const;
+
+	UWorld* World = nullptr;
+	FMovementTestCourse Course;
+	TArray<FTransform> Starts;
+	TArray<ACustomCMCCharacter*> Characters;
+	int32 NumRequested = 0;
+};
+
+/**
+ * Counts the heap allocations the game thread makes while in scope, by standing in for GMalloc and passing
+ * every call on to the allocator it replaced
+ */
+class FScopedAllocationCounter final : public FMalloc
+{
+public:
+	FScopedAllocationCounter();
+	virtual ~FScopedAllocationCounter() override;
+
+	uint64 GetNumAllocations() const { return NumAllocations; }
+	void ResetCount() { NumAllocations = 0; }
+
+	virtual void* Malloc(SIZE_T Size, uint32 Alignment) override;
+	virtual void* Realloc(void* Original, SIZE_T Size, uint32 Alignment) override;
+	virtual void Free(void* Original) override;
+	virtual SIZE_T QuantizeSize(SIZE_T Size, uint32 Alignment) override { return Inner->QuantizeSize(Size, Alignment); }
+	virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+	virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+	virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+	virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+	virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+	virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+private:
+	FMalloc* Inner = nullptr;
+	std::atomic<uint64> NumAllocations{0};
+};
+
+/**
+ * Reaches UCustomCharacterMovementComponent internals for the tests, it is a friend of the component
+ */
+struct FCustomMovementTestAccess
+{
+	// ProbeHang and the floor sweep PhysHang runs on demand, with the params PhysHang uses
+	static void ProbeHang(const UCustomCharacterMovementComponent& Movement, const FVector& Location, const FQuat& Rotation, FHangProbe& Out)
+	{
+		const FCollisionQueryParams& Params = Movement.CustomCharacterOwner->GetIgnoreCharacterParams();
+		Movement.ProbeHang(Location, Rotation, Params, Movement.ClimbableQueryParams, Out);
+		Movement.ProbeHangFloor(Movement.ClimbableQueryParams, Out);
+	}
+
+	static void SweepClimbable(const UCustomCharacterMovementComponent& Movement, const FVector& Start, const FVector& End, FHangProbeHits& OutHits)
+	{
+		Movement.DoCapsuleTraceMultiByObject(Start, End, Movement.ClimbableQueryParams, OutHits);
+	}
+
+	static void PhysHang(UCustomCharacterMovementComponent& Movement, float DeltaTime) { Movement.PhysHang(DeltaTime, 0); }
+
+	static FHangProbe& GetHangProbe(UCustomCharacterMovementComponent& Movement) { return Movement.HangProbe; }
+	static bool CanReuseHangProbe(const UCustomCharacterMovementComponent& Movement, const FVector& Location, const FQuat& Rotation)
+	{
+		return Movement.CanReuseHangProbe(Location, Rotation);
+	}
+
+	// A client prediction data of the component's own type, owned by the caller
+	static TUniquePtr<FNetworkPredictionData_Client_Character> MakeClientPredictionData(const UCustomCharacterMovementComponent& Movement)
+	{
+		return MakeUnique<UCustomCharacterMovementComponent::FNetworkPredictionData_Client_Custom>(Movement);
+	}
+
+	// The component's ledge math, so the tests run the shipped code path and not a copy of it
+	static FVector GetLedgeGrabStartLocation(const UCustomCharacterMovementComponent& Movement, const FHitResult& FrontHit, const FHitResult& SurfaceHit)
+	{
+		return Movement.GetLedgeGrabStartLocation(FrontHit, SurfaceHit);
+	}
+	static FVector GetLedgeGrabCurrentLocation(const UCustomCharacterMovementComponent& Movement, const FHitResult& FrontHit, const FHitResult& SurfaceHit)
+	{
+		return Movement.GetLedgeGrabCurrentLocation(FrontHit, SurfaceHit);
+	}
+	static FQuat GetClimbRotation(UCustomCharacterMovementComponent& Movement, const FVector& SurfaceNormal, float DeltaTime)
+	{
+		Movement.CurrentClimbableSurfaceNormal = SurfaceNormal;
+		return Movement.GetClimbRotation(DeltaTime);
+	}
+	static void ProcessClimbableSurfaceInfo(UCustomCharacterMovementComponent& Movement, TConstArrayView<FHitResult> Hits, FVector& OutLocation, FVector& OutNormal)
+	{
+		Movement.HangProbe.ClimbableHits.Reset();
+		Movement.HangProbe.ClimbableHits.Append(Hits.GetData(), Hits.Num());
+		Movement.ProcessClimbableSurfaceInfo();
+		OutLocation = Movement.CurrentClimbableSurfaceLocation;
+		OutNormal = Movement.CurrentClimbableSurfaceNormal;
+	}
+
+	static float GetMaxLedgeGrabDistance(const UCustomCharacterMovementComponent& Movement) { return Movement.MaxLedgeGrabDistance; }
+	static float GetHangProbeReuseDistance(const UCustomCharacterMovementComponent& Movement) { return Movement.HangProbeReuseDistance; }
+	static float GetHangLedgeCarryDistance(const UCustomCharacterMovementComponent& Movement) { return Movement.HangLedgeCarryDistance; }
+	static float GetClimbCapsuleTraceRadius(const UCustomCharacterMovementComponent& Movement) { return Movement.ClimbCapsuleTraceRadius; }
+	static float GetClimbCapsuleTraceHalfHeight(const UCustomCharacterMovementComponent& Movement) { return Movement.ClimbCapsuleTraceHalfHeight; }
+	static float GetHangMinNetSendInterval(const UCustomCharacterMovementComponent& Movement) { return Movement.HangMinNetSendInterval; }
+	static float GetCapsuleHalfHeight(const UCustomCharacterMovementComponent& Movement) { return Movement.CapHH(); }
+	static float GetCapsuleRadius(const UCustomCharacterMovementComponent& Movement) { return Movement.CapR(); }
+};
+
+#endif
@@ -0,0 +1,69 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CustomCMCCharacter.h"
+#include "Tests/MovementTestWorld.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPhysHangAllocationTest, "CustomCMC.Movement.PhysHang.NoAllocations",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPhysHangAllocationTest::RunTest(const FString& Parameters)
+{
+	FMovementTestWorld TestWorld(1);
+	if (!TestTrue(TEXT("Test world created"), TestWorld.IsValid())) return false;
+
+	constexpr float DeltaTime = 1.f / 60.f;
+	TestWorld.Tick(DeltaTime);
+
+	// Hang from the middle of the lane's wall, facing it
+	ACustomCMCCharacter* Character = TestWorld.Characters[0];
+	UCustomCharacterMovementComponent& Movement = *TestWorld.GetMovement(0);
+	const FVector LaneStart = TestWorld.Starts[0].GetLocation();
+	const FVector HangLocation(LaneStart.X - 100.f + TestWorld.Course.WallDistance - FCustomMovementTestAccess::GetCapsuleRadius(Movement) - 2.f,
+		LaneStart.Y, TestWorld.Course.LedgeHeight - 60.f);
+	Character->SetActorLocationAndRotation(HangLocation, FRotator::ZeroRotator, false, nullptr, ETeleportType::TeleportPhysics);
+	Movement.Velocity = FVector::ZeroVector;
+	Movement.SetMovementMode(MOVE_Custom, CMOVE_Hang);
+
+	// Warm up through the normal tick, every buffer reaches the size it keeps
+	for (int32 Frame = 0; Frame < 30; ++Frame)
+	{
+		TestWorld.Tick(DeltaTime);
+	}
+	if (!TestTrue(TEXT("Character is hanging after warm up"), Movement.IsHanging())) return false;
+
+	FHangProbe& Probe = FCustomMovementTestAccess::GetHangProbe(Movement);
+	uint64 ReusedAllocations = 0;
+	uint64 FreshAllocations = 0;
+	{
+		FScopedAllocationCounter Counter;
+
+		// Standing still, the probe is reused
+		for (int32 Tick = 0; Tick < 10; ++Tick)
+		{
+			FCustomMovementTestAccess::PhysHang(Movement, DeltaTime);
+		}
+		ReusedAllocations = Counter.GetNumAllocations();
+
+		// Probe taken again every tick
+		Counter.ResetCount();
+		for (int32 Tick = 0; Tick < 10; ++Tick)
+		{
+			Probe.bValid = false;
+			FCustomMovementTestAccess::PhysHang(Movement, DeltaTime);
+		}
+		FreshAllocations = Counter.GetNumAllocations();
+	}
+
+	TestTrue(TEXT("Still hanging"), Movement.IsHanging());
+	TestEqual(TEXT("Allocations over 10 PhysHang ticks reusing the probe"), ReusedAllocations, uint64(0));
+	TestEqual(TEXT("Allocations over 10 PhysHang ticks taking a fresh probe"), FreshAllocations, uint64(0));
+	return true;
+}
+
+#endif
@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "CustomCMCCharacter.h"
+#include "Tests/MovementTestWorld.h"
+
+namespace PhysHangTickRateTest
+{
+	// Same defaults as the benchmark commandlet's -Trajectory run
+	static constexpr float PositionTolerance = 2.f;
+	static constexpr float VelocityTolerance = 10.f;
+	static constexpr float ShimmySeconds = 1.f;
+
+	struct FHangResult
+	{
+		bool bHanging = false;
+		FVector Location = FVector::ZeroVector;
+		FVector Velocity = FVector::ZeroVector;
+	};
+
+	// Hangs from the middle of the lane's wall and shimmies along it at TickRate
+	static bool RunShimmy(FAutomationTestBase& Test, float TickRate, FHangResult& OutResult)
+	{
+		FMovementTestWorld TestWorld(1);
+		if (!Test.TestTrue(TEXT("Test world created"), TestWorld.IsValid())) return false;
+		TestWorld.Tick(1.f / 60.f);
+
+		ACustomCMCCharacter* Character = TestWorld.Characters[0];
+		UCustomCharacterMovementComponent& Movement = *TestWorld.GetMovement(0);
+		const FVector LaneStart = TestWorld.Starts[0].GetLocation();
+		const FVector HangLocation(LaneStart.X - 100.f + TestWorld.Course.WallDistance - FCustomMovementTestAccess::GetCapsuleRadius(Movement) - 2.f,
+			LaneStart.Y, TestWorld.Course.LedgeHeight - 60.f);
+		Character->SetActorLocationAndRotation(HangLocation, FRotator::ZeroRotator, false, nullptr, ETeleportType::TeleportPhysics);
+		Movement.Velocity = FVector::ZeroVector;
+		Movement.SetMovementMode(MOVE_Custom, CMOVE_Hang);
+
+		// Along the wall, which runs along Y. Not the ledge tangent, which PhysHang only finds on its first tick
+		const int32 NumTicks = FMath::RoundToInt32(ShimmySeconds * TickRate);
+		for (int32 Tick = 0; Tick < NumTicks; ++Tick)
+		{
+			Character->AddMovementInput(FVector::RightVector, 1.f);
+			TestWorld.Tick(1.f / TickRate);
+		}
+
+		OutResult.bHanging = Movement.IsHanging();
+		OutResult.Location = Character->GetActorLocation();
+		OutResult.Velocity = Movement.Velocity;
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPhysHangTickRateTest, "CustomCMC.Movement.PhysHang.TickRates",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPhysHangTickRateTest::RunTest(const FString& Parameters)
+{
+	using namespace PhysHangTickRateTest;
+
+	// The last rate is the reference
+	const float TickRates[] = { 30.f, 60.f, 120.f };
+	FHangResult Results[UE_ARRAY_COUNT(TickRates)];
+	for (int32 Rate = 0; Rate < UE_ARRAY_COUNT(TickRates); ++Rate)
+	{
+		if (!RunShimmy(*this, TickRates[Rate], Results[Rate])) return false;
+		TestTrue(FString::Printf(TEXT("Still hanging at %.0f Hz"), TickRates[Rate]), Results[Rate].bHanging);
+	}
+
+	const FHangResult& Reference = Results[UE_ARRAY_COUNT(TickRates) - 1];
+	// Otherwise nothing moved and the comparisons prove nothing
+	TestTrue(TEXT("Shimmied along the wall"), FMath::Abs(Reference.Velocity.Y) > VelocityTolerance);
+
+	for (int32 Rate = 0; Rate < UE_ARRAY_COUNT(TickRates) - 1; ++Rate)
+	{
+		const FHangResult& Result = Results[Rate];
+		AddInfo(FString::Printf(TEXT("%.0f Hz ends %.2f cm and %.2f cm/s from %.0f Hz"), TickRates[Rate],
+			FVector::Dist(Result.Location, Reference.Location), FVector::Dist(Result.Velocity, Reference.Velocity), TickRates[UE_ARRAY_COUNT(TickRates) - 1]));
+		TestEqual(FString::Printf(TEXT("End position at %.0f Hz"), TickRates[Rate]), Result.Location, Reference.Location, PositionTolerance);
+		TestEqual(FString::Printf(TEXT("End velocity at %.0f Hz"), TickRates[Rate]), Result.Velocity, Reference.Velocity, VelocityTolerance);
+	}
+	return true;
+}
+
+#endif
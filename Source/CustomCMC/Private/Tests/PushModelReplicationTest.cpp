@@ -0,0 +1,82 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_EDITOR
+
+#include "Editor.h"
+#include "MovementNetStress.h"
+
+namespace PushModelReplicationTest
+{
+	// Push model must not make replication slower, not a measurement: the run's own log and CSV carry the numbers
+	static constexpr double CostMargin = 1.1;
+
+	static constexpr int32 NumClients = 16;
+	static const TCHAR* RunParams = TEXT("Profiles=Off WarmupSeconds=5 Duration=20 RepGraph=1");
+
+	// One stress run with push model off, then one with it on
+	struct FState
+	{
+		TUniquePtr<MovementNetStress::FStressRun> Run;
+		TOptional<MovementNetStress::FRunResult> Compared;
+		TOptional<MovementNetStress::FRunResult> Pushed;
+	};
+
+	static TUniquePtr<MovementNetStress::FStressRun> StartRun(bool bPushModel)
+	{
+		return MakeUnique<MovementNetStress::FStressRun>(FString::Printf(TEXT("%s Clients=%d PushModel=%d"),
+			RunParams, NumClients, bPushModel ? 1 : 0));
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPushModelReplicationTest, "CustomCMC.Net.PushModel",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::StressFilter)
+
+bool FPushModelReplicationTest::RunTest(const FString& Parameters)
+{
+	using namespace PushModelReplicationTest;
+
+	if (!TestTrue(TEXT("Editor with no play session in progress"), GEditor && !GEditor->IsPlaySessionInProgress())) return false;
+
+	const TSharedRef<FState> State = MakeShared<FState>();
+	State->Run = StartRun(false);
+
+	ADD_LATENT_AUTOMATION_COMMAND(FFunctionLatentCommand([this, State]()
+	{
+		if (!State->Run->IsFinished()) return false;
+
+		const TArray<MovementNetStress::FRunResult>& Results = State->Run->GetResults();
+		TOptional<MovementNetStress::FRunResult>& Slot = State->Compared.IsSet() ? State->Pushed : State->Compared;
+		if (Results.Num() == 1)
+		{
+			Slot = Results[0];
+		}
+		State->Run.Reset();
+
+		if (!State->Pushed.IsSet() && State->Compared.IsSet() && State->Compared->bCompleted)
+		{
+			State->Run = StartRun(true);
+			return false;
+		}
+
+		if (!TestTrue(TEXT("Run without push model completed"), State->Compared.IsSet() && State->Compared->bCompleted)) return true;
+		if (!TestTrue(TEXT("Run with push model completed"), State->Pushed.IsSet() && State->Pushed->bCompleted)) return true;
+		TestTrue(TEXT("Runs used push model as asked"), !State->Compared->bPushModel && State->Pushed->bPushModel);
+
+		const double Before = State->Compared->ReplicateMs;
+		const double After = State->Pushed->ReplicateMs;
+		AddInfo(FString::Printf(TEXT("ServerReplicateActors %.3f ms/frame without push model, %.3f ms/frame with it; server frame %.3f and %.3f ms"),
+			Before, After, State->Compared->ServerMs, State->Pushed->ServerMs));
+
+		// Replication is only timed inside the replication graph
+		if (!TestTrue(TEXT("Replication time measured"), Before > 0.0 && After > 0.0)) return true;
+		TestTrue(FString::Printf(TEXT("Replication %.3f ms/frame with push model, at most %.3f"), After, Before * CostMargin), After <= Before * CostMargin);
+		return true;
+	}));
+	return true;
+}
+
+#endif
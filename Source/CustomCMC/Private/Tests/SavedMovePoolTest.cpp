@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Tests/MovementTestWorld.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSavedMovePoolTest, "CustomCMC.Movement.SavedMovePool.NoAllocations",
+	EAutomationTestFlags_ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FSavedMovePoolTest::RunTest(const FString& Parameters)
+{
+	FMovementTestWorld TestWorld(1);
+	if (!TestTrue(TEXT("Test world created"), TestWorld.IsValid())) return false;
+
+	TUniquePtr<FNetworkPredictionData_Client_Character> ClientData = FCustomMovementTestAccess::MakeClientPredictionData(*TestWorld.GetMovement(0));
+	const int32 Capacity = ClientData->MaxSavedMoveCount + 2;
+
+	// The first move builds the slab, that is where its allocations belong
+	TArray<FSavedMovePtr> Moves;
+	Moves.Reserve(Capacity + 1);
+	Moves.Add(ClientData->AllocateNewMove());
+	if (!TestTrue(TEXT("First move allocated"), Moves[0].IsValid())) return false;
+	const FSavedMove_Character* FirstMove = Moves[0].Get();
+
+	uint64 SlabAllocations = 0;
+	uint64 RecycleAllocations = 0;
+	{
+		FScopedAllocationCounter Counter;
+
+		// Every slot handed out and released, twice
+		for (int32 Round = 0; Round < 2; ++Round)
+		{
+			while (Moves.Num() < Capacity)
+			{
+				Moves.Add(ClientData->AllocateNewMove());
+			}
+			Moves.Reset();
+		}
+		SlabAllocations = Counter.GetNumAllocations();
+
+		// A released slot is handed out again
+		Counter.ResetCount();
+		for (int32 Move = 0; Move < Capacity * 4; ++Move)
+		{
+			FSavedMovePtr Recycled = ClientData->AllocateNewMove();
+			Moves.Add(MoveTemp(Recycled));
+			Moves.Reset();
+		}
+		RecycleAllocations = Counter.GetNumAllocations();
+	}
+
+	TestEqual(TEXT("Allocations handing out and releasing every slot"), SlabAllocations, uint64(0));
+	TestEqual(TEXT("Allocations recycling released slots"), RecycleAllocations, uint64(0));
+
+	// Slots in use are never handed out twice, past the slab moves come from the heap
+	TSet<const FSavedMove_Character*> Distinct;
+	for (int32 Move = 0; Move <= Capacity; ++Move)
+	{
+		Moves.Add(ClientData->AllocateNewMove());
+		Distinct.Add(Moves.Last().Get());
+	}
+	TestEqual(TEXT("Moves in use are distinct"), Distinct.Num(), Capacity + 1);
+	TestTrue(TEXT("Slab moves are reused"), Distinct.Contains(FirstMove));
+
+	// Released before the prediction data, the slab moves go with it
+	Moves.Reset();
+	ClientData.Reset();
+	return true;
+}
+
+#endif
@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ReplicationGraph.h"
+#include "CustomCMCReplicationGraph.generated.h"
+
+class UReplicationGraphNode_ActorList;
+class UReplicationGraphNode_AlwaysRelevant_ForConnection;
+class UReplicationGraphNode_GridSpatialization2D;
+
+// Which node an actor class is routed to
+enum class ECustomCMCClassRepPolicy : uint8
+{
+	// Never routed, the per-connection node adds player controllers itself
+	NotRouted,
+	// Game state, player states and world settings
+	RelevantAllConnections,
+	// Grid node, never moves after spawning
+	Spatialize_Static,
+	// Grid node, cell re-evaluated every frame
+	Spatialize_Dynamic,
+	// Grid node, treated as static while dormant
+	Spatialize_Dormancy,
+	// Per-connection node of the owning connection
+	OwnerOnly,
+};
+
+USTRUCT()
+struct FCustomCMCConnectionNode
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<UNetConnection> NetConnection = nullptr;
+
+	UPROPERTY()
+	TObjectPtr<UReplicationGraphNode_AlwaysRelevant_ForConnection> Node = nullptr;
+};
+
+/**
+ * Replication graph for every CustomCMC game mode, selected in DefaultEngine.ini.
+ * Characters, enemies and damageable boxes go to a 2D spatial grid, pickups and checkpoints to the grid's
+ * dormancy handling, game-wide info actors to an always relevant list and owner-only actors to the owner's connection
+ */
+UCLASS(Transient, Config=Engine)
+class CUSTOMCMC_API UCustomCMCReplicationGraph : public UReplicationGraph
+{
+	GENERATED_BODY()
+
+public:
+	virtual void ResetGameWorldState() override;
+	virtual void InitGlobalActorClassSettings() override;
+	virtual void InitGlobalGraphNodes() override;
+	virtual void InitConnectionGraphNodes(UNetReplicationGraphConnection* RepGraphConnection) override;
+	virtual void RouteAddNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo, FGlobalActorReplicationInfo& GlobalInfo) override;
+	virtual void RouteRemoveNetworkActorToNodes(const FNewReplicatedActorInfo& ActorInfo) override;
+	virtual void RemoveClientConnection(UNetConnection* NetConnection) override;
+	virtual int32 ServerReplicateActors(float DeltaSeconds) override;
+
+	// Applies an actor's NetUpdateFrequency changed at runtime, the graph otherwise keeps the class rate
+	void SetActorNetUpdateFrequency(const AActor* Actor, float NetUpdateFrequency);
+
+#if !UE_BUILD_SHIPPING
+	// Time spent in ServerReplicateActors since the graph was created, the scope STAT_NetReplicateActors covers.
+	// Read without the stats system by CustomCMC.Net.Stress
+	double GetReplicateActorsSeconds() const { return ReplicateActorsSeconds; }
+#endif
+
+	UPROPERTY(Config)
+	float GridCellSize = 10000.f;
+
+	// Keeps actor locations positive in grid space
+	UPROPERTY(Config)
+	FVector2D GridSpatialBias = FVector2D(-150000.f, -200000.f);
+
+private:
+	ECustomCMCClassRepPolicy GetPolicy(const AActor* Actor) const;
+	UReplicationGraphNode_AlwaysRelevant_ForConnection* GetConnectionNode(const UNetConnection* NetConnection) const;
+	// Adds an owner-only actor to its owning connection's node, false while it has none
+	bool RouteOwnerOnlyActor(AActor* Actor);
+
+	UPROPERTY()
+	TObjectPtr<UReplicationGraphNode_GridSpatialization2D> GridNode;
+
+	UPROPERTY()
+	TObjectPtr<UReplicationGraphNode_ActorList> AlwaysRelevantNode;
+
+	UPROPERTY()
+	TArray<FCustomCMCConnectionNode> ConnectionNodes;
+
+	// Owner-only actors spawned before they had an owning connection, routed once they have one
+	UPROPERTY()
+	TArray<TObjectPtr<AActor>> PendingOwnerOnlyActors;
+
+	// Connection node each routed owner-only actor was added to. Its owner may change since, removal and
+	// re-routing go by this rather than by the current owner
+	UPROPERTY()
+	TMap<TObjectPtr<AActor>, TObjectPtr<UReplicationGraphNode_AlwaysRelevant_ForConnection>> OwnerOnlyActorNodes;
+
+	TClassMap<ECustomCMCClassRepPolicy> ClassRepPolicies;
+
+#if !UE_BUILD_SHIPPING
+	double ReplicateActorsSeconds = 0.0;
+#endif
+};
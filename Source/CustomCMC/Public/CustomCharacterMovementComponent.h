@@ -4,8 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "LedgeIndexSubsystem.h"
+#include "MovementDebugRecorder.h"
 #include "CustomCharacterMovementComponent.generated.h"
 
+class UServerMoveScheduler;
+struct FMovementModeCounters;
+
 /*On tick you will call perform move which executes the movement logic
  *
  * Then it will set the saved move to the safe move and check if it can be combined with other moves
@@ -25,6 +30,164 @@ enum ECustomMovementMode
 	CMOVE_MAX			UMETA(Hidden),
 };
 
+// A ledge that TryLedgeGrab has already validated, kept so repeated jump presses against the same
+// geometry can skip the front and height scene queries. Clearance is checked again on every use
+struct FLedgeCacheEntry
+{
+	// Components of the front and top faces and their transforms when the ledge was traced
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+	FTransform ComponentTransform;
+	TWeakObjectPtr<UPrimitiveComponent> SurfaceComponent;
+	FTransform SurfaceComponentTransform;
+
+	// Segment of the ledge along its tangent, so a long wall can hold several entries
+	int32 SegmentIndex = 0;
+
+	FHitResult FrontHit;
+	FHitResult SurfaceHit;
+	FVector EdgeTangent = FVector::ZeroVector;
+
+	// Character base locations from which this ledge resolves to the same hits
+	FBox ValidityVolume = FBox(ForceInit);
+	FVector TraceDirection = FVector::ZeroVector;
+	double TimeStamp = 0.0;
+};
+
+// Result of the front/height/clearance traces TryLedgeGrab runs on a cache miss
+struct FLedgeProbe
+{
+	FHitResult FrontHit;
+	FHitResult SurfaceHit;
+
+	// Front and surface passed the angle and height checks
+	bool bValidLedge = false;
+	bool bHasClearance = false;
+};
+
+// Hits of one hang probe sweep, inline so taking, swapping and reusing probes never touches the heap.
+// Sweeps past this many hits keep the nearest ones
+static constexpr int32 MaxHangProbeHits = 8;
+using FHangProbeHits = TArray<FHitResult, TInlineAllocator<MaxHangProbeHits>>;
+
+// Result of the scene queries PhysHang runs at the start of a tick
+struct FHangProbe
+{
+	// Where the probe was taken from, a probe is reused while the character stays close to this
+	bool bValid = false;
+	FVector Location = FVector::ZeroVector;
+	FQuat Rotation = FQuat::Identity;
+
+	// Set when the ledge came from the offline index and the wall/top traces were skipped
+	bool bIndexedLedge = false;
+	FLedgeIndexHit IndexHit;
+
+	FVector WallStart = FVector::ZeroVector;
+	FVector WallEnd = FVector::ZeroVector;
+	FHitResult WallHit;
+	FVector TopStart = FVector::ZeroVector;
+	FVector TopEnd = FVector::ZeroVector;
+	FHitResult TopHit;
+	// Where the wall and top faces were last traced from, and whether this probe carried them over instead
+	FVector LedgeTraceLocation = FVector::ZeroVector;
+	bool bLedgeCarried = false;
+
+	FHangProbeHits ClimbableHits;
+
+	// Swept on first use, only climbing down needs the floor
+	bool bFloorProbed = false;
+	FHangProbeHits FloorHits;
+
+	// Every component the probe hit and its transform at the time, the probe is stale once any of them moves
+	TArray<TPair<TWeakObjectPtr<const UPrimitiveComponent>, FTransform>, TInlineAllocator<4>> Components;
+
+	// Clears the results but keeps the array allocations
+	void Reset()
+	{
+		bValid = false;
+		bIndexedLedge = false;
+		IndexHit = FLedgeIndexHit();
+		WallHit = FHitResult();
+		TopHit = FHitResult();
+		bLedgeCarried = false;
+		ClimbableHits.Reset();
+		bFloorProbed = false;
+		FloorHits.Reset();
+		Components.Reset();
+	}
+
+	void TrackComponent(const FHitResult& Hit);
+};
+
+// Ledge context a hanging client sends with each ServerMove, quantized so the server can check it against its own
+struct FCustomHangState
+{
+	bool bHanging = false;
+
+	// Bumped on every ledge grab, client and server agree on the ledge while this matches
+	uint8 LedgeGrabID = 0;
+
+	// Ledge tangent, see FLedgeMath::PackDirection
+	uint16 PackedTangent = 0;
+
+	// Character location relative to the grabbed ledge anchor in whole cm, sent as 16 bits per axis
+	FIntVector LedgeOffset = FIntVector::ZeroValue;
+
+	void Serialize(FArchive& Ar);
+
+	bool operator==(const FCustomHangState& Other) const
+	{
+		return bHanging == Other.bHanging && LedgeGrabID == Other.LedgeGrabID && PackedTangent == Other.PackedTangent && LedgeOffset == Other.LedgeOffset;
+	}
+};
+
+
+UENUM()
+enum class ELedgeGrabMontage : uint8
+{
+	Tall,
+	Short,
+};
+
+// Sent by the server on every ledge grab, simulated proxies start the transition from it without tracing
+USTRUCT()
+struct FLedgeGrabEvent
+{
+	GENERATED_BODY()
+
+	// Bumped on every grab, so two grabs inside one net update still replicate
+	UPROPERTY()
+	uint8 Sequence = 0;
+
+	UPROPERTY()
+	FVector_NetQuantize TargetLocation = FVector::ZeroVector;
+
+	// Ledge tangent, see FLedgeMath::PackDirection
+	UPROPERTY()
+	uint16 PackedTangent = 0;
+
+	UPROPERTY()
+	ELedgeGrabMontage Montage = ELedgeGrabMontage::Tall;
+
+	// Length of the transition root motion in ms
+	UPROPERTY()
+	uint8 DurationMs = 0;
+
+	// Server world time the grab started, in whole ms. Wraps after 49 days, so only the difference to the
+	// proxy's server time is meaningful, and it stays exact however long the server has been up
+	UPROPERTY()
+	uint32 ServerStartTimeMs = 0;
+
+	bool NetSerialize(FArchive& Ar, UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FLedgeGrabEvent> : public TStructOpsTypeTraitsBase2<FLedgeGrabEvent>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
 
 /**
  * 
@@ -43,6 +206,16 @@ private:
 	
 	// Allows Character To use private variables
 	friend class ACustomCMCCharacter;
+	// Reads the ledge filter angles so the offline index matches TryLedgeGrab
+	friend class ULedgeExtractionCommandlet;
+	// Runs this component's probes in the frame's batch
+	friend class ULedgeProbeSubsystem;
+	// Runs this component's held ServerMoves within the frame's budget
+	friend class UServerMoveScheduler;
+	// Feeds recorded ServerMoves through MoveAutonomous
+	friend class UMovementReplayCommandlet;
+	// Lets the automation tests in Private/Tests reach the probes and the prediction data
+	friend struct FCustomMovementTestAccess;
 	
 	// This class sends a lightweight version of our movement to the server
 	class FSavedMove_Custom : public FSavedMove_Character
@@ -66,28 +239,125 @@ private:
 		uint8 Saved_bHadAnimRootMotion:1;
 		uint8 Saved_bTransitionFinished:1;
 
+		// AccelDotThresholdCombine as the engine set it, hang moves loosen it
+		float DefaultAccelDotThresholdCombine;
+
 	public:
 		FSavedMove_Custom();
 
+		// Not a flag, sent in FCustomNetworkMoveData
+		FCustomHangState Saved_HangState;
+
+		bool HasJumpInput() const { return bPressedJump || Saved_bPressedCustomJump; }
+
 		virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+		virtual void CombineWith(const FSavedMove_Character* OldMove, ACharacter* InCharacter, APlayerController* PC, const FVector& OldStartLocation) override;
 		virtual void Clear() override;
 		virtual uint8 GetCompressedFlags() const override;
 		virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData) override;
 		virtual void PrepMoveFor(ACharacter* C) override;
 	};
 
+	// ServerMove payload with the hang state appended, it costs one bit while not hanging
+	struct FCustomNetworkMoveData : public FCharacterNetworkMoveData
+	{
+		FCustomHangState HangState;
+
+		virtual void ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType) override;
+		virtual bool Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap, ENetworkMoveType MoveType) override;
+	};
+
+	struct FCustomNetworkMoveDataContainer : public FCharacterNetworkMoveDataContainer
+	{
+		FCustomNetworkMoveDataContainer();
+
+		FCustomNetworkMoveData CustomMoves[3];
+	};
+	FCustomNetworkMoveDataContainer CustomNetworkMoveDataContainer;
+
+	// Move response with the server's LedgeGrabID appended to corrections, so a client whose prediction grabbed
+	// a ledge the server did not, or missed one it did, counts from the server's value again
+	struct FCustomMoveResponseDataContainer : public FCharacterMoveResponseDataContainer
+	{
+		uint8 LedgeGrabID = 0;
+
+		virtual void ServerFillResponseData(const UCharacterMovementComponent& CharacterMovement, const FClientAdjustment& PendingAdjustment) override;
+		virtual bool Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap) override;
+	};
+	FCustomMoveResponseDataContainer CustomMoveResponseDataContainer;
+
+	// A received ServerMove held by UServerMoveScheduler, in the layout of FCustomNetworkMoveDataContainer
+	struct FDeferredServerMove
+	{
+		// MovementBase is kept in MovementBases instead, the base can be destroyed before the move runs
+		FCustomNetworkMoveData Moves[3];
+		TWeakObjectPtr<UPrimitiveComponent> MovementBases[3];
+		double ArrivalTime = 0.0;
+		bool bHasPendingMove = false;
+		bool bHasOldMove = false;
+		bool bIsDualHybridRootMotionMove = false;
+		bool bDisableCombinedScopedMove = false;
+		// A lone new move standing or hanging still, see IsIdleServerMove
+		bool bIdle = false;
+	};
+	// Arrival order, which is timestamp order
+	TArray<FDeferredServerMove> DeferredServerMoves;
+	UPROPERTY(Transient) TObjectPtr<UServerMoveScheduler> ServerMoveScheduler;
+
 	// Needed to switch to our custom movement
 	class FNetworkPredictionData_Client_Custom : public FNetworkPredictionData_Client_Character
 	{
 	public:
 		FNetworkPredictionData_Client_Custom(const UCharacterMovementComponent& ClientMovement);
+		virtual ~FNetworkPredictionData_Client_Custom() override;
 
 		typedef FNetworkPredictionData_Client_Character Super;
 
 		virtual FSavedMovePtr AllocateNewMove() override;
+
+	private:
+		// A saved move on its own cache lines
+		struct alignas(PLATFORM_CACHE_LINE_SIZE) FSavedMoveSlot
+		{
+			TTypeCompatibleBytes<FSavedMove_Custom> Move;
+		};
+
+		void CreateSlab();
+
+		// Fixed slab the moves live in, each constructed once together with the shared pointer handed out for it,
+		// so handing a slot out again only adds a reference. The engine's FreeMoves list recycles moves through
+		// Clear(), a slot only SlotMoves still references is free. Only when every slot is in use does a move
+		// come from the heap
+		TUniquePtr<FSavedMoveSlot[]> MoveSlab;
+		TArray<FSavedMovePtr> SlotMoves;
+		int32 NextSlot = 0;
+		int32 HighWaterMark = 0;
 	};
 	
 	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+
+	// Hanging clients with no jump input send at most every HangMinNetSendInterval
+	virtual float GetClientNetSendDeltaTime(const APlayerController* PC, const FNetworkPredictionData_Client_Character* ClientData, const FSavedMovePtr& NewMove) const override;
+	virtual void CallServerMovePacked(const FSavedMove_Character* NewMove, const FSavedMove_Character* PendingMove, const FSavedMove_Character* OldMove) override;
+	// Counts the corrections the server sends this character's client
+	virtual void ServerSendMoveResponse(const FClientAdjustment& PendingAdjustment) override;
+	// Takes over the server's LedgeGrabID, root motion corrections end up here too
+	virtual void ClientAdjustPosition_Implementation(float TimeStamp, FVector NewLoc, FVector NewVel, UPrimitiveComponent* NewBase, FName NewBaseBoneName,
+		bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode, TOptional<FRotator> OptionalRotation = TOptional<FRotator>()) override;
+	// Records each correction's mode and likely cause, see FMovementCorrectionTelemetry
+	virtual bool ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientWorldLocation,
+		const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode) override;
+	// Hands the move to UServerMoveScheduler while CustomCMC.Net.MoveBudgetMs is on
+	virtual void ServerMove_HandleMoveData(const FCharacterNetworkMoveDataContainer& MoveDataContainer) override;
+
+	// Runs the held moves in arrival order, folding idle moves the next one repeats
+	void RunDeferredServerMoves();
+	bool HasDeferredServerMoves() const { return !DeferredServerMoves.IsEmpty(); }
+	bool HasActiveDeferredServerMove() const;
+	double GetOldestDeferredServerMoveTime() const { return DeferredServerMoves[0].ArrivalTime; }
+	// No input that could change the state, and the server agrees the character is standing or hanging still
+	bool IsIdleServerMove(const FCustomNetworkMoveData& Move) const;
+	bool IsServerStateIdle(uint8 ClientMovementMode) const;
 #pragma region Overrides
 	
 	void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
@@ -96,10 +366,14 @@ private:
 
 	virtual void InitializeComponent() override;
 
+	virtual void RegisterComponentTickFunctions(bool bRegister) override;
+
 protected:
 
 
 	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+
+	virtual void MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel) override;
 	
 	virtual void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
 
@@ -118,6 +392,8 @@ protected:
 	virtual float GetGravityZ() const override;
 	
 	virtual void PhysCustom(float deltaTime, int32 Iterations) override;
+	// substeps the ledge grab transition, which runs in flying
+	virtual void PhysFlying(float deltaTime, int32 Iterations) override;
 	
 	virtual void OnMovementModeChanged(EMovementMode PreviousMovementMode, uint8 PreviousCustomMode) override;
 
@@ -151,7 +427,12 @@ protected:
 	//Replication
 
 	UPROPERTY(ReplicatedUsing=OnRep_LedgeGrab)
-	bool Proxy_bLedgeGrabbed;
+	FLedgeGrabEvent LedgeGrabEvent;
+
+	// Last event a proxy played
+	uint8 LastLedgeGrabSequence = 0;
+	// Seconds past its end a grab still blends its final pose into the hang on a proxy that heard of it late
+	static constexpr float LedgeGrabLateBlendWindow = 1.f;
 
 
 
@@ -186,9 +467,6 @@ protected:
 	
 	UPROPERTY(EditDefaultsOnly)
 	UAnimMontage* ProxyShortLedgeGrabMontage;
-	
-	UPROPERTY(EditDefaultsOnly)
-	UAnimMontage* ProxyTallLedgeGrabMontage;
 
 	UPROPERTY(EditDefaultsOnly)
 	float LedgeGrabZOffset = 40.f;
@@ -198,21 +476,147 @@ protected:
 
 	float LedgeGrabSpeed = 100.f;
 	float LedgeBrakingDeceleration = 10000.f;
+
+	// Ledge Cache
+	// Half size of the box around the character base in which a cached ledge is reused
+	UPROPERTY(EditDefaultsOnly, Category="LedgeGrab|Cache")
+	float LedgeCacheValidityExtent = 15.f;
+
+	// Length of a ledge segment along its tangent, one cache entry per segment
+	UPROPERTY(EditDefaultsOnly, Category="LedgeGrab|Cache")
+	float LedgeCacheSegmentLength = 50.f;
+
+	// Seconds a cached ledge stays valid
+	UPROPERTY(EditDefaultsOnly, Category="LedgeGrab|Cache")
+	float LedgeCacheLifetime = 2.f;
+
+	// Min dot between the cached and current trace direction for a cached ledge to be reused
+	UPROPERTY(EditDefaultsOnly, Category="LedgeGrab|Cache")
+	float LedgeCacheMinDirectionDot = 0.98f;
+
+	static constexpr int32 MaxLedgeCacheEntries = 8;
+
+	// Ledge Index
+	// Length above and below an indexed ledge's top face of the trace that confirms it
+	UPROPERTY(EditDefaultsOnly, Category="LedgeGrab|Index")
+	float IndexedLedgeConfirmDistance = 5.f;
+
+	// Max height difference between the traced top face and the indexed one
+	UPROPERTY(EditDefaultsOnly, Category="LedgeGrab|Index")
+	float IndexedLedgeTolerance = 2.f;
 # pragma endregion LedgeGrabVariables
 
 	UPROPERTY(Transient)
 	class ACustomCMCCharacter* CustomCharacterOwner;
+
+	// Offline ledge index for the current map, ledges missing from it are found by tracing
+	UPROPERTY(Transient)
+	ULedgeIndexSubsystem* LedgeIndexSubsystem;
+
+	// Scene queries for ledge grab and hang, safe to run off the game thread
+	void ProbeLedge(const FVector& BaseLoc, const FVector& Fwd, float CheckDistance, const FCollisionQueryParams& Params, FLedgeProbe& Out) const;
+	// Room for the capsule on top of the ledge
+	bool HasLedgeClearance(const FHitResult& SurfaceHit, const FVector& Fwd, const FCollisionQueryParams& Params) const;
+	void ProbeHang(const FVector& Location, const FQuat& Rotation, const FCollisionQueryParams& Params, const FCollisionQueryParams& ClimbParams, FHangProbe& Out) const;
+	void ProbeHangFloor(const FCollisionQueryParams& ClimbParams, FHangProbe& Probe) const;
+	// Previous's traced wall and top faces still hold from Location, ProbeHang keeps them if its climbable sweep finds the same wall
+	bool CanCarryHangLedge(const FVector& Location, const FQuat& Rotation, const FHangProbe& Previous) const;
+	// Downward climb speed from which a floor hit stops hanging
+	static constexpr float HangFloorMinDescentSpeed = 10.f;
+
+	// Probes run ahead of movement by ULedgeProbeSubsystem against static geometry only. They are used when the inputs
+	// still match this frame and nothing dynamic is inside their bounds, otherwise the synchronous probe runs
+	struct FBatchedProbes
+	{
+		uint64 Frame = 0;
+
+		// The character's ignore params restricted to static and to dynamic geometry
+		FCollisionQueryParams StaticParams;
+		FCollisionQueryParams DynamicParams;
+
+		bool bHang = false;
+		FVector HangLocation = FVector::ZeroVector;
+		FQuat HangRotation = FQuat::Identity;
+		FBox HangBounds = FBox(ForceInit);
+		FHangProbe Hang;
+
+		bool bLedge = false;
+		FVector LedgeBaseLoc = FVector::ZeroVector;
+		FVector LedgeFwd = FVector::ZeroVector;
+		float LedgeCheckDistance = 0.f;
+		FBox LedgeBounds = FBox(ForceInit);
+		FLedgeProbe Ledge;
+	};
+	FBatchedProbes BatchedProbes;
+
+	bool GatherBatchedProbes();
+	void RunBatchedProbes();
+	bool ConsumeBatchedHangProbe(const FVector& Location, const FQuat& Rotation, FHangProbe& Out);
+	// Movable geometry gathered with the batch, pawns included, inside Bounds where it is now
+	bool HasDynamicGeometryIn(const FBox& Bounds) const;
+	// Conservative bounds of everything ProbeLedge and ProbeHang can touch
+	FBox GetLedgeProbeBounds(const FVector& BaseLoc, const FVector& Fwd, float CheckDistance) const;
+	FBox GetHangProbeBounds(const FVector& Location, const FQuat& Rotation) const;
+
+	// Last hang probe, reused while the character has barely moved and nothing it hit has moved
+	FHangProbe HangProbe;
+	bool CanReuseHangProbe(const FVector& Location, const FQuat& Rotation) const;
+	bool bHangProbeReused = false;
+
+	// Last snap was blocked before it could move, with an unchanged probe the next one would be too
+	bool bHangSnapBlocked = false;
+
+	// Hang state sent by the client, or checked by the server against its own
+	FCustomHangState GetHangState() const;
+	bool ValidateClientHangState(const FCustomHangState& ClientState) const;
+
+	// Ledge grab count and the point the last grab was anchored to, the reference for FCustomHangState::LedgeOffset.
+	// Corrections reset the client's count to the server's, replayed moves then bump it as the server did
+	uint8 LedgeGrabID = 0;
+	FVector CurrentLedgeAnchor = FVector::ZeroVector;
+
+	// Set on the server for a ServerMove whose hang state matched. Only then does the server reuse its hang probe
+	// for a remote client, under the same HangProbeReuseDistance the client reuses its own over
+	bool bClientHangStateValidated = false;
+
+	// Set on the server when a client move changed the movement mode, for the correction telemetry
+	bool bMovementModeChangedInMove = false;
+	bool ConsumeBatchedLedgeProbe(const FVector& BaseLoc, const FVector& Fwd, float CheckDistance, FLedgeProbe& Out);
 	// LedgeGrab 
 	bool TryLedgeGrab();
 	void PhysHang(float deltaTime, int32 Iterations);
+	// Equal substeps of at most MaxHangSubstepTime a tick is split into, up to MaxHangSubsteps
+	int32 GetNumHangSubsteps(float DeltaTime) const;
+
+	// Ledge Cache
+	const FLedgeCacheEntry* FindCachedLedge(const FVector& BaseLoc, const FVector& Fwd);
+	void CacheLedge(const FHitResult& FrontHit, const FHitResult& SurfaceHit, const FVector& BaseLoc, const FVector& Fwd);
+
+	TArray<FLedgeCacheEntry, TInlineAllocator<MaxLedgeCacheEntries>> LedgeCache;
+	uint32 LedgeCacheHits = 0;
+	uint32 LedgeCacheMisses = 0;
+	// Presses resolved from the ledge index, they never reach the cache
+	uint32 LedgeIndexHits = 0;
+#if !UE_BUILD_SHIPPING
+	// Scene queries spent resolving the ledge on each path, up to the tall ledge overlap they all share
+	uint64 LedgeIndexQueries = 0;
+	uint64 LedgeCacheQueries = 0;
+	uint64 LedgeProbeQueries = 0;
+#endif
+
+	// Ledge Index
+	bool FindIndexedLedge(const FVector& BaseLoc, const FVector& Fwd, float CheckDistance, FHitResult& OutFrontHit, FHitResult& OutSurfaceHit, float& OutClearance) const;
+	// Traces the top face of an indexed ledge, fills in the hit components and fails when the scene no longer matches the index
+	bool ConfirmIndexedLedge(FHitResult& FrontHit, FHitResult& SurfaceHit, const FCollisionQueryParams& Params) const;
+	bool FindIndexedHangLedge(const FVector& Location, const FQuat& Rotation, FLedgeIndexHit& OutHit) const;
 
 	FVector GetLedgeGrabStartLocation(FHitResult FrontHit, FHitResult SurfaceHit) const;
 	//Custom To Be Replaced
 	FVector GetLedgeGrabCurrentLocation(FHitResult FrontHit, FHitResult SurfaceHit) const;
-	void SnapMovementToClimableSurfaces(float DeltaTime);
+	void SnapMovementToClimableSurfaces(float DeltaTime, int32 NumSubsteps);
 	FQuat GetClimbRotation(float DeltaTime);
 	bool CheckShouldStopHanging();
-	bool CheckHasReachedFloor();
+	bool CheckHasReachedFloor(TConstArrayView<FHitResult> PossibleFloorHits) const;
 	void StopHanging();
 
 	FHitResult CurrentFrontHit;
@@ -228,6 +632,44 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Climb|Hang")
 	float CornerInterpSpeed = 10.f;
 
+	// Longest step the hang and the ledge grab transition integrate in one go. Longer ticks are split into equal substeps,
+	// so a server ticking at 30 Hz follows the same path as a client at 120 Hz
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang", meta=(ClampMin="0.001", Units="s"))
+	float MaxHangSubstepTime = 1.f / 120.f;
+	// Substeps per tick at most, a longer hitch takes longer substeps
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang", meta=(ClampMin="1"))
+	int32 MaxHangSubsteps = 8;
+
+	// Rate the hang pulls the character onto the climbable surface, each substep closes Substep * HangSnapSpeed of the gap
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang")
+	float HangSnapSpeed = 100.f;
+
+	// Distance in cm and angle in degrees the character may move or turn before the hang probe is taken again
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang")
+	float HangProbeReuseDistance = 1.f;
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang")
+	float HangProbeReuseAngle = 0.5f;
+	// Distance in cm a shimmy may carry the traced wall and top faces over while the climbable sweep keeps finding the same wall
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang", meta=(ClampMin="0", Units="cm"))
+	float HangLedgeCarryDistance = 50.f;
+
+	// How far the client's ledge offset in cm and tangent in degrees may be from the server's and still be trusted
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang|Network")
+	float HangStateMaxOffsetError = 3.f;
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang|Network")
+	float HangStateMaxTangentError = 5.f;
+
+	// Consecutive hang moves on the same ledge combine while their accelerations differ by less than this
+	// and point within the angle whose cosine is HangCombineAccelDotThreshold
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang|Network")
+	float HangCombineMaxAccelDelta = 100.f;
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang|Network")
+	float HangCombineAccelDotThreshold = 0.97f;
+
+	// Seconds between ServerMoves while hanging without jump input, see CustomCMC.Net.HangMoveCoalescing
+	UPROPERTY(EditDefaultsOnly, Category="Climb|Hang|Network")
+	float HangMinNetSendInterval = 0.05f;
+
 public:
 #pragma region InputEvents
 	UFUNCTION(BlueprintCallable)
@@ -249,6 +691,33 @@ public:
 
 	FORCEINLINE FVector GetCurrentLedgeTangent() const { return CurrentLedgeTangent; }
 
+#if !UE_BUILD_SHIPPING
+	// Writes this character's recorded movement debug to Saved/MovementDebug
+	void DumpMovementDebug() const;
+
+	// Bits a ServerMove for the current state costs with the flags-only move data and with the hang state appended
+	void MeasureServerMoveBits(int32& OutFlagsOnlyBits, int32& OutHangStateBits);
+
+	// Server only, corrections sent to this character's client since it spawned
+	uint32 GetServerCorrections() const { return ServerCorrections; }
+
+	// Movement mode counters of this component's world
+	FMovementModeCounters& GetModeCounters() const;
+
+	// Scene queries the ledge index and cache saved over probing every press, at the probe's average cost here.
+	// A batched probe costs the game thread less than a probe run inline, so this is measured and not a fixed count
+	double GetLedgeQueriesSaved() const;
+#endif
+
+	// Number of jump presses resolved from / missing the ledge cache
+	UFUNCTION(BlueprintPure, Category="LedgeGrab|Cache")
+	int32 GetLedgeCacheHits() const { return LedgeCacheHits; }
+	UFUNCTION(BlueprintPure, Category="LedgeGrab|Cache")
+	int32 GetLedgeCacheMisses() const { return LedgeCacheMisses; }
+	// Number of jump presses resolved from the offline ledge index, before the cache is looked at
+	UFUNCTION(BlueprintPure, Category="LedgeGrab|Cache")
+	int32 GetLedgeIndexHits() const { return LedgeIndexHits; }
+
 
 private:
 	//Helpers
@@ -259,6 +728,16 @@ private:
 	UFUNCTION()
 	void OnRep_LedgeGrab();
 
+#if !UE_BUILD_SHIPPING
+	// Debug shapes and messages from ledge grab and hang, see CustomCMC.Debug.Movement
+	mutable FMovementDebugRecorder DebugRecorder;
+
+	uint32 ServerCorrections = 0;
+
+	// Resolved in InitializeComponent, scene queries count from worker threads too
+	FMovementModeCounters* ModeCounters = nullptr;
+#endif
+
 	// Ledge Detection Experiment
 	FVector CurrentLedgeTangent;
 
@@ -267,12 +746,20 @@ private:
 
 	// Climb Project Functions and variables
 	void ProcessClimbableSurfaceInfo();
-	bool TraceClimbableSurfaces();
-	TArray<FHitResult> DoCapsuleTraceMultiByObject(const FVector& Start,const FVector& End,bool bShowDebugShape = false,bool bDrawPersistantShapes = false);
+	// Sweeps the climb capsule against ClimbableSurfaceTraceTypes, OutHits is reset first so callers can reuse it
+	void DoCapsuleTraceMultiByObject(const FVector& Start, const FVector& End, const FCollisionQueryParams& QueryParams, FHangProbeHits& OutHits) const;
 
-	FVector CurrentClimbableSurfaceNormal;
+	// ClimbableSurfaceTraceTypes resolved once in InitializeComponent, the static variant is for batched probes
+	FCollisionObjectQueryParams ClimbableObjectQueryParams;
+	FCollisionQueryParams ClimbableQueryParams;
+	FCollisionQueryParams StaticClimbableQueryParams;
 
-	TArray<FHitResult> ClimbableSurfacesTracedResults;
+	// UWorld sweeps only write default allocated arrays. The sweep lands here, reserved for MaxHangProbeHits in
+	// InitializeComponent so it never grows in normal use, then is copied into the probe's inline hits.
+	// Only one probe of a component runs at a time, batched or not
+	mutable TArray<FHitResult> ClimbableSweepScratch;
+
+	FVector CurrentClimbableSurfaceNormal;
 
 	FVector CurrentClimbableSurfaceLocation;
 	
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "LedgeExtractionCommandlet.generated.h"
+
+struct FLedgeEdge;
+
+/**
+ * Walks the static collision of one or more maps and writes their grabbable edges to a ULedgeIndexAsset.
+ *
+ * UnrealEditor-Cmd CustomCMC.uproject -run=LedgeExtraction [-Maps=/Game/ThirdPerson/Lvl_ThirdPerson+...]
+ *		[-MinWallSteepnessAngle=75] [-MaxSurfaceAngle=40]
+ *
+ * Angles default to the UCustomCharacterMovementComponent defaults so the index agrees with TryLedgeGrab
+ */
+UCLASS()
+class CUSTOMCMC_API ULedgeExtractionCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	ULedgeExtractionCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	bool ExtractMap(const FString& MapPackageName);
+	void ExtractComponent(class UStaticMeshComponent* Component, TArray<FLedgeEdge>& OutEdges) const;
+	void ExtractTriangles(const TArray<FVector>& Vertices, const TArray<int32>& Indices, TArray<FLedgeEdge>& OutEdges) const;
+	float MeasureClearance(UWorld* World, const FLedgeEdge& Edge) const;
+
+	float MinWallSteepnessAngle = 75.f;
+	float MaxSurfaceAngle = 40.f;
+
+	// Sphere used to measure free space above a ledge and how far up to look
+	float ClearanceProbeRadius = 40.f;
+	float MaxClearance = 400.f;
+
+	// Edges shorter than this are dropped
+	float MinEdgeLength = 5.f;
+};
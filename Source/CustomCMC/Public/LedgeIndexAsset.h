@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "LedgeIndexAsset.generated.h"
+
+/**
+ * A single grabbable edge extracted from static collision.
+ * Normals are packed to int16 per axis to keep the asset compact (40 bytes per edge).
+ */
+struct CUSTOMCMC_API FLedgeEdge
+{
+	FVector3f Start = FVector3f::ZeroVector;
+	FVector3f End = FVector3f::ZeroVector;
+	int16 PackedWallNormal[3] = {0, 0, 0};
+	int16 PackedTopNormal[3] = {0, 0, 0};
+
+	// Free vertical space above the top face, measured at extraction time
+	float Clearance = 0.f;
+
+	FORCEINLINE FVector GetStart() const { return FVector(Start); }
+	FORCEINLINE FVector GetEnd() const { return FVector(End); }
+	FORCEINLINE FVector GetWallNormal() const { return UnpackNormal(PackedWallNormal); }
+	FORCEINLINE FVector GetTopNormal() const { return UnpackNormal(PackedTopNormal); }
+
+	void SetWallNormal(const FVector& Normal) { PackNormal(Normal, PackedWallNormal); }
+	void SetTopNormal(const FVector& Normal) { PackNormal(Normal, PackedTopNormal); }
+
+	static void PackNormal(const FVector& Normal, int16 (&Out)[3])
+	{
+		const FVector SafeNormal = Normal.GetSafeNormal();
+		for (int32 Axis = 0; Axis < 3; ++Axis)
+		{
+			Out[Axis] = (int16)FMath::RoundToInt32(FMath::Clamp(SafeNormal[Axis], -1.0, 1.0) * MAX_int16);
+		}
+	}
+
+	static FVector UnpackNormal(const int16 (&In)[3])
+	{
+		return FVector(In[0], In[1], In[2]).GetSafeNormal();
+	}
+
+	friend FArchive& operator<<(FArchive& Ar, FLedgeEdge& Edge)
+	{
+		Ar << Edge.Start << Edge.End;
+		for (int32 Axis = 0; Axis < 3; ++Axis) Ar << Edge.PackedWallNormal[Axis];
+		for (int32 Axis = 0; Axis < 3; ++Axis) Ar << Edge.PackedTopNormal[Axis];
+		Ar << Edge.Clearance;
+		return Ar;
+	}
+};
+
+/**
+ * Grabbable edges of one map, written by ULedgeExtractionCommandlet and loaded by ULedgeIndexSubsystem
+ */
+UCLASS()
+class CUSTOMCMC_API ULedgeIndexAsset : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	// Long package name of the map the edges were extracted from
+	UPROPERTY(VisibleAnywhere, Category="Ledge Index")
+	FString SourceMap;
+
+	// Filter angles used during extraction, kept so stale assets can be spotted
+	UPROPERTY(VisibleAnywhere, Category="Ledge Index")
+	float MinWallSteepnessAngle = 0.f;
+
+	UPROPERTY(VisibleAnywhere, Category="Ledge Index")
+	float MaxSurfaceAngle = 0.f;
+
+	TArray<FLedgeEdge> Edges;
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	// Where the index for a map lives, e.g. /Game/LedgeIndex/LI_Lvl_ThirdPerson
+	static FString GetAssetPackageName(const FString& MapPackageName);
+};
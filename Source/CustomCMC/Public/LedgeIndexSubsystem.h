@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "LedgeIndexAsset.h"
+#include "LedgeIndexSubsystem.generated.h"
+
+// Result of a ledge index query
+struct FLedgeIndexHit
+{
+	const FLedgeEdge* Edge = nullptr;
+
+	// Closest point on the edge to the query location
+	FVector Point = FVector::ZeroVector;
+
+	// Distance from the query location to Point along the query direction
+	float Distance = 0.f;
+};
+
+/**
+ * Uniform XY grid over edge bounds. Edges referenced by each cell are stored contiguously
+ * (CellStart/CellEdges) so a query walks a handful of flat arrays rather than a tree
+ */
+class CUSTOMCMC_API FLedgeGrid
+{
+public:
+	void Build(TArray<FLedgeEdge>&& InEdges, float InCellSize);
+	void Reset();
+
+	bool IsEmpty() const { return Edges.IsEmpty(); }
+	int32 Num() const { return Edges.Num(); }
+
+	// Calls Func for every edge whose bounds overlap Box. An edge spanning several cells may be visited more than once
+	template <typename FuncType>
+	void ForEachEdge(const FBox& Box, FuncType&& Func) const
+	{
+		if (Edges.IsEmpty()) return;
+
+		const FBox3f QueryBox(Box);
+		const FIntPoint Min = GetCell(Box.Min);
+		const FIntPoint Max = GetCell(Box.Max);
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			for (int32 X = Min.X; X <= Max.X; ++X)
+			{
+				const int32 Cell = Y * Dims.X + X;
+				for (int32 i = CellStart[Cell]; i < CellStart[Cell + 1]; ++i)
+				{
+					const int32 EdgeIndex = CellEdges[i];
+					if (EdgeBounds[EdgeIndex].Intersect(QueryBox))
+					{
+						Func(Edges[EdgeIndex]);
+					}
+				}
+			}
+		}
+	}
+
+private:
+	FIntPoint GetCell(const FVector& Location) const
+	{
+		return FIntPoint(
+			FMath::Clamp(FMath::FloorToInt32((Location.X - Origin.X) / CellSize), 0, Dims.X - 1),
+			FMath::Clamp(FMath::FloorToInt32((Location.Y - Origin.Y) / CellSize), 0, Dims.Y - 1));
+	}
+
+	TArray<FLedgeEdge> Edges;
+	TArray<FBox3f> EdgeBounds;
+	TArray<int32> CellStart;
+	TArray<int32> CellEdges;
+
+	FVector2D Origin = FVector2D::ZeroVector;
+	FIntPoint Dims = FIntPoint::ZeroValue;
+	float CellSize = 1.f;
+};
+
+/**
+ * Loads the ledge index asset for the current map and answers ledge queries from it,
+ * so ledge grabbing and hanging do not need to trace static collision
+ */
+UCLASS()
+class CUSTOMCMC_API ULedgeIndexSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	bool HasIndexData() const { return !Grid.IsEmpty(); }
+
+	/**
+	 * Finds the nearest edge in front of Location along Direction.
+	 * @param MaxDistance		how far ahead of Location the edge may be
+	 * @param MaxLateral		how far to the side of the Direction line the closest edge point may be
+	 * @param MinZ, MaxZ		world height range the edge point must fall in
+	 * @param MinFacingDot		min dot between Direction and the inverted wall normal
+	 */
+	bool FindLedge(const FVector& Location, const FVector& Direction, float MaxDistance, float MaxLateral, float MinZ, float MaxZ, float MinFacingDot, FLedgeIndexHit& OutHit) const;
+
+	// Size of one grid cell in cm
+	static constexpr float GridCellSize = 400.f;
+
+private:
+	FLedgeGrid Grid;
+};
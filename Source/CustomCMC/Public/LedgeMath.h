@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/HitResult.h"
+
+/**
+ * Ledge geometry used by UCustomCharacterMovementComponent, free of any component or world access.
+ * The batch functions come in a scalar and a VectorRegister variant that give the same results
+ */
+struct FLedgeMath
+{
+	// Unit vector along the edge where two faces meet, Cross(First, Second).
+	// TryLedgeGrab passes (top, wall) and PhysHang (wall, top), so their tangents run in opposite directions
+	static FORCEINLINE FVector GetEdgeTangent(const FVector& FirstNormal, const FVector& SecondNormal)
+	{
+		return FVector::CrossProduct(FirstNormal, SecondNormal).GetSafeNormal();
+	}
+
+	// Where the capsule centre goes to hang from a ledge whose top was hit at SurfaceLocation
+	static FORCEINLINE FVector GetLedgeGrabLocation(const FVector& SurfaceLocation, const FVector& WallNormal, const FVector& SurfaceNormal,
+		const FVector& Forward, float CapsuleRadius, float CapsuleHalfHeight)
+	{
+		const float CosWallSteepnessAngle = WallNormal | FVector::UpVector;
+		const float DownDistance = CapsuleHalfHeight * 2.f;
+		const FVector EdgeTangent = GetEdgeTangent(SurfaceNormal, WallNormal);
+		const FVector WallNormal2D = WallNormal.GetSafeNormal2D();
+
+		FVector Location = SurfaceLocation;
+		Location += WallNormal2D * (2.f + CapsuleRadius);
+		Location += Forward.GetSafeNormal2D().ProjectOnTo(EdgeTangent) * CapsuleRadius * .3f;
+		Location += FVector::UpVector * CapsuleHalfHeight;
+		Location += FVector::DownVector * DownDistance;
+		Location += WallNormal2D * CosWallSteepnessAngle * DownDistance;
+		return Location;
+	}
+
+	// Rotation that turns the character to face into SurfaceNormal, interpolated from CurrentQuat
+	static FORCEINLINE FQuat GetClimbRotation(const FQuat& CurrentQuat, const FVector& SurfaceNormal, float DeltaTime, float InterpSpeed)
+	{
+		const FQuat TargetQuat = FRotationMatrix::MakeFromX(-SurfaceNormal).ToQuat();
+		return FMath::QInterpTo(CurrentQuat, TargetQuat, DeltaTime, InterpSpeed);
+	}
+
+	// Unit direction as yaw and pitch bytes, about 1.4 degrees of precision
+	static FORCEINLINE uint16 PackDirection(const FVector& Direction)
+	{
+		const FRotator Rotation = Direction.Rotation();
+		return static_cast<uint16>(FRotator::CompressAxisToByte(Rotation.Yaw) | FRotator::CompressAxisToByte(Rotation.Pitch) << 8);
+	}
+
+	static FORCEINLINE FVector UnpackDirection(uint16 Packed)
+	{
+		return FRotator(FRotator::DecompressAxisFromByte(Packed >> 8), FRotator::DecompressAxisFromByte(Packed & 0xFF), 0.f).Vector();
+	}
+
+	// Average impact point and normalized average impact normal of a set of hits
+	static FORCEINLINE void AverageHitSurfaces(TConstArrayView<FHitResult> Hits, FVector& OutLocation, FVector& OutNormal)
+	{
+		OutLocation = FVector::ZeroVector;
+		OutNormal = FVector::ZeroVector;
+		if (Hits.IsEmpty()) return;
+
+		for (const FHitResult& Hit : Hits)
+		{
+			OutLocation += Hit.ImpactPoint;
+			OutNormal += Hit.ImpactNormal;
+		}
+		OutLocation /= Hits.Num();
+		OutNormal = OutNormal.GetSafeNormal();
+	}
+
+	// Same as AverageHitSurfaces over separate location and normal arrays of equal length
+	static FORCEINLINE void AverageSurfaces(TConstArrayView<FVector> Locations, TConstArrayView<FVector> Normals, FVector& OutLocation, FVector& OutNormal)
+	{
+		check(Locations.Num() == Normals.Num());
+		OutLocation = FVector::ZeroVector;
+		OutNormal = FVector::ZeroVector;
+		if (Locations.IsEmpty()) return;
+
+		for (int32 i = 0; i < Locations.Num(); ++i)
+		{
+			OutLocation += Locations[i];
+			OutNormal += Normals[i];
+		}
+		OutLocation /= Locations.Num();
+		OutNormal = OutNormal.GetSafeNormal();
+	}
+
+	// Sums in the same order as the scalar variant so the results match bit for bit
+	static FORCEINLINE void AverageSurfacesVectorized(TConstArrayView<FVector> Locations, TConstArrayView<FVector> Normals, FVector& OutLocation, FVector& OutNormal)
+	{
+		check(Locations.Num() == Normals.Num());
+		OutLocation = FVector::ZeroVector;
+		OutNormal = FVector::ZeroVector;
+		if (Locations.IsEmpty()) return;
+
+		VectorRegister4Double LocationSum = VectorZeroDouble();
+		VectorRegister4Double NormalSum = VectorZeroDouble();
+		for (int32 i = 0; i < Locations.Num(); ++i)
+		{
+			LocationSum = VectorAdd(LocationSum, VectorLoadFloat3_W0(&Locations[i].X));
+			NormalSum = VectorAdd(NormalSum, VectorLoadFloat3_W0(&Normals[i].X));
+		}
+		// FVector divides by multiplying with the reciprocal, do the same
+		LocationSum = VectorMultiply(LocationSum, VectorSetFloat1(1.0 / Locations.Num()));
+
+		VectorStoreFloat3(LocationSum, &OutLocation.X);
+		VectorStoreFloat3(NormalSum, &OutNormal.X);
+		OutNormal = OutNormal.GetSafeNormal();
+	}
+
+	// GetEdgeTangent for every pair, OutTangents must be as long as the inputs
+	static FORCEINLINE void GetEdgeTangents(TConstArrayView<FVector> FirstNormals, TConstArrayView<FVector> SecondNormals, TArrayView<FVector> OutTangents)
+	{
+		check(FirstNormals.Num() == SecondNormals.Num() && OutTangents.Num() == FirstNormals.Num());
+		for (int32 i = 0; i < FirstNormals.Num(); ++i)
+		{
+			OutTangents[i] = GetEdgeTangent(FirstNormals[i], SecondNormals[i]);
+		}
+	}
+
+	// Vectorized GetEdgeTangents. Degenerate pairs give a zero tangent like GetSafeNormal, otherwise the
+	// results agree with the scalar variant to within rounding of the square root
+	static FORCEINLINE void GetEdgeTangentsVectorized(TConstArrayView<FVector> FirstNormals, TConstArrayView<FVector> SecondNormals, TArrayView<FVector> OutTangents)
+	{
+		check(FirstNormals.Num() == SecondNormals.Num() && OutTangents.Num() == FirstNormals.Num());
+		const VectorRegister4Double Tolerance = VectorSetFloat1(UE_SMALL_NUMBER);
+		for (int32 i = 0; i < FirstNormals.Num(); ++i)
+		{
+			const VectorRegister4Double Cross = VectorCross(VectorLoadFloat3_W0(&FirstNormals[i].X), VectorLoadFloat3_W0(&SecondNormals[i].X));
+			const VectorRegister4Double SizeSquared = VectorDot3(Cross, Cross);
+			const VectorRegister4Double Normalized = VectorDivide(Cross, VectorSqrt(SizeSquared));
+			VectorStoreFloat3(VectorSelect(VectorCompareGT(SizeSquared, Tolerance), Normalized, VectorZeroDouble()), &OutTangents[i].X);
+		}
+	}
+};
@@ -0,0 +1,77 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Engine/OverlapResult.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "LedgeProbeSubsystem.generated.h"
+
+class UCustomCharacterMovementComponent;
+class ULedgeProbeSubsystem;
+struct FCollisionQueryParams;
+
+// Runs the frame's ledge probe batch in TG_PrePhysics, ahead of every custom movement component
+USTRUCT()
+struct FLedgeProbeTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	ULedgeProbeSubsystem* Subsystem = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FLedgeProbeTickFunction> : public TStructOpsTypeTraitsBase2<FLedgeProbeTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/**
+ * Collects the ledge grab and hang probes of every UCustomCharacterMovementComponent for the frame
+ * and runs them against static geometry together with ParallelFor before any of those components move.
+ * Pawns and other movable geometry are not in the batch. One overlap over the whole batch gathers the movable primitives
+ * near it, and a component only uses its batched probe when none of them is inside its probe bounds where they are when the
+ * probe is used, otherwise it runs the synchronous probe, so results match that path.
+ * CustomCMC.BatchLedgeProbes switches between this and the synchronous per-component path
+ */
+UCLASS()
+class CUSTOMCMC_API ULedgeProbeSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	void RegisterComponent(UCustomCharacterMovementComponent* Component);
+	void UnregisterComponent(UCustomCharacterMovementComponent* Component);
+
+	FTickFunction& GetTickFunction() { return TickFunction; }
+
+	// Gathers this frame's probe requests and runs them across task graph workers
+	void RunBatch();
+
+	// A movable primitive gathered with this frame's batch is inside Bounds now, leaving out what Params ignores
+	bool HasDynamicPrimitiveIn(const FBox& Bounds, const FCollisionQueryParams& Params) const;
+
+private:
+	FLedgeProbeTickFunction TickFunction;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UCustomCharacterMovementComponent>> Components;
+
+	// Components with probes this frame, kept to avoid reallocating every tick
+	TArray<UCustomCharacterMovementComponent*> Batch;
+
+	// Movable primitives around this frame's batch, gathered once before any component moves
+	TArray<FOverlapResult> DynamicOverlaps;
+};
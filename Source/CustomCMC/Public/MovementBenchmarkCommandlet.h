@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MovementTestCourse.h"
+#include "MovementBenchmarkCommandlet.generated.h"
+
+class ACustomCMCCharacter;
+
+/**
+ * Spawns scripted ACustomCMCCharacter bots in a generated course of walls and ledges and measures what their movement costs.
+ * Each bot walks at a wall, jumps, grabs the ledge, shimmies along it while hanging and starts over.
+ *
+ * UnrealEditor-Cmd CustomCMC.uproject -run=MovementBenchmark -nullrhi [-Counts=1+16+64+256] [-Frames=600] [-WarmupFrames=120]
+ *		[-FPS=60] [-CharacterClass=/Game/ThirdPerson/Blueprints/BP_ThirdPersonCharacter.BP_ThirdPersonCharacter_C] [-Output=Path/Without/Extension]
+ *
+ * Writes <Output>.csv and <Output>.json with game thread ms per frame and per simulated second, scene queries per frame,
+ * movement tick cost per mode and the bits of a hanging ServerMove with and without the hang state.
+ * Running it with -FPS=30 and -FPS=60 compares what a server ticking at either rate spends.
+ * -CompareBatching runs every count with CustomCMC.BatchLedgeProbes off and then on, one row each, for the probe batch's A/B.
+ *
+ * -Trajectory [-TrajectorySeconds=10] [-Tolerance=2] runs one bot through the script at 30, 60 and 120 Hz instead, deciding its input
+ * on the same 30 Hz steps, and writes <Output>_Trajectory.csv with how far the 30 and 60 Hz paths are from the 120 Hz one in each mode.
+ * Fails if a hanging character is further than Tolerance cm from the 120 Hz path
+ */
+UCLASS()
+class CUSTOMCMC_API UMovementBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UMovementBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	struct FBot;
+	struct FRunResult;
+	struct FTrajectoryPoint;
+
+	bool RunCount(TSubclassOf<ACustomCMCCharacter> CharacterClass, int32 NumCharacters, FRunResult& OutResult) const;
+	void DriveBot(FBot& Bot, float DeltaTime) const;
+	bool WriteResults(const FString& OutputPath, const TArray<FRunResult>& Results) const;
+
+	bool RunTrajectory(TSubclassOf<ACustomCMCCharacter> CharacterClass, int32 StepsPerSample, TArray<FTrajectoryPoint>& OutPoints) const;
+	bool CompareTrajectories(TSubclassOf<ACustomCMCCharacter> CharacterClass, const FString& OutputPath) const;
+
+	int32 Frames = 600;
+	int32 WarmupFrames = 120;
+	float FrameDeltaTime = 1.f / 60.f;
+
+	// The rate trajectories are sampled and the script decides at, the lowest rate compared
+	static constexpr float TrajectorySampleRate = 30.f;
+	float TrajectorySeconds = 10.f;
+	float TrajectoryTolerance = 2.f;
+
+	// One lane per bot
+	FMovementTestCourse Course;
+};
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "MovementModeCounters.h"
+#include "Engine/EngineTypes.h"
+#include <atomic>
+
+#if !UE_BUILD_SHIPPING
+
+/**
+ * Server corrections by the movement mode the server was in and the likely cause, with a histogram of the position error.
+ * Recorded from ServerCheckClientError on the game thread, read from anywhere. Each correction also feeds the
+ * STATGROUP_CustomCMC counters and the CustomCMCCorrections CSV category for the frame.
+ * CustomCMC.Net.Corrections logs the totals since the last reset, largest sources first
+ */
+struct CUSTOMCMC_API FMovementCorrectionTelemetry
+{
+	// First match wins, in this order
+	enum class ECause : uint8
+	{
+		// Client and server ended the move in different modes
+		ModeMismatch,
+		// Same final mode, but the server changed mode during the move
+		ModeChange,
+		// Root motion source or montage root motion active, the ledge grab transition among them
+		RootMotion,
+		Hang,
+		Sprint,
+		Other,
+		Num,
+	};
+
+	// Position error in cm: [0,1) [1,2) [2,4) ... [128,256) and 256 or more
+	static constexpr int32 NumErrorBuckets = 10;
+
+	struct FCorrection
+	{
+		FMovementModeCounters::EMode Mode = FMovementModeCounters::EMode::Other;
+		uint8 MovementMode = 0;
+		uint8 CustomMode = 0;
+		float PositionError = 0.f;
+		bool bRootMotion = false;
+		ECause Cause = ECause::Other;
+	};
+
+	static void Record(const FCorrection& Correction);
+	static void Reset();
+	static void Dump();
+
+	static const TCHAR* GetCauseName(ECause Cause);
+	static int32 GetErrorBucket(float PositionError);
+
+private:
+	static constexpr int32 NumModes = static_cast<int32>(FMovementModeCounters::EMode::Num);
+	static constexpr int32 NumCauses = static_cast<int32>(ECause::Num);
+
+	struct FModeTotals
+	{
+		std::atomic<uint64> Corrections[NumCauses] = {};
+		// Summed in hundredths of a cm so it stays an integer
+		std::atomic<uint64> ErrorCentiCm[NumCauses] = {};
+		std::atomic<uint64> RootMotion{0};
+		std::atomic<uint64> ErrorHistogram[NumErrorBuckets] = {};
+	};
+
+	static FModeTotals Totals[NumModes];
+	static std::atomic<uint64> ByMovementMode[MOVE_MAX];
+	static std::atomic<uint64> ByCustomMode[256];
+};
+
+#endif
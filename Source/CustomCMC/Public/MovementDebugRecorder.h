@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+
+// Movement debug recording only exists outside Shipping
+#if !UE_BUILD_SHIPPING
+
+class UWorld;
+
+// CustomCMC.Debug.Movement: 0 off, 1 record, 2 record and draw
+extern CUSTOMCMC_API int32 GCustomCMCMovementDebug;
+
+// One recorded debug shape or message
+struct FMovementDebugEntry
+{
+	enum class EType : uint8
+	{
+		Message,
+		Point,
+		Line,
+		Capsule,
+	};
+
+	EType Type = EType::Message;
+	FColor Color = FColor::White;
+	int32 MessageKey = -1;
+	double Time = 0.0;
+	float Duration = 0.f;
+	float Thickness = 0.f;
+
+	// Point or line start or capsule centre
+	FVector A = FVector::ZeroVector;
+	// Line end, or capsule half height and radius in X and Y
+	FVector B = FVector::ZeroVector;
+
+	FString Message;
+};
+
+/**
+ * Fixed-size ring buffer of debug shapes and messages for one character.
+ * Callers check IsEnabled first, so with the cvar off recording costs a single branch and no string formatting.
+ * Entries are drawn live with CustomCMC.Debug.Movement 2 and written to Saved/MovementDebug by CustomCMC.Debug.DumpMovement
+ */
+class CUSTOMCMC_API FMovementDebugRecorder
+{
+public:
+	static constexpr int32 Capacity = 256;
+
+	static bool IsEnabled() { return GCustomCMCMovementDebug != 0; }
+	static bool ShouldDrawLive() { return GCustomCMCMovementDebug > 1; }
+
+	// Safe to call from the batched probe workers
+	void Message(const FString& Text, const FColor& Color, float Duration, int32 Key = -1);
+	void Point(const FVector& Location, const FColor& Color, float Duration);
+	void Line(const FVector& Start, const FVector& End, const FColor& Color, float Duration, float Thickness = 0.f);
+	void Capsule(const FVector& Center, float HalfHeight, float Radius, const FColor& Color, float Duration);
+
+	// Draws everything recorded since the last call
+	void DrawPending(UWorld* World);
+
+	// Writes the buffer to FilePath, oldest entry first
+	bool Dump(const FString& FilePath) const;
+
+private:
+	// Lock must be held
+	FMovementDebugEntry& Add(FMovementDebugEntry::EType Type, const FColor& Color, float Duration);
+
+	TArray<FMovementDebugEntry> Entries;
+
+	// Next slot to write, entries recorded and drawn so far
+	int32 Head = 0;
+	uint64 NumRecorded = 0;
+	uint64 NumDrawn = 0;
+
+	mutable FCriticalSection Lock;
+};
+
+#endif
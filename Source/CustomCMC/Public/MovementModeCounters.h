@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include <atomic>
+
+class UCharacterMovementComponent;
+class UWorld;
+
+#if !UE_BUILD_SHIPPING
+
+/**
+ * Running totals of movement component tick cost and scene queries, split by movement mode, one set per world
+ * so a server and its PIE clients, or several commandlet worlds, each count their own characters.
+ * Kept outside the stats system so the movement benchmark can read them with stats disabled.
+ * CustomCMC.Net.ServerMoveRate logs the ServerMoves each client sends per second in every mode,
+ * CustomCMC.Net.NetUpdateRate the net updates and bytes each server character sends per second
+ */
+struct CUSTOMCMC_API FMovementModeCounters
+{
+	enum class EMode : uint8
+	{
+		Walking,
+		Falling,
+		// Ledge grab root motion transition, runs in MOVE_Flying
+		Transition,
+		Hang,
+		Other,
+		Num,
+	};
+
+	struct FTotals
+	{
+		std::atomic<uint64> Ticks{0};
+		std::atomic<uint64> Cycles{0};
+		std::atomic<uint64> SceneQueries{0};
+
+		// ServerMoves sent by autonomous clients and the time they spent in the mode
+		std::atomic<uint64> ServerMoves{0};
+		std::atomic<uint64> ClientMicroseconds{0};
+
+		// Net updates of server characters and the time they spent in the mode
+		std::atomic<uint64> NetUpdates{0};
+		std::atomic<uint64> ServerMicroseconds{0};
+
+		// Bits server characters wrote to their actor channels, summed over every connection they replicate to
+		std::atomic<uint64> NetBits{0};
+
+		// Corrections the server sent clients whose characters were in the mode
+		std::atomic<uint64> Corrections{0};
+	};
+
+	static EMode GetMode(const UCharacterMovementComponent& Movement);
+	static const TCHAR* GetModeName(EMode Mode);
+
+	// Counters of World, created on first use and dropped when the world is cleaned up.
+	// Callers on hot paths keep the reference, it stays valid for the world's lifetime
+	static FMovementModeCounters& ForWorld(const UWorld* World);
+	// Every world's counters, for the console commands
+	static void ForEachWorld(TFunctionRef<void(const FString& WorldName, FMovementModeCounters& Counters)> Func);
+	static void ResetAll();
+
+	FTotals& Get(EMode Mode) { return Totals[static_cast<int32>(Mode)]; }
+	const FTotals& Get(EMode Mode) const { return Totals[static_cast<int32>(Mode)]; }
+	void Reset();
+
+private:
+	FTotals Totals[static_cast<int32>(EMode::Num)];
+};
+
+#endif
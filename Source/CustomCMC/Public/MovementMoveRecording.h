@@ -0,0 +1,90 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CustomCharacterMovementComponent.h"
+#include "MovementTestCourse.h"
+
+#if !UE_BUILD_SHIPPING
+
+class UWorld;
+
+/**
+ * The ServerMoves a server ran for each remote character, as UMovementReplayCommandlet feeds them back.
+ * Each move is what the client's FSavedMove_Custom sent: timestamp, acceleration, control rotation, compressed flags
+ * and hang state, plus the delta time the server ran it with. Stored as a small binary file, about 30 bytes a move
+ */
+struct CUSTOMCMC_API FMovementMoveRecording
+{
+	struct FMove
+	{
+		float TimeStamp = 0.f;
+		float DeltaTime = 0.f;
+		FVector3f Acceleration = FVector3f::ZeroVector;
+		// FRotator::CompressAxisToShort
+		uint16 ControlPitch = 0;
+		uint16 ControlYaw = 0;
+		uint16 ControlRoll = 0;
+		uint8 CompressedFlags = 0;
+		FCustomHangState HangState;
+
+		FRotator GetControlRotation() const;
+		void Serialize(FArchive& Ar);
+	};
+
+	// One character, starting at a move made walking or falling without root motion so the replay can set it up from this
+	struct FTrack
+	{
+		FString CharacterClass;
+		FVector StartLocation = FVector::ZeroVector;
+		FRotator StartRotation = FRotator::ZeroRotator;
+		FVector StartVelocity = FVector::ZeroVector;
+		uint8 StartMovementMode = MOVE_Walking;
+		// Where the server had the character when the recording stopped
+		FVector EndLocation = FVector::ZeroVector;
+		TArray<FMove> Moves;
+	};
+
+	// Long package name of the map, without a PIE prefix
+	FString Map;
+
+	// Set when the moves were recorded on a generated FMovementTestCourse, the replay builds the same one
+	bool bHasCourse = false;
+	FMovementTestCourse Course;
+	int32 CourseLanes = 0;
+
+	TArray<FTrack> Tracks;
+
+	bool Save(const FString& Filename);
+	bool Load(const FString& Filename);
+
+private:
+	static constexpr uint32 Magic = 0x524D4D43;
+	static constexpr uint16 Version = 1;
+
+	void Serialize(FArchive& Ar);
+};
+
+/**
+ * Records the ServerMoves of every remote UCustomCharacterMovementComponent in one server world to a FMovementMoveRecording.
+ * CustomCMC.Net.RecordMoves starts and stops it from the console, CustomCMC.Net.Stress Record=1 records each measured profile
+ */
+class CUSTOMCMC_API FMovementMoveRecorder
+{
+public:
+	static bool IsRecording() { return bRecording; }
+
+	static void Start(UWorld* World, const FString& Filename, const FMovementTestCourse* Course = nullptr, int32 CourseLanes = 0);
+	// Writes the file, false if nothing was recording or it could not be written
+	static bool Stop();
+
+	// From MoveAutonomous before the move runs
+	static void RecordMove(const UCustomCharacterMovementComponent& Movement, float TimeStamp, float DeltaTime, uint8 CompressedFlags,
+		const FVector& Acceleration, const FRotator& ControlRotation, const FCustomHangState& HangState);
+
+private:
+	static bool bRecording;
+};
+
+#endif
@@ -0,0 +1,213 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_EDITOR
+
+#include "MovementModeCounters.h"
+#include "MovementTestCourse.h"
+#include "Containers/Ticker.h"
+#include "Engine/EngineBaseTypes.h"
+
+class ACustomCMCCharacter;
+class APlayerController;
+class UWorld;
+
+/**
+ * In-process network stress run for the custom movement, behind the CustomCMC.Net.Stress console command and automation test.
+ * Starts a Play In Editor session under one process with a listen or dedicated server and N clients, builds a course lane per
+ * client in every PIE world and drives each client's autonomous character through it: sprint at a wall, jump, grab the ledge,
+ * shimmy while hanging, jump off and walk back. The session is restarted for every packet emulation profile.
+ * Headless: UnrealEditor CustomCMC.uproject -nullrhi -unattended -ExecCmds="CustomCMC.Net.Stress Clients=8 Quit=1"
+ */
+namespace MovementNetStress
+{
+	struct FProfile
+	{
+		FString Name;
+		// Milliseconds, added in each direction
+		int32 PktLag = 0;
+		int32 PktLagVariance = 0;
+		// Percent of packets
+		int32 PktLoss = 0;
+		int32 PktDup = 0;
+		bool bPktOrder = false;
+	};
+
+	// One client's character, driven on the client so its moves go through prediction
+	struct FBot
+	{
+		enum class EPhase : uint8
+		{
+			Sprint,
+			Jump,
+			Grab,
+			Hang,
+			Release,
+			Return,
+		};
+
+		TWeakObjectPtr<UWorld> World;
+		TWeakObjectPtr<ACustomCMCCharacter> Character;
+		int32 Lane = INDEX_NONE;
+		// Bound at the lane start, so the return check starts the first sprint
+		EPhase Phase = EPhase::Return;
+		float PhaseTime = 0.f;
+
+		// Spreads the bots over the script so they do not all jump on the same frame
+		float StartDelay = 0.f;
+
+		// Stands still at the lane start, for the server's idle client handling
+		bool bIdle = false;
+
+		uint32 Grabs = 0;
+	};
+
+	// One client's connection and character on the server
+	struct FPlayer
+	{
+		TWeakObjectPtr<APlayerController> Controller;
+		TWeakObjectPtr<ACustomCMCCharacter> Character;
+		int32 Lane = INDEX_NONE;
+
+		uint32 CorrectionsAtStart = 0;
+		uint32 Resets = 0;
+
+		// Sums of per frame samples over the measured seconds
+		double InBytesPerSecond = 0.0;
+		double OutBytesPerSecond = 0.0;
+		double LagSeconds = 0.0;
+		int32 Samples = 0;
+	};
+
+	struct FClientResult
+	{
+		int32 Lane = 0;
+		uint32 Corrections = 0;
+		double CorrectionsPerMinute = 0.0;
+		double InBytesPerSecond = 0.0;
+		double OutBytesPerSecond = 0.0;
+		double PingMs = 0.0;
+		uint32 Grabs = 0;
+		uint32 Resets = 0;
+	};
+
+	struct FModeResult
+	{
+		uint64 Corrections = 0;
+		double ServerMovesPerSecond = 0.0;
+		double NetUpdatesPerSecond = 0.0;
+		// Sent by the server per character in the mode, to all connections together
+		double BytesPerSecond = 0.0;
+	};
+
+	struct FRunResult
+	{
+		FProfile Profile;
+		bool bCompleted = false;
+		bool bReplicationGraph = false;
+		bool bPushModel = false;
+		double MeasuredSeconds = 0.0;
+		double ServerMs = 0.0;
+		double MaxServerMs = 0.0;
+		double ServerMsStdDev = 0.0;
+		double ServerMsPerClient = 0.0;
+		// Server ms per frame in ServerReplicateActors, measured with the replication graph only
+		double ReplicateMs = 0.0;
+		TArray<FClientResult> Clients;
+		FModeResult Modes[static_cast<int32>(FMovementModeCounters::EMode::Num)];
+	};
+
+	// Runs every requested profile in turn from the core ticker, takes the console command's arguments
+	class FStressRun
+	{
+	public:
+		explicit FStressRun(const FString& Params);
+		~FStressRun();
+
+		bool IsFinished() const { return !TickerHandle.IsValid(); }
+
+		// One result per requested profile, complete once IsFinished
+		const TArray<FRunResult>& GetResults() const { return Results; }
+		// Every profile completed, the results were written and no client passed MaxCorrectionsPerMinute
+		bool HasPassed() const { return bPassed; }
+
+	private:
+		enum class EState : uint8
+		{
+			Join,
+			Warmup,
+			Measure,
+			Stop,
+		};
+
+		bool Tick(float DeltaTime);
+		void StartProfile();
+		void StopProfile(bool bCompleted);
+		void Finish();
+
+		bool IsJoined(UWorld*& OutServerWorld);
+		void PlaceClients(UWorld* World);
+		void StartMeasuring();
+		void DriveBot(FBot& Bot, float DeltaTime) const;
+		void SamplePlayers();
+		void CollectResult();
+		bool WriteResults() const;
+
+		void OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+		void OnServerPostTickFlush();
+		// Server replication time so far, zero without the replication graph
+		double GetReplicateSeconds() const;
+
+		TArray<FProfile> Profiles;
+		int32 ProfileIndex = 0;
+		int32 NumClients = 8;
+		int32 NumIdleClients = 0;
+		// CustomCMC.Net.MoveBudgetMs for the run, negative leaves it as it is
+		float MoveBudgetMs = -1.f;
+		float PreviousMoveBudgetMs = 0.f;
+		// CustomCMC.Net.HangMoveCoalescing for the run, negative leaves it as it is
+		int32 HangMoveCoalescing = -1;
+		bool bPreviousHangMoveCoalescing = true;
+		// net.IsPushModelEnabled for the run, negative leaves it as it is. Every profile starts a new PIE session,
+		// whose net driver builds its replication layouts with the value set here
+		int32 PushModel = -1;
+		bool bPreviousPushModel = true;
+		bool bDedicatedServer = false;
+		bool bReplicationGraph = true;
+		bool bQuitWhenDone = false;
+		// Records the ServerMoves of each measured profile for UMovementReplayCommandlet
+		bool bRecordMoves = false;
+		float WarmupSeconds = 5.f;
+		float MeasureSeconds = 30.f;
+		float JoinTimeout = 60.f;
+		float MaxCorrectionsPerMinute = -1.f;
+		FString OutputPath;
+
+		// Above the level, so its geometry is out of the way
+		FMovementTestCourse Course;
+		TArray<FTransform> Starts;
+
+		EState State = EState::Join;
+		double StateStartTime = 0.0;
+		TArray<FBot> Bots;
+		TArray<FPlayer> Players;
+		TWeakObjectPtr<UWorld> ServerWorld;
+		FDelegateHandle WorldTickStartHandle;
+		FDelegateHandle PostTickFlushHandle;
+		double ServerTickStart = 0.0;
+		double ServerSeconds = 0.0;
+		double ServerSecondsSquared = 0.0;
+		double MaxServerSeconds = 0.0;
+		int32 ServerFrames = 0;
+		double ReplicateSecondsAtStart = 0.0;
+
+		TArray<FRunResult> Results;
+		bool bPassed = false;
+		FTSTicker::FDelegateHandle TickerHandle;
+	};
+}
+
+#endif
@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "MovementReplayCommandlet.generated.h"
+
+struct FMovementMoveRecording;
+
+/**
+ * Replays ServerMoves recorded by FMovementMoveRecorder straight into UCustomCharacterMovementComponent::MoveAutonomous,
+ * with no networking and no world tick, as fast as they run. Every run spawns the characters afresh, so the same recording
+ * is the same input each time.
+ *
+ * UnrealEditor-Cmd CustomCMC.uproject -run=MovementReplay -Recording=Path/To/File.moves -nullrhi [-Runs=3] [-Tolerance=0]
+ *		[-Output=Path/Without/Extension]
+ *
+ * Writes <Output>.csv with each character's final location per run and <Output>.json with the move cost per mode
+ * (mean, median, 99th percentile and max) and the largest distance between runs. Fails if that is above Tolerance cm
+ */
+UCLASS()
+class CUSTOMCMC_API UMovementReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UMovementReplayCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	struct FRunResult;
+
+	bool RunReplay(UWorld* World, const FMovementMoveRecording& Recording, FRunResult& OutResult) const;
+	bool WriteResults(const FString& OutputPath, const FMovementMoveRecording& Recording, const TArray<FRunResult>& Results, double MaxDivergence) const;
+
+	int32 Runs = 3;
+	float Tolerance = 0.f;
+};
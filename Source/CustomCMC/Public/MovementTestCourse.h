@@ -0,0 +1,26 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+/**
+ * Generated course the movement commandlets drive their bots through: a floor with one lane per bot,
+ * each ending at a wall wide enough to shimmy along its ledge. Building it twice with the same settings
+ * gives the same collision, so server and client worlds can each build their own copy
+ */
+struct CUSTOMCMC_API FMovementTestCourse
+{
+	float LaneWidth = 500.f;
+	float LaneLength = 1000.f;
+	float WallDistance = 600.f;
+	float LedgeHeight = 230.f;
+
+	// Corner of the floor, moved away from the level's own geometry when built into a loaded map
+	FVector Origin = FVector::ZeroVector;
+
+	// Spawns the course, OutStarts gets each lane's start facing the wall
+	void Build(UWorld* World, int32 NumLanes, TArray<FTransform>& OutStarts) const;
+};
@@ -0,0 +1,142 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "PlatformingMovementComponent.generated.h"
+
+class UAnimMontage;
+
+// Which way the wall jump probe looks for a wall
+UENUM(BlueprintType)
+enum class EWallJumpProbe : uint8
+{
+	// Along the direction the character faces
+	Facing,
+	// Along the horizontal input, no input means no wall jump
+	Input,
+};
+
+/**
+ * Double jump, wall jump and dash as predicted movement state.
+ *
+ * The input only raises a one move request that travels in the compressed flags. The client and the server both
+ * resolve it inside the move, so the wall probe, the launch and the dash run on the same inputs on both sides, and
+ * the lockout and dash timers count move time, so a replayed move restores and advances them exactly.
+ */
+UCLASS()
+class CUSTOMCMC_API UPlatformingMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+	class FSavedMove_Platforming : public FSavedMove_Character
+	{
+		enum CompressedFlags
+		{
+			FLAG_Dash		= FLAG_Custom_0,
+			FLAG_AirJump	= FLAG_Custom_1,
+		};
+
+		// Requests
+		uint8 Saved_bWantsToDash:1;
+		uint8 Saved_bWantsToAirJump:1;
+
+		// State at the start of the move, restored before a replay
+		uint8 Saved_bHasDoubleJumped:1;
+		uint8 Saved_bHasWallJumped:1;
+		uint8 Saved_bHasDashed:1;
+		uint8 Saved_bIsDashing:1;
+
+		float Saved_WallJumpLockTime = 0.f;
+		float Saved_DashTimeRemaining = 0.f;
+
+	public:
+		FSavedMove_Platforming();
+
+		virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+		virtual void Clear() override;
+		virtual uint8 GetCompressedFlags() const override;
+		virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData) override;
+		virtual void PrepMoveFor(ACharacter* C) override;
+	};
+
+	class FNetworkPredictionData_Client_Platforming : public FNetworkPredictionData_Client_Character
+	{
+	public:
+		FNetworkPredictionData_Client_Platforming(const UCharacterMovementComponent& ClientMovement);
+
+		typedef FNetworkPredictionData_Client_Character Super;
+
+		virtual FSavedMovePtr AllocateNewMove() override;
+	};
+
+public:
+	// Wall Jump, tunable per placed character as it was on the characters
+	// Distance to probe ahead of the character for a wall to jump from
+	UPROPERTY(EditAnywhere, Category="Wall Jump") float WallJumpTraceDistance = 50.f;
+	// Radius of the probe, zero probes with a line
+	UPROPERTY(EditAnywhere, Category="Wall Jump") float WallJumpTraceRadius = 25.f;
+	UPROPERTY(EditAnywhere, Category="Wall Jump") EWallJumpProbe WallJumpProbe = EWallJumpProbe::Facing;
+	// Speed along the wall normal
+	UPROPERTY(EditAnywhere, Category="Wall Jump") float WallJumpHorizontalImpulse = 800.f;
+	UPROPERTY(EditAnywhere, Category="Wall Jump") float WallJumpVerticalImpulse = 900.f;
+	// Above zero the vertical impulse is JumpZVelocity times this instead, read at the jump so it follows JumpZVelocity
+	UPROPERTY(EditAnywhere, Category="Wall Jump") float WallJumpVerticalJumpZScale = 0.f;
+	// Adds the vertical impulse to the wall normal's own upward part, off replaces it so a leaning wall launches as high as an upright one
+	UPROPERTY(EditAnywhere, Category="Wall Jump") bool bWallJumpKeepsNormalZ = true;
+	// Move time after a wall jump before another one, the character ignores movement input meanwhile
+	UPROPERTY(EditAnywhere, Category="Wall Jump") float WallJumpLockout = 0.1f;
+
+	// Dash
+	// Move time the dash lasts, gravity is off and the montage drives the character meanwhile
+	UPROPERTY(EditDefaultsOnly, Category="Dash") float DashDuration = 0.3f;
+
+	// Set by the owner, played on the client and the server when a dash starts
+	UPROPERTY(Transient) TObjectPtr<UAnimMontage> DashMontage;
+
+	// Cosmetic, broadcast outside of replays
+	FSimpleMulticastDelegate OnAirJumped;
+	FSimpleMulticastDelegate OnDashEnded;
+
+	// Input, the request is resolved in the next move
+	void DashPressed();
+	void AirJumpPressed();
+
+	UFUNCTION(BlueprintPure) bool HasDoubleJumped() const { return bHasDoubleJumped; }
+	UFUNCTION(BlueprintPure) bool HasWallJumped() const { return bHasWallJumped; }
+	UFUNCTION(BlueprintPure) bool HasDashed() const { return bHasDashed; }
+	UFUNCTION(BlueprintPure) bool IsDashing() const { return bIsDashing; }
+
+	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+	virtual float GetGravityZ() const override;
+	virtual bool CanAttemptJump() const override;
+
+protected:
+	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+	virtual void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
+	virtual void ProcessLanded(const FHitResult& Hit, float remainingTime, int32 Iterations) override;
+
+private:
+	void TickAbilityTimers(float DeltaSeconds);
+	void StartDash();
+	void EndDash();
+	void AirJump();
+	bool TryWallJump();
+	bool TryDoubleJump();
+
+	// True outside of a client replay, cosmetics only run then
+	bool IsPlayingNewMove() const;
+
+	// Requests, one move long
+	bool bWantsToDash = false;
+	bool bWantsToAirJump = false;
+
+	bool bHasDoubleJumped = false;
+	bool bHasWallJumped = false;
+	bool bHasDashed = false;
+	bool bIsDashing = false;
+
+	float WallJumpLockTime = 0.f;
+	float DashTimeRemaining = 0.f;
+};
@@ -0,0 +1,80 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ServerMoveScheduler.generated.h"
+
+class UCustomCharacterMovementComponent;
+
+/**
+ * Holds the server's UCustomCharacterMovementComponent ServerMove processing to a per frame time budget.
+ *
+ * A move from an active client runs as it arrives while the frame's budget lasts. After that, and for every move
+ * of a client standing or hanging still, the move waits in its component in arrival order. Once the frame's packets
+ * are in, the waiting clients run in priority order until the budget is spent: overdue first, then contested
+ * (another character close by), then active, then idle. Idle clients run at most every CustomCMC.Net.IdleMoveIntervalMs,
+ * their identical standing still moves folded into the last one, whose timestamp covers the time of the folded ones.
+ * No client waits longer than CustomCMC.Net.MaxMoveDeferMs, so no move is dropped and timestamps stay in order.
+ * CustomCMC.Net.MoveBudgetMs 0 turns it off
+ */
+UCLASS()
+class CUSTOMCMC_API UServerMoveScheduler : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	// Times the moves run inside it against the frame's budget
+	struct FScopedCharge
+	{
+		explicit FScopedCharge(UServerMoveScheduler& InScheduler);
+		~FScopedCharge();
+
+		UServerMoveScheduler& Scheduler;
+		double StartTime;
+	};
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	void RegisterComponent(UCustomCharacterMovementComponent* Component);
+	void UnregisterComponent(UCustomCharacterMovementComponent* Component);
+
+	// Only on servers with CustomCMC.Net.MoveBudgetMs above 0
+	bool IsActive() const;
+	bool HasBudget() const;
+
+	// The component holds a move, an active one runs right away while the budget lasts
+	void MarkWaiting(UCustomCharacterMovementComponent* Component, bool bIdle);
+
+private:
+	void OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds);
+	// Runs after the frame's packets are in and before anything ticks
+	void RunWaiting();
+
+	bool IsContested(const UCustomCharacterMovementComponent& Component) const;
+
+	UPROPERTY(Transient)
+	TArray<TObjectPtr<UCustomCharacterMovementComponent>> Components;
+
+	// Components holding moves, each listed once
+	TArray<UCustomCharacterMovementComponent*> Waiting;
+
+	struct FCandidate
+	{
+		UCustomCharacterMovementComponent* Component;
+		double Age;
+		int32 Priority;
+	};
+	// Kept to avoid reallocating every frame
+	TArray<FCandidate> Candidates;
+
+	// ServerMove time spent this frame
+	double FrameSeconds = 0.0;
+
+	FDelegateHandle WorldTickStartHandle;
+	FDelegateHandle PostTickDispatchHandle;
+};
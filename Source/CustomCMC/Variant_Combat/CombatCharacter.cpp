@@ -2,6 +2,7 @@
 
 
 #include "CombatCharacter.h"
+#include "CustomCMC.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/WidgetComponent.h"
 #include "GameFramework/CharacterMovementComponent.h"
@@ -11,6 +12,7 @@
 #include "EnhancedInputSubsystems.h"
 #include "EnhancedInputComponent.h"
 #include "CombatLifeBar.h"
+#include "CombatHitboxHistory.h"
 #include "Engine/DamageEvents.h"
 #include "TimerManager.h"
 #include "Engine/LocalPlayer.h"
@@ -172,7 +174,10 @@ void ACombatCharacter::ResetHP()
 	CurrentHP = MaxHP;
 
 	// update the life bar
-	LifeBarWidget->SetLifePercentage(1.0f);
+	if (LifeBarWidget)
+	{
+		LifeBarWidget->SetLifePercentage(1.0f);
+	}
 }
 
 void ACombatCharacter::ComboAttack()
@@ -256,15 +261,8 @@ void ACombatCharacter::DoAttackTrace(FName DamageSourceBone)
 	ObjectParams.AddObjectTypesToQuery(ECC_Pawn);
 	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
 
-	// use a sphere shape for the sweep
-	FCollisionShape CollisionShape;
-	CollisionShape.SetSphere(MeleeTraceRadius);
-
-	// ignore self
-	FCollisionQueryParams QueryParams;
-	QueryParams.AddIgnoredActor(this);
-
-	if (GetWorld()->SweepMultiByObjectType(OutHits, TraceStart, TraceEnd, FQuat::Identity, ObjectParams, CollisionShape, QueryParams))
+	// sweep a sphere, rewound to what a remote player saw, ignoring self
+	if (UCombatHitboxHistorySubsystem::SweepMelee(this, OutHits, TraceStart, TraceEnd, MeleeTraceRadius, ObjectParams))
 	{
 		// iterate over each object hit
 		for (const FHitResult& CurrentHit : OutHits)
@@ -400,7 +398,10 @@ float ACombatCharacter::TakeDamage(float Damage, struct FDamageEvent const& Dama
 	else
 	{
 		// update the life bar
-		LifeBarWidget->SetLifePercentage(CurrentHP / MaxHP);
+		if (LifeBarWidget)
+		{
+			LifeBarWidget->SetLifePercentage(CurrentHP / MaxHP);
+		}
 
 		// enable partial ragdoll physics, but keep the pelvis vertical
 		GetMesh()->SetPhysicsBlendWeight(0.5f);
@@ -427,18 +428,27 @@ void ACombatCharacter::BeginPlay()
 {
 	Super::BeginPlay();
 
-	// get the life bar from the widget component
-	LifeBarWidget = Cast<UCombatLifeBar>(LifeBar->GetUserWidgetObject());
-	check(LifeBarWidget);
-
 	// initialize the camera
 	GetCameraBoom()->TargetArmLength = DefaultCameraDistance;
 
 	// save the relative transform for the mesh so we can reset the ragdoll later
 	MeshStartingTransform = GetMesh()->GetRelativeTransform();
 
-	// set the life bar color
-	LifeBarWidget->SetBarColor(LifeBarColor);
+	if (CustomCMC::ShouldRunCosmetics(this))
+	{
+		// get the life bar from the widget component
+		LifeBarWidget = Cast<UCombatLifeBar>(LifeBar->GetUserWidgetObject());
+		check(LifeBarWidget);
+
+		// set the life bar color
+		LifeBarWidget->SetBarColor(LifeBarColor);
+	}
+	else
+	{
+		// dedicated servers have no life bar widget and no one looking through the camera
+		LifeBar->SetComponentTickEnabled(false);
+		GetCameraBoom()->SetComponentTickEnabled(false);
+	}
 
 	// reset HP to maximum
 	ResetHP();
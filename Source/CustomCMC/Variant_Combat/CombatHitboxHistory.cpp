@@ -0,0 +1,393 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CombatHitboxHistory.h"
+#include "CustomCMC.h"
+#include "CombatDamageable.h"
+#include "Components/CapsuleComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/PlayerState.h"
+#include "HAL/IConsoleManager.h"
+
+static TAutoConsoleVariable<bool> CVarLagCompensation(
+	TEXT("Combat.LagCompensation"),
+	true,
+	TEXT("Rewinds melee sweeps of remote players to the positions they saw, from the hitbox history the server keeps"));
+
+static TAutoConsoleVariable<float> CVarMaxRewindMs(
+	TEXT("Combat.LagCompensation.MaxRewindMs"),
+	250.f,
+	TEXT("Furthest back a melee sweep is rewound, a player with a worse connection hits slightly behind what they saw"));
+
+static TAutoConsoleVariable<float> CVarInterpDelayMs(
+	TEXT("Combat.LagCompensation.InterpDelayMs"),
+	100.f,
+	TEXT("How far behind the server a client shows other characters on top of its ping, the simulated proxy smoothing time"));
+
+DECLARE_CYCLE_STAT(TEXT("Hitbox History Sample"), STAT_HitboxHistorySample, STATGROUP_CustomCMC);
+DECLARE_CYCLE_STAT(TEXT("Hitbox History Sweep"), STAT_HitboxHistorySweep, STATGROUP_CustomCMC);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hitbox History Actors"), STAT_HitboxHistoryActors, STATGROUP_CustomCMC);
+
+int32 FCombatHitboxHistory::AddSlot(float Radius, float HalfHeight, uint32 ObjectTypeBit)
+{
+	check(ObjectTypeBit != 0);
+
+	int32 Slot;
+	if (FreeSlots.Num() > 0)
+	{
+		Slot = FreeSlots.Pop(EAllowShrinking::No);
+	}
+	else
+	{
+		Slot = SlotRadius.AddUninitialized();
+		SlotHalfHeight.AddUninitialized();
+		SlotObjectTypeBit.AddUninitialized();
+		SlotFirstSample.AddUninitialized();
+
+		if (Slot >= Stride)
+		{
+			Grow(FMath::Max(Stride * 2, 16));
+		}
+	}
+
+	SlotRadius[Slot] = Radius;
+	SlotHalfHeight[Slot] = FMath::Max(HalfHeight, Radius);
+	SlotObjectTypeBit[Slot] = ObjectTypeBit;
+	SlotFirstSample[Slot] = NextSerial;
+	return Slot;
+}
+
+void FCombatHitboxHistory::RemoveSlot(int32 Slot)
+{
+	SlotObjectTypeBit[Slot] = 0;
+	FreeSlots.Add(Slot);
+}
+
+void FCombatHitboxHistory::Grow(int32 NewStride)
+{
+	auto Relayout = [this, NewStride](TArray<float>& Values)
+	{
+		TArray<float> NewValues;
+		NewValues.SetNumZeroed(Capacity * NewStride);
+		for (int32 Sample = 0; Sample < Capacity && Stride > 0; ++Sample)
+		{
+			FMemory::Memcpy(&NewValues[Sample * NewStride], &Values[Sample * Stride], Stride * sizeof(float));
+		}
+		Values = MoveTemp(NewValues);
+	};
+
+	Relayout(CenterX);
+	Relayout(CenterY);
+	Relayout(CenterZ);
+	Stride = NewStride;
+}
+
+void FCombatHitboxHistory::AddSample(double Time, TConstArrayView<FVector> Centers)
+{
+	check(Centers.Num() <= Stride);
+
+	NewestIndex = (NewestIndex + 1) % Capacity;
+	NumSamples = FMath::Min(NumSamples + 1, Capacity);
+	SampleTime[NewestIndex] = Time;
+	SampleSerial[NewestIndex] = NextSerial++;
+
+	float* X = CenterX.GetData() + NewestIndex * Stride;
+	float* Y = CenterY.GetData() + NewestIndex * Stride;
+	float* Z = CenterZ.GetData() + NewestIndex * Stride;
+	for (int32 Slot = 0; Slot < Centers.Num(); ++Slot)
+	{
+		X[Slot] = Centers[Slot].X;
+		Y[Slot] = Centers[Slot].Y;
+		Z[Slot] = Centers[Slot].Z;
+	}
+}
+
+double FCombatHitboxHistory::GetNewestTime() const
+{
+	return SampleTime[NewestIndex];
+}
+
+double FCombatHitboxHistory::GetOldestTime() const
+{
+	return SampleTime[GetRingIndex(NumSamples - 1)];
+}
+
+void FCombatHitboxHistory::SweepSphere(double Time, const FVector& Start, const FVector& End, float Radius, uint32 ObjectTypeBits, int32 IgnoredSlot, TArray<FHit>& OutHits) const
+{
+	if (NumSamples == 0) return;
+
+	// the samples around Time, Newer is one younger than Older unless Time is outside the history
+	int32 OlderAge = 0;
+	if (Time < GetNewestTime() && NumSamples > 1)
+	{
+		// sample times fall with age, find the youngest at or before Time
+		int32 Low = 1;
+		int32 High = NumSamples - 1;
+		while (Low < High)
+		{
+			const int32 Mid = (Low + High) / 2;
+			if (SampleTime[GetRingIndex(Mid)] <= Time)
+			{
+				High = Mid;
+			}
+			else
+			{
+				Low = Mid + 1;
+			}
+		}
+		OlderAge = Low;
+	}
+	const int32 NewerAge = FMath::Max(OlderAge - 1, 0);
+
+	const int32 Older = GetRingIndex(OlderAge);
+	const int32 Newer = GetRingIndex(NewerAge);
+	const double TimeSpan = SampleTime[Newer] - SampleTime[Older];
+	const float Alpha = TimeSpan > 0.0 ? float(FMath::Clamp((Time - SampleTime[Older]) / TimeSpan, 0.0, 1.0)) : 0.f;
+
+	const float* OlderX = CenterX.GetData() + Older * Stride;
+	const float* OlderY = CenterY.GetData() + Older * Stride;
+	const float* OlderZ = CenterZ.GetData() + Older * Stride;
+	const float* NewerX = CenterX.GetData() + Newer * Stride;
+	const float* NewerY = CenterY.GetData() + Newer * Stride;
+	const float* NewerZ = CenterZ.GetData() + Newer * Stride;
+
+	for (int32 Slot = 0; Slot < SlotRadius.Num(); ++Slot)
+	{
+		if ((SlotObjectTypeBit[Slot] & ObjectTypeBits) == 0 || Slot == IgnoredSlot) continue;
+
+		// a slot added after the older sample only has the newer one
+		if (SlotFirstSample[Slot] > SampleSerial[Newer]) continue;
+		const float SlotAlpha = SlotFirstSample[Slot] > SampleSerial[Older] ? 1.f : Alpha;
+
+		FCapsule Capsule;
+		Capsule.Center = FVector(
+			FMath::Lerp(OlderX[Slot], NewerX[Slot], SlotAlpha),
+			FMath::Lerp(OlderY[Slot], NewerY[Slot], SlotAlpha),
+			FMath::Lerp(OlderZ[Slot], NewerZ[Slot], SlotAlpha));
+		Capsule.Radius = SlotRadius[Slot];
+		Capsule.HalfHeight = SlotHalfHeight[Slot];
+
+		FHit Hit;
+		if (SweepSphereCapsule(Start, End, Radius, Capsule, Hit))
+		{
+			Hit.Slot = Slot;
+			OutHits.Add(Hit);
+		}
+	}
+}
+
+bool FCombatHitboxHistory::SweepSphereCapsule(const FVector& Start, const FVector& End, float Radius, const FCapsule& Capsule, FHit& OutHit)
+{
+	// the sphere touches the capsule where the sweep passes within both radii of the capsule's segment
+	const FVector SegmentOffset = FVector(0.f, 0.f, Capsule.HalfHeight - Capsule.Radius);
+	FVector SweepPoint, CapsulePoint;
+	FMath::SegmentDistToSegmentSafe(Start, End, Capsule.Center - SegmentOffset, Capsule.Center + SegmentOffset, SweepPoint, CapsulePoint);
+
+	const FVector Offset = SweepPoint - CapsulePoint;
+	if (Offset.SizeSquared() > FMath::Square(Radius + Capsule.Radius)) return false;
+
+	// a sweep through the axis pushes back towards where it started
+	FVector Normal = Offset.GetSafeNormal();
+	if (Normal.IsZero())
+	{
+		Normal = (Start - CapsulePoint).GetSafeNormal2D();
+		if (Normal.IsZero())
+		{
+			Normal = FVector::ForwardVector;
+		}
+	}
+
+	OutHit.ImpactNormal = Normal;
+	OutHit.ImpactPoint = CapsulePoint + Normal * Capsule.Radius;
+	return true;
+}
+
+bool UCombatHitboxHistorySubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	if (!Super::ShouldCreateSubsystem(Outer)) return false;
+
+	const UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld();
+}
+
+void UCombatHitboxHistorySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	UWorld* World = GetWorld();
+	ActorSpawnedHandle = World->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UCombatHitboxHistorySubsystem::OnActorSpawned));
+	ActorDestroyedHandle = World->AddOnActorDestroyedHandler(FOnActorDestroyed::FDelegate::CreateUObject(this, &UCombatHitboxHistorySubsystem::OnActorDestroyed));
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddUObject(this, &UCombatHitboxHistorySubsystem::OnWorldPostActorTick);
+}
+
+void UCombatHitboxHistorySubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// actors placed in the level were not spawned through the handler
+	for (TActorIterator<AActor> It(&InWorld); It; ++It)
+	{
+		TrackActor(*It);
+	}
+}
+
+void UCombatHitboxHistorySubsystem::Deinitialize()
+{
+	UWorld* World = GetWorld();
+	World->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+	World->RemoveOnActorDestroyededHandler(ActorDestroyedHandle);
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+
+	ActorSlots.Reset();
+	SlotActors.Reset();
+	SlotComponents.Reset();
+	SlotLocalCenters.Reset();
+
+	Super::Deinitialize();
+}
+
+void UCombatHitboxHistorySubsystem::OnActorSpawned(AActor* Actor)
+{
+	TrackActor(Actor);
+}
+
+void UCombatHitboxHistorySubsystem::OnActorDestroyed(AActor* Actor)
+{
+	UntrackActor(Actor);
+}
+
+void UCombatHitboxHistorySubsystem::TrackActor(AActor* Actor)
+{
+	if (!Actor || !Actor->Implements<UCombatDamageable>() || ActorSlots.Contains(Actor)) return;
+
+	// characters are hit on their capsule, anything else on its largest colliding part
+	UPrimitiveComponent* Component = Cast<UCapsuleComponent>(Actor->GetRootComponent());
+	if (!Component)
+	{
+		float LargestRadius = 0.f;
+		Actor->ForEachComponent<UPrimitiveComponent>(false, [&Component, &LargestRadius](UPrimitiveComponent* Primitive)
+		{
+			if (Primitive->IsQueryCollisionEnabled() && Primitive->Bounds.SphereRadius > LargestRadius)
+			{
+				Component = Primitive;
+				LargestRadius = Primitive->Bounds.SphereRadius;
+			}
+		});
+	}
+	if (!Component) return;
+
+	float Radius, HalfHeight;
+	FVector LocalCenter = FVector::ZeroVector;
+	if (const UCapsuleComponent* Capsule = Cast<UCapsuleComponent>(Component))
+	{
+		Capsule->GetScaledCapsuleSize(Radius, HalfHeight);
+	}
+	else
+	{
+		// an upright capsule through the bounds, it stays upright as the part rotates
+		const FBoxSphereBounds LocalBounds = Component->CalcBounds(FTransform::Identity);
+		const FVector Extent = LocalBounds.BoxExtent * Component->GetComponentScale().GetAbs();
+		LocalCenter = LocalBounds.Origin;
+		Radius = FMath::Max(Extent.X, Extent.Y);
+		HalfHeight = Extent.Z;
+	}
+
+	const int32 Slot = History.AddSlot(Radius, HalfHeight, ECC_TO_BITFIELD(Component->GetCollisionObjectType()));
+	if (Slot >= SlotActors.Num())
+	{
+		SlotActors.SetNum(Slot + 1);
+		SlotComponents.SetNum(Slot + 1);
+		SlotLocalCenters.SetNum(Slot + 1);
+	}
+	SlotActors[Slot] = Actor;
+	SlotComponents[Slot] = Component;
+	SlotLocalCenters[Slot] = LocalCenter;
+	ActorSlots.Add(Actor, Slot);
+}
+
+void UCombatHitboxHistorySubsystem::UntrackActor(AActor* Actor)
+{
+	int32 Slot;
+	if (!ActorSlots.RemoveAndCopyValue(Actor, Slot)) return;
+
+	History.RemoveSlot(Slot);
+	SlotActors[Slot].Reset();
+	SlotComponents[Slot].Reset();
+}
+
+FVector UCombatHitboxHistorySubsystem::GetCenter(int32 Slot) const
+{
+	const UPrimitiveComponent* Component = SlotComponents[Slot].Get();
+	return Component ? Component->GetComponentTransform().TransformPosition(SlotLocalCenters[Slot]) : FVector::ZeroVector;
+}
+
+void UCombatHitboxHistorySubsystem::OnWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+	// only the server judges hits
+	if (InWorld != GetWorld() || InWorld->GetNetMode() == NM_Client || !CVarLagCompensation.GetValueOnGameThread()) return;
+
+	CUSTOMCMC_SCOPE(STAT_HitboxHistorySample);
+	SET_DWORD_STAT(STAT_HitboxHistoryActors, ActorSlots.Num());
+
+	Centers.SetNumUninitialized(History.GetNumSlots(), EAllowShrinking::No);
+	for (int32 Slot = 0; Slot < Centers.Num(); ++Slot)
+	{
+		Centers[Slot] = History.IsSlotUsed(Slot) ? GetCenter(Slot) : FVector::ZeroVector;
+	}
+	History.AddSample(InWorld->GetTimeSeconds(), Centers);
+}
+
+double UCombatHitboxHistorySubsystem::GetViewTime(const AActor* Attacker) const
+{
+	const double Now = GetWorld()->GetTimeSeconds();
+
+	const APawn* Pawn = Cast<APawn>(Attacker);
+	const APlayerController* PlayerController = Pawn ? Cast<APlayerController>(Pawn->GetController()) : nullptr;
+	if (!PlayerController || PlayerController->IsLocalController() || !PlayerController->PlayerState) return Now;
+
+	// the ping is a round trip: the client's positions left the server half of it ago, and its attack took the other half to arrive
+	const float RewindMs = PlayerController->PlayerState->GetPingInMilliseconds() + CVarInterpDelayMs.GetValueOnGameThread();
+	return Now - FMath::Clamp(RewindMs, 0.f, CVarMaxRewindMs.GetValueOnGameThread()) * 0.001;
+}
+
+bool UCombatHitboxHistorySubsystem::SweepMelee(const AActor* Attacker, TArray<FHitResult>& OutHits, const FVector& Start, const FVector& End, float Radius,
+	const FCollisionObjectQueryParams& ObjectParams)
+{
+	UWorld* World = Attacker->GetWorld();
+	const UCombatHitboxHistorySubsystem* Subsystem = World->GetSubsystem<UCombatHitboxHistorySubsystem>();
+
+	const bool bRewind = Subsystem && CVarLagCompensation.GetValueOnGameThread() && World->GetNetMode() != NM_Client && !Subsystem->History.IsEmpty();
+	const double ViewTime = bRewind ? Subsystem->GetViewTime(Attacker) : 0.0;
+
+	// anyone who sees the present is swept against the world as it is
+	if (!bRewind || ViewTime >= Subsystem->History.GetNewestTime())
+	{
+		FCollisionQueryParams QueryParams;
+		QueryParams.AddIgnoredActor(Attacker);
+		return World->SweepMultiByObjectType(OutHits, Start, End, FQuat::Identity, ObjectParams, FCollisionShape::MakeSphere(Radius), QueryParams);
+	}
+
+	CUSTOMCMC_SCOPE(STAT_HitboxHistorySweep);
+
+	const int32* AttackerSlot = Subsystem->ActorSlots.Find(Attacker);
+
+	TArray<FCombatHitboxHistory::FHit, TInlineAllocator<8>> Hits;
+	Subsystem->History.SweepSphere(ViewTime, Start, End, Radius, uint32(ObjectParams.GetQueryBitfield()), AttackerSlot ? *AttackerSlot : INDEX_NONE, Hits);
+
+	for (const FCombatHitboxHistory::FHit& Hit : Hits)
+	{
+		AActor* Actor = Subsystem->SlotActors[Hit.Slot].Get();
+		UPrimitiveComponent* Component = Subsystem->SlotComponents[Hit.Slot].Get();
+		if (!Actor || !Component) continue;
+
+		FHitResult& HitResult = OutHits.Emplace_GetRef(Actor, Component, Hit.ImpactPoint, Hit.ImpactNormal);
+		HitResult.TraceStart = Start;
+		HitResult.TraceEnd = End;
+	}
+
+	return OutHits.Num() > 0;
+}
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CombatHitboxHistory.generated.h"
+
+class UPrimitiveComponent;
+struct FCollisionObjectQueryParams;
+
+/**
+ *  Past positions of a set of upright hit capsules, for rewinding melee sweeps.
+ *  A fixed ring of samples, each one all capsules' centers at one time. Centers are stored structure of arrays,
+ *  sample major, so a rewind reads one contiguous run of X, Y and Z per sample
+ */
+struct FCombatHitboxHistory
+{
+	/** Samples kept, about a second at 60 Hz */
+	static constexpr int32 Capacity = 64;
+
+	struct FCapsule
+	{
+		FVector Center = FVector::ZeroVector;
+		float Radius = 0.0f;
+		float HalfHeight = 0.0f;
+	};
+
+	struct FHit
+	{
+		int32 Slot = INDEX_NONE;
+		FVector ImpactPoint = FVector::ZeroVector;
+		/** Out of the capsule, towards the sweep */
+		FVector ImpactNormal = FVector::ZeroVector;
+	};
+
+	/** Adds a capsule, it is part of samples from the next one on */
+	int32 AddSlot(float Radius, float HalfHeight, uint32 ObjectTypeBit);
+	void RemoveSlot(int32 Slot);
+	int32 GetNumSlots() const { return SlotRadius.Num(); }
+	bool IsSlotUsed(int32 Slot) const { return SlotObjectTypeBit[Slot] != 0; }
+
+	/** Records every slot's center at Time, Centers is indexed by slot. Times must increase */
+	void AddSample(double Time, TConstArrayView<FVector> Centers);
+
+	bool IsEmpty() const { return NumSamples == 0; }
+	double GetNewestTime() const;
+	double GetOldestTime() const;
+
+	/**
+	 *  Sweeps a sphere from Start to End against the capsules as they were at Time, interpolated between the two samples around it.
+	 *  Times outside the history use the oldest or newest sample. Only slots whose object type is in ObjectTypeBits are tested
+	 */
+	void SweepSphere(double Time, const FVector& Start, const FVector& End, float Radius, uint32 ObjectTypeBits, int32 IgnoredSlot, TArray<FHit>& OutHits) const;
+
+	/** Sphere sweep against one upright capsule */
+	static bool SweepSphereCapsule(const FVector& Start, const FVector& End, float Radius, const FCapsule& Capsule, FHit& OutHit);
+
+private:
+	/** Ring index of the Age'th newest sample */
+	int32 GetRingIndex(int32 Age) const { return (NewestIndex - Age + Capacity) % Capacity; }
+
+	/** Grows the per sample arrays to a larger slot stride */
+	void Grow(int32 NewStride);
+
+	// Per slot
+	TArray<float> SlotRadius;
+	TArray<float> SlotHalfHeight;
+	// ECC_TO_BITFIELD of the slot's object type, 0 for a free slot
+	TArray<uint32> SlotObjectTypeBit;
+	// Serial of the first sample the slot is in
+	TArray<uint64> SlotFirstSample;
+	TArray<int32> FreeSlots;
+
+	// Per sample
+	double SampleTime[Capacity] = {};
+	uint64 SampleSerial[Capacity] = {};
+
+	// Capacity * Stride, a sample's slots are contiguous
+	TArray<float> CenterX;
+	TArray<float> CenterY;
+	TArray<float> CenterZ;
+	int32 Stride = 0;
+
+	int32 NewestIndex = Capacity - 1;
+	int32 NumSamples = 0;
+	uint64 NextSerial = 0;
+};
+
+/**
+ *  Keeps a FCombatHitboxHistory of every ICombatDamageable actor in the world, sampled after the actors tick,
+ *  and runs melee sweeps against it at the time the attacker saw.
+ *  A remote player's view lags the server by their round trip plus the simulated proxy smoothing, so the sweep rewinds that far,
+ *  up to Combat.LagCompensation.MaxRewindMs. Local players and AI see the present and sweep the current positions
+ */
+UCLASS()
+class UCombatHitboxHistorySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	/**
+	 *  Melee sweep for an attacker, against the rewound hitboxes when lag compensation is on, otherwise against the world.
+	 *  Hits carry the actor, impact point and impact normal. The attacker is ignored
+	 */
+	static bool SweepMelee(const AActor* Attacker, TArray<FHitResult>& OutHits, const FVector& Start, const FVector& End, float Radius,
+		const FCollisionObjectQueryParams& ObjectParams);
+
+	/** Server time the attacker was looking at */
+	double GetViewTime(const AActor* Attacker) const;
+
+protected:
+
+	void OnActorSpawned(AActor* Actor);
+	void OnActorDestroyed(AActor* Actor);
+	void OnWorldPostActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+
+	void TrackActor(AActor* Actor);
+	void UntrackActor(AActor* Actor);
+
+	/** Where the slot's capsule is now */
+	FVector GetCenter(int32 Slot) const;
+
+	FCombatHitboxHistory History;
+
+	/** Per slot, what the capsule follows. The actor's root capsule, otherwise its largest colliding primitive */
+	TArray<TWeakObjectPtr<AActor>> SlotActors;
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> SlotComponents;
+	/** Bounds center in the component's space, zero for capsules */
+	TArray<FVector> SlotLocalCenters;
+
+	TMap<TWeakObjectPtr<AActor>, int32> ActorSlots;
+
+	/** Kept to avoid reallocating every frame */
+	TArray<FVector> Centers;
+
+	FDelegateHandle ActorSpawnedHandle;
+	FDelegateHandle ActorDestroyedHandle;
+	FDelegateHandle PostActorTickHandle;
+};
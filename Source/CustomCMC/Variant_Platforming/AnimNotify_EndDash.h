@@ -7,7 +7,9 @@
 #include "AnimNotify_EndDash.generated.h"
 
 /**
- *  AnimNotify to finish the dash animation and restore player control
+ *  AnimNotify marking where the dash animation finishes and player control is restored.
+ *  APlatformingCharacter reads its time to set how long the predicted dash lasts.
+ *  It only marks a time: the movement component ends the dash on move time so the server and replays agree on it
  */
 UCLASS()
 class UAnimNotify_EndDash : public UAnimNotify
@@ -16,9 +18,6 @@ class UAnimNotify_EndDash : public UAnimNotify
 	
 public:
 
-	/** Perform the Anim Notify */
-	virtual void Notify(USkeletalMeshComponent* MeshComp, UAnimSequenceBase* Animation, const FAnimNotifyEventReference& EventReference) override;
-
 	/** Get the notify name */
 	virtual FString GetNotifyName_Implementation() const override;
 };
@@ -3,29 +3,23 @@
 
 #include "PlatformingCharacter.h"
 
+#include "CustomCMC.h"
+#include "AnimNotify_EndDash.h"
+#include "PlatformingMovementComponent.h"
+#include "Animation/AnimMontage.h"
 #include "Components/CapsuleComponent.h"
-#include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "Camera/CameraComponent.h"
 #include "EnhancedInputSubsystems.h"
 #include "EnhancedInputComponent.h"
-#include "TimerManager.h"
 #include "Engine/LocalPlayer.h"
 
-APlatformingCharacter::APlatformingCharacter()
+APlatformingCharacter::APlatformingCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UPlatformingMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
  	PrimaryActorTick.bCanEverTick = true;
 
-	// initialize the flags
-	bHasWallJumped = false;
-	bHasDoubleJumped = false;
-	bHasDashed = false;
-	bIsDashing = false;
-
-	// bind the attack montage ended delegate
-	OnDashMontageEnded.BindUObject(this, &APlatformingCharacter::DashMontageEnded);
-
 	// enable press and hold jump
 	JumpMaxHoldTime = 0.4f;
 
@@ -60,6 +54,16 @@ APlatformingCharacter::APlatformingCharacter()
 	GetCharacterMovement()->NavAgentProps.AgentRadius = 42.0;
 	GetCharacterMovement()->NavAgentProps.AgentHeight = 192.0;
 
+	// wall jump off the wall the character faces
+	UPlatformingMovementComponent* PlatformingMovement = GetPlatformingMovement();
+	PlatformingMovement->WallJumpProbe = EWallJumpProbe::Facing;
+	PlatformingMovement->WallJumpTraceDistance = 50.0f;
+	PlatformingMovement->WallJumpTraceRadius = 25.0f;
+	PlatformingMovement->WallJumpHorizontalImpulse = 800.0f;
+	PlatformingMovement->WallJumpVerticalImpulse = 900.0f;
+	PlatformingMovement->bWallJumpKeepsNormalZ = true;
+	PlatformingMovement->WallJumpLockout = 0.1f;
+
 	// create the camera boom
 	CameraBoom = CreateDefaultSubobject<USpringArmComponent>(TEXT("CameraBoom"));
 	CameraBoom->SetupAttachment(RootComponent);
@@ -102,66 +106,17 @@ void APlatformingCharacter::Dash()
 
 void APlatformingCharacter::MultiJump()
 {
+	UPlatformingMovementComponent* PlatformingMovement = GetPlatformingMovement();
+
 	// ignore jumps while dashing
-	if(bIsDashing)
+	if (PlatformingMovement->IsDashing())
 		return;
 
 	// are we already in the air?
-	if (GetCharacterMovement()->IsFalling())
+	if (PlatformingMovement->IsFalling())
 	{
-
-		// have we already wall jumped?
-		if (!bHasWallJumped)
-		{
-			// run a sphere sweep to check if we're in front of a wall
-			FHitResult OutHit;
-
-			const FVector TraceStart = GetActorLocation();
-			const FVector TraceEnd = TraceStart + (GetActorForwardVector() * WallJumpTraceDistance);
-			const FCollisionShape TraceShape = FCollisionShape::MakeSphere(WallJumpTraceRadius);
-
-			FCollisionQueryParams QueryParams;
-			QueryParams.AddIgnoredActor(this);
-
-			if (GetWorld()->SweepSingleByChannel(OutHit, TraceStart, TraceEnd, FQuat(), ECollisionChannel::ECC_Visibility, TraceShape, QueryParams))
-			{
-				// rotate the character to face away from the wall, so we're correctly oriented for the next wall jump
-				FRotator WallOrientation = OutHit.ImpactNormal.ToOrientationRotator();
-				WallOrientation.Pitch = 0.0f;
-				WallOrientation.Roll = 0.0f;
-
-				SetActorRotation(WallOrientation);
-
-				// apply a launch impulse to the character to perform the actual wall jump
-				const FVector WallJumpImpulse = (OutHit.ImpactNormal * WallJumpBounceImpulse) + (FVector::UpVector * WallJumpVerticalImpulse);
-
-				LaunchCharacter(WallJumpImpulse, true, true);
-
-				// enable the jump trail
-				SetJumpTrailState(true);
-
-				// raise the wall jump flag to prevent an immediate second wall jump
-				bHasWallJumped = true;
-
-				GetWorld()->GetTimerManager().SetTimer(WallJumpTimer, this, &APlatformingCharacter::ResetWallJump, DelayBetweenWallJumps, false);
-			}
-			// no wall jump, try a double jump next
-			else
-			{
-				// only double jump once while we're in the air
-				if (!bHasDoubleJumped)
-				{
-					bHasDoubleJumped = true;
-
-					// use the built-in CMC functionality to do the double jump
-					Jump();
-
-					// enable the jump trail
-					SetJumpTrailState(true);
-				}
-			}
-		}
-
+		// the movement component picks the wall jump or the double jump inside the move, so the server makes the same choice
+		PlatformingMovement->AirJumpPressed();
 	}
 	else
 	{
@@ -173,18 +128,12 @@ void APlatformingCharacter::MultiJump()
 	}
 }
 
-void APlatformingCharacter::ResetWallJump()
-{
-	// reset the wall jump input lock
-	bHasWallJumped = false;
-}
-
 void APlatformingCharacter::DoMove(float Right, float Forward)
 {
 	if (GetController() != nullptr)
 	{
 		// momentarily disable movement inputs if we've just wall jumped
-		if (!bHasWallJumped)
+		if (!HasWallJumped())
 		{
 			// find out which way is forward
 			const FRotator Rotation = GetController()->GetControlRotation();
@@ -216,33 +165,14 @@ void APlatformingCharacter::DoLook(float Yaw, float Pitch)
 void APlatformingCharacter::DoDash()
 {
 	// ignore the input if we've already dashed and have yet to reset
-	if (bHasDashed)
+	if (GetPlatformingMovement()->HasDashed())
 		return;
 
-	// raise the dash flags
-	bIsDashing = true;
-	bHasDashed = true;
-
-	// disable gravity while dashing
-	GetCharacterMovement()->GravityScale = 0.0f;
-
-	// reset the character velocity so we don't carry momentum into the dash
-	GetCharacterMovement()->Velocity = FVector::ZeroVector;
+	// the movement component starts the dash in the next move and plays the dash montage
+	GetPlatformingMovement()->DashPressed();
 
 	// enable the jump trails
 	SetJumpTrailState(true);
-
-	// play the dash montage
-	if (UAnimInstance* AnimInstance = GetMesh()->GetAnimInstance())
-	{
-		const float MontageLength = AnimInstance->Montage_Play(DashMontage, 1.0f, EMontagePlayReturnType::MontageLength, 0.0f, true);
-
-		// has the montage played successfully?
-		if (MontageLength > 0.0f)
-		{
-			AnimInstance->Montage_SetEndDelegate(OnDashMontageEnded, DashMontage);
-		}
-	}
 }
 
 void APlatformingCharacter::DoJumpStart()
@@ -257,50 +187,74 @@ void APlatformingCharacter::DoJumpEnd()
 	StopJumping();
 }
 
-void APlatformingCharacter::DashMontageEnded(UAnimMontage* Montage, bool bInterrupted)
+void APlatformingCharacter::AirJumped()
 {
-	// if the montage was interrupted, end the dash
-	if (bInterrupted)
-	{
-		EndDash();
-	}
+	// enable the jump trail
+	SetJumpTrailState(true);
 }
 
-void APlatformingCharacter::EndDash()
+void APlatformingCharacter::DashEnded()
 {
-	// restore gravity
-	GetCharacterMovement()->GravityScale = 2.5f;
-
-	// reset the dashing flag
-	bIsDashing = false;
-
 	// are we grounded after the dash?
 	if (GetCharacterMovement()->IsMovingOnGround())
 	{
-		// reset the dash usage flag, since we won't receive a landed event
-		bHasDashed = false;
-
 		// deactivate the jump trails
 		SetJumpTrailState(false);
 	}
 }
 
+float APlatformingCharacter::GetDashDuration() const
+{
+	if (!DashMontage)
+	{
+		return GetPlatformingMovement()->DashDuration;
+	}
+
+	// the End Dash notify marks where control returns to the player
+	for (const FAnimNotifyEvent& NotifyEvent : DashMontage->Notifies)
+	{
+		if (Cast<UAnimNotify_EndDash>(NotifyEvent.Notify))
+		{
+			return NotifyEvent.GetTriggerTime();
+		}
+	}
+
+	return DashMontage->GetPlayLength();
+}
+
 bool APlatformingCharacter::HasDoubleJumped() const
 {
-	return bHasDoubleJumped;
+	return GetPlatformingMovement()->HasDoubleJumped();
 }
 
 bool APlatformingCharacter::HasWallJumped() const
 {
-	return bHasWallJumped;
+	return GetPlatformingMovement()->HasWallJumped();
+}
+
+UPlatformingMovementComponent* APlatformingCharacter::GetPlatformingMovement() const
+{
+	return CastChecked<UPlatformingMovementComponent>(GetCharacterMovement());
 }
 
-void APlatformingCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+void APlatformingCharacter::BeginPlay()
 {
-	Super::EndPlay(EndPlayReason);
+	Super::BeginPlay();
+
+	// the dash runs on move time, as long as the montage takes to reach its End Dash notify
+	UPlatformingMovementComponent* PlatformingMovement = GetPlatformingMovement();
+	PlatformingMovement->DashMontage = DashMontage;
+	PlatformingMovement->DashDuration = GetDashDuration();
+
+	// cosmetics follow the predicted abilities
+	PlatformingMovement->OnAirJumped.AddUObject(this, &APlatformingCharacter::AirJumped);
+	PlatformingMovement->OnDashEnded.AddUObject(this, &APlatformingCharacter::DashEnded);
 
-	// clear the wall jump reset timer
-	GetWorld()->GetTimerManager().ClearTimer(WallJumpTimer);
+	// dedicated servers don't need the camera lag or the camera collision probe
+	if (!CustomCMC::ShouldRunCosmetics(this))
+	{
+		CameraBoom->SetComponentTickEnabled(false);
+	}
 }
 
 void APlatformingCharacter::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
@@ -329,10 +283,6 @@ void APlatformingCharacter::Landed(const FHitResult& Hit)
 {
 	Super::Landed(Hit);
 
-	// reset the double jump and dash flags
-	bHasDoubleJumped = false;
-	bHasDashed = false;
-
 	// deactivate the jump trail
 	SetJumpTrailState(false);
 }
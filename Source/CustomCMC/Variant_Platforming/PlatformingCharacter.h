@@ -13,6 +13,7 @@ class UCameraComponent;
 class UInputAction;
 struct FInputActionValue;
 class UAnimMontage;
+class UPlatformingMovementComponent;
 
 /**
  *  An enhanced Third Person Character with the following functionality:
@@ -21,6 +22,7 @@ class UAnimMontage;
  *  - Double Jump
  *  - Wall Jump
  *  - Dash
+ *  The jumps and the dash are predicted by UPlatformingMovementComponent, the character only routes input and cosmetics
  */
 UCLASS(abstract)
 class APlatformingCharacter : public ACharacter
@@ -60,7 +62,7 @@ protected:
 public:
 
 	/** Constructor */
-	APlatformingCharacter();
+	APlatformingCharacter(const FObjectInitializer& ObjectInitializer);
 
 protected:
 
@@ -76,9 +78,6 @@ protected:
 	/** Called for jump pressed to check for advanced multi-jump conditions */
 	void MultiJump();
 
-	/** Resets the wall jump input lock */
-	void ResetWallJump();
-
 public:
 
 	/** Handles move inputs from either controls or UI interfaces */
@@ -103,18 +102,19 @@ public:
 
 protected:
 
-	/** Called from a delegate when the dash montage ends */
-	void DashMontageEnded(UAnimMontage* Montage, bool bInterrupted);
+	/** Called by the movement component after a wall jump or double jump */
+	void AirJumped();
+
+	/** Called by the movement component when the dash ends */
+	void DashEnded();
+
+	/** Returns the time of the End Dash notify in the dash montage, which is how long the dash lasts */
+	float GetDashDuration() const;
 
 	/** Passes control to Blueprint to enable or disable jump trails */
 	UFUNCTION(BlueprintImplementableEvent, Category="Platforming")
 	void SetJumpTrailState(bool bEnabled);
 
-public:
-
-	/** Ends the dash state */
-	void EndDash();
-
 public:
 
 	/** Returns true if the character has just double jumped */
@@ -127,49 +127,17 @@ public:
 
 public:	
 	
-	/** EndPlay cleanup */
-	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	/** Hands the dash setup to the movement component */
+	virtual void BeginPlay() override;
 
 	/** Sets up input action bindings */
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
-	/** Handle landings to reset dash and advanced jump state */
+	/** Handle landings to turn off the jump trail */
 	virtual void Landed(const FHitResult& Hit) override;
 
 protected:
 
-	/** movement state flag bits, packed into a uint8 for memory efficiency */
-	uint8 bHasWallJumped : 1;
-	uint8 bHasDoubleJumped : 1;
-	uint8 bHasDashed : 1;
-	uint8 bIsDashing : 1;
-
-	/** timer for wall jump input reset */
-	FTimerHandle WallJumpTimer;
-
-	/** Dash montage ended delegate */
-	FOnMontageEnded OnDashMontageEnded;
-
-	/** Distance to trace ahead of the character to look for walls to jump from */
-	UPROPERTY(EditAnywhere, Category="Wall Jump")
-	float WallJumpTraceDistance = 50.0f;
-
-	/** Radius of the wall jump sphere trace check */
-	UPROPERTY(EditAnywhere, Category="Wall Jump")
-	float WallJumpTraceRadius = 25.0f;
-
-	/** Impulse to apply away from the wall when wall jumping */
-	UPROPERTY(EditAnywhere, Category="Wall Jump")
-	float WallJumpBounceImpulse = 800.0f;
-
-	/** Vertical impulse to apply when wall jumping */
-	UPROPERTY(EditAnywhere, Category="Wall Jump")
-	float WallJumpVerticalImpulse = 900.0f;
-
-	/** Time to ignore jump inputs after a wall jump */
-	UPROPERTY(EditAnywhere, Category="Wall Jump")
-	float DelayBetweenWallJumps = 0.1f;
-
 	/** AnimMontage to use for the Dash action */
 	UPROPERTY(EditAnywhere, Category="Dash")
 	UAnimMontage* DashMontage;
@@ -181,4 +149,7 @@ public:
 	/** Returns FollowCamera subobject **/
 	FORCEINLINE class UCameraComponent* GetFollowCamera() const { return FollowCamera; }
 
+	/** Returns the movement component that predicts the jumps and the dash **/
+	UPlatformingMovementComponent* GetPlatformingMovement() const;
+
 };
@@ -2,7 +2,7 @@
 
 
 #include "SideScrollingCharacter.h"
-#include "GameFramework/CharacterMovementComponent.h"
+#include "PlatformingMovementComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Camera/CameraComponent.h"
 #include "Components/InputComponent.h"
@@ -11,10 +11,9 @@
 #include "InputAction.h"
 #include "Engine/World.h"
 #include "SideScrollingInteractable.h"
-#include "Kismet/KismetMathLibrary.h"
-#include "TimerManager.h"
 
-ASideScrollingCharacter::ASideScrollingCharacter()
+ASideScrollingCharacter::ASideScrollingCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UPlatformingMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
 	PrimaryActorTick.bCanEverTick = true;
 
@@ -55,16 +54,20 @@ ASideScrollingCharacter::ASideScrollingCharacter()
 	GetCharacterMovement()->SetPlaneConstraintNormal(FVector(0.0f, 1.0f, 0.0f));
 	GetCharacterMovement()->bConstrainToPlane = true;
 
-	// enable double jump
-	JumpMaxCount = 2;
-}
+	// wall jump off the wall we're pushing against, no sweep radius
+	UPlatformingMovementComponent* PlatformingMovement = GetPlatformingMovement();
+	PlatformingMovement->WallJumpProbe = EWallJumpProbe::Input;
+	PlatformingMovement->WallJumpTraceDistance = 50.0f;
+	PlatformingMovement->WallJumpTraceRadius = 0.0f;
+	PlatformingMovement->WallJumpHorizontalImpulse = 500.0f;
+	PlatformingMovement->WallJumpVerticalJumpZScale = 1.4f;
+	PlatformingMovement->bWallJumpKeepsNormalZ = false;
 
-void ASideScrollingCharacter::EndPlay(EEndPlayReason::Type EndPlayReason)
-{
-	Super::EndPlay(EndPlayReason);
+	// disable input for a bit after a wall jump to preserve momentum
+	PlatformingMovement->WallJumpLockout = 0.3f;
 
-	// clear the wall jump timer
-	GetWorld()->GetTimerManager().ClearTimer(WallJumpTimer);
+	// enable double jump
+	JumpMaxCount = 2;
 }
 
 void ASideScrollingCharacter::SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent)
@@ -115,12 +118,6 @@ void ASideScrollingCharacter::NotifyHit(class UPrimitiveComponent* MyComp, AActo
 	}
 }
 
-void ASideScrollingCharacter::Landed(const FHitResult& Hit)
-{
-	// reset the double jump
-	bHasDoubleJumped = false;
-}
-
 void ASideScrollingCharacter::Move(const FInputActionValue& Value)
 {
 	FVector2D MoveVector = Value.Get<FVector2D>();
@@ -144,7 +141,7 @@ void ASideScrollingCharacter::DropReleased(const FInputActionValue& Value)
 void ASideScrollingCharacter::DoMove(float Forward)
 {
 	// is movement temporarily disabled after wall jumping?
-	if (!bHasWallJumped)
+	if (!HasWallJumped())
 	{
 		// save the movement values
 		ActionValueY = Forward;
@@ -222,56 +219,8 @@ void ASideScrollingCharacter::MultiJump()
 		return;
 	}
 
-	// if we have a horizontal input, try for wall jump first
-	if (!bHasWallJumped && !FMath::IsNearlyZero(ActionValueY))
-	{
-		// trace ahead of the character for walls
-		FHitResult OutHit;
-
-		const FVector Start = GetActorLocation();
-		const FVector End = Start + (FVector(ActionValueY > 0.0f ? 1.0f : -1.0f, 0.0f, 0.0f) * WallJumpTraceDistance);
-
-		FCollisionQueryParams QueryParams;
-		QueryParams.AddIgnoredActor(this);
-
-		GetWorld()->LineTraceSingleByChannel(OutHit, Start, End, ECC_Visibility, QueryParams);
-
-		if (OutHit.bBlockingHit)
-		{
-			// rotate to the bounce direction
-			const FRotator BounceRot = UKismetMathLibrary::MakeRotFromX(OutHit.ImpactNormal);
-			SetActorRotation(FRotator(0.0f, BounceRot.Yaw, 0.0f));
-
-			// calculate the impulse vector
-			FVector WallJumpImpulse = OutHit.ImpactNormal * WallJumpHorizontalImpulse;
-			WallJumpImpulse.Z = GetCharacterMovement()->JumpZVelocity * WallJumpVerticalMultiplier;
-
-			// launch the character away from the wall
-			LaunchCharacter(WallJumpImpulse, true, true);
-
-			// enable wall jump lockout for a bit
-			bHasWallJumped = true;
-
-			// schedule wall jump lockout reset
-			GetWorld()->GetTimerManager().SetTimer(WallJumpTimer, this, &ASideScrollingCharacter::ResetWallJump, DelayBetweenWallJumps, false);
-
-			return;
-		}
-	}
-
-	// test for double jump only if we haven't already tested for wall jump
-	if (!bHasWallJumped)
-	{
-		// The movement component handles double jump but we still need to manage the flag for animation
-		if (!bHasDoubleJumped)
-		{
-			// raise the double jump flag
-			bHasDoubleJumped = true;
-
-			// let the CMC handle jump
-			Jump();
-		}
-	}
+	// the movement component tries the wall jump, then the double jump, inside the move so the server makes the same choice
+	GetPlatformingMovement()->AirJumpPressed();
 }
 
 void ASideScrollingCharacter::CheckForSoftCollision()
@@ -301,12 +250,6 @@ void ASideScrollingCharacter::CheckForSoftCollision()
 	}
 }
 
-void ASideScrollingCharacter::ResetWallJump()
-{
-	// reset the wall jump flag
-	bHasWallJumped = false;
-}
-
 void ASideScrollingCharacter::SetSoftCollision(bool bEnabled)
 {
 	// enable or disable collision response to the soft collision channel
@@ -315,10 +258,15 @@ void ASideScrollingCharacter::SetSoftCollision(bool bEnabled)
 
 bool ASideScrollingCharacter::HasDoubleJumped() const
 {
-	return bHasDoubleJumped;
+	return GetPlatformingMovement()->HasDoubleJumped();
 }
 
 bool ASideScrollingCharacter::HasWallJumped() const
 {
-	return bHasWallJumped;
+	return GetPlatformingMovement()->HasWallJumped();
+}
+
+UPlatformingMovementComponent* ASideScrollingCharacter::GetPlatformingMovement() const
+{
+	return CastChecked<UPlatformingMovementComponent>(GetCharacterMovement());
 }
@@ -7,11 +7,13 @@
 #include "SideScrollingCharacter.generated.h"
 
 class UCameraComponent;
+class UPlatformingMovementComponent;
 class UInputAction;
 struct FInputActionValue;
 
 /**
  *  A player-controllable character side scrolling game
+ *  Wall jumps and double jumps are predicted by UPlatformingMovementComponent
  */
 UCLASS(abstract)
 class ASideScrollingCharacter : public ACharacter
@@ -44,26 +46,10 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Side Scrolling")
 	float InteractionRadius = 200.0f;
 
-	/** Time to disable input after a wall jump to preserve momentum */
-	UPROPERTY(EditAnywhere, Category="Side Scrolling")
-	float DelayBetweenWallJumps = 0.3f;
-
 	/** Impulse to manually push physics objects while we're in midair */
 	UPROPERTY(EditAnywhere, Category="Side Scrolling")
 	float JumpPushImpulse = 600.0f;
 
-	/** Distance to trace ahead of the character for wall jumps */
-	UPROPERTY(EditAnywhere, Category="Side Scrolling")
-	float WallJumpTraceDistance = 50.0f;
-
-	/** Horizontal impulse to apply to the character during wall jumps */
-	UPROPERTY(EditAnywhere, Category="Side Scrolling")
-	float WallJumpHorizontalImpulse = 500.0f;
-
-	/** Multiplies the jump Z velocity for wall jumps. */
-	UPROPERTY(EditAnywhere, Category="Side Scrolling")
-	float WallJumpVerticalMultiplier = 1.4f;
-
 	/** Collision object type to use for soft collision traces (dropping down floors) */
 	UPROPERTY(EditAnywhere, Category="Side Scrolling")
 	TEnumAsByte<ECollisionChannel> SoftCollisionObjectType;
@@ -72,43 +58,28 @@ protected:
 	UPROPERTY(EditAnywhere, Category="Side Scrolling")
 	float SoftCollisionTraceDistance = 1000.0f;
 
-	/** Wall jump lockout timer */
-	FTimerHandle WallJumpTimer;
-
 	/** Last captured horizontal movement input value */
 	float ActionValueY = 0.0f;
 
 	/** Last captured platform drop axis value */
 	float DropValue = 0.0f;
 
-	/** If true, this character has already wall jumped */
-	bool bHasWallJumped = false;
-
-	/** If true, this character has already double jumped */
-	bool bHasDoubleJumped = false;
-
 	/** If true, this character is moving along the side scrolling axis */
 	bool bMovingHorizontally = false;
 
 public:
 	
 	/** Constructor */
-	ASideScrollingCharacter();
+	ASideScrollingCharacter(const FObjectInitializer& ObjectInitializer);
 
 protected:
 
-	/** Gameplay cleanup */
-	virtual void EndPlay(EEndPlayReason::Type EndPlayReason) override;
-
 	/** Initialize input action bindings */
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
 	/** Collision handling */
 	virtual void NotifyHit(class UPrimitiveComponent* MyComp, AActor* Other, class UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation, FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit) override;
 
-	/** Landing handling */
-	virtual void Landed(const FHitResult& Hit) override;
-
 protected:
 
 	/** Called for movement input */
@@ -150,9 +121,6 @@ protected:
 	/** Checks for soft collision with platforms */
 	void CheckForSoftCollision();
 
-	/** Resets wall jump lockout. Called from timer after a wall jump */
-	void ResetWallJump();
-
 public:
 
 	/** Sets the soft collision response. True passes, False blocks */
@@ -167,4 +135,7 @@ public:
 	/** Returns true if the character has just wall jumped */
 	UFUNCTION(BlueprintPure, Category="Side Scrolling")
 	bool HasWallJumped() const;
+
+	/** Returns the movement component that predicts the jumps */
+	UPlatformingMovementComponent* GetPlatformingMovement() const;
 };
@@ -10,6 +10,7 @@ public class CustomCMCEditorTarget : TargetRules
 		Type = TargetType.Editor;
 		DefaultBuildSettings = BuildSettingsVersion.V5;
 		IncludeOrderVersion = EngineIncludeOrderVersion.Unreal5_6;
+		bWithPushModel = true;
 		ExtraModuleNames.Add("CustomCMC");
 	}
 }